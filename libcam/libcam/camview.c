@@ -51,6 +51,9 @@ extern int debug_level;//debug
 __MUTEX_TYPE capture_mutex = __STATIC_MUTEX_INIT;//初始化静态锁
 __COND_TYPE capture_cond;
 
+#define AUDIO_WAIT_TIMEOUT_MS 50 /*max audio wait before checking the capture flags*/
+#define AUDIO_METER_FRAME_SIZE 1024 /*capture frames per buffer while only metering*/
+
 static int render = RENDER_SDL; /*render API*/
 static int quit = 0; /*terminate flag*/
 static int save_image = 0; /*save image flag*/
@@ -110,6 +113,36 @@ static char status_message[80];
 
 static int encode_thread_running = 0;
 
+/*
+ * pre-roll: the encoder thread runs without a file (armed) and keeps
+ * the last seconds of encoded packets; start_encoder_thread only
+ * requests the armed thread to open the file and splice them
+ *
+ * record ready: with no pre-roll the armed thread only keeps the
+ * encoder contexts open (no frames are encoded and the audio capture
+ * is not started) so the first frame is encoded right after the click
+ */
+static int record_ready = 0;       /*arm the encoder thread without pre-roll*/
+static int high_bit_depth = 0;     /*p010/p016 frames for 10 and 16 bit formats*/
+static int preroll_armed = 0;      /*encoder thread running without a file*/
+static int armed_feed = 0;         /*frames are encoded while armed (pre-roll)*/
+static int record_request = 0;     /*armed thread must start recording*/
+static int armed_start = 0;        /*encoder thread was started armed*/
+static int armed_video_codec = -1; /*settings of the armed encoder*/
+static int armed_audio_codec = -1;
+static int armed_muxer = -1;
+static __MUTEX_TYPE encoder_state_mutex = __STATIC_MUTEX_INIT;
+
+static uint64_t record_click_ts = 0;  /*start_encoder_thread call time*/
+static int64_t record_latency = -1;   /*click to first encoded frame (ns)*/
+
+/*level metering while previewing (audio stream without buffering)*/
+static int audio_meter_enabled = 0;   /*meter audio while previewing*/
+static int audio_meter_preview = 0;   /*preview is running*/
+static int audio_meter_running = 0;   /*audio stream runs in metering only mode*/
+static int audio_meter_recording = 0; /*audio stream is owned by the encoder*/
+static __MUTEX_TYPE audio_meter_mutex = __STATIC_MUTEX_INIT;
+
 
 void set_video_time_capture(double video_time)
 {
@@ -315,6 +348,36 @@ int video_capture_get_save_video()
     return save_video;
 }
 
+/*
+ * gets the encoder input flag (frames must be added to the encoder)
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 1 if recording or the pre-roll is armed, 0 otherwise
+ */
+int video_capture_get_encoder_input()
+{
+    return save_video || (preroll_armed && armed_feed);
+}
+
+/*
+ * gets the encoder thread active flag
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 1 if recording or armed, 0 otherwise
+ */
+static int encoder_thread_active()
+{
+    return save_video || preroll_armed;
+}
+
 /*
  * sets the save image flag
  * args:
@@ -527,6 +590,8 @@ int get_resolution_status()
 v4l2_dev_t *get_v4l2_dev(const char *device)
 {
     my_vd = v4l2core_init_dev(device);
+    if(my_vd)
+        v4l2core_set_high_bit_depth(my_vd, high_bit_depth);
 
     return my_vd;
 }
@@ -622,12 +687,76 @@ audio_context_t *get_audio_context()
  */
 void close_audio_context()
 {
+    /*stop the metering stream of the old context*/
+    __LOCK_MUTEX(&audio_meter_mutex);
+    if(audio_meter_running && my_audio_ctx != NULL)
+    {
+        audio_stop(my_audio_ctx);
+        audio_set_meter_only(my_audio_ctx, 0);
+    }
+    audio_meter_running = 0;
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+
     if(my_audio_ctx != NULL)
         audio_close(my_audio_ctx);
 
     my_audio_ctx = NULL;
 }
 
+/*
+ * start the audio stream in metering only mode if it is wanted
+ *   must be called with audio_meter_mutex locked
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void audio_meter_update_locked()
+{
+    audio_context_t *audio_ctx = get_audio_context();
+    int want = audio_meter_enabled && audio_meter_preview &&
+        !audio_meter_recording && audio_ctx != NULL;
+
+    if(want && !audio_meter_running)
+    {
+        audio_set_meter_only(audio_ctx, 1);
+        audio_set_cap_buffer_size(audio_ctx,
+            AUDIO_METER_FRAME_SIZE * audio_get_channels(audio_ctx));
+        if(audio_start(audio_ctx) == 0)
+        {
+            audio_meter_running = 1;
+
+            /*enable vu meter OSD display (levels set by update_audio_metering)*/
+            uint32_t osd_mask = render_get_osd_mask();
+            if(audio_get_channels(audio_ctx) > 1)
+                osd_mask |= REND_OSD_VUMETER_STEREO;
+            else
+                osd_mask |= REND_OSD_VUMETER_MONO;
+            render_set_osd_mask(osd_mask);
+        }
+        else
+            audio_set_meter_only(audio_ctx, 0);
+    }
+    else if(!want && audio_meter_running)
+    {
+        if(audio_ctx)
+        {
+            audio_stop(audio_ctx);
+            audio_set_meter_only(audio_ctx, 0);
+        }
+        audio_meter_running = 0;
+
+        /*reset vu meter and disable OSD vumeter*/
+        float vu_level[2] = {0, 0};
+        render_set_vu_level(vu_level);
+        render_set_osd_mask(render_get_osd_mask() &
+            ~(REND_OSD_VUMETER_STEREO | REND_OSD_VUMETER_MONO));
+    }
+}
+
 /*
  * audio processing loop (should run in a separate thread)
  * args:
@@ -661,6 +790,12 @@ static void *audio_processing_loop(void *data)
     //	frame_size = 1024;
 
     //初始化音频样本获取缓存大小
+    /*the metering stream is restarted with the encoder buffer size*/
+    __LOCK_MUTEX(&audio_meter_mutex);
+    audio_meter_recording = 1;
+    audio_meter_update_locked();
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+
     audio_set_cap_buffer_size(audio_ctx,
         frame_size * audio_get_channels(audio_ctx));
     audio_start(audio_ctx);
@@ -686,7 +821,7 @@ static void *audio_processing_loop(void *data)
 
     render_set_osd_mask(osd_mask);
 
-    while(video_capture_get_save_video())
+    while(encoder_thread_active())
     {
         if(get_capture_pause())
         {
@@ -695,6 +830,8 @@ static void *audio_processing_loop(void *data)
             {
                 audio_pause_timestamp = audio_buff->timestamp - audio_timestamp_tmp;
             }
+            else
+                audio_wait_buffer(audio_ctx, AUDIO_WAIT_TIMEOUT_MS);
             continue;
         }
 
@@ -709,17 +846,18 @@ static void *audio_processing_loop(void *data)
         if(ret > 0) {
             /*
              * no buffers to process
-             * sleep a couple of milisec
+             * block until the capture thread fills one
              */
-             struct timespec req = {
-                .tv_sec = 0,
-                .tv_nsec = 1000000};/*nanosec*/
-             nanosleep(&req, NULL);
+            audio_wait_buffer(audio_ctx, AUDIO_WAIT_TIMEOUT_MS);
         } else if(ret == 0) {
             encoder_ctx->enc_audio_ctx->pts = audio_buff->timestamp - audio_timestamp_reference;
+            encoder_ctx->enc_audio_ctx->capture_ts = audio_buff->capture_ts;
 
-            /*OSD vu meter level*/
-            render_set_vu_level(audio_buff->level_meter);
+            /*OSD vu meter level (published by the metering tap)*/
+            float vu_level[AUDIO_METER_MAX_CHANNELS] = {0};
+            if(audio_get_levels(audio_ctx, vu_level, NULL, AUDIO_METER_MAX_CHANNELS) == 1)
+                vu_level[1] = vu_level[0];
+            render_set_vu_level(vu_level);
 
             encoder_process_audio_buffer(encoder_ctx, audio_buff->data);
         }
@@ -744,9 +882,92 @@ static void *audio_processing_loop(void *data)
     audio_stop(audio_ctx);
     audio_delete_buffer(audio_buff);
 
+    /*back to metering only while the preview runs*/
+    __LOCK_MUTEX(&audio_meter_mutex);
+    audio_meter_recording = 0;
+    audio_meter_update_locked();
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+
     return ((void *) 0);
 }
 
+/*
+ * get the full video file name from the current path and name
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to a new allocated string (must be freed)
+ */
+static char *get_video_filename()
+{
+    char *video_filename = NULL;
+    /*get_video_[name|path] always return a non NULL value*/
+    char *name = strdup(get_video_name());
+    char *path = strdup(get_video_path());
+
+
+    //    if(get_video_sufix_flag())
+    //    {
+    //        char *new_name = add_file_suffix(path, name);
+    //        free(name); /*free old name*/
+    //        name = new_name; /*replace with suffixed name*/
+    //    }
+    int pathsize = strlen(path);
+    if(path[pathsize - 1] != '/')
+        video_filename = smart_cat(path, '/', name);
+    else
+        video_filename = smart_cat(path, 0, name);
+
+    snprintf(status_message, 79, _("saving video to %s"), video_filename);
+    //gui_status_message(status_message);
+
+    free(path);
+    free(name);
+
+    return video_filename;
+}
+
+/*
+ * start the audio processing thread
+ * args:
+ *    encoder_ctx - pointer to encoder context
+ *    audio_ctx - pointer to audio context (can be null)
+ *    thread - pointer to the thread handler
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 1 if the thread was created, 0 otherwise
+ */
+static int start_audio_processing(encoder_context_t *encoder_ctx,
+    audio_context_t *audio_ctx,
+    __THREAD_TYPE *thread)
+{
+    if(encoder_ctx->enc_audio_ctx == NULL || audio_ctx == NULL ||
+        audio_get_channels(audio_ctx) <= 0)
+        return 0;
+
+    if(debug_level > 1)
+        printf("deepin-camera: starting encoder audio thread\n");
+
+    int ret = __THREAD_CREATE(thread, audio_processing_loop, (void *) encoder_ctx);
+
+    if(ret)
+    {
+        fprintf(stderr, "deepin-camera: encoder audio thread creation failed (%i)\n", ret);
+        return 0;
+    }
+
+    if(debug_level > 2)
+        printf("deepin-camera: created audio encoder thread with tid: %u\n",
+            (unsigned int) *thread);
+
+    return 1;
+}
+
 /*
  * encoder loop (should run in a separate thread)
  * args:
@@ -759,7 +980,12 @@ static void *audio_processing_loop(void *data)
  */
 static void *encoder_loop(__attribute__((unused))void *data)
 {
-    my_encoder_status = 1;
+    /*armed: don't report a recording until it is requested*/
+    __LOCK_MUTEX(&encoder_state_mutex);
+    int armed = armed_start;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+    if(!armed)
+        my_encoder_status = 1;
 
     if(debug_level > 1)
         printf("deepin-camera: encoder thread (tid: %u)\n",
@@ -838,55 +1064,78 @@ static void *encoder_loop(__attribute__((unused))void *data)
     }
 
     char *video_filename = NULL;
-    /*get_video_[name|path] always return a non NULL value*/
-    char *name = strdup(get_video_name());
-    char *path = strdup(get_video_path());
-
 
-    //    if(get_video_sufix_flag())
-    //    {
-    //        char *new_name = add_file_suffix(path, name);
-    //        free(name); /*free old name*/
-    //        name = new_name; /*replace with suffixed name*/
-    //    }
-    int pathsize = strlen(path);
-    if(path[pathsize - 1] != '/')
-        video_filename = smart_cat(path, '/', name);
+    if(armed)
+        encoder_muxer_arm(encoder_ctx);
     else
-        video_filename = smart_cat(path, 0, name);
-
-    snprintf(status_message, 79, _("saving video to %s"), video_filename);
-    //gui_status_message(status_message);
+    {
+        video_filename = get_video_filename();
 
-    /*muxer initialization*/
+        /*muxer initialization*/
 
-    encoder_muxer_init(encoder_ctx, video_filename);
+        encoder_muxer_init(encoder_ctx, video_filename);
 
-    /*start video capture*/
-    video_capture_save_video(1);
+        /*start video capture*/
+        video_capture_save_video(1);
+    }
 
 //    int treshold = 358400; /*100 Mbytes*/
 //    int64_t last_check_pts = 0; /*last pts when disk supervisor called*/
 
-    /*start audio processing thread*/
-    if(encoder_ctx->enc_audio_ctx != NULL && audio_get_channels(audio_ctx) > 0)
+    /*start audio processing thread (record ready: on request)*/
+    int audio_running = 0;
+    if(!armed || armed_feed)
+        audio_running = start_audio_processing(encoder_ctx, audio_ctx, &encoder_audio_thread);
+
+    while(encoder_thread_active())
     {
-        if(debug_level > 1)
-            printf("deepin-camera: starting encoder audio thread\n");
+        /*armed: open the file and splice the pre-roll on request*/
+        if(armed)
+        {
+            __LOCK_MUTEX(&encoder_state_mutex);
+            int start = record_request;
+            if(start)
+            {
+                record_request = 0;
+                my_encoder_status = 1;
+                /*keep the encoder input flag set while switching*/
+                video_capture_save_video(1);
+                preroll_armed = 0;
+            }
+            __UNLOCK_MUTEX(&encoder_state_mutex);
+
+            if(start)
+            {
+                armed = 0;
 
-        int ret = __THREAD_CREATE(&encoder_audio_thread, audio_processing_loop, (void *) encoder_ctx);
+                /*raw h264: the recording must start with a IDR frame*/
+                if(encoder_ctx->video_codec_ind == 0 &&
+                    v4l2core_get_requested_frame_format(my_vd) == V4L2_PIX_FMT_H264)
+                    v4l2core_h264_request_idr(my_vd);
 
-        if(ret)
-            fprintf(stderr, "deepin-camera: encoder audio thread creation failed (%i)\n", ret);
-        else if(debug_level > 2)
-            printf("deepin-camera: created audio encoder thread with tid: %u\n",
-                (unsigned int) encoder_audio_thread);
-    }
+                video_filename = get_video_filename();
+                encoder_muxer_init(encoder_ctx, video_filename);
+
+                if(!audio_running)
+                    audio_running = start_audio_processing(encoder_ctx, audio_ctx, &encoder_audio_thread);
+            }
+        }
 
-    while(video_capture_get_save_video())
-    {
         /*process the video buffer*/
-        if(encoder_process_next_video_buffer(encoder_ctx) > 0)
+        int no_buffer = encoder_process_next_video_buffer(encoder_ctx);
+
+        /*click to first encoded frame latency*/
+        if(!no_buffer && !armed && record_latency < 0)
+        {
+            __LOCK_MUTEX(&encoder_state_mutex);
+            record_latency = (int64_t) (v4l2core_time_get_timestamp() - record_click_ts);
+            __UNLOCK_MUTEX(&encoder_state_mutex);
+            if(debug_level > 0)
+                printf("deepin-camera: record start latency %.1f ms\n",
+                    (double) record_latency / 1000000);
+        }
+
+        if(no_buffer > 0)
         {
             /*
              * no buffers to process
@@ -924,15 +1173,18 @@ static void *encoder_loop(__attribute__((unused))void *data)
         printf("deepin-camera: flushing video buffers - done\n");
 
     /*make sure the audio processing thread has stopped*/
-    if(encoder_ctx->enc_audio_ctx != NULL && audio_get_channels(audio_ctx) > 0)
+    if(audio_running)
     {
         if(debug_level > 1)
             printf("deepin-camera: join encoder audio thread\n");
         __THREAD_JOIN(encoder_audio_thread);
     }
 
-    /*close the muxer*/
-    encoder_muxer_close(encoder_ctx);
+    /*close the muxer (or drop the pre-roll if never recorded)*/
+    if(armed)
+        encoder_muxer_disarm();
+    else
+        encoder_muxer_close(encoder_ctx);
 
     /*close the encoder context (clean up)*/
     encoder_close(encoder_ctx);
@@ -946,8 +1198,6 @@ static void *encoder_loop(__attribute__((unused))void *data)
     }
     /*clean strings*/
     free(video_filename);
-    free(path);
-    free(name);
 
     my_encoder_status = 0;
 
@@ -968,6 +1218,8 @@ v4l2_dev_t *create_v4l2_device_handler(const char *device)
 {
 //    cheese_print_log("create_v4l2_device_handler\n");
     my_vd = v4l2core_init_dev(device);
+    if(my_vd)
+        v4l2core_set_high_bit_depth(my_vd, high_bit_depth);
 
     return my_vd;
 }
@@ -1057,30 +1309,20 @@ void *capture_loop(void *data)
             int current_height = v4l2core_get_frame_height(my_vd);
 
             restart = 0; /*reset*/
-            v4l2core_stop_stream(my_vd);
-
-            v4l2core_clean_buffers(my_vd);
 
-            /*try new format (values prepared by the request callback)*/
-            ret = v4l2core_update_current_format(my_vd);
-            /*try to set the video stream format on the device*/
+            /*
+             * try new format (values prepared by the request callback)
+             * frame buffers and decoder are kept whenever possible and
+             * the first listed format is used as fallback
+             */
+            ret = v4l2core_switch_format(my_vd);
             if(ret != E_OK)
             {
-                fprintf(stderr, "deepin-camera: could not set the defined stream format\n");
-                fprintf(stderr, "deepin-camera: trying first listed stream format\n");
-
-                v4l2core_prepare_valid_format(my_vd);
-                v4l2core_prepare_valid_resolution(my_vd);
-                ret = v4l2core_update_current_format(my_vd);
-
-                if(ret != E_OK)
-                {
-                    fprintf(stderr, "deepin-camera: also could not set the first listed stream format\n");
+                fprintf(stderr, "deepin-camera: could not start a video stream in the device\n");
 
-                    //gui_error("Deepin-camera error", "could not start a video stream in the device", 1);
+                //gui_error("Deepin-camera error", "could not start a video stream in the device", 1);
 
-                    return ((void *) -1);
-                }
+                return ((void *) -1);
             }
 
             if((current_width != v4l2core_get_frame_width(my_vd)) ||
@@ -1108,9 +1350,6 @@ void *capture_loop(void *data)
                     v4l2core_get_requested_frame_format(my_vd),
                     v4l2core_get_frame_width(my_vd),
                     v4l2core_get_frame_height(my_vd));
-
-            v4l2core_start_stream(my_vd);
-
         }
 
         /*get the frame from v4l2 core*/
@@ -1196,8 +1435,8 @@ void *capture_loop(void *data)
                 save_image = 0; /*reset*/
             }
 
-            /*save the frame (video)*/
-            if(video_capture_get_save_video())
+            /*save the frame (video or pre-roll)*/
+            if(video_capture_get_encoder_input())
             {
                 int size = (frame->width * frame->height * 3) / 2;
 
@@ -1274,6 +1513,8 @@ void *capture_loop(void *data)
     /*if we are still saving video then stop it*/
     if(video_capture_get_save_video())
         stop_encoder_thread();
+    else
+        stop_encoder_preroll();
 
     render_close();
 
@@ -1292,9 +1533,38 @@ void *capture_loop(void *data)
  */
 int start_encoder_thread(void *data)
 {
+    __LOCK_MUTEX(&encoder_state_mutex);
+    record_click_ts = v4l2core_time_get_timestamp();
+    record_latency = -1;
     if (encode_thread_running)
-        return 0;
+    {
+        if (!preroll_armed || record_request)
+        {
+            __UNLOCK_MUTEX(&encoder_state_mutex);
+            return 0;
+        }
+
+        if (armed_video_codec == get_video_codec_ind() &&
+            armed_audio_codec == get_audio_codec_ind() &&
+            armed_muxer == get_video_muxer())
+        {
+            /*the armed thread opens the file (with the pre-roll)*/
+            record_request = 1;
+            __UNLOCK_MUTEX(&encoder_state_mutex);
+            return 0;
+        }
 
+        /*settings changed since arming: restart unarmed*/
+        preroll_armed = 0;
+        __UNLOCK_MUTEX(&encoder_state_mutex);
+
+        __THREAD_JOIN(encoder_thread);
+
+        __LOCK_MUTEX(&encoder_state_mutex);
+        encode_thread_running = 0;
+    }
+
+    armed_start = 0;
     int ret = __THREAD_CREATE(&encoder_thread, encoder_loop, data);
 
     if(ret) {
@@ -1304,10 +1574,254 @@ int start_encoder_thread(void *data)
             printf("deepin-camera: created encoder thread with tid: %u\n", (unsigned int) encoder_thread);
         encode_thread_running = 1;
     }
+    __UNLOCK_MUTEX(&encoder_state_mutex);
 
     return ret;
 }
 
+/*
+ * set the record ready flag (arm the encoder thread without pre-roll)
+ *   takes effect on the next start_encoder_preroll
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_record_ready(int value)
+{
+    record_ready = value;
+}
+
+/*
+ * get the record ready flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: record ready flag
+ */
+int get_record_ready()
+{
+    return record_ready;
+}
+
+/*
+ * set the high bit depth flag (p010/p016 frames for 10 and 16 bit formats)
+ *   takes effect on the next device handler creation
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_high_bit_depth(int value)
+{
+    high_bit_depth = value ? 1 : 0;
+}
+
+/*
+ * get the high bit depth flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: high bit depth flag
+ */
+int get_high_bit_depth()
+{
+    return high_bit_depth;
+}
+
+/*
+ * set the audio metering flag (meter audio levels while previewing)
+ *   takes effect on the next start_audio_metering
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_audio_metering(int value)
+{
+    __LOCK_MUTEX(&audio_meter_mutex);
+    audio_meter_enabled = value;
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+}
+
+/*
+ * start level metering for the preview
+ *   the audio stream runs without queueing buffers until a
+ *   recording takes it over, levels are published to the OSD
+ *   vu meter by update_audio_metering
+ *   no-op if audio metering is disabled
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void start_audio_metering()
+{
+    __LOCK_MUTEX(&audio_meter_mutex);
+    audio_meter_preview = 1;
+    audio_meter_update_locked();
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+}
+
+/*
+ * publish the preview metering levels to the OSD vu meter
+ *   called by the preview loop for every frame, no-op unless the
+ *   audio stream runs in metering only mode (while recording the
+ *   audio thread publishes the levels)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void update_audio_metering()
+{
+    __LOCK_MUTEX(&audio_meter_mutex);
+    if(audio_meter_running && my_audio_ctx != NULL)
+    {
+        float vu_level[AUDIO_METER_MAX_CHANNELS] = {0};
+        if(audio_get_levels(my_audio_ctx, vu_level, NULL, AUDIO_METER_MAX_CHANNELS) == 1)
+            vu_level[1] = vu_level[0];
+        render_set_vu_level(vu_level);
+    }
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+}
+
+/*
+ * stop level metering for the preview
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void stop_audio_metering()
+{
+    __LOCK_MUTEX(&audio_meter_mutex);
+    audio_meter_preview = 0;
+    audio_meter_update_locked();
+    __UNLOCK_MUTEX(&audio_meter_mutex);
+}
+
+/*
+ * get the latency from the last start_encoder_thread call to
+ * the first encoded frame of the recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: latency in nanoseconds (-1 if no frame was encoded yet)
+ */
+int64_t get_record_start_latency()
+{
+    __LOCK_MUTEX(&encoder_state_mutex);
+    int64_t latency = record_latency;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+
+    return latency;
+}
+
+/*
+ * start the encoder thread armed (pre-roll or record ready)
+ *   no-op if both are disabled or the encoder thread is running
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int start_encoder_preroll()
+{
+    if(encoder_get_preroll() <= 0 && !record_ready)
+        return 0;
+
+    __LOCK_MUTEX(&encoder_state_mutex);
+    if(encode_thread_running)
+    {
+        __UNLOCK_MUTEX(&encoder_state_mutex);
+        return 0;
+    }
+
+    preroll_armed = 1;
+    armed_feed = encoder_get_preroll() > 0;
+    armed_start = 1;
+    record_request = 0;
+    armed_video_codec = get_video_codec_ind();
+    armed_audio_codec = get_audio_codec_ind();
+    armed_muxer = get_video_muxer();
+
+    int ret = __THREAD_CREATE(&encoder_thread, encoder_loop, NULL);
+
+    if(ret) {
+        fprintf(stderr, "deepin-camera: encoder (armed) thread creation failed (%i)\n", ret);
+        preroll_armed = 0;
+    } else
+        encode_thread_running = 1;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+
+    return ret;
+}
+
+/*
+ * stop the armed encoder thread (drops the pre-roll)
+ *   no-op if recording: use stop_encoder_thread
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int stop_encoder_preroll()
+{
+    __LOCK_MUTEX(&encoder_state_mutex);
+    if(!encode_thread_running || !preroll_armed || record_request)
+    {
+        __UNLOCK_MUTEX(&encoder_state_mutex);
+        return 0;
+    }
+    preroll_armed = 0;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+
+    __THREAD_JOIN(encoder_thread);
+
+    __LOCK_MUTEX(&encoder_state_mutex);
+    encode_thread_running = 0;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+
+    if(debug_level > 1)
+        printf("deepin-camera: encoder (armed) thread terminated and joined\n");
+
+    return 0;
+}
+
 /*
  * stop the encoder thread
  * args:
@@ -1320,7 +1834,12 @@ int start_encoder_thread(void *data)
  */
 int stop_encoder_thread()
 {
+    __LOCK_MUTEX(&encoder_state_mutex);
     video_capture_save_video(0);
+    preroll_armed = 0;
+    record_request = 0;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
+
     if(0 != (int)(get_video_time_capture()))
         set_video_time_capture(0);
 
@@ -1331,7 +1850,9 @@ int stop_encoder_thread()
     if(debug_level > 1)
         printf("deepin-camera: encoder thread terminated and joined\n");
 
+    __LOCK_MUTEX(&encoder_state_mutex);
     encode_thread_running = 0;
+    __UNLOCK_MUTEX(&encoder_state_mutex);
 
     return 0;
 }
@@ -286,6 +286,18 @@ extern void reset_video_timer(void);
 
 extern int video_capture_get_save_video(void);
 
+/*
+ * gets the encoder input flag (frames must be added to the encoder)
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 1 if recording or the pre-roll is armed, 0 otherwise
+ */
+int video_capture_get_encoder_input();
+
 void video_capture_save_image(void);
 
 /*
@@ -411,6 +423,152 @@ int start_encoder_thread();
  */
 extern int stop_encoder_thread(void);
 
+/*
+ * start the encoder thread armed (pre-roll or record ready)
+ *   no-op if both are disabled or the encoder thread is running
+ *   start_encoder_thread then opens the file (splicing the pre-roll)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int start_encoder_preroll();
+
+/*
+ * stop the armed encoder thread (drops the pre-roll)
+ *   no-op if recording: use stop_encoder_thread
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int stop_encoder_preroll();
+
+/*
+ * set the record ready flag (arm the encoder thread without pre-roll)
+ *   takes effect on the next start_encoder_preroll
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_record_ready(int value);
+
+/*
+ * get the record ready flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: record ready flag
+ */
+int get_record_ready();
+
+/*
+ * set the high bit depth flag (p010/p016 frames for 10 and 16 bit formats)
+ *   takes effect on the next device handler creation
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_high_bit_depth(int value);
+
+/*
+ * get the high bit depth flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: high bit depth flag
+ */
+int get_high_bit_depth();
+
+/*
+ * set the audio metering flag (meter audio levels while previewing)
+ *   takes effect on the next start_audio_metering
+ * args:
+ *   value - 1 enable, 0 disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_audio_metering(int value);
+
+/*
+ * start level metering for the preview
+ *   the audio stream runs without queueing buffers until a
+ *   recording takes it over, levels are published to the OSD
+ *   vu meter by update_audio_metering
+ *   no-op if audio metering is disabled
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void start_audio_metering();
+
+/*
+ * publish the preview metering levels to the OSD vu meter
+ *   called by the preview loop for every frame, no-op unless the
+ *   audio stream runs in metering only mode (while recording the
+ *   audio thread publishes the levels)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void update_audio_metering();
+
+/*
+ * stop level metering for the preview
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void stop_audio_metering();
+
+/*
+ * get the latency from the last start_encoder_thread call to
+ * the first encoded frame of the recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: latency in nanoseconds (-1 if no frame was encoded yet)
+ */
+int64_t get_record_start_latency();
+
 /*
  * capture loop (should run in a separate thread)
  * args:
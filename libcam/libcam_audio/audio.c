@@ -38,6 +38,19 @@
 #include <math.h>
 #include <errno.h>
 #include <assert.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -51,11 +64,19 @@
   #include "audio_pulseaudio.h"
 #endif
 
-#define AUDBUFF_NUM     80    /*number of audio buffers*/
+#define AUDBUFF_TIME_MS 2000  /*audio ring latency target (max consumer stall)*/
+#define AUDBUFF_MIN_NUM 8     /*min number of audio buffers*/
 #define AUDBUFF_FRAMES  1152  /*number of audio frames per buffer*/
+
+/*
+ * single producer (capture callback) single consumer (encoder thread) ring
+ *   indexes are free running counters, slot = index & (audio_buff_num - 1)
+ *   write index is only stored by the producer, read index only by the consumer
+ */
 static audio_buff_t *audio_buffers = NULL; /*pointer to buffers list*/
-static int buffer_read_index = 0; /*current read index of buffer list*/
-static int buffer_write_index = 0;/*current write index of buffer list*/
+static uint32_t audio_buff_num = 0;       /*number of buffers (power of 2)*/
+static uint32_t buffer_read_index = 0;    /*current read index of buffer list*/
+static uint32_t buffer_write_index = 0;   /*current write index of buffer list*/
 
 extern int verbosity;
 
@@ -116,8 +137,8 @@ void audio_unlock_mutex(audio_context_t *audio_ctx)
  */
 static void audio_free_buffers()
 {
-	buffer_read_index = 0;
-	buffer_write_index = 0;
+	__atomic_store_n(&buffer_read_index, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&buffer_write_index, 0, __ATOMIC_RELEASE);
 
 	/*return if no buffers set*/
 	if(!audio_buffers)
@@ -129,13 +150,14 @@ static void audio_free_buffers()
 
 	int i = 0;
 
-	for(i = 0; i < AUDBUFF_NUM; ++i)
+	for(i = 0; i < (int) audio_buff_num; ++i)
 	{
 		free(audio_buffers[i].data);
 	}
 
 	free(audio_buffers);
 	audio_buffers = NULL;
+	audio_buff_num = 0;
 }
 
 /*
@@ -239,14 +261,29 @@ static int audio_init_buffers(audio_context_t *audio_ctx)
 	/*free audio_buffers (if any)*/
 	audio_free_buffers();
 
-	audio_buffers = calloc(AUDBUFF_NUM, sizeof(audio_buff_t));
+	/*enough buffers to cover the latency target, rounded up to a power of 2*/
+	int buff_frames = audio_ctx->capture_buff_size / (audio_ctx->channels > 0 ? audio_ctx->channels : 1);
+	int64_t needed = ((int64_t) audio_ctx->samprate * AUDBUFF_TIME_MS / 1000 + buff_frames - 1) /
+		(buff_frames > 0 ? buff_frames : 1);
+	audio_buff_num = AUDBUFF_MIN_NUM;
+	while((int64_t) audio_buff_num < needed && audio_buff_num < (1u << 16))
+		audio_buff_num <<= 1;
+
+	if(verbosity > 1)
+		printf("AUDIO: audio ring with %u buffers of %i frames\n", audio_buff_num, buff_frames);
+
+	__atomic_store_n(&audio_ctx->dropped_buffers, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&audio_ctx->input_overflows, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&audio_ctx->input_underflows, 0, __ATOMIC_RELAXED);
+
+	audio_buffers = calloc(audio_buff_num, sizeof(audio_buff_t));
 	if(audio_buffers == NULL)
 	{
 		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_init_buffers): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-	for(i = 0; i < AUDBUFF_NUM; ++i)
+	for(i = 0; i < (int) audio_buff_num; ++i)
 	{
 		audio_buffers[i].data = calloc(
 			audio_ctx->capture_buff_size, sizeof(sample_t));
@@ -263,6 +300,8 @@ static int audio_init_buffers(audio_context_t *audio_ctx)
 
 /*
  * fill a audio buffer data and move write index to next one
+ *   runs on the capture (real time) thread: no locks, allocation or stdio,
+ *   dropped buffers are only counted and get reported by the consumer
  * args:
  *   audio_ctx - pointer to audio context data
  *   ts - timestamp for end of data
@@ -277,8 +316,6 @@ void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts)
 	/*assertions*/
 	assert(audio_ctx != NULL);
 
-	if(verbosity > 3)
-		printf("AUDIO: filling buffer ts:%" PRId64 "\n", ts);
 	/*in nanosec*/
 	uint64_t frame_length = NSEC_PER_SEC / audio_ctx->samprate;
 	uint64_t buffer_length = frame_length * (audio_ctx->capture_buff_size / audio_ctx->channels);
@@ -287,140 +324,545 @@ void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts)
 
 	audio_ctx->ts_drift = audio_ctx->current_ts - ts;
 
-	/*get the current write indexed buffer flag*/
-	audio_lock_mutex(audio_ctx);
-	int flag = audio_buffers[buffer_write_index].flag;
-	audio_unlock_mutex(audio_ctx);
+	if(audio_buffers == NULL ||
+		__atomic_load_n(&audio_ctx->meter_only, __ATOMIC_RELAXED))
+		return;
+
+	uint32_t w_ind = buffer_write_index; /*only written by this thread*/
+	uint32_t r_ind = __atomic_load_n(&buffer_read_index, __ATOMIC_ACQUIRE);
 
-	if(flag == AUDIO_BUFF_USED)
+	if(w_ind - r_ind >= audio_buff_num)
 	{
-		fprintf(stderr, "AUDIO: write buffer(%i) is still in use - dropping data\n", buffer_write_index);
+		/*ring is full - drop data*/
+		__atomic_add_fetch(&audio_ctx->dropped_buffers, 1, __ATOMIC_RELAXED);
 		return;
 	}
 
+	audio_buff_t *buff = &audio_buffers[w_ind & (audio_buff_num - 1)];
+
 	/*write max_frames and fill a buffer*/
-	memcpy(audio_buffers[buffer_write_index].data,
+	memcpy(buff->data,
 		audio_ctx->capture_buff,
 		audio_ctx->capture_buff_size * sizeof(sample_t));
 	/*buffer begin time*/
-	audio_buffers[buffer_write_index].timestamp = audio_ctx->current_ts - buffer_length;
-	if(audio_buffers[buffer_write_index].timestamp < 0)
-		fprintf(stderr, "AUDIO: write buffer(%i) - invalid timestamp (< 0): cur_ts:%" PRId64 " buf_length:%" PRId64 "\n", 
-			buffer_write_index, audio_ctx->current_ts, buffer_length);
+	buff->timestamp = audio_ctx->current_ts - buffer_length;
+	buff->capture_ts = ts;
 
-	audio_buffers[buffer_write_index].level_meter[0] = audio_ctx->capture_buff_level[0];
-	audio_buffers[buffer_write_index].level_meter[1] = audio_ctx->capture_buff_level[1];
+	/*last published peak levels (written by this thread)*/
+	buff->level_meter[0] = audio_ctx->meter_peak[0];
+	buff->level_meter[1] = audio_ctx->meter_peak[audio_ctx->channels > 1 ? 1 : 0];
+	buff->flag = AUDIO_BUFF_USED;
 
-	audio_lock_mutex(audio_ctx);
-	audio_buffers[buffer_write_index].flag = AUDIO_BUFF_USED;
-	NEXT_IND(buffer_write_index, AUDBUFF_NUM);
-	audio_unlock_mutex(audio_ctx);
+	/*publish the buffer (seq_cst: pairs with the consumer_waiting check)*/
+	__atomic_store_n(&buffer_write_index, w_ind + 1, __ATOMIC_SEQ_CST);
 
+	/*wake a blocked consumer (eventfd write doesn't block or lock)*/
+	if(audio_ctx->event_fd >= 0 &&
+		__atomic_load_n(&audio_ctx->consumer_waiting, __ATOMIC_SEQ_CST))
+	{
+		uint64_t one = 1;
+		if(write(audio_ctx->event_fd, &one, sizeof(one)) < 0)
+			__atomic_add_fetch(&audio_ctx->dropped_wakeups, 1, __ATOMIC_RELAXED);
+	}
 }
 
-/* saturate float samples to int16 limits*/
-static int16_t clip_int16 (float in)
+/*
+ * check if the ring has buffers ready for the consumer
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if a buffer is ready, 0 otherwise
+ */
+static int audio_buffer_ready()
 {
-	//int16_t out = (int16_t) (in < -32768) ? -32768 : (in > 32767) ? 32767 : in;
-
-	long lout =  lroundf(in);
-	int16_t out = (lout < INT16_MIN) ? INT16_MIN : (lout > INT16_MAX) ? INT16_MAX: (int16_t) lout;
-	return (out);
+	return __atomic_load_n(&buffer_write_index, __ATOMIC_SEQ_CST) !=
+		__atomic_load_n(&buffer_read_index, __ATOMIC_RELAXED);
 }
 
 /*
- * get the next used buffer from the ring buffer
+ * wait for a captured buffer to be ready
+ *   blocks on an eventfd signaled by the capture thread
+ *   instead of polling audio_get_next_buffer
  * args:
  *   audio_ctx - pointer to audio context
- *   buff - pointer to an allocated audio buffer
- *   type - type of data (SAMPLE_TYPE_[INT16|FLOAT])
- *   mask - audio fx mask
+ *   timeout_ms - max time to wait in ms
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: 0 if a buffer is ready, 1 on timeout
+ */
+int audio_wait_buffer(audio_context_t *audio_ctx, int timeout_ms)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	if(audio_buffers != NULL && audio_buffer_ready())
+		return 0;
+
+	if(audio_buffers == NULL || audio_ctx->event_fd < 0)
+	{
+		/*no capture running (or no eventfd): just sleep the timeout*/
+		struct timespec req = {
+			.tv_sec = timeout_ms / 1000,
+			.tv_nsec = (timeout_ms % 1000) * 1000000L};
+		nanosleep(&req, NULL);
+		return (audio_buffers != NULL && audio_buffer_ready()) ? 0 : 1;
+	}
+
+	__atomic_store_n(&audio_ctx->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+
+	/*recheck after announcing the wait, the producer may have missed the flag*/
+	if(!audio_buffer_ready())
+	{
+		struct pollfd pfd = {
+			.fd = audio_ctx->event_fd,
+			.events = POLLIN,
+			.revents = 0};
+		poll(&pfd, 1, timeout_ms);
+	}
+
+	__atomic_store_n(&audio_ctx->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+
+	/*drain the counter (non blocking)*/
+	uint64_t count = 0;
+	if(read(audio_ctx->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN && verbosity > 0)
+		fprintf(stderr, "AUDIO: (audio_wait_buffer) eventfd read failed: %s\n", strerror(errno));
+
+	return audio_buffer_ready() ? 0 : 1;
+}
+
+/*
+ * report capture problems counted on the real time thread
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+static void audio_report_xruns(audio_context_t *audio_ctx)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	uint32_t dropped = __atomic_exchange_n(&audio_ctx->dropped_buffers, 0, __ATOMIC_RELAXED);
+	uint32_t overflows = __atomic_exchange_n(&audio_ctx->input_overflows, 0, __ATOMIC_RELAXED);
+	uint32_t underflows = __atomic_exchange_n(&audio_ctx->input_underflows, 0, __ATOMIC_RELAXED);
+
+	if(dropped)
+		fprintf(stderr, "AUDIO: audio ring full - dropped %u buffers\n", dropped);
+	if(overflows)
+		fprintf(stderr, "AUDIO: %u input buffer overflows (compensated with silence)\n", overflows);
+	if(underflows)
+		fprintf(stderr, "AUDIO: %u input buffer underflows\n", underflows);
+
+	uint32_t wakeups = __atomic_exchange_n(&audio_ctx->dropped_wakeups, 0, __ATOMIC_RELAXED);
+	if(wakeups && verbosity > 0)
+		fprintf(stderr, "AUDIO: %u consumer wake up events failed\n", wakeups);
+}
+
+/*
+ * saturate float samples to int16 limits
+ *   rounds to nearest even (like the simd conversions)
+ */
+static inline int16_t clip_int16 (float in)
+{
+	if(in < (float) INT16_MIN)
+		in = (float) INT16_MIN;
+	if(in > (float) INT16_MAX)
+		in = (float) INT16_MAX;
+
+	return (int16_t) lrintf(in);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * convert float samples to int16 (avx2)
+ *   16 samples per iteration
+ * args:
+ *   out - pointer to int16 output
+ *   in - pointer to float input
+ *   n - number of samples
  *
  * asserts:
  *   none
  *
- * returns: error code
+ * returns: number of converted samples
  */
-int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int type, uint32_t mask)
+__attribute__((target("avx2")))
+static int float_to_s16_avx2(int16_t *out, const sample_t *in, int n)
 {
-	audio_lock_mutex(audio_ctx);
-	int flag = audio_buffers[buffer_read_index].flag;
-	audio_unlock_mutex(audio_ctx);
+	const __m256 scale = _mm256_set1_ps((float) INT16_MAX);
+	const __m256 vmin = _mm256_set1_ps((float) INT16_MIN);
+	const __m256 vmax = _mm256_set1_ps((float) INT16_MAX);
 
-	if(flag == AUDIO_BUFF_FREE)
-		return 1; /*all done*/
+	int i = 0;
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+		b = _mm256_min_ps(_mm256_max_ps(b, vmin), vmax);
+		/*packs works per 128 bit lane: restore the sample order*/
+		__m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *) (out + i), v);
+	}
 
-	/*aplly fx*/
-	audio_fx_apply(audio_ctx, (sample_t *) audio_buffers[buffer_read_index].data, mask);
+	return i;
+}
 
-	/*copy data into requested format type*/
+/*
+ * check for avx2 support (cached)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if avx2 is supported
+ */
+static int cpu_has_avx2()
+{
+	static int has_avx2 = -1;
+	if(has_avx2 < 0)
+	{
+		__builtin_cpu_init();
+		has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return has_avx2;
+}
+#endif
+
+/*
+ * convert float samples to int16 with saturation
+ * args:
+ *   out - pointer to int16 output
+ *   in - pointer to float input (-1.0 to 1.0)
+ *   n - number of samples
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void float_to_s16(int16_t *out, const sample_t *in, int n)
+{
 	int i = 0;
-	switch(type)
+
+#if defined(__x86_64__) || defined(__i386__)
+	if(cpu_has_avx2())
+		i = float_to_s16_avx2(out, in, n);
+#endif
+
+#if defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps((float) INT16_MAX);
+	const __m128 vmin = _mm_set1_ps((float) INT16_MIN);
+	const __m128 vmax = _mm_set1_ps((float) INT16_MAX);
+	for(; i + 8 <= n; i += 8)
 	{
-		case GV_SAMPLE_TYPE_FLOAT:
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(in + i + 4), scale);
+		a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+		b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+		_mm_storeu_si128((__m128i *) (out + i),
+			_mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+#elif defined(__aarch64__)
+	const float32x4_t scale = vdupq_n_f32((float) INT16_MAX);
+	for(; i + 8 <= n; i += 8)
+	{
+		int32x4_t a = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+		int32x4_t b = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i + 4), scale));
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+#endif
+
+	for(; i < n; ++i)
+		out[i] = clip_int16(in[i] * INT16_MAX);
+}
+
+/*
+ * deinterleave float samples into planes
+ * args:
+ *   out - pointer to planar float output (frames samples per plane)
+ *   in - pointer to interleaved float input
+ *   frames - number of frames
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_deinterleave_float(float *out, const sample_t *in, int frames, int channels)
+{
+	int i = 0;
+
+	if(channels == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+
+	if(channels == 2)
+	{
+		float *l = out;
+		float *r = out + frames;
+#if defined(__SSE2__)
+		for(; i + 4 <= frames; i += 4)
 		{
-			sample_t *my_data = (sample_t *) buff->data;
-			memcpy( my_data, audio_buffers[buffer_read_index].data,
-				audio_ctx->capture_buff_size * sizeof(sample_t));
-			break;
+			__m128 a = _mm_loadu_ps(in + 2 * i);
+			__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+			_mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
 		}
-		case GV_SAMPLE_TYPE_INT16:
+#elif defined(__aarch64__)
+		for(; i + 4 <= frames; i += 4)
 		{
-			int16_t *my_data = (int16_t *) buff->data;
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
-			for(i = 0; i < audio_ctx->capture_buff_size; ++i)
-			{
-				my_data[i] = clip_int16( (buff_p[i]) * INT16_MAX);
-			}
-			break;
+			float32x4x2_t v = vld2q_f32(in + 2 * i);
+			vst1q_f32(l + i, v.val[0]);
+			vst1q_f32(r + i, v.val[1]);
 		}
-		case GV_SAMPLE_TYPE_FLOATP:
+#endif
+		for(; i < frames; ++i)
 		{
-			int j=0;
+			l[i] = in[2 * i];
+			r[i] = in[2 * i + 1];
+		}
+		return;
+	}
 
-			float *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
+	int j = 0;
+	for(i = 0; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			out[j * frames + i] = *in++;
+}
 
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (float *) (((float *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
+/*
+ * interleave float planes into samples
+ * args:
+ *   out - pointer to interleaved float output
+ *   in - pointer to planar float input (frames samples per plane)
+ *   frames - number of frames
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_interleave_float(sample_t *out, const float *in, int frames, int channels)
+{
+	int i = 0;
 
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = *buff_p++;
-				}
-			break;
+	if(channels == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+
+	if(channels == 2)
+	{
+		const float *l = in;
+		const float *r = in + frames;
+#if defined(__SSE2__)
+		for(; i + 4 <= frames; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(l + i);
+			__m128 b = _mm_loadu_ps(r + i);
+			_mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(a, b));
+			_mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(a, b));
 		}
-		case GV_SAMPLE_TYPE_INT16P:
+#elif defined(__aarch64__)
+		for(; i + 4 <= frames; i += 4)
+		{
+			float32x4x2_t v;
+			v.val[0] = vld1q_f32(l + i);
+			v.val[1] = vld1q_f32(r + i);
+			vst2q_f32(out + 2 * i, v);
+		}
+#endif
+		for(; i < frames; ++i)
 		{
-			int j=0;
+			out[2 * i] = l[i];
+			out[2 * i + 1] = r[i];
+		}
+		return;
+	}
 
-			int16_t *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
+	int j = 0;
+	for(i = 0; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			*out++ = in[j * frames + i];
+}
 
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (int16_t *) (((int16_t *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
+/*
+ * deinterleave float samples into int16 planes (saturated)
+ * args:
+ *   out - pointer to planar int16 output (frames samples per plane)
+ *   in - pointer to interleaved float input
+ *   frames - number of frames
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void deinterleave_s16(int16_t *out, const sample_t *in, int frames, int channels)
+{
+	int i = 0;
 
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = clip_int16((*buff_p++) * INT16_MAX);
-				}
-			break;
+	if(channels == 1)
+	{
+		float_to_s16(out, in, frames);
+		return;
+	}
+
+	if(channels == 2)
+	{
+		int16_t *l = out;
+		int16_t *r = out + frames;
+#if defined(__SSE2__)
+		const __m128 scale = _mm_set1_ps((float) INT16_MAX);
+		const __m128 vmin = _mm_set1_ps((float) INT16_MIN);
+		const __m128 vmax = _mm_set1_ps((float) INT16_MAX);
+		for(; i + 8 <= frames; i += 8)
+		{
+			__m128 a = _mm_loadu_ps(in + 2 * i);
+			__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+			__m128 c = _mm_loadu_ps(in + 2 * i + 8);
+			__m128 d = _mm_loadu_ps(in + 2 * i + 12);
+			__m128 l0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 r0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			__m128 l1 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 r1 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1));
+			l0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(l0, scale), vmin), vmax);
+			l1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(l1, scale), vmin), vmax);
+			r0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(r0, scale), vmin), vmax);
+			r1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(r1, scale), vmin), vmax);
+			_mm_storeu_si128((__m128i *) (l + i),
+				_mm_packs_epi32(_mm_cvtps_epi32(l0), _mm_cvtps_epi32(l1)));
+			_mm_storeu_si128((__m128i *) (r + i),
+				_mm_packs_epi32(_mm_cvtps_epi32(r0), _mm_cvtps_epi32(r1)));
+		}
+#elif defined(__aarch64__)
+		const float32x4_t scale = vdupq_n_f32((float) INT16_MAX);
+		for(; i + 4 <= frames; i += 4)
+		{
+			float32x4x2_t v = vld2q_f32(in + 2 * i);
+			vst1_s16(l + i, vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(v.val[0], scale))));
+			vst1_s16(r + i, vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(v.val[1], scale))));
 		}
+#endif
+		for(; i < frames; ++i)
+		{
+			l[i] = clip_int16(in[2 * i] * INT16_MAX);
+			r[i] = clip_int16(in[2 * i + 1] * INT16_MAX);
+		}
+		return;
 	}
 
-	buff->timestamp = audio_buffers[buffer_read_index].timestamp;
+	int j = 0;
+	for(i = 0; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			out[j * frames + i] = clip_int16((*in++) * INT16_MAX);
+}
+
+/*
+ * convert interleaved float samples to the requested format
+ *   (single pass: simd conversion and deinterleave)
+ * args:
+ *   out - pointer to output buffer
+ *   in - pointer to interleaved float input
+ *   frames - number of frames
+ *   channels - number of channels
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void audio_convert_samples(void *out, const sample_t *in, int frames, int channels, int type)
+{
+	/*assertions*/
+	assert(out != NULL);
+	assert(in != NULL);
+
+	switch(type)
+	{
+		case GV_SAMPLE_TYPE_FLOAT:
+			memcpy(out, in, frames * channels * sizeof(sample_t));
+			break;
+		case GV_SAMPLE_TYPE_INT16:
+			float_to_s16((int16_t *) out, in, frames * channels);
+			break;
+		case GV_SAMPLE_TYPE_FLOATP:
+			audio_deinterleave_float((float *) out, in, frames, channels);
+			break;
+		case GV_SAMPLE_TYPE_INT16P:
+			deinterleave_s16((int16_t *) out, in, frames, channels);
+			break;
+	}
+}
+
+/*
+ * get the next used buffer from the ring buffer
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   buff - pointer to an allocated audio buffer
+ *   type - type of data (SAMPLE_TYPE_[INT16|FLOAT])
+ *   mask - audio fx mask
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int type, uint32_t mask)
+{
+	audio_report_xruns(audio_ctx);
+
+	if(audio_buffers == NULL)
+		return 1;
 
-	buff->level_meter[0] = audio_buffers[buffer_read_index].level_meter[0];
-	buff->level_meter[1] = audio_buffers[buffer_read_index].level_meter[1];
+	uint32_t r_ind = buffer_read_index; /*only written by this thread*/
+	uint32_t w_ind = __atomic_load_n(&buffer_write_index, __ATOMIC_ACQUIRE);
 
-	audio_lock_mutex(audio_ctx);
-	audio_buffers[buffer_read_index].flag = AUDIO_BUFF_FREE;
-	NEXT_IND(buffer_read_index, AUDBUFF_NUM);
-	audio_unlock_mutex(audio_ctx);
+	if(r_ind == w_ind)
+		return 1; /*all done*/
+
+	audio_buff_t *ring_buff = &audio_buffers[r_ind & (audio_buff_num - 1)];
+
+	if(ring_buff->timestamp < 0)
+		fprintf(stderr, "AUDIO: read buffer(%u) - invalid timestamp (< 0): %" PRId64 "\n",
+			r_ind & (audio_buff_num - 1), ring_buff->timestamp);
+
+	/*aplly fx*/
+	audio_fx_apply(audio_ctx, (sample_t *) ring_buff->data, mask);
+
+	/*copy data into requested format type*/
+	audio_convert_samples(buff->data, (sample_t *) ring_buff->data,
+		audio_ctx->capture_buff_size / audio_ctx->channels, audio_ctx->channels, type);
+
+	buff->timestamp = ring_buff->timestamp;
+	buff->capture_ts = ring_buff->capture_ts;
+
+	buff->level_meter[0] = ring_buff->level_meter[0];
+	buff->level_meter[1] = ring_buff->level_meter[1];
+
+	ring_buff->flag = AUDIO_BUFF_FREE;
+
+	/*release the buffer to the producer*/
+	__atomic_store_n(&buffer_read_index, r_ind + 1, __ATOMIC_RELEASE);
 
 	return 0;
 }
@@ -449,6 +891,12 @@ audio_context_t *audio_init(int api, int device)
 
 	/*initialize the mutex*/
 	__INIT_MUTEX(&(audio_ctx->mutex));
+
+	/*consumer wake up event*/
+	audio_ctx->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(audio_ctx->event_fd < 0)
+		fprintf(stderr, "AUDIO: (audio_init) couldn't create eventfd, consumers will poll: %s\n",
+			strerror(errno));
 	
 	int ret = 0;
 
@@ -758,6 +1206,9 @@ int audio_start(audio_context_t *audio_ctx)
 	audio_ctx->snd_begintime = 0;
 	audio_ctx->ts_drift = 0;  
 
+	/*levels restart from silence*/
+	audio_meter_reset(audio_ctx);
+
 	int err = 0;
 
 	switch(audio_ctx->api)
@@ -842,6 +1293,12 @@ void audio_close(audio_context_t *audio_ctx)
 	/*destroy the mutex*/
 	__CLOSE_MUTEX(&(audio_ctx->mutex));
 
+	if(audio_ctx->event_fd >= 0)
+	{
+		close(audio_ctx->event_fd);
+		audio_ctx->event_fd = -1;
+	}
+
 	switch(audio_ctx->api)
 	{
 		case AUDIO_NONE:
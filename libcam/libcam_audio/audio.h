@@ -49,11 +49,30 @@ struct _audio_context_t
 
 	sample_t *capture_buff;       /*pointer to capture data*/
 	int capture_buff_size;        /*capture buffer size (bytes)*/
-	float capture_buff_level[2];  /*capture buffer channels level*/
 
 	void *stream;                 /*pointer to audio stream (portaudio)*/
 
 	int stream_flag;              /*stream flag*/
+
+	/*counted on the capture thread, reported by the consumer*/
+	uint32_t dropped_buffers;     /*buffers dropped with the ring full*/
+	uint32_t input_overflows;     /*api input overflows*/
+	uint32_t input_underflows;    /*api input underflows*/
+	uint32_t dropped_wakeups;     /*failed consumer wake ups*/
+
+	/*level metering tap (accumulated on the capture thread)*/
+	float meter_peak_acc[AUDIO_METER_MAX_CHANNELS];  /*peak of current period*/
+	float meter_sumsq_acc[AUDIO_METER_MAX_CHANNELS]; /*sum of squares of current period*/
+	int meter_frames;             /*frames in current period*/
+	int meter_period;             /*frames per published level*/
+	/*published levels (seqlock: meter_seq is odd while writing)*/
+	uint32_t meter_seq;
+	float meter_peak[AUDIO_METER_MAX_CHANNELS];
+	float meter_rms[AUDIO_METER_MAX_CHANNELS];
+	int meter_only;               /*don't queue buffers, only meter*/
+
+	int event_fd;                 /*eventfd signaled when a buffer is ready*/
+	int consumer_waiting;         /*consumer is blocked on event_fd*/
 	
 	pthread_mutex_t mutex;       /*audio mutex*/
 
@@ -61,6 +80,7 @@ struct _audio_context_t
 
 /*
  * fill a audio buffer data and move write index to next one
+ *   (real time safe: no locks, allocation or stdio)
  * args:
  *   audio_ctx - pointer to audio context data
  *   ts - timestamp for end of data
@@ -72,4 +92,75 @@ struct _audio_context_t
  */
 void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts);
 
+/*
+ * reset the metering tap (called before starting the stream)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_meter_reset(audio_context_t *audio_ctx);
+
+/*
+ * publish levels (seqlock writer, capture thread only)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   peak - per channel peak values
+ *   rms - per channel rms values
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_meter_publish(audio_context_t *audio_ctx, const float *peak, const float *rms);
+
+/*
+ * metering tap: measure captured samples in place
+ *   (real time safe: no locks, allocation or stdio)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   in - pointer to interleaved captured samples (NULL for silence)
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_meter_process(audio_context_t *audio_ctx, const sample_t *in, int frames);
+
+/*
+ * deinterleave float samples into planes
+ * args:
+ *   out - pointer to planar float output (frames samples per plane)
+ *   in - pointer to interleaved float input
+ *   frames - number of frames
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_deinterleave_float(float *out, const sample_t *in, int frames, int channels);
+
+/*
+ * interleave float planes into samples
+ * args:
+ *   out - pointer to interleaved float output
+ *   in - pointer to planar float input (frames samples per plane)
+ *   frames - number of frames
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_interleave_float(sample_t *out, const float *in, int frames, int channels);
+
 #endif
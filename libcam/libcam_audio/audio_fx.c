@@ -19,6 +19,15 @@
 #                                                                               #
 ********************************************************************************/
 
+/*******************************************************************************#
+#                                                                               #
+#  Audio library - effects                                                      #
+#                                                                               #
+#  effects run on deinterleaved (planar) blocks for any number of channels,    #
+#  all state is allocated once per stream format and only reset on toggling    #
+#                                                                               #
+********************************************************************************/
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -28,10 +37,15 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "cameraconfig.h"
 #include "gviewaudio.h"
 #include "audio.h"
@@ -43,129 +57,153 @@
 
 extern int verbosity;
 
+/*effect slots (graph order)*/
+#define FX_ECHO    (0)
+#define FX_REVERB  (1)
+#define FX_FUZZ    (2)
+#define FX_WAHWAH  (3)
+#define FX_DUCKY   (4)
+#define FX_NUM     (5)
+
+#define FX_REPORT_BLOCKS (500) /*blocks between cost reports (verbosity > 1)*/
+
+/*effect parameters*/
+#define ECHO_DELAY_MS    (300)
+#define ECHO_DECAY       (0.5f)
+#define REVERB_DELAY_MS  (50)
+#define REVERB_AP_GAIN   (0.75f)
+#define REVERB_IN_GAIN   (0.7f)
+#define FUZZ_HPF_FREQ    (1000)
+#define FUZZ_HPF_RES     (0.9f)
+#define WAH_FREQ         (1.5f)
+#define WAH_STARTPHASE   (0.0f)
+#define WAH_DEPTH        (0.7f)
+#define WAH_FREQOFS      (0.3f)
+#define WAH_RES          (2.5f)
+#define PITCH_RATE       (2)
+#define PITCH_WINDOW_MS  (20)
+#define PITCH_LPF_RES    (0.9f)
+
+#define lfoskipsamples 30
+
+static const uint32_t fx_flags[FX_NUM] =
+{
+	AUDIO_FX_ECHO,
+	AUDIO_FX_REVERB,
+	AUDIO_FX_FUZZ,
+	AUDIO_FX_WAHWAH,
+	AUDIO_FX_DUCKY
+};
+
+static const char *fx_names[FX_NUM] =
+{
+	"echo",
+	"reverb",
+	"fuzz",
+	"wahwah",
+	"ducky"
+};
+
 /*----------- structs for audio effects ------------*/
 
-/*data for Butterworth filter (LP or HP)*/
-typedef struct _fx_filt_data_t
+/*
+ * biquad filter (direct form I), one state set per channel
+ * out(n) = b0 * in + b1 * in(n-1) + b2 * in(n-2) - a1*out(n-1) - a2*out(n-2)
+ */
+typedef struct _fx_biquad_t
 {
-	sample_t buff_in1[2];
-	sample_t buff_in2[2];
-	sample_t buff_out1[2];
-	sample_t buff_out2[2];
-	float c;
-	float a1;
-	float a2;
-	float a3;
+	float b0;
 	float b1;
 	float b2;
-} fx_filt_data_t;
-
-/*data for Comb4 filter*/
-typedef struct _fx_comb4_data_t
-{
-	int buff_size1;
-	int buff_size2;
-	int buff_size3;
-	int buff_size4;
-
-	sample_t *CombBuff10; // four parallel  comb filters - first channel
-	sample_t *CombBuff11; // four parallel comb filters - second channel
-	sample_t *CombBuff20; // four parallel  comb filters - first channel
-	sample_t *CombBuff21; // four parallel comb filters - second channel
-	sample_t *CombBuff30; // four parallel  comb filters - first channel
-	sample_t *CombBuff31; // four parallel comb filters - second channel
-	sample_t *CombBuff40; // four parallel  comb filters - first channel
-	sample_t *CombBuff41; // four parallel comb filters - second channel
-
-	int CombIndex1; //comb filter 1 index
-	int CombIndex2; //comb filter 2 index
-	int CombIndex3; //comb filter 3 index
-	int CombIndex4; //comb filter 4 index
-} fx_comb4_data_t;
-
-/* data for delay*/
-typedef struct _fx_delay_data_t
+	float a1;
+	float a2;
+	float *x1; /*in(n-1) per channel*/
+	float *x2; /*in(n-2) per channel*/
+	float *y1; /*out(n-1) per channel*/
+	float *y2; /*out(n-2) per channel*/
+} fx_biquad_t;
+
+/*delay line, one plane of size samples per channel (shared index)*/
+typedef struct _fx_delay_t
 {
-	int buff_size;
-	sample_t *delayBuff1; // delay buffer 1 - first channel
-	sample_t *delayBuff2; // delay buffer 2 - second channel (stereo)
-	int delayIndex; // delay buffer index
-} fx_delay_data_t;
+	int size;
+	int index;
+	float *buff;
+} fx_delay_t;
 
 /* data for WahWah effect*/
 typedef struct _fx_wah_data_t
 {
 	float lfoskip;
 	unsigned long skipcount;
-	float xn1;
-	float xn2;
-	float yn1;
-	float yn2;
-	float b0;
-	float b1;
-	float b2;
-	float a0;
-	float a1;
-	float a2;
 	float phase;
+	fx_biquad_t filt;
 } fx_wah_data_t;
 
+/* data for pitch (rate transposer) effect*/
 typedef struct _fx_rate_data_t
 {
-	sample_t *rBuff1;
-	sample_t *rBuff2;
-	sample_t *wBuff1;
-	sample_t *wBuff2;
+	float *rBuff; /*decimated samples per channel (frames)*/
+	float *wBuff; /*window per channel (wSize)*/
 	int wSize;
-	int numsamples;
+	fx_biquad_t lpf;
 } fx_rate_data_t;
 
 typedef struct _audio_fx_t
 {
-	fx_delay_data_t *ECHO;
-	fx_delay_data_t *AP1;
-	fx_comb4_data_t *COMB4;
-	fx_filt_data_t  *HPF;
-	fx_filt_data_t  *LPF1;
-	fx_rate_data_t  *RT1;
-	fx_wah_data_t   *wahData;
+	/*stream format the state was allocated for*/
+	int channels;
+	int samprate;
+	int frames;
+
+	float *planes;  /*deinterleaved block (channels * frames)*/
+	float *acc;     /*accumulator block (channels * frames)*/
+
+	fx_delay_t echo;
+	fx_delay_t comb[4];
+	fx_delay_t allpass;
+	fx_biquad_t hpf;
+	fx_wah_data_t wah;
+	fx_rate_data_t pitch;
+
+	uint32_t active;              /*currently enabled fx mask*/
+	uint64_t cost_ns[FX_NUM];     /*accumulated processing time*/
+	uint64_t cost_blocks[FX_NUM]; /*processed blocks*/
+	uint64_t blocks;              /*total processed blocks*/
 } audio_fx_t;
 
 /*audio fx data*/
 static audio_fx_t *aud_fx = NULL;
 
 /*
- * initialize audio fx data
+ * alloc zeroed float data (exits on failure)
  * args:
- *    none
+ *   n - number of floats
  *
  * asserts:
- *    none
+ *   none
  *
- * returns: none
+ * returns: pointer to allocated data
  */
-static void audio_fx_init ()
+static float *fx_alloc(int n)
 {
-	aud_fx = calloc(1, sizeof(audio_fx_t));
-	if(aud_fx == NULL)
+	float *p = calloc(n > 0 ? n : 1, sizeof(float));
+	if(p == NULL)
 	{
-		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_init): %s\n", strerror(errno));
+		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx): %s\n", strerror(errno));
 		exit(-1);
 	}
-	/*Echo effect data */
-	aud_fx->ECHO = NULL;
-	/* 4 parallel comb filters data*/
-	aud_fx->COMB4 = NULL;
-	/*all pass 1 filter data*/
-	aud_fx->AP1 = NULL;
-	/*WahWah effect data*/
-	aud_fx->wahData = NULL;
-	/*high pass filter data*/
-	aud_fx->HPF = NULL;
-	/*rate transposer*/
-	aud_fx->RT1 = NULL;
-	/*low pass filter*/
-	aud_fx->LPF1 = NULL;
+	return p;
+}
+
+/*
+ * monotonic time in nanosec
+ */
+static uint64_t fx_time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
 }
 
 /*
@@ -178,70 +216,65 @@ static void audio_fx_init ()
  *
  * returns: float sample
  */
-static float clip_float (float in)
+static inline float clip_float (float in)
 {
-	in = (in < -1.0) ? -1.0 : (in > 1.0) ? 1.0 : in;
+	in = (in < -1.0f) ? -1.0f : (in > 1.0f) ? 1.0f : in;
 
 	return in;
 }
 
+/*------------------------------ biquad filters ------------------------------*/
+
 /*
- * Butterworth Filter for HP or LP
- * out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
+ * alloc biquad state for channels
  * args:
- *   FILT - pointer to fx_filt_data_t
- *   Buff - sampe buffer
- *   NumSamples - samples in buffer
- *   channels - number of audio channels
+ *   bq - pointer to biquad
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
  */
-static void Butt(fx_filt_data_t *FILT,
-	sample_t *Buff,
-	int NumSamples,
-	int channels)
+static void biquad_alloc(fx_biquad_t *bq, int channels)
 {
-	int index = 0;
+	float *state = fx_alloc(4 * channels);
+	bq->x1 = state;
+	bq->x2 = state + channels;
+	bq->y1 = state + 2 * channels;
+	bq->y2 = state + 3 * channels;
+}
 
-	for (index = 0; index < NumSamples; index = index + channels)
-	{
-		sample_t out = FILT->a1 * Buff[index] + FILT->a2 * FILT->buff_in1[0] +
-			FILT->a3 * FILT->buff_in1[1] - FILT->b1 * FILT->buff_out1[0] -
-			FILT->b2 * FILT->buff_out1[1];
-		FILT->buff_in1[1] = FILT->buff_in1[0]; //in(n-2) = in(n-1)
-		FILT->buff_in1[0] = Buff[index]; // in(n-1) = in
-		FILT->buff_out1[1] = FILT->buff_out1[0]; //out(n-2) = out(n-1)
-		FILT->buff_out1[0] = out; //out(n-1) = out
-
-		Buff[index] = clip_float(out);
-		/*process second channel*/
-		if(channels > 1)
-		{
-			out = FILT->a1 * Buff[index+1] + FILT->a2 * FILT->buff_in2[0] +
-				FILT->a3 * FILT->buff_in2[1] - FILT->b1 * FILT->buff_out2[0] -
-				FILT->b2 * FILT->buff_out2[1];
-			FILT->buff_in2[1] = FILT->buff_in2[0]; //in(n-2) = in(n-1)
-			FILT->buff_in2[0] = Buff[index+1]; // in(n-1) = in
-			FILT->buff_out2[1] = FILT->buff_out2[0]; //out(n-2) = out(n-1)
-			FILT->buff_out2[0] = out; //out(n-1) = out
-
-			Buff[index+1] = clip_float(out);
-		}
-	}
+/*
+ * reset biquad state
+ * args:
+ *   bq - pointer to biquad
+ *   channels - number of channels
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void biquad_reset(fx_biquad_t *bq, int channels)
+{
+	memset(bq->x1, 0, 4 * channels * sizeof(float));
 }
 
 /*
- * HP Filter: out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
+ * Butterworth HP coefficients
  * f - cuttof freq., from ~0 Hz to SampleRate/2 - though many synths seem to filter only  up to SampleRate/4
  * r  = rez amount, from sqrt(2) to ~ 0.1
  *
  *  c = tan(pi * f / sample_rate);
- *  a1 = 1.0 / ( 1.0 + r * c + c * c);
- *  a2 = -2*a1;
- *  a3 = a1;
- *  b1 = 2.0 * ( c*c - 1.0) * a1;
- *  b2 = ( 1.0 - r * c + c * c) * a1;
+ *  b0 = 1.0 / ( 1.0 + r * c + c * c);
+ *  b1 = -2*b0;
+ *  b2 = b0;
+ *  a1 = 2.0 * ( c*c - 1.0) * b0;
+ *  a2 = ( 1.0 - r * c + c * c) * b0;
  * args:
- *   audio_ctx - pointer to audio context
- *   data -pointer to audio buffer to be processed
+ *   bq - pointer to biquad
+ *   samprate - sample rate
  *   cutoff_freq - filter cut off frequency
  *   res - rez amount
  *
@@ -250,47 +283,27 @@ static void Butt(fx_filt_data_t *FILT,
  *
  * returns: none
  */
-static void HPF(audio_context_t *audio_ctx,
-	sample_t *data,
-	int cutoff_freq,
-	float res)
+static void biquad_set_hpf(fx_biquad_t *bq, int samprate, float cutoff_freq, float res)
 {
-	if(aud_fx->HPF == NULL)
-	{
-		float inv_samprate = 1.0 / audio_ctx->samprate;
-		aud_fx->HPF = calloc(1, sizeof(fx_filt_data_t));
-		if(aud_fx->HPF == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (HPF): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->HPF->c = tan(M_PI * cutoff_freq * inv_samprate);
-		aud_fx->HPF->a1 = 1.0 / (1.0 + (res * aud_fx->HPF->c) + (aud_fx->HPF->c * aud_fx->HPF->c));
-		aud_fx->HPF->a2 = -2.0 * aud_fx->HPF->a1;
-		aud_fx->HPF->a3 = aud_fx->HPF->a1;
-		aud_fx->HPF->b1 = 2.0 * ((aud_fx->HPF->c * aud_fx->HPF->c) - 1.0) * aud_fx->HPF->a1;
-		aud_fx->HPF->b2 = (1.0 - (res * aud_fx->HPF->c) + (aud_fx->HPF->c * aud_fx->HPF->c)) * aud_fx->HPF->a1;
-	}
-
-	Butt(aud_fx->HPF, data, audio_ctx->capture_buff_size, audio_ctx->channels);
+	float c = tan(M_PI * cutoff_freq / samprate);
+	bq->b0 = 1.0 / (1.0 + (res * c) + (c * c));
+	bq->b1 = -2.0 * bq->b0;
+	bq->b2 = bq->b0;
+	bq->a1 = 2.0 * ((c * c) - 1.0) * bq->b0;
+	bq->a2 = (1.0 - (res * c) + (c * c)) * bq->b0;
 }
 
 /*
- * LP Filter: out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
- * f - cuttof freq., from ~0 Hz to SampleRate/2 -
- *     though many synths seem to filter only  up to SampleRate/4
- * r  = rez amount, from sqrt(2) to ~ 0.1
- *
+ * Butterworth LP coefficients
  * c = 1.0 / tan(pi * f / sample_rate);
- * a1 = 1.0 / ( 1.0 + r * c + c * c);
- * a2 = 2* a1;
- * a3 = a1;
- * b1 = 2.0 * ( 1.0 - c*c) * a1;
- * b2 = ( 1.0 - r * c + c * c) * a1;
- *
+ * b0 = 1.0 / ( 1.0 + r * c + c * c);
+ * b1 = 2* b0;
+ * b2 = b0;
+ * a1 = 2.0 * ( 1.0 - c*c) * b0;
+ * a2 = ( 1.0 - r * c + c * c) * b0;
  * args:
- *   audio_ctx - pointer to audio context
- *   data -pointer to audio buffer to be processed
+ *   bq - pointer to biquad
+ *   samprate - sample rate
  *   cutoff_freq - filter cut off frequency
  *   res - rez amount
  *
@@ -299,790 +312,714 @@ static void HPF(audio_context_t *audio_ctx,
  *
  * returns: none
  */
-static void LPF(audio_context_t *audio_ctx,
-	sample_t *data,
-	float cutoff_freq,
-	float res)
+static void biquad_set_lpf(fx_biquad_t *bq, int samprate, float cutoff_freq, float res)
 {
-	if(aud_fx->LPF1 == NULL)
-	{
-		aud_fx->LPF1 = calloc(1, sizeof(fx_filt_data_t));
-		if(aud_fx->LPF1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (LPF): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->LPF1->c = 1.0 / tan(M_PI * cutoff_freq / audio_ctx->samprate);
-		aud_fx->LPF1->a1 = 1.0 / (1.0 + (res * aud_fx->LPF1->c) + (aud_fx->LPF1->c * aud_fx->LPF1->c));
-		aud_fx->LPF1->a2 = 2.0 * aud_fx->LPF1->a1;
-		aud_fx->LPF1->a3 = aud_fx->LPF1->a1;
-		aud_fx->LPF1->b1 = 2.0 * (1.0 - (aud_fx->LPF1->c * aud_fx->LPF1->c)) * aud_fx->LPF1->a1;
-		aud_fx->LPF1->b2 = (1.0 - (res * aud_fx->LPF1->c) + (aud_fx->LPF1->c * aud_fx->LPF1->c)) * aud_fx->LPF1->a1;
-	}
-
-	Butt(aud_fx->LPF1, data, audio_ctx->capture_buff_size, audio_ctx->channels);
+	float c = 1.0 / tan(M_PI * cutoff_freq / samprate);
+	bq->b0 = 1.0 / (1.0 + (res * c) + (c * c));
+	bq->b1 = 2.0 * bq->b0;
+	bq->b2 = bq->b0;
+	bq->a1 = 2.0 * (1.0 - (c * c)) * bq->b0;
+	bq->a2 = (1.0 - (res * c) + (c * c)) * bq->b0;
 }
 
-/* Non-linear amplifier with soft distortion curve.
+/*
+ * run a biquad over one channel plane (output is clipped, state is not)
  * args:
- *   input - sample input
+ *   bq - pointer to biquad
+ *   ch - channel index
+ *   x - pointer to channel plane
+ *   n - number of samples
  *
  * asserts:
  *   none
  *
- * returns: processed sample
+ * returns: none
  */
-static sample_t CubicAmplifier( sample_t input )
+static void biquad_plane(fx_biquad_t *bq, int ch, float *x, int n)
 {
-	sample_t out;
-	float temp;
-	if( input < 0 ) /*silence*/
-	{
+	float x1 = bq->x1[ch], x2 = bq->x2[ch];
+	float y1 = bq->y1[ch], y2 = bq->y2[ch];
+	int i = 0;
 
-		temp = input + 1.0f;
-		out = (temp * temp * temp) - 1.0f;
-	}
-	else
+	for(i = 0; i < n; ++i)
 	{
-		temp = input - 1.0f;
-		out = (temp * temp * temp) + 1.0f;
+		float in = x[i];
+		float out = bq->b0 * in + bq->b1 * x1 + bq->b2 * x2 - bq->a1 * y1 - bq->a2 * y2;
+		x2 = x1;
+		x1 = in;
+		y2 = y1;
+		y1 = out;
+		x[i] = clip_float(out);
 	}
-	return clip_float(out);
+
+	bq->x1[ch] = x1;
+	bq->x2[ch] = x2;
+	bq->y1[ch] = y1;
+	bq->y2[ch] = y2;
 }
 
+#if defined(__SSE2__)
 /*
- * four paralell Comb filters for reverb
+ * run a biquad over four channel planes at once (one channel per lane)
+ *   blocks of 4x4 samples are transposed so each vector holds
+ *   the same time sample of the four channels
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay1_ms - delay for filter 1
- *   delay2_ms - delay for filter 2
- *   delay3_ms - delay for filter 3
- *   delay4_ms - delay for filter 4
- *   gain1 - feed gain for filter 1
- *   gain2 - feed gain for filter 2
- *   gain3 - feed gain for filter 3
- *   gain4 - feed gain for filter 4
- *   in_gain - input line gain
+ *   bq - pointer to biquad
+ *   ch - first channel index
+ *   planes - pointer to the first channel plane
+ *   frames - samples per plane
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void CombFilter4 (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay1_ms,
-	int delay2_ms,
-	int delay3_ms,
-	int delay4_ms,
-	float gain1,
-	float gain2,
-	float gain3,
-	float gain4,
-	float in_gain)
+static void biquad_planes4(fx_biquad_t *bq, int ch, float *planes, int frames)
 {
-	int samp=0;
-	/*buff_size in samples*/
+	const __m128 b0 = _mm_set1_ps(bq->b0);
+	const __m128 b1 = _mm_set1_ps(bq->b1);
+	const __m128 b2 = _mm_set1_ps(bq->b2);
+	const __m128 a1 = _mm_set1_ps(bq->a1);
+	const __m128 a2 = _mm_set1_ps(bq->a2);
+	const __m128 vmin = _mm_set1_ps(-1.0f);
+	const __m128 vmax = _mm_set1_ps(1.0f);
+
+	__m128 x1 = _mm_loadu_ps(bq->x1 + ch);
+	__m128 x2 = _mm_loadu_ps(bq->x2 + ch);
+	__m128 y1 = _mm_loadu_ps(bq->y1 + ch);
+	__m128 y2 = _mm_loadu_ps(bq->y2 + ch);
+
+	float *p0 = planes;
+	float *p1 = planes + frames;
+	float *p2 = planes + 2 * frames;
+	float *p3 = planes + 3 * frames;
 
-	if (aud_fx->COMB4 == NULL)
+	int i = 0;
+	int k = 0;
+	for(i = 0; i < frames; i += 4)
 	{
-		aud_fx->COMB4 = calloc(1, sizeof(fx_comb4_data_t));
-		if(aud_fx->COMB4 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		/*buff_size in samples*/
-		aud_fx->COMB4->buff_size1 = (int) delay1_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size2 = (int) delay2_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size3 = (int) delay3_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size4 = (int) delay4_ms * (audio_ctx->samprate * 0.001);
-
-		aud_fx->COMB4->CombBuff10 = calloc(aud_fx->COMB4->buff_size1, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff10 == NULL)
+		int n = (frames - i < 4) ? frames - i : 4;
+		__m128 r[4];
+		if(n == 4)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
+			r[0] = _mm_loadu_ps(p0 + i);
+			r[1] = _mm_loadu_ps(p1 + i);
+			r[2] = _mm_loadu_ps(p2 + i);
+			r[3] = _mm_loadu_ps(p3 + i);
+			_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
 		}
-		aud_fx->COMB4->CombBuff20 = calloc(aud_fx->COMB4->buff_size2, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff20 == NULL)
+		else
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
+			for(k = 0; k < n; ++k)
+				r[k] = _mm_setr_ps(p0[i + k], p1[i + k], p2[i + k], p3[i + k]);
 		}
-		aud_fx->COMB4->CombBuff30 = calloc(aud_fx->COMB4->buff_size3, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff30 == NULL)
+
+		for(k = 0; k < n; ++k)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
+			__m128 in = r[k];
+			__m128 out = _mm_sub_ps(
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, in), _mm_mul_ps(b1, x1)), _mm_mul_ps(b2, x2)),
+				_mm_add_ps(_mm_mul_ps(a1, y1), _mm_mul_ps(a2, y2)));
+			x2 = x1;
+			x1 = in;
+			y2 = y1;
+			y1 = out;
+			r[k] = _mm_min_ps(_mm_max_ps(out, vmin), vmax);
 		}
-		aud_fx->COMB4->CombBuff40 = calloc(aud_fx->COMB4->buff_size4, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff40 == NULL)
+
+		if(n == 4)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
+			_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+			_mm_storeu_ps(p0 + i, r[0]);
+			_mm_storeu_ps(p1 + i, r[1]);
+			_mm_storeu_ps(p2 + i, r[2]);
+			_mm_storeu_ps(p3 + i, r[3]);
 		}
-		aud_fx->COMB4->CombBuff11 = NULL;
-		aud_fx->COMB4->CombBuff21 = NULL;
-		aud_fx->COMB4->CombBuff31 = NULL;
-		aud_fx->COMB4->CombBuff41 = NULL;
-		if(audio_ctx->channels > 1)
+		else
 		{
-			aud_fx->COMB4->CombBuff11 = calloc(aud_fx->COMB4->buff_size1, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff11 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff21 = calloc(aud_fx->COMB4->buff_size2, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff21 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff31 = calloc(aud_fx->COMB4->buff_size3, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff31 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff41 = calloc(aud_fx->COMB4->buff_size4, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff41 == NULL)
+			for(k = 0; k < n; ++k)
 			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
+				float v[4];
+				_mm_storeu_ps(v, r[k]);
+				p0[i + k] = v[0];
+				p1[i + k] = v[1];
+				p2[i + k] = v[2];
+				p3[i + k] = v[3];
 			}
 		}
 	}
 
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp = samp + audio_ctx->channels)
-	{
-		sample_t out1 = in_gain * data[samp] +
-			gain1 * aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1];
-		sample_t out2 = in_gain * data[samp] +
-			gain2 * aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2];
-		sample_t out3 = in_gain * data[samp] +
-			gain3 * aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3];
-		sample_t out4 = in_gain * data[samp] +
-			gain4 * aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4];
-
-		aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1] = data[samp] +
-			gain1 * aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1];
-		aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2] = data[samp] +
-			gain2 * aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2];
-		aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3] = data[samp] +
-			gain3 * aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3];
-		aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4] = data[samp] +
-			gain4 * aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4];
-
-		data[samp] = clip_float(out1 + out2 + out3 + out4);
-
-		/*if stereo process second channel */
-		if(audio_ctx->channels > 1)
-		{
-			out1 = in_gain * data[samp+1] +
-				gain1 * aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1];
-			out2 = in_gain * data[samp+1] +
-				gain2 * aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2];
-			out3 = in_gain * data[samp+1] +
-				gain3 * aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3];
-			out4 = in_gain * data[samp+1] +
-				gain4 * aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4];
-
-			aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1] = data[samp+1] +
-				gain1 * aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1];
-			aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2] = data[samp+1] +
-				gain2 * aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2];
-			aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3] = data[samp+1] +
-				gain3 * aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3];
-			aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4] = data[samp+1] +
-				gain4 * aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4];
-
-			data[samp+1] = clip_float(out1 + out2 + out3 + out4);
-		}
-
-		if(++(aud_fx->COMB4->CombIndex1) >= aud_fx->COMB4->buff_size1) aud_fx->COMB4->CombIndex1=0;
-		if(++(aud_fx->COMB4->CombIndex2) >= aud_fx->COMB4->buff_size2) aud_fx->COMB4->CombIndex2=0;
-		if(++(aud_fx->COMB4->CombIndex3) >= aud_fx->COMB4->buff_size3) aud_fx->COMB4->CombIndex3=0;
-		if(++(aud_fx->COMB4->CombIndex4) >= aud_fx->COMB4->buff_size4) aud_fx->COMB4->CombIndex4=0;
-	}
+	_mm_storeu_ps(bq->x1 + ch, x1);
+	_mm_storeu_ps(bq->x2 + ch, x2);
+	_mm_storeu_ps(bq->y1 + ch, y1);
+	_mm_storeu_ps(bq->y2 + ch, y2);
 }
+#endif
 
 /*
- * All pass filter
+ * run a biquad over all channel planes
  * args:
- *   AP - pointer to fx_delay_data_t
- *   Buff -pointer to sample buffer
- *   NumSamples - number of samples in buffer
- *   channels -number of audio channels
- *   gain- filter gain
+ *   bq - pointer to biquad
+ *   planes - pointer to channel planes
+ *   frames - samples per plane
+ *   channels - number of channels
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void all_pass (fx_delay_data_t *AP,
-	sample_t *Buff,
-	int NumSamples,
-	int channels,
-	float gain)
+static void biquad_process(fx_biquad_t *bq, float *planes, int frames, int channels)
 {
-	int samp = 0;
-	float inv_gain = 1.0 / gain;
+	int ch = 0;
+#if defined(__SSE2__)
+	for(; ch + 4 <= channels; ch += 4)
+		biquad_planes4(bq, ch, planes + ch * frames, frames);
+#endif
+	for(; ch < channels; ++ch)
+		biquad_plane(bq, ch, planes + ch * frames, frames);
+}
+
+/*------------------------------- delay lines --------------------------------*/
+
+/*
+ * delay line kernel: runs over a contiguous run of the delay line,
+ *   no sample is read after being written in the same run so
+ *   the loop has no carried dependency
+ */
+typedef void (*fx_delay_kernel_t)(float *x, float *acc, float *d, int n, float g);
 
-	for(samp = 0; samp < NumSamples; samp += channels)
+/*
+ * echo: out = 0.7 * in + 0.3 * d; d = in + d * g
+ */
+static void echo_kernel(float *x, __attribute__((unused)) float *acc, float *d, int n, float g)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128 dry = _mm_set1_ps(0.7f);
+	const __m128 wet = _mm_set1_ps(0.3f);
+	const __m128 vg = _mm_set1_ps(g);
+	const __m128 vmin = _mm_set1_ps(-1.0f);
+	const __m128 vmax = _mm_set1_ps(1.0f);
+	for(; i + 4 <= n; i += 4)
 	{
-		AP->delayBuff1[AP->delayIndex] = Buff[samp] +
-			(gain * AP->delayBuff1[AP->delayIndex]);
-		Buff[samp] = ((AP->delayBuff1[AP->delayIndex] * (1 - gain*gain)) -
-			Buff[samp]) * inv_gain;
-		if(channels > 1)
-		{
-			AP->delayBuff2[AP->delayIndex] = Buff[samp+1] +
-				(gain * AP->delayBuff2[AP->delayIndex]);
-			Buff[samp+1] = ((AP->delayBuff2[AP->delayIndex] * (1 - gain*gain)) -
-				Buff[samp+1]) * inv_gain;
-		}
+		__m128 in = _mm_loadu_ps(x + i);
+		__m128 dl = _mm_loadu_ps(d + i);
+		__m128 out = _mm_add_ps(_mm_mul_ps(dry, in), _mm_mul_ps(wet, dl));
+		_mm_storeu_ps(d + i, _mm_add_ps(in, _mm_mul_ps(dl, vg)));
+		_mm_storeu_ps(x + i, _mm_min_ps(_mm_max_ps(out, vmin), vmax));
+	}
+#endif
+	for(; i < n; ++i)
+	{
+		float out = 0.7f * x[i] + 0.3f * d[i];
+		d[i] = x[i] + d[i] * g;
+		x[i] = clip_float(out);
+	}
+}
+
+/*
+ * comb: acc += g * d; d = in + g * d
+ */
+static void comb_kernel(float *x, float *acc, float *d, int n, float g)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128 vg = _mm_set1_ps(g);
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 gd = _mm_mul_ps(vg, _mm_loadu_ps(d + i));
+		_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), gd));
+		_mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(x + i), gd));
+	}
+#endif
+	for(; i < n; ++i)
+	{
+		float gd = g * d[i];
+		acc[i] += gd;
+		d[i] = x[i] + gd;
+	}
+}
 
-		if(++(AP->delayIndex) >= AP->buff_size) AP->delayIndex=0;
+/*
+ * all pass: d = in + g * d; out = (d * (1 - g*g) - in) / g
+ */
+static void allpass_kernel(float *x, __attribute__((unused)) float *acc, float *d, int n, float g)
+{
+	float k = 1.0f - g * g;
+	float inv_gain = 1.0f / g;
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128 vg = _mm_set1_ps(g);
+	const __m128 vk = _mm_set1_ps(k);
+	const __m128 vinv = _mm_set1_ps(inv_gain);
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 in = _mm_loadu_ps(x + i);
+		__m128 dl = _mm_add_ps(in, _mm_mul_ps(vg, _mm_loadu_ps(d + i)));
+		_mm_storeu_ps(d + i, dl);
+		_mm_storeu_ps(x + i, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dl, vk), in), vinv));
+	}
+#endif
+	for(; i < n; ++i)
+	{
+		d[i] = x[i] + g * d[i];
+		x[i] = (d[i] * k - x[i]) * inv_gain;
 	}
 }
 
 /*
- * All pass for reverb
+ * alloc a delay line
  * args:
- * 	 audio_ctx - audio context
- *   data - audio buffer to be processed
+ *   dl - pointer to delay line
  *   delay_ms - delay in ms
- *   gain - filter gain
+ *   samprate - sample rate
+ *   channels - number of channels
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void all_pass1 (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms,
-	float gain)
+static void delay_alloc(fx_delay_t *dl, int delay_ms, int samprate, int channels)
 {
-	if(aud_fx->AP1 == NULL)
-	{
-		aud_fx->AP1 = calloc(1, sizeof(fx_delay_data_t));
-		if(aud_fx->AP1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->AP1->buff_size = (int) delay_ms  * (audio_ctx->samprate * 0.001);
-		aud_fx->AP1->delayBuff1 = calloc(aud_fx->AP1->buff_size, sizeof(sample_t));
-		if(aud_fx->AP1->delayBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->AP1->delayBuff2 = NULL;
-		if(audio_ctx->channels > 1)
-		{
-			aud_fx->AP1->delayBuff2 = calloc(aud_fx->AP1->buff_size, sizeof(sample_t));
-			if(aud_fx->AP1->delayBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
-	}
-
-	all_pass (aud_fx->AP1, data,
-		audio_ctx->capture_buff_size, audio_ctx->channels, gain);
+	dl->size = (int) (delay_ms * (samprate * 0.001));
+	if(dl->size < 1)
+		dl->size = 1;
+	dl->index = 0;
+	dl->buff = fx_alloc(dl->size * channels);
 }
 
 /*
- * reduce number of samples with linear interpolation
- *    rate - rate of samples to remove [1,...[
- *    rate = 1-> XXX (splits channels) 2 -> X0X0X  3 -> X00X00X 4 -> X000X000X
+ * reset a delay line
  * args:
- *   RT - pointer to fx_rate_data_t
- *   Buff - pointer to sample buffer
- *   rate - rate of samples to remove
- *   NumSamples - samples in buffer
- *   channels - audio channels
+ *   dl - pointer to delay line
+ *   channels - number of channels
  *
  * asserts:
+ *   none
  *
  * returns: none
  */
-static void change_rate_less(fx_rate_data_t *RT,
-	sample_t *Buff,
-	int rate,
-	int NumSamples,
-	int channels)
+static void delay_reset(fx_delay_t *dl, int channels)
 {
-	int samp = 0;
-	int n = 0, i = 0;
-
-	for (samp = 0; samp < NumSamples; samp += channels)
-	{
-		if (n==0)
-		{
-			RT->rBuff1[i] = Buff[samp];
-			if(channels > 1)
-				RT->rBuff2[i] = Buff[samp + 1];
-
-			i++;
-		}
-		if(++n >= rate) n=0;
-	}
-	RT->numsamples = i;
+	dl->index = 0;
+	memset(dl->buff, 0, dl->size * channels * sizeof(float));
 }
 
 /*
- * increase audio tempo by adding audio windows of wtime_ms in given rate
- *   rate: 2 -> [w1..w2][w1..w2][w2..w3][w2..w3]  3-> [w1..w2][w1..w2][w1..w2][w2..w3][w2..w3][w2..w3]
+ * run a delay line kernel over all channel planes
+ *   the block is split at the delay line wrap point
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   rate -rate of added windows
- *   wtime_ms - window time in ms
+ *   dl - pointer to delay line
+ *   planes - pointer to channel planes
+ *   acc - pointer to accumulator planes (or NULL)
+ *   frames - samples per plane
+ *   channels - number of channels
+ *   kernel - delay line kernel
+ *   g - kernel gain
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void change_tempo_more(audio_context_t *audio_ctx,
-	sample_t *data,
-	int rate,
-	int	wtime_ms)
+static void delay_process(fx_delay_t *dl, float *planes, float *acc,
+	int frames, int channels, fx_delay_kernel_t kernel, float g)
 {
-	int samp = 0;
-	int i = 0;
-	int r = 0;
-	int index = 0;
+	int done = 0;
+	int index = dl->index;
+	int ch = 0;
 
-	if(aud_fx->RT1->wBuff1 == NULL)
+	while(done < frames)
 	{
-		aud_fx->RT1->wSize  = wtime_ms * audio_ctx->samprate * 0.001;
-		aud_fx->RT1->wBuff1 = calloc(aud_fx->RT1->wSize, sizeof(sample_t));
-		if(aud_fx->RT1->wBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (change_tempo_more): %s\n", strerror(errno));
-			exit(-1);
-		}
-		if (audio_ctx->channels >1)
-		{
-			aud_fx->RT1->wBuff2 = calloc(aud_fx->RT1->wSize, sizeof(sample_t));
-			if(aud_fx->RT1->wBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (change_tempo_more): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
+		int n = frames - done;
+		if(n > dl->size - index)
+			n = dl->size - index;
+
+		for(ch = 0; ch < channels; ++ch)
+			kernel(planes + ch * frames + done,
+				acc ? acc + ch * frames + done : NULL,
+				dl->buff + ch * dl->size + index, n, g);
+
+		index += n;
+		if(index >= dl->size)
+			index = 0;
+		done += n;
 	}
 
-	//printf("samples  = %i\n", data->RT1->numsamples);
-	for(samp = 0; samp < aud_fx->RT1->numsamples; samp++)
-	{
-		aud_fx->RT1->wBuff1[i] = aud_fx->RT1->rBuff1[samp];
-		if(audio_ctx->channels > 1)
-			aud_fx->RT1->wBuff2[i] = aud_fx->RT1->rBuff2[samp];
-
-		if((++i) > aud_fx->RT1->wSize)
-		{
-			for (r = 0; r < rate; r++)
-			{
-				for(i = 0; i < aud_fx->RT1->wSize; i++)
-				{
-					data[index] = aud_fx->RT1->wBuff1[i];
-					if (audio_ctx->channels > 1)
-						data[index +1] = aud_fx->RT1->wBuff2[i];
-					index += audio_ctx->channels;
-				}
-			}
-			i = 0;
-		}
-	}
+	dl->index = index;
 }
 
-#define FUZZ(x) CubicAmplifier(CubicAmplifier(CubicAmplifier(CubicAmplifier(x))))
+/*--------------------------------- effects ----------------------------------*/
 
 /*
- * Fuzz distortion
+ * Echo effect
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
+ *   fx - pointer to fx data
  *
  * asserts:
- *    audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_fuzz (audio_context_t *audio_ctx, sample_t *data)
+static void audio_fx_echo(audio_fx_t *fx)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	int samp=0;
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp++)
-		data[samp] = FUZZ(data[samp]);
-	HPF(audio_ctx, data, 1000, 0.9);
+	delay_process(&fx->echo, fx->planes, NULL, fx->frames, fx->channels,
+		echo_kernel, ECHO_DECAY);
 }
 
 /*
- * Echo effect
+ * Reverb effect: four paralell comb filters and an all pass
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay_ms - echo delay in ms (e.g: 300)
- *   decay - feedback gain (<1)  (e.g: 0.5)
+ *   fx - pointer to fx data
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_echo(audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms,
-	float decay)
+static void audio_fx_reverb(audio_fx_t *fx)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
+	static const float gain[4] = {0.55f, 0.6f, 0.5f, 0.45f};
+	int n = fx->frames * fx->channels;
+	int i = 0;
+	int k = 0;
 
-	int samp = 0;
+	/*all four filters add in_gain * in*/
+	for(i = 0; i < n; ++i)
+		fx->acc[i] = 4 * REVERB_IN_GAIN * fx->planes[i];
 
-	if(aud_fx->ECHO == NULL)
-	{
-		aud_fx->ECHO = calloc(1, sizeof(fx_delay_data_t));
-		if(aud_fx->ECHO == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->ECHO->buff_size = (int) delay_ms * audio_ctx->samprate * 0.001;
-		aud_fx->ECHO->delayBuff1 = calloc(aud_fx->ECHO->buff_size, sizeof(sample_t));
-		if(aud_fx->ECHO->delayBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->ECHO->delayBuff2 = NULL;
-		if(audio_ctx->channels > 1)
-		{
-			aud_fx->ECHO->delayBuff2 = calloc(aud_fx->ECHO->buff_size, sizeof(sample_t));
-			if(aud_fx->ECHO->delayBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
-	}
+	for(k = 0; k < 4; ++k)
+		delay_process(&fx->comb[k], fx->planes, fx->acc, fx->frames, fx->channels,
+			comb_kernel, gain[k]);
 
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp = samp + audio_ctx->channels)
-	{
-		sample_t out = (0.7 * data[samp]) +
-			(0.3 * aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex]);
-		aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex] = data[samp] +
-			(aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex] * decay);
-		data[samp] = clip_float(out);
-		/*if stereo process second channel in separate*/
-		if (audio_ctx->channels > 1)
-		{
-			out = (0.7 * data[samp+1]) +
-				(0.3 * aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex]);
-			aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex] = data[samp] +
-				(aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex] * decay);
-			data[samp+1] = clip_float(out);
-		}
+	for(i = 0; i < n; ++i)
+		fx->planes[i] = clip_float(fx->acc[i]);
 
-		if(++(aud_fx->ECHO->delayIndex) >= aud_fx->ECHO->buff_size) aud_fx->ECHO->delayIndex=0;
-	}
+	delay_process(&fx->allpass, fx->planes, NULL, fx->frames, fx->channels,
+		allpass_kernel, REVERB_AP_GAIN);
+}
+
+/* Non-linear amplifier with soft distortion curve.
+ * args:
+ *   input - sample input
+ *
+ * asserts:
+ *   none
+ *
+ * returns: processed sample
+ */
+static inline float CubicAmplifier(float input)
+{
+	float temp = (input < 0) ? input + 1.0f : input - 1.0f;
+	float out = temp * temp * temp + ((input < 0) ? -1.0f : 1.0f);
+	return clip_float(out);
 }
 
+#if defined(__SSE2__)
+static inline __m128 CubicAmplifier4(__m128 input)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 vmin = _mm_set1_ps(-1.0f);
+	__m128 neg = _mm_cmplt_ps(input, _mm_setzero_ps());
+	/*sign = input < 0 ? -1 : 1*/
+	__m128 sign = _mm_or_ps(_mm_and_ps(neg, vmin), _mm_andnot_ps(neg, one));
+	__m128 temp = _mm_sub_ps(input, sign);
+	__m128 out = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(temp, temp), temp), sign);
+	return _mm_min_ps(_mm_max_ps(out, vmin), one);
+}
+#endif
+
 /*
- * Reverb effect
+ * Fuzz distortion
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay_ms - reverb delay in ms
+ *   fx - pointer to fx data
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_reverb (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms)
+static void audio_fx_fuzz(audio_fx_t *fx)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
+	int n = fx->frames * fx->channels;
+	float *x = fx->planes;
+	int i = 0;
+#if defined(__SSE2__)
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(x + i);
+		v = CubicAmplifier4(CubicAmplifier4(CubicAmplifier4(CubicAmplifier4(v))));
+		_mm_storeu_ps(x + i, v);
+	}
+#endif
+	for(; i < n; ++i)
+		x[i] = CubicAmplifier(CubicAmplifier(CubicAmplifier(CubicAmplifier(x[i]))));
 
-	/*4 parallel comb filters*/
-	CombFilter4 (audio_ctx, data,
-		delay_ms, delay_ms - 5, delay_ms -10, delay_ms -15,
-		0.55, 0.6, 0.5, 0.45, 0.7);
-	
-	/*all pass*/
-	all_pass1 (audio_ctx, data, delay_ms, 0.75);
+	biquad_process(&fx->hpf, fx->planes, fx->frames, fx->channels);
 }
 
-#define lfoskipsamples 30
-
 /*
  * WahWah effect
+ *   the LFO is shared, the filter runs per channel
  * 	  !!!!!!!!!!!!! IMPORTANT!!!!!!!!! :
  * 	  depth and freqofs should be from 0(min) to 1(max) !
  * 	  res should be greater than 0 !
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   freq - LFO frequency (1.5)
- *   startphase - LFO startphase in RADIANS - usefull for stereo WahWah (0)
+ *   fx - pointer to fx data
  *   depth - Wah depth (0.7)
  *   freqofs - Wah frequency offset (0.3)
  *   res - Resonance (2.5)
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_wahwah (audio_context_t *audio_ctx,
-	sample_t *data,
-	float freq,
-	float startphase,
-	float depth,
-	float freqofs,
-	float res)
+static void audio_fx_wahwah(audio_fx_t *fx, float depth, float freqofs, float res)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	float frequency, omega, sn, cs, alpha;
-
-	if(aud_fx->wahData == NULL)
-	{
-		aud_fx->wahData = calloc(1, sizeof(fx_wah_data_t));
-		if(aud_fx->wahData == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_wahwah): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->wahData->lfoskip = freq * 2 * M_PI / audio_ctx->samprate;
-		aud_fx->wahData->phase = startphase;
-		/*if right channel set: phase += (float)M_PI;*/
-	}
+	fx_wah_data_t *wah = &fx->wah;
+	int done = 0;
+	int ch = 0;
 
-	int samp = 0;
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp++)
+	while(done < fx->frames)
 	{
-		float in = data[samp];
+		/*coefficients are updated every lfoskipsamples frames*/
+		int n = lfoskipsamples - (int) (wah->skipcount % lfoskipsamples);
+		if(n > fx->frames - done)
+			n = fx->frames - done;
 
-		if ((aud_fx->wahData->skipcount++) % lfoskipsamples == 0)
+		if(wah->skipcount % lfoskipsamples == 0)
 		{
-			frequency = (1 + cos(aud_fx->wahData->skipcount * aud_fx->wahData->lfoskip + aud_fx->wahData->phase)) * 0.5;
+			float frequency = (1 + cos((wah->skipcount + 1) * wah->lfoskip + wah->phase)) * 0.5;
 			frequency = frequency * depth * (1 - freqofs) + freqofs;
 			frequency = exp((frequency - 1) * 6);
-			omega = M_PI * frequency;
-			sn = sin(omega);
-			cs = cos(omega);
-			alpha = sn / (2 * res);
-			aud_fx->wahData->b0 = (1 - cs) * 0.5;
-			aud_fx->wahData->b1 = 1 - cs;
-			aud_fx->wahData->b2 = (1 - cs) * 0.5;
-			aud_fx->wahData->a0 = 1 + alpha;
-			aud_fx->wahData->a1 = -2 * cs;
-			aud_fx->wahData->a2 = 1 - alpha;
+			float omega = M_PI * frequency;
+			float sn = sin(omega);
+			float cs = cos(omega);
+			float alpha = sn / (2 * res);
+			float inv_a0 = 1.0f / (1 + alpha);
+			wah->filt.b0 = (1 - cs) * 0.5 * inv_a0;
+			wah->filt.b1 = (1 - cs) * inv_a0;
+			wah->filt.b2 = (1 - cs) * 0.5 * inv_a0;
+			wah->filt.a1 = -2 * cs * inv_a0;
+			wah->filt.a2 = (1 - alpha) * inv_a0;
 		}
-		float out = (aud_fx->wahData->b0 * in + aud_fx->wahData->b1 * aud_fx->wahData->xn1 +
-			aud_fx->wahData->b2 * aud_fx->wahData->xn2 - aud_fx->wahData->a1 * aud_fx->wahData->yn1 -
-			aud_fx->wahData->a2 * aud_fx->wahData->yn2) / aud_fx->wahData->a0;
-		aud_fx->wahData->xn2 = aud_fx->wahData->xn1;
-		aud_fx->wahData->xn1 = in;
-		aud_fx->wahData->yn2 = aud_fx->wahData->yn1;
-		aud_fx->wahData->yn1 = out;
-
-		data[samp] = clip_float(out);
+
+		for(ch = 0; ch < fx->channels; ++ch)
+			biquad_plane(&wah->filt, ch, fx->planes + ch * fx->frames + done, n);
+
+		wah->skipcount += n;
+		done += n;
 	}
 }
 
 /*
  * change pitch effect
+ *   reduces the number of samples (1 in rate) and repeats
+ *   windows of wSize samples rate times, then low pass filters
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
+ *   fx - pointer to fx data
  *   rate - window rate
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_change_pitch (audio_context_t *audio_ctx,
-	sample_t *data,
-	int rate)
+static void audio_fx_change_pitch(audio_fx_t *fx, int rate)
 {
-	if(aud_fx->RT1 == NULL)
+	fx_rate_data_t *rt = &fx->pitch;
+	int ch = 0;
+
+	for(ch = 0; ch < fx->channels; ++ch)
 	{
-		aud_fx->RT1 = calloc(1, sizeof(fx_rate_data_t));
-		if(aud_fx->RT1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->RT1->wBuff1 = NULL;
-		aud_fx->RT1->wBuff2 = NULL;
-		aud_fx->RT1->rBuff1 = calloc(audio_ctx->capture_buff_size/audio_ctx->channels, sizeof(sample_t));
-		if(aud_fx->RT1->rBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->RT1->rBuff2 = NULL;
-		if(audio_ctx->channels > 1)
+		float *x = fx->planes + ch * fx->frames;
+		float *rbuff = rt->rBuff + ch * fx->frames;
+		float *wbuff = rt->wBuff + ch * rt->wSize;
+
+		/*reduce number of samples*/
+		int numsamples = 0;
+		int samp = 0;
+		for(samp = 0; samp < fx->frames; samp += rate)
+			rbuff[numsamples++] = x[samp];
+
+		/*repeat windows*/
+		int i = 0;
+		int index = 0;
+		int r = 0;
+		for(samp = 0; samp < numsamples; samp++)
 		{
-			aud_fx->RT1->rBuff2 = calloc(audio_ctx->capture_buff_size/audio_ctx->channels, sizeof(sample_t));
-			if(aud_fx->RT1->rBuff2 == NULL)
+			wbuff[i++] = rbuff[samp];
+			if(i >= rt->wSize)
 			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-				exit(-1);
+				for(r = 0; r < rate && index + rt->wSize <= fx->frames; r++)
+				{
+					memcpy(x + index, wbuff, rt->wSize * sizeof(float));
+					index += rt->wSize;
+				}
+				i = 0;
 			}
 		}
 	}
 
-	change_rate_less(aud_fx->RT1, data, rate, audio_ctx->capture_buff_size, audio_ctx->channels);
-	change_tempo_more(audio_ctx, data, rate, 20);
-	LPF(audio_ctx, data, audio_ctx->samprate * 0.25, 0.9);
+	biquad_process(&rt->lpf, fx->planes, fx->frames, fx->channels);
 }
 
-/*
- * clean fx_delay_data_t
- * args:
- *   DELAY - pointer to fx_delay_data_t
- *
- * asserts:
- *   none
- *
- * returns: none
- */
-static void close_DELAY(fx_delay_data_t *DELAY)
-{
-	if(DELAY != NULL)
-	{
-		free(DELAY->delayBuff1);
-		free(DELAY->delayBuff2);
-		free(DELAY);
-	}
-}
+/*------------------------------ state handling ------------------------------*/
 
 /*
- * clean fx_comb4_data_t
+ * reset the state of an effect (on enable)
  * args:
- *   COMB4 - pointer to fx_comb4_data_t
+ *   fx - pointer to fx data
+ *   slot - effect slot
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_COMB4(fx_comb4_data_t *COMB4)
+static void audio_fx_reset(audio_fx_t *fx, int slot)
 {
-	if(COMB4 != NULL)
+	int k = 0;
+	switch(slot)
 	{
-		free(COMB4->CombBuff10);
-		free(COMB4->CombBuff20);
-		free(COMB4->CombBuff30);
-		free(COMB4->CombBuff40);
-
-		free(COMB4->CombBuff11);
-		free(COMB4->CombBuff21);
-		free(COMB4->CombBuff31);
-		free(COMB4->CombBuff41);
-
-		free(COMB4);
+		case FX_ECHO:
+			delay_reset(&fx->echo, fx->channels);
+			break;
+		case FX_REVERB:
+			for(k = 0; k < 4; ++k)
+				delay_reset(&fx->comb[k], fx->channels);
+			delay_reset(&fx->allpass, fx->channels);
+			break;
+		case FX_FUZZ:
+			biquad_reset(&fx->hpf, fx->channels);
+			break;
+		case FX_WAHWAH:
+			fx->wah.skipcount = 0;
+			biquad_reset(&fx->wah.filt, fx->channels);
+			break;
+		case FX_DUCKY:
+			biquad_reset(&fx->pitch.lpf, fx->channels);
+			break;
 	}
 }
 
 /*
- * clean fx_filt_data_t
+ * free fx data
  * args:
- *   FILT - pointer to fx_filt_data_t
+ *   fx - pointer to fx data
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_FILT(fx_filt_data_t *FILT)
+static void audio_fx_free(audio_fx_t *fx)
 {
-	if(FILT != NULL)
-	{
-		free(FILT);
-	}
+	if(fx == NULL)
+		return;
+
+	int k = 0;
+	free(fx->planes);
+	free(fx->acc);
+	free(fx->echo.buff);
+	for(k = 0; k < 4; ++k)
+		free(fx->comb[k].buff);
+	free(fx->allpass.buff);
+	free(fx->hpf.x1);
+	free(fx->wah.filt.x1);
+	free(fx->pitch.rBuff);
+	free(fx->pitch.wBuff);
+	free(fx->pitch.lpf.x1);
+	free(fx);
 }
 
 /*
- * clean fx_wah_data_t
+ * initialize audio fx data for a stream format
+ *   (all effects state is allocated here, never while processing)
  * args:
- *   WAH - pointer to fx_wah_data_t
+ *   channels - number of channels
+ *   samprate - sample rate
+ *   frames - frames per block
  *
  * asserts:
- *   none
+ *    none
  *
- * returns: none
+ * returns: pointer to fx data
  */
-static void close_WAHWAH(fx_wah_data_t *WAH)
+static audio_fx_t *audio_fx_init(int channels, int samprate, int frames)
 {
-	if(WAH != NULL)
+	audio_fx_t *fx = calloc(1, sizeof(audio_fx_t));
+	if(fx == NULL)
 	{
-		free(WAH);
+		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_init): %s\n", strerror(errno));
+		exit(-1);
 	}
-}
 
-/*
- * clean reverb data
- * args:
- *   none
- *
- * asserts:
- *   none
- *
- * returns: none
- */
-static void close_reverb()
-{
-	close_DELAY(aud_fx->AP1);
-	aud_fx->AP1 = NULL;
-	close_COMB4(aud_fx->COMB4);
-	aud_fx->COMB4 = NULL;
+	fx->channels = channels;
+	fx->samprate = samprate;
+	fx->frames = frames;
+
+	fx->planes = fx_alloc(channels * frames);
+	fx->acc = fx_alloc(channels * frames);
+
+	/*echo*/
+	delay_alloc(&fx->echo, ECHO_DELAY_MS, samprate, channels);
+
+	/*reverb: 4 parallel comb filters and an all pass*/
+	int k = 0;
+	for(k = 0; k < 4; ++k)
+		delay_alloc(&fx->comb[k], REVERB_DELAY_MS - 5 * k, samprate, channels);
+	delay_alloc(&fx->allpass, REVERB_DELAY_MS, samprate, channels);
+
+	/*fuzz*/
+	biquad_alloc(&fx->hpf, channels);
+	biquad_set_hpf(&fx->hpf, samprate, FUZZ_HPF_FREQ, FUZZ_HPF_RES);
+
+	/*wahwah*/
+	biquad_alloc(&fx->wah.filt, channels);
+	fx->wah.lfoskip = WAH_FREQ * 2 * M_PI / samprate;
+	fx->wah.phase = WAH_STARTPHASE;
+
+	/*pitch*/
+	fx->pitch.wSize = (int) (PITCH_WINDOW_MS * samprate * 0.001);
+	if(fx->pitch.wSize < 1)
+		fx->pitch.wSize = 1;
+	fx->pitch.rBuff = fx_alloc(channels * frames);
+	fx->pitch.wBuff = fx_alloc(channels * fx->pitch.wSize);
+	biquad_alloc(&fx->pitch.lpf, channels);
+	biquad_set_lpf(&fx->pitch.lpf, samprate, samprate * 0.25, PITCH_LPF_RES);
+
+	if(verbosity > 1)
+		printf("AUDIO: fx graph for %i channels, %i Hz, %i frames per block\n",
+			channels, samprate, frames);
+
+	return fx;
 }
 
 /*
- * clean pitch data
+ * print the average cost of the active effects
  * args:
- *   none
+ *   fx - pointer to fx data
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_pitch ()
+static void audio_fx_report(audio_fx_t *fx)
 {
-	if(aud_fx->RT1 != NULL)
+	int slot = 0;
+	printf("AUDIO: fx cost per block (%i ch x %i frames):", fx->channels, fx->frames);
+	for(slot = 0; slot < FX_NUM; ++slot)
 	{
-		free(aud_fx->RT1->rBuff1);
-		free(aud_fx->RT1->rBuff2);
-		free(aud_fx->RT1->wBuff1);
-		free(aud_fx->RT1->wBuff2);
-		free(aud_fx->RT1);
-		aud_fx->RT1 = NULL;
-		close_FILT(aud_fx->LPF1);
-		aud_fx->LPF1 = NULL;
+		if(fx->cost_blocks[slot] > 0)
+			printf(" %s %.1f us", fx_names[slot],
+				(double) fx->cost_ns[slot] / fx->cost_blocks[slot] / 1000.0);
 	}
+	printf("\n");
 }
 
 /*
@@ -1097,31 +1034,21 @@ static void close_pitch ()
  */
 void audio_fx_close()
 {
-	if(aud_fx == NULL)
-		return;
-
-	close_DELAY(aud_fx->ECHO);
-	aud_fx->ECHO = NULL;
-	close_reverb();
-	close_WAHWAH(aud_fx->wahData);
-	aud_fx->wahData = NULL;
-	close_FILT(aud_fx->HPF);
-	aud_fx->HPF = NULL;
-	close_pitch();
-
-	free(aud_fx);
+	audio_fx_free(aud_fx);
 	aud_fx = NULL;
 }
 
 /*
  * apply audio fx
+ *   the block is deinterleaved once, runs through the enabled
+ *   effects (echo, reverb, fuzz, wahwah, ducky) and is interleaved back
  * args:
  *   audio_ctx - pointer to audio context
- *   proc_buff - pointer to audio buffer to process
+ *   data - pointer to audio buffer to process (interleaved)
  *   mask - or'ed fx combination
  *
  * asserts:
- *    none
+ *    audio_ctx is not null
  *
  * returns: none
  */
@@ -1129,48 +1056,75 @@ void audio_fx_apply(audio_context_t *audio_ctx,
 	sample_t *data,
 	uint32_t mask)
 {
-	if(mask != AUDIO_FX_NONE)
-    {
-		if(verbosity > 2)
-			printf("AUDIO: Apllying Fx (0x%x)\n", mask);
-			
-		if(aud_fx == NULL)
-			audio_fx_init();
-		
-		if(mask & AUDIO_FX_ECHO)
-			audio_fx_echo(audio_ctx, data, 300, 0.5);
-		else
-		{
-			close_DELAY(aud_fx->ECHO);
-			aud_fx->ECHO = NULL;
-		}
+	/*assertions*/
+	assert(audio_ctx != NULL);
 
-		if(mask & AUDIO_FX_REVERB)
-			audio_fx_reverb(audio_ctx, data, 50);
-		else
-			close_reverb();
+	if(mask == AUDIO_FX_NONE)
+	{
+		/*keep the state allocated, effects are reset when enabled again*/
+		if(aud_fx)
+			aud_fx->active = AUDIO_FX_NONE;
+		return;
+	}
 
-		if(mask & AUDIO_FX_FUZZ)
-			audio_fx_fuzz(audio_ctx, data);
-		else
-		{
-			close_FILT(aud_fx->HPF);
-			aud_fx->HPF = NULL;
-		}
+	int channels = audio_ctx->channels;
+	if(channels <= 0 || audio_ctx->samprate <= 0)
+		return;
+	int frames = audio_ctx->capture_buff_size / channels;
 
-		if(mask & AUDIO_FX_WAHWAH)
-			audio_fx_wahwah(audio_ctx, data, 1.5, 0, 0.7, 0.3, 2.5);
-		else
+	if(aud_fx == NULL || aud_fx->channels != channels ||
+		aud_fx->samprate != audio_ctx->samprate || aud_fx->frames != frames)
+	{
+		audio_fx_free(aud_fx);
+		aud_fx = audio_fx_init(channels, audio_ctx->samprate, frames);
+	}
+
+	audio_fx_t *fx = aud_fx;
+
+	if(verbosity > 2 && mask != fx->active)
+		printf("AUDIO: Apllying Fx (0x%x)\n", mask);
+
+	audio_deinterleave_float(fx->planes, data, frames, channels);
+
+	int slot = 0;
+	for(slot = 0; slot < FX_NUM; ++slot)
+	{
+		if(!(mask & fx_flags[slot]))
+			continue;
+
+		/*newly enabled: start from silence*/
+		if(!(fx->active & fx_flags[slot]))
+			audio_fx_reset(fx, slot);
+
+		uint64_t t0 = fx_time_ns();
+
+		switch(slot)
 		{
-			close_WAHWAH(aud_fx->wahData);
-			aud_fx->wahData = NULL;
+			case FX_ECHO:
+				audio_fx_echo(fx);
+				break;
+			case FX_REVERB:
+				audio_fx_reverb(fx);
+				break;
+			case FX_FUZZ:
+				audio_fx_fuzz(fx);
+				break;
+			case FX_WAHWAH:
+				audio_fx_wahwah(fx, WAH_DEPTH, WAH_FREQOFS, WAH_RES);
+				break;
+			case FX_DUCKY:
+				audio_fx_change_pitch(fx, PITCH_RATE);
+				break;
 		}
 
-		if(mask & AUDIO_FX_DUCKY)
-			audio_fx_change_pitch(audio_ctx, data, 2);
-		else
-			close_pitch();
+		fx->cost_ns[slot] += fx_time_ns() - t0;
+		fx->cost_blocks[slot]++;
 	}
-	else
-		audio_fx_close();
+
+	fx->active = mask;
+
+	audio_interleave_float(data, fx->planes, frames, channels);
+
+	if(verbosity > 1 && (++fx->blocks % FX_REPORT_BLOCKS) == 0)
+		audio_fx_report(fx);
 }
@@ -0,0 +1,363 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Audio library - level metering                                               #
+#                                                                               #
+#  peak and rms levels are measured on the capture buffers as they arrive      #
+#  (no copies) and published lock free at a fixed rate for the UI              #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "gviewaudio.h"
+#include "audio.h"
+
+extern int verbosity;
+
+/*
+ * accumulate peak and sum of squares for a block of interleaved samples
+ *   1, 2, 4 and 8 channels use simd (each lane always maps to the same
+ *   channel), other channel counts fall back to scalar code
+ * args:
+ *   in - pointer to interleaved samples
+ *   frames - number of frames
+ *   channels - number of channels (<= AUDIO_METER_MAX_CHANNELS)
+ *   peak - pointer to per channel peak (absolute) values to update
+ *   sumsq - pointer to per channel sum of squares to update
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void audio_meter_accumulate(const sample_t *in, int frames, int channels,
+	float *peak, float *sumsq)
+{
+	int n = frames * channels;
+	int i = 0;
+	int l = 0;
+
+	if(8 % channels == 0)
+	{
+		float lane_peak[8];
+		float lane_sum[8];
+#if defined(__SSE2__)
+		const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 p0 = _mm_setzero_ps();
+		__m128 p1 = _mm_setzero_ps();
+		__m128 s0 = _mm_setzero_ps();
+		__m128 s1 = _mm_setzero_ps();
+		for(; i + 8 <= n; i += 8)
+		{
+			__m128 a = _mm_loadu_ps(in + i);
+			__m128 b = _mm_loadu_ps(in + i + 4);
+			p0 = _mm_max_ps(p0, _mm_and_ps(a, abs_mask));
+			p1 = _mm_max_ps(p1, _mm_and_ps(b, abs_mask));
+			s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+		}
+		_mm_storeu_ps(lane_peak, p0);
+		_mm_storeu_ps(lane_peak + 4, p1);
+		_mm_storeu_ps(lane_sum, s0);
+		_mm_storeu_ps(lane_sum + 4, s1);
+#elif defined(__aarch64__)
+		float32x4_t p0 = vdupq_n_f32(0);
+		float32x4_t p1 = vdupq_n_f32(0);
+		float32x4_t s0 = vdupq_n_f32(0);
+		float32x4_t s1 = vdupq_n_f32(0);
+		for(; i + 8 <= n; i += 8)
+		{
+			float32x4_t a = vld1q_f32(in + i);
+			float32x4_t b = vld1q_f32(in + i + 4);
+			p0 = vmaxq_f32(p0, vabsq_f32(a));
+			p1 = vmaxq_f32(p1, vabsq_f32(b));
+			s0 = vmlaq_f32(s0, a, a);
+			s1 = vmlaq_f32(s1, b, b);
+		}
+		vst1q_f32(lane_peak, p0);
+		vst1q_f32(lane_peak + 4, p1);
+		vst1q_f32(lane_sum, s0);
+		vst1q_f32(lane_sum + 4, s1);
+#else
+		memset(lane_peak, 0, sizeof(lane_peak));
+		memset(lane_sum, 0, sizeof(lane_sum));
+#endif
+		/*lane l holds samples of channel l % channels*/
+		for(l = 0; l < 8; ++l)
+		{
+			int ch = l % channels;
+			if(peak[ch] < lane_peak[l])
+				peak[ch] = lane_peak[l];
+			sumsq[ch] += lane_sum[l];
+		}
+	}
+
+	/*remaining samples (i is always a multiple of channels)*/
+	int ch = 0;
+	for(; i < n; ++i)
+	{
+		float v = fabsf(in[i]);
+		if(peak[ch] < v)
+			peak[ch] = v;
+		sumsq[ch] += v * v;
+		if(++ch >= channels)
+			ch = 0;
+	}
+}
+
+/*
+ * get peak and rms levels of a block of interleaved samples
+ * args:
+ *   in - pointer to interleaved samples
+ *   frames - number of frames
+ *   channels - number of channels (<= AUDIO_METER_MAX_CHANNELS)
+ *   peak - pointer to per channel peak output (absolute value)
+ *   rms - pointer to per channel rms output
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_get_block_levels(const sample_t *in, int frames, int channels,
+	float *peak, float *rms)
+{
+	if(channels <= 0 || channels > AUDIO_METER_MAX_CHANNELS)
+		return;
+
+	memset(peak, 0, channels * sizeof(float));
+	memset(rms, 0, channels * sizeof(float));
+
+	if(in == NULL || frames <= 0)
+		return;
+
+	audio_meter_accumulate(in, frames, channels, peak, rms);
+
+	int ch = 0;
+	for(ch = 0; ch < channels; ++ch)
+		rms[ch] = sqrtf(rms[ch] / frames);
+}
+
+/*
+ * reset the metering tap (called before starting the stream)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_meter_reset(audio_context_t *audio_ctx)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	memset(audio_ctx->meter_peak_acc, 0, sizeof(audio_ctx->meter_peak_acc));
+	memset(audio_ctx->meter_sumsq_acc, 0, sizeof(audio_ctx->meter_sumsq_acc));
+	audio_ctx->meter_frames = 0;
+	audio_ctx->meter_period = audio_ctx->samprate / AUDIO_METER_RATE;
+	if(audio_ctx->meter_period < 1)
+		audio_ctx->meter_period = 1;
+
+	float zero[AUDIO_METER_MAX_CHANNELS] = {0};
+	audio_meter_publish(audio_ctx, zero, zero);
+}
+
+/*
+ * publish levels (seqlock writer, capture thread only)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   peak - per channel peak values
+ *   rms - per channel rms values
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_meter_publish(audio_context_t *audio_ctx, const float *peak, const float *rms)
+{
+	uint32_t seq = audio_ctx->meter_seq; /*only written by this thread*/
+	int ch = 0;
+
+	__atomic_store_n(&audio_ctx->meter_seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for(ch = 0; ch < AUDIO_METER_MAX_CHANNELS; ++ch)
+	{
+		__atomic_store(&audio_ctx->meter_peak[ch], (float *) &peak[ch], __ATOMIC_RELAXED);
+		__atomic_store(&audio_ctx->meter_rms[ch], (float *) &rms[ch], __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&audio_ctx->meter_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * metering tap: measure captured samples in place
+ *   runs on the capture (real time) thread: no locks, allocation or stdio,
+ *   levels are published every meter_period frames
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   in - pointer to interleaved captured samples (NULL for silence)
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_meter_process(audio_context_t *audio_ctx, const sample_t *in, int frames)
+{
+	int channels = audio_ctx->channels;
+	if(channels > AUDIO_METER_MAX_CHANNELS)
+		channels = AUDIO_METER_MAX_CHANNELS;
+
+	while(frames > 0)
+	{
+		int n = audio_ctx->meter_period - audio_ctx->meter_frames;
+		if(n > frames)
+			n = frames;
+
+		if(in != NULL)
+		{
+			if(channels == audio_ctx->channels)
+				audio_meter_accumulate(in, n, channels,
+					audio_ctx->meter_peak_acc, audio_ctx->meter_sumsq_acc);
+			else
+			{
+				/*only the first AUDIO_METER_MAX_CHANNELS are metered*/
+				int i = 0;
+				for(i = 0; i < n; ++i)
+					audio_meter_accumulate(in + i * audio_ctx->channels, 1, channels,
+						audio_ctx->meter_peak_acc, audio_ctx->meter_sumsq_acc);
+			}
+			in += n * audio_ctx->channels;
+		}
+
+		audio_ctx->meter_frames += n;
+		frames -= n;
+
+		if(audio_ctx->meter_frames >= audio_ctx->meter_period)
+		{
+			float rms[AUDIO_METER_MAX_CHANNELS] = {0};
+			int ch = 0;
+			for(ch = 0; ch < channels; ++ch)
+				rms[ch] = sqrtf(audio_ctx->meter_sumsq_acc[ch] / audio_ctx->meter_frames);
+
+			audio_meter_publish(audio_ctx, audio_ctx->meter_peak_acc, rms);
+
+			memset(audio_ctx->meter_peak_acc, 0, sizeof(audio_ctx->meter_peak_acc));
+			memset(audio_ctx->meter_sumsq_acc, 0, sizeof(audio_ctx->meter_sumsq_acc));
+			audio_ctx->meter_frames = 0;
+		}
+	}
+}
+
+/*
+ * get the last published levels
+ *   lock free (seqlock reader), can be called from any thread
+ *   while the stream runs, also in metering only mode
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   peak - pointer to per channel peak output (or NULL)
+ *   rms - pointer to per channel rms output (or NULL)
+ *   max_channels - size of the peak and rms arrays
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: number of channels copied
+ */
+int audio_get_levels(audio_context_t *audio_ctx, float *peak, float *rms, int max_channels)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	int channels = audio_ctx->channels;
+	if(channels > AUDIO_METER_MAX_CHANNELS)
+		channels = AUDIO_METER_MAX_CHANNELS;
+	if(channels > max_channels)
+		channels = max_channels;
+	if(channels <= 0)
+		return 0;
+
+	float p[AUDIO_METER_MAX_CHANNELS];
+	float r[AUDIO_METER_MAX_CHANNELS];
+	uint32_t seq0 = 0;
+	uint32_t seq1 = 0;
+	int ch = 0;
+
+	do
+	{
+		seq0 = __atomic_load_n(&audio_ctx->meter_seq, __ATOMIC_ACQUIRE);
+		for(ch = 0; ch < channels; ++ch)
+		{
+			__atomic_load(&audio_ctx->meter_peak[ch], &p[ch], __ATOMIC_RELAXED);
+			__atomic_load(&audio_ctx->meter_rms[ch], &r[ch], __ATOMIC_RELAXED);
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq1 = __atomic_load_n(&audio_ctx->meter_seq, __ATOMIC_RELAXED);
+	} while((seq0 & 1) || seq0 != seq1);
+
+	if(peak)
+		memcpy(peak, p, channels * sizeof(float));
+	if(rms)
+		memcpy(rms, r, channels * sizeof(float));
+
+	return channels;
+}
+
+/*
+ * set metering only mode
+ *   the stream keeps running and feeding the level meter
+ *   but captured buffers are not queued for the consumer
+ *   (level metering while previewing without recording)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   flag - 1 metering only, 0 metering and buffering
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_set_meter_only(audio_context_t *audio_ctx, int flag)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	__atomic_store_n(&audio_ctx->meter_only, flag ? 1 : 0, __ATOMIC_RELAXED);
+}
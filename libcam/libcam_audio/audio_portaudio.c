@@ -50,6 +50,8 @@ static int sample_index = 0;
 
 /*
  * Portaudio record callback
+ *   runs on the portaudio real time thread: no locks, allocation or stdio,
+ *   stream problems are counted and reported by the audio consumer
  * args:
  *    inputBuffer - pointer to captured input data (for recording)
  *    outputBuffer - pointer ouput data (for playing - NOT USED)
@@ -76,17 +78,9 @@ __attribute__((unused))	void *outputBuffer,
 	/*asserts*/
 	assert(audio_ctx != NULL);
 	
-	if(audio_ctx->channels == 0)
-	{
-		fprintf(stderr, "AUDIO: (portaudio) recordCallback failed: channels = 0\n");
-		return (paContinue);
-	}
-	
-	if(audio_ctx->samprate == 0)
-	{
-		fprintf(stderr, "AUDIO: (portaudio) recordCallback failed: samprate = 0\n");
+	/*checked in audio_start_portaudio*/
+	if(audio_ctx->channels == 0 || audio_ctx->samprate == 0)
 		return (paContinue);
-	}
 
 	uint32_t i = 0;
 
@@ -108,7 +102,7 @@ __attribute__((unused))	void *outputBuffer,
 
 	if(statusFlags & paInputOverflow)
 	{
-		fprintf( stderr, "AUDIO: portaudio buffer overflow\n" );
+		__atomic_add_fetch(&audio_ctx->input_overflows, 1, __ATOMIC_RELAXED);
 
 		int64_t d_ts = ts - audio_ctx->last_ts;
 		uint32_t n_samples = (d_ts / frame_length) * audio_ctx->channels;
@@ -123,43 +117,25 @@ __attribute__((unused))	void *outputBuffer,
 				sample_index = 0;
 			}
 		}
-
-		if(verbosity > 1)
-            printf("AUDIO: compensate overflow with %u silence samples\n", n_samples);
 	}
 	if(statusFlags & paInputUnderflow)
-		fprintf( stderr, "AUDIO: portaudio buffer underflow\n" );
+		__atomic_add_fetch(&audio_ctx->input_underflows, 1, __ATOMIC_RELAXED);
 
-	if(sample_index == 0)
-	{
-		audio_ctx->capture_buff_level[0] = 0;
-		audio_ctx->capture_buff_level[1] = 0;
-	}
+	/*metering tap (on the portaudio buffer, no copy)*/
+	audio_meter_process(audio_ctx, rptr, framesPerBuffer);
 
-	int chan = 0;
 	/*store capture samples*/
 	for( i = 0; i < numSamples; ++i )
-    {
-        capture_buff[sample_index] = inputBuffer ? *rptr++ : 0;
-       
-        if(sample_index < audio_ctx->capture_buff_size){
-            /*store peak value*/
-            if(audio_ctx->capture_buff_level[chan] < capture_buff[sample_index])
-                audio_ctx->capture_buff_level[chan] = capture_buff[sample_index];
-            chan++;
-            if(chan >= audio_ctx->channels)
-                chan = 0;
-        }
-		 sample_index++;
-        if(sample_index >= audio_ctx->capture_buff_size)
+	{
+		capture_buff[sample_index] = inputBuffer ? *rptr++ : 0;
+
+		sample_index++;
+		if(sample_index >= audio_ctx->capture_buff_size)
 		{
 			buff_ts = ts + ( i / audio_ctx->channels ) * frame_length;
 
 			audio_fill_buffer(audio_ctx, buff_ts);
 
-			/*reset*/
-			audio_ctx->capture_buff_level[0] = 0;
-			audio_ctx->capture_buff_level[1] = 0;
 			sample_index = 0;
 		}
 	}
@@ -401,6 +377,13 @@ int audio_start_portaudio(audio_context_t *audio_ctx)
 		}
 	}
 
+	if(audio_ctx->channels <= 0 || audio_ctx->samprate <= 0)
+	{
+		fprintf(stderr, "AUDIO: (portaudio) can't start stream: channels = %i samprate = %i\n",
+			audio_ctx->channels, audio_ctx->samprate);
+		return(-1);
+	}
+
 	PaStreamParameters inputParameters;
 
 	inputParameters.device = audio_ctx->list_devices[audio_ctx->device].id;
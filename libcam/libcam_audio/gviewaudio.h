@@ -62,6 +62,10 @@ __BEGIN_DECLS
 #define AUDIO_FX_WAHWAH (1<<3)
 #define AUDIO_FX_DUCKY  (1<<4)
 
+/*level metering*/
+#define AUDIO_METER_MAX_CHANNELS (8)  /*metered channels*/
+#define AUDIO_METER_RATE         (30) /*published levels per second*/
+
 /*audio sample format (definition also in gview_encoder)*/
 #ifndef GV_SAMPLE_TYPE_INT16
 #define GV_SAMPLE_TYPE_INT16  (0) //interleaved
@@ -80,6 +84,7 @@ typedef struct _audio_buff_t {
     int64_t timestamp;
     int flag;
     float level_meter[2]; /*average sample level*/
+    int64_t capture_ts; /*real (monotonic) capture time of the buffer end*/
 } audio_buff_t;
 
 typedef struct _audio_device_t {
@@ -109,6 +114,9 @@ void audio_set_verbosity(int value);
 
 /*
  * audio initialization
+ *   the capture is limited to 2 channels (devices with more channels
+ *   are opened as stereo), the vu meter and the recording paths only
+ *   handle mono and stereo
  * args:
  *   api - audio API to use
  *           (AUDIO_NONE, AUDIO_PORTAUDIO, AUDIO_PULSE, ...)
@@ -323,8 +331,91 @@ int audio_get_next_buffer(audio_context_t *audio_ctx,
                           int type,
                           uint32_t mask);
 
+/*
+ * convert interleaved float samples to the requested format
+ *   (single pass: simd conversion and deinterleave)
+ * args:
+ *   out - pointer to output buffer
+ *   in - pointer to interleaved float input
+ *   frames - number of frames
+ *   channels - number of channels
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void audio_convert_samples(void *out, const sample_t *in, int frames, int channels, int type);
+
+/*
+ * wait for a captured buffer to be ready (blocking, no polling)
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   timeout_ms - max time to wait in ms
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: 0 if a buffer is ready, 1 on timeout
+ */
+int audio_wait_buffer(audio_context_t *audio_ctx, int timeout_ms);
+
+/*
+ * get peak and rms levels of a block of interleaved samples
+ * args:
+ *   in - pointer to interleaved samples
+ *   frames - number of frames
+ *   channels - number of channels (<= AUDIO_METER_MAX_CHANNELS)
+ *   peak - pointer to per channel peak output (absolute value)
+ *   rms - pointer to per channel rms output
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_get_block_levels(const sample_t *in, int frames, int channels,
+	float *peak, float *rms);
+
+/*
+ * get the last published levels (AUDIO_METER_RATE times per second)
+ *   lock free, can be called from any thread
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   peak - pointer to per channel peak output (or NULL)
+ *   rms - pointer to per channel rms output (or NULL)
+ *   max_channels - size of the peak and rms arrays
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: number of channels copied
+ */
+int audio_get_levels(audio_context_t *audio_ctx, float *peak, float *rms, int max_channels);
+
+/*
+ * set metering only mode
+ *   the stream keeps feeding the level meter but captured
+ *   buffers are not queued (metering while previewing)
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *   flag - 1 metering only, 0 metering and buffering
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_set_meter_only(audio_context_t *audio_ctx, int flag);
+
 /*
  * apply audio fx
+ *   effects run on planar blocks for any number of channels, the
+ *   filters are vectorized across groups of 4 channels so with the
+ *   current mono/stereo capture (see audio_init) they take the
+ *   scalar per channel path
  * args:
  *   audio_ctx - pointer to audio context
  *   data - pointer to sample buffer to process
@@ -9,6 +9,7 @@ HEADERS += \
 SOURCES += \
     $$PWD/audio.c \
     $$PWD/audio_fx.c \
+    $$PWD/audio_meter.c \
     $$PWD/audio_portaudio.c \
 #    $$PWD/audio_pulseaudio.c \
 #    $$PWD/core_time.c
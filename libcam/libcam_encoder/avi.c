@@ -750,6 +750,25 @@ static int avi_write_counters(avi_context_t *avi_ctx, __attribute__((unused))avi
     return 0;
 }
 
+/*
+ * store a 32 bit value (little endian) in a byte array
+ * args:
+ *   p - pointer to the array (at least 4 bytes)
+ *   val - value to store
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static inline void avi_put_le32(uint8_t *p, uint32_t val)
+{
+    p[0] = (uint8_t) val;
+    p[1] = (uint8_t) (val >> 8);
+    p[2] = (uint8_t) (val >> 16);
+    p[3] = (uint8_t) (val >> 24);
+}
+
 static int avi_write_ix(avi_context_t *avi_ctx)
 {
     char tag[5];
@@ -761,6 +780,13 @@ static int avi_write_ix(avi_context_t *avi_ctx)
     if (riff->id > AVI_MASTER_INDEX_SIZE)
         return -1;
 
+    uint8_t *ix_buf = malloc(AVI_INDEX_CLUSTER_SIZE * 8);
+    if (ix_buf == NULL)
+    {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (avi_write_ix): %s\n", strerror(errno));
+        exit(-1);
+    }
+
     for (i=0;i<avi_ctx->stream_list_size;i++)
     {
         stream_io_t *stream = get_stream(avi_ctx->stream_list, i);
@@ -785,14 +811,21 @@ static int avi_write_ix(avi_context_t *avi_ctx)
         io_write_wl64(avi_ctx->writer, (uint64_t)riff->movi_list);/* qwBaseOffset */
         io_write_wl32(avi_ctx->writer, 0);             /* dwReserved_3 (must be 0) */
 
-        for (j=0; j< indexes->entry; j++)
+        /* pack each index cluster and write it in one go */
+        for (j=0; j< indexes->entry; j+= AVI_INDEX_CLUSTER_SIZE)
         {
-             avi_I_entry_t *ie = avi_get_ientry(indexes, j);
-             io_write_wl32(avi_ctx->writer, ie->pos + 8);
-             io_write_wl32(avi_ctx->writer, ((uint32_t)ie->len & ~0x80000000) |
-                          (ie->flags & 0x10 ? 0 : 0x80000000));
+             avi_I_entry_t *ie = indexes->cluster[j / AVI_INDEX_CLUSTER_SIZE];
+             int n = MIN(indexes->entry - j, AVI_INDEX_CLUSTER_SIZE);
+             uint8_t *p = ix_buf;
+             int k;
+             for (k=0; k < n; k++, p += 8)
+             {
+                 avi_put_le32(p, ie[k].pos + 8);
+                 avi_put_le32(p + 4, ((uint32_t)ie[k].len & ~0x80000000) |
+                          (ie[k].flags & 0x10 ? 0 : 0x80000000));
+             }
+             io_write_buf(avi_ctx->writer, ix_buf, n * 8);
          }
-         io_flush_buffer(avi_ctx->writer);
          pos = io_get_offset(avi_ctx->writer); //current position
          if(verbosity > 0)
 			printf("ENCODER: (avi) wrote ix %s with %i entries\n",
@@ -811,6 +844,8 @@ static int avi_write_ix(avi_context_t *avi_ctx)
 		//return to position
          io_seek(avi_ctx->writer, pos);
     }
+
+    free(ix_buf);
     return 0;
 }
 
@@ -826,6 +861,15 @@ static int avi_write_idx1(avi_context_t *avi_ctx, avi_riff_t *riff)
     avi_I_entry_t *ie = 0, *tie;
     int empty, stream_id = -1;
 
+    /* merged entries are packed and written in bulk */
+    uint8_t *idx_buf = malloc(AVI_INDEX_CLUSTER_SIZE * 16);
+    if (idx_buf == NULL)
+    {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (avi_write_idx1): %s\n", strerror(errno));
+        exit(-1);
+    }
+    int n = 0;
+
     idx_chunk = avi_open_tag(avi_ctx, "idx1");
     for (i=0;i<avi_ctx->stream_list_size;i++)
     {
@@ -856,15 +900,26 @@ static int avi_write_idx1(avi_context_t *avi_ctx, avi_riff_t *riff)
         {
             stream = get_stream(avi_ctx->stream_list, stream_id);
             avi_stream2fourcc(tag, stream);
-            io_write_4cc(avi_ctx->writer, tag);
-            io_write_wl32(avi_ctx->writer, ie->flags);
-            io_write_wl32(avi_ctx->writer, ie->pos);
-            io_write_wl32(avi_ctx->writer, ie->len);
+            uint8_t *p = idx_buf + n * 16;
+            memcpy(p, tag, 4);
+            avi_put_le32(p + 4, ie->flags);
+            avi_put_le32(p + 8, ie->pos);
+            avi_put_le32(p + 12, ie->len);
             stream->entry++;
+
+            if (++n == AVI_INDEX_CLUSTER_SIZE)
+            {
+                io_write_buf(avi_ctx->writer, idx_buf, n * 16);
+                n = 0;
+            }
         }
     }
     while (!empty);
 
+    if (n > 0)
+        io_write_buf(avi_ctx->writer, idx_buf, n * 16);
+    free(idx_buf);
+
     avi_close_tag(avi_ctx, idx_chunk);
     if(verbosity > 0)
 		printf("ENCODER: (avi) wrote idx1\n");
@@ -952,8 +1007,10 @@ __attribute__((unused))	int block_align,
     if (size & 1)
         io_write_w8(avi_ctx->writer, 0);
 
-    io_flush_buffer(avi_ctx->writer);
-
+    /*
+     * no flush here: offsets are tracked by the writer, data reaches
+     * the file when the buffer fills up or on RIFF boundaries
+     */
     return 0;
 }
 
@@ -128,6 +128,12 @@ static int video_read_index = 0;
 static int video_write_index = 0;
 static int video_scheduler = 0;
 
+/*video encoder statistics (encoder thread)*/
+static uint64_t stats_window_start = 0; /*current window start (monotonic ns)*/
+static uint64_t stats_busy_time = 0;    /*encoding time in the current window (ns)*/
+static int stats_frames = 0;            /*frames encoded in the current window*/
+static double stats_encode_fps = 0;     /*throughput of the last window*/
+
 static int64_t video_pause_timestamp = 0;
 
 /*
@@ -418,6 +424,153 @@ static void encoder_set_raw_video_input(
     }
 }
 
+/*
+ * set the video codec tuning (threads, preset, rate control and lookahead)
+ * args:
+ *   video_codec_data - pointer to video codec data
+ *   video_defaults - pointer to video codec defaults
+ *
+ * asserts:
+ *   video_codec_data is not null
+ *   video_codec_data->codec_context is not null
+ *   video_defaults is not null
+ *
+ * returns: none
+ */
+static void encoder_set_video_tuning(
+    encoder_codec_data_t *video_codec_data,
+    video_codec_t *video_defaults)
+{
+    //assertions
+    assert(video_codec_data != NULL);
+    assert(video_codec_data->codec_context != NULL);
+    assert(video_defaults != NULL);
+
+    AVCodecContext *codec_context = video_codec_data->codec_context;
+    AVDictionary **options = &video_codec_data->private_options;
+
+    /*threads: auto is one per core*/
+    int threads = video_defaults->num_threads;
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int) cores : 1;
+        if (threads > ENCODER_MAX_AUTO_THREADS)
+            threads = ENCODER_MAX_AUTO_THREADS;
+    }
+    codec_context->thread_count = threads;
+
+    if (video_defaults->thread_type == ENCODER_THREAD_SLICE)
+        codec_context->thread_type = FF_THREAD_SLICE;
+    else if (video_defaults->thread_type == ENCODER_THREAD_FRAME)
+        codec_context->thread_type = FF_THREAD_FRAME;
+
+    /*rate control: bit rate modes*/
+    switch (video_defaults->rc_mode) {
+    case ENCODER_RC_CBR:
+        codec_context->bit_rate = video_defaults->rc_value;
+        codec_context->rc_min_rate = video_defaults->rc_value;
+        codec_context->rc_max_rate = video_defaults->rc_value;
+        codec_context->rc_buffer_size = video_defaults->rc_value; /*1 sec*/
+        break;
+    case ENCODER_RC_VBR:
+        codec_context->bit_rate = video_defaults->rc_value;
+        break;
+    default:
+        break;
+    }
+
+    char value[32];
+
+    /*
+     * tile columns (log2) for the row multithreaded encoders:
+     * one per thread with a minimum tile width of 256 pixels
+     */
+    int tiles_log2 = 0;
+    while ((2 << tiles_log2) <= threads && (codec_context->width >> (tiles_log2 + 1)) >= 256)
+        tiles_log2++;
+
+    switch (video_defaults->codec_id) {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
+        if (video_defaults->preset[0])
+            getAvutil()->m_av_dict_set(options, "preset", video_defaults->preset, 0);
+        if (video_defaults->tune[0])
+            getAvutil()->m_av_dict_set(options, "tune", video_defaults->tune, 0);
+        if (video_defaults->rc_mode == ENCODER_RC_CRF)
+            getAvutil()->m_av_dict_set_int(options, "crf", video_defaults->rc_value, 0);
+        if (video_defaults->lookahead > 0) {
+            if (video_defaults->codec_id == AV_CODEC_ID_H264)
+                getAvutil()->m_av_dict_set_int(options, "rc-lookahead", video_defaults->lookahead, 0);
+            else {
+                snprintf(value, sizeof(value), "rc-lookahead=%i", video_defaults->lookahead);
+                getAvutil()->m_av_dict_set(options, "x265-params", value, 0);
+            }
+        }
+        break;
+
+    case AV_CODEC_ID_VP8:
+    case AV_CODEC_ID_VP9:
+        /*libvpx: the preset is the encoding deadline (good, realtime or best)*/
+        if (video_defaults->preset[0])
+            getAvutil()->m_av_dict_set(options, "deadline", video_defaults->preset, 0);
+        if (video_defaults->tune[0])
+            getAvutil()->m_av_dict_set(options, "tune", video_defaults->tune, 0);
+        if (video_defaults->speed != 0)
+            getAvutil()->m_av_dict_set_int(options, "cpu-used", video_defaults->speed, 0);
+        if (video_defaults->rc_mode == ENCODER_RC_CRF)
+            getAvutil()->m_av_dict_set_int(options, "crf", video_defaults->rc_value, 0);
+        if (video_defaults->lookahead > 0)
+            getAvutil()->m_av_dict_set_int(options, "lag-in-frames", video_defaults->lookahead, 0);
+        if (video_defaults->codec_id == AV_CODEC_ID_VP9) {
+            getAvutil()->m_av_dict_set_int(options, "row-mt", 1, 0);
+            getAvutil()->m_av_dict_set_int(options, "tile-columns", tiles_log2, 0);
+        }
+        break;
+
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+    case AV_CODEC_ID_AV1:
+        if (video_codec_data->codec && video_codec_data->codec->name &&
+                strcmp(video_codec_data->codec->name, "libsvtav1") == 0) {
+            /*SVT-AV1: the speed is the encoder preset (threads are managed by the encoder)*/
+            if (video_defaults->speed != 0)
+                getAvutil()->m_av_dict_set_int(options, "preset", video_defaults->speed, 0);
+            if (video_defaults->rc_mode == ENCODER_RC_CRF)
+                getAvutil()->m_av_dict_set_int(options, "crf", video_defaults->rc_value, 0);
+            snprintf(value, sizeof(value), "tile-columns=%i", tiles_log2);
+            getAvutil()->m_av_dict_set(options, "svtav1-params", value, 0);
+        } else {
+            /*libaom: the preset is the usage (good or realtime)*/
+            if (video_defaults->preset[0])
+                getAvutil()->m_av_dict_set(options, "usage", video_defaults->preset, 0);
+            if (video_defaults->speed != 0)
+                getAvutil()->m_av_dict_set_int(options, "cpu-used", video_defaults->speed, 0);
+            if (video_defaults->rc_mode == ENCODER_RC_CRF)
+                getAvutil()->m_av_dict_set_int(options, "crf", video_defaults->rc_value, 0);
+            if (video_defaults->lookahead > 0)
+                getAvutil()->m_av_dict_set_int(options, "lag-in-frames", video_defaults->lookahead, 0);
+            getAvutil()->m_av_dict_set_int(options, "row-mt", 1, 0);
+            getAvutil()->m_av_dict_set_int(options, "tile-columns", tiles_log2, 0);
+        }
+        break;
+#endif
+
+    default:
+        /*native libav encoders: constant quality is a fixed qscale*/
+        if (video_defaults->rc_mode == ENCODER_RC_CRF) {
+            codec_context->flags |= AV_CODEC_FLAG_QSCALE;
+            codec_context->global_quality = FF_QP2LAMBDA * video_defaults->rc_value;
+        }
+        break;
+    }
+
+    if (verbosity > 0)
+        printf("ENCODER: video tuning (%s): %i threads (type %i) preset '%s' tune '%s' speed %i rc %i (%i) lookahead %i\n",
+               video_defaults->codec_name, threads, video_defaults->thread_type,
+               video_defaults->preset, video_defaults->tune, video_defaults->speed,
+               video_defaults->rc_mode, video_defaults->rc_value,
+               video_defaults->lookahead);
+}
+
 /*
  * video encoder initialization
  * args:
@@ -527,8 +680,6 @@ static encoder_video_context_t *encoder_video_init(encoder_context_t *encoder_ct
     video_codec_data->codec_context->height = encoder_ctx->video_height;
 
     video_codec_data->codec_context->flags |= video_defaults->flags;
-    if (video_defaults->num_threads > 0)
-        video_codec_data->codec_context->thread_count = video_defaults->num_threads;
     /*
      * mb_decision:
      * 0 (FF_MB_DECISION_SIMPLE) Use mbcmp (default).
@@ -586,30 +737,17 @@ static encoder_video_context_t *encoder_video_init(encoder_context_t *encoder_ct
         video_codec_data->codec_context->gop_size = video_codec_data->codec_context->time_base.den;
     }
     switch (video_defaults->codec_id) {
-    case AV_CODEC_ID_H264: {
-        video_codec_data->codec_context->me_range = 16;
-        //av_dict_set(&video_codec_data->private_options, "rc_lookahead", "1", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "crf", "23", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "preset", "ultrafast", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "tune", "zerolatency", 0);
-    }
-    break;
-    case AV_CODEC_ID_HEVC: {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
         video_codec_data->codec_context->me_range = 16;
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "crf", "28", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "preset", "ultrafast", 0);
-    }
-    break;
-    case AV_CODEC_ID_VP8: {
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "quality", "good", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "cpu-used", "-10", 0);
-        getAvutil()->m_av_dict_set(&video_codec_data->private_options, "speed", "10", 0);
-    }
-    break;
+        break;
     default:
         break;
     }
 
+    /*threads, preset, rate control and lookahead*/
+    encoder_set_video_tuning(video_codec_data, video_defaults);
+
     int ret = 0;
     /* open codec*/
     if ((ret = getLoadLibsInstance()->m_avcodec_open2(
@@ -793,7 +931,7 @@ static encoder_audio_context_t *encoder_audio_init(encoder_context_t *encoder_ct
     int best_samprate = select_sample_rate(audio_codec_data->codec, encoder_ctx->audio_samprate);
 
     if (best_samprate != encoder_ctx->audio_samprate) {
-        fprintf(stderr, "ENCODER: audio codec doesn't support sample rate = %i (best is %i)\n",
+        fprintf(stderr, "ENCODER: audio codec doesn't support sample rate = %i (resampling to %i)\n",
                 encoder_ctx->audio_samprate, best_samprate);
         encoder_ctx->audio_samprate = best_samprate;
     }
@@ -922,6 +1060,21 @@ static encoder_audio_context_t *encoder_audio_init(encoder_context_t *encoder_ct
     /*set codec data in encoder context*/
     enc_audio_ctx->codec_data = (void *) audio_codec_data;
 
+    /*
+     * resample capture buffers (frame_size frames at the capture rate)
+     * to the codec rate and correct the capture clock drift
+     */
+    enc_audio_ctx->resampler = encoder_resampler_init(
+                                   encoder_ctx->audio_channels,
+                                   encoder_ctx->audio_in_samprate,
+                                   encoder_ctx->audio_samprate,
+                                   audio_defaults->sample_format,
+                                   frame_size);
+
+    if (!enc_audio_ctx->resampler && encoder_ctx->audio_in_samprate != encoder_ctx->audio_samprate)
+        fprintf(stderr, "ENCODER: no audio resampler: audio will play at the wrong rate (%i -> %i)\n",
+                encoder_ctx->audio_in_samprate, encoder_ctx->audio_samprate);
+
     return (enc_audio_ctx);
 #endif
 }
@@ -953,6 +1106,28 @@ int encoder_get_audio_frame_size(encoder_context_t *encoder_ctx)
 
 }
 
+/*
+ * get the measured audio clock drift
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: drift of the audio capture clock against
+ *   the video (monotonic) clock in ppm (0 if not measured)
+ */
+double encoder_get_audio_drift_ppm(encoder_context_t *encoder_ctx)
+{
+    /*assertions*/
+    assert(encoder_ctx);
+
+    if (encoder_ctx->enc_audio_ctx == NULL || encoder_ctx->enc_audio_ctx->resampler == NULL)
+        return 0;
+
+    return encoder_resampler_get_drift((encoder_resampler_t *) encoder_ctx->enc_audio_ctx->resampler);
+}
+
 /*
  * get the audio encoder input sample format
  * args:
@@ -1074,6 +1249,144 @@ double encoder_buff_scheduler(int mode, double thresh, double max_time)
     return (sched_time);
 }
 
+/*
+ * get the video encoder statistics
+ * args:
+ *   encode_fps - pointer to encoder throughput (frames per second
+ *      of encoding time, measured over the last second) or NULL
+ *   queue_depth - pointer to frames waiting in the ring buffer or NULL
+ *   queue_size - pointer to ring buffer size or NULL
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_get_video_stats(double *encode_fps, int *queue_depth, int *queue_size)
+{
+    int diff_ind = 0;
+
+    __LOCK_MUTEX(__PMUTEX);
+    if (video_write_index >= video_read_index)
+        diff_ind = video_write_index - video_read_index;
+    else
+        diff_ind = (video_ring_buffer_size - video_read_index) + video_write_index;
+    /*same index with a used buffer: ring is full*/
+    if (diff_ind == 0 && video_ring_buffer &&
+            video_ring_buffer[video_read_index].flag != VIDEO_BUFF_FREE)
+        diff_ind = video_ring_buffer_size;
+
+    if (encode_fps)
+        *encode_fps = stats_encode_fps;
+    __UNLOCK_MUTEX(__PMUTEX);
+
+    if (queue_depth)
+        *queue_depth = diff_ind;
+    if (queue_size)
+        *queue_size = video_ring_buffer_size;
+}
+
+/*
+ * encode synthetic frames (packets are dropped) to measure the encoder speed
+ * args:
+ *   video_codec_ind - video codec list index
+ *   width - frame width
+ *   height - frame height
+ *   fps_num - fps numerator
+ *   fps_den - fps denominator
+ *   frames - number of frames to encode
+ *
+ * asserts:
+ *   none
+ *
+ * returns: encoded frames per second (-1 on error)
+ */
+double encoder_benchmark_video(int video_codec_ind, int width, int height,
+    int fps_num, int fps_den, int frames)
+{
+    if (video_codec_ind <= 0 || width <= 0 || height <= 0 || frames <= 0) {
+        fprintf(stderr, "ENCODER: (benchmark) bad parameters\n");
+        return -1;
+    }
+
+    encoder_context_t *encoder_ctx = encoder_init(
+        V4L2_PIX_FMT_YUV420,
+        video_codec_ind,
+        -1, /*no audio*/
+        ENCODER_MUX_MKV,
+        width,
+        height,
+        fps_num,
+        fps_den,
+        0,
+        0);
+
+    if (!encoder_ctx || !encoder_ctx->enc_video_ctx || encoder_ctx->video_codec_ind != video_codec_ind) {
+        fprintf(stderr, "ENCODER: (benchmark) video codec %i not available\n", video_codec_ind);
+        if (encoder_ctx)
+            encoder_close(encoder_ctx);
+        return -1;
+    }
+
+    /*the armed muxer keeps the packets in the pre-roll ring (no file)*/
+    encoder_muxer_arm(encoder_ctx);
+
+    int size = (width * height * 3) / 2;
+    uint8_t *frame = calloc(size, sizeof(uint8_t));
+    if (frame == NULL) {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_benchmark_video): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    int64_t frame_time = fps_den > 0 ? (int64_t) NSEC_PER_SEC * fps_num / fps_den : NSEC_PER_SEC / 30;
+    uint64_t busy_time = 0;
+    int i = 0;
+    for (i = 0; i < frames; i++) {
+        /*synthetic frame: moving luma gradient with noise, flat chroma*/
+        int x = 0;
+        int y = 0;
+        uint32_t seed = (uint32_t) i * 2654435761u;
+        for (y = 0; y < height; y++) {
+            uint8_t *line = frame + y * width;
+            for (x = 0; x < width; x++) {
+                seed = seed * 1103515245u + 12345u;
+                line[x] = (uint8_t) (((x + y + i * 4) & 0xFF) ^ ((seed >> 24) & 0x0F));
+            }
+        }
+        memset(frame + width * height, 128, size - width * height);
+
+        encoder_ctx->enc_video_ctx->pts = i * frame_time;
+
+        uint64_t start = v4l2core_time_get_timestamp();
+        if (HW_VAAPI_OK == is_vaapi)
+            encoder_encode_video_vaapi(encoder_ctx, frame);
+        else
+            encoder_encode_video(encoder_ctx, frame);
+        busy_time += v4l2core_time_get_timestamp() - start;
+    }
+
+    /*delayed frames are part of the encoding time*/
+    uint64_t start = v4l2core_time_get_timestamp();
+    encoder_ctx->enc_video_ctx->flush_delayed_frames = 1;
+    if (HW_VAAPI_OK == is_vaapi)
+        encoder_encode_video_vaapi(encoder_ctx, NULL);
+    else
+        encoder_encode_video(encoder_ctx, NULL);
+    busy_time += v4l2core_time_get_timestamp() - start;
+
+    free(frame);
+    encoder_muxer_disarm();
+    encoder_close(encoder_ctx);
+
+    double fps = busy_time > 0 ? (double) frames * NSEC_PER_SEC / busy_time : 0;
+
+    if (verbosity > 0)
+        printf("ENCODER: (benchmark) codec %i %ix%i: %i frames in %.3f sec (%.1f fps)\n",
+               video_codec_ind, width, height, frames, (double) busy_time / NSEC_PER_SEC, fps);
+
+    return fps;
+}
+
 /*
  * get valid video codec count
  * args:
@@ -1158,6 +1471,7 @@ encoder_context_t *encoder_init(
 
     encoder_ctx->audio_channels = audio_channels;
     encoder_ctx->audio_samprate = audio_samprate;
+    encoder_ctx->audio_in_samprate = audio_samprate;
 
     /******************* video **********************/
     encoder_video_init_vaapi(encoder_ctx);
@@ -1279,11 +1593,30 @@ int encoder_process_next_video_buffer(encoder_context_t *encoder_ctx)
         if (video_ring_buffer[video_read_index].keyframe)
             encoder_ctx->enc_video_ctx->flags |= AV_PKT_FLAG_KEY;
     }
+    uint64_t encode_start = v4l2core_time_get_timestamp();
+
     if (HW_VAAPI_OK == is_vaapi)
         encoder_encode_video_vaapi(encoder_ctx, video_ring_buffer[video_read_index].frame);
     else
         encoder_encode_video(encoder_ctx, video_ring_buffer[video_read_index].frame);
 
+    /*encoder throughput: frames per second of encoding time*/
+    uint64_t encode_end = v4l2core_time_get_timestamp();
+    if (stats_window_start == 0)
+        stats_window_start = encode_start;
+    stats_busy_time += encode_end - encode_start;
+    stats_frames++;
+    if (encode_end - stats_window_start >= NSEC_PER_SEC) {
+        double encode_fps = stats_busy_time > 0 ?
+            (double) stats_frames * NSEC_PER_SEC / stats_busy_time : 0;
+        __LOCK_MUTEX(__PMUTEX);
+        stats_encode_fps = encode_fps;
+        __UNLOCK_MUTEX(__PMUTEX);
+        stats_window_start = encode_end;
+        stats_busy_time = 0;
+        stats_frames = 0;
+    }
+
     /*mux the frame*/
     __LOCK_MUTEX(__PMUTEX);
 
@@ -1377,9 +1710,28 @@ int encoder_flush_audio_buffer(encoder_context_t *encoder_ctx)
     /*assertions*/
     assert(encoder_ctx != NULL);
 
-    /*flush libav*/
+    encoder_audio_context_t *enc_audio_ctx = encoder_ctx->enc_audio_ctx;
     int flushed_frame_counter = 0;
-    encoder_ctx->enc_audio_ctx->flush_delayed_frames  = 1;
+
+    if (!enc_audio_ctx)
+        return -1;
+
+    encoder_resampler_t *rs = (encoder_resampler_t *) enc_audio_ctx->resampler;
+
+    /*drain the resampler delay and fifo before flushing the codec*/
+    if (rs != NULL && encoder_resampler_push(rs, NULL, 0, 0, 0) >= 0) {
+        uint8_t *frame = NULL;
+        int64_t pts = 0;
+
+        while ((frame = encoder_resampler_pull(rs, &pts)) != NULL) {
+            enc_audio_ctx->pts = pts;
+            encoder_encode_audio(encoder_ctx, frame);
+            flushed_frame_counter++;
+        }
+    }
+
+    /*flush libav*/
+    enc_audio_ctx->flush_delayed_frames  = 1;
 
     // while(!encoder_ctx->enc_audio_ctx->flush_done)
     // {
@@ -1414,7 +1766,29 @@ int encoder_process_audio_buffer(encoder_context_t *encoder_ctx, void *data)
         encoder_ctx->audio_channels <= 0)
         return -1;
 
-    return encoder_encode_audio(encoder_ctx, data);
+    encoder_audio_context_t *enc_audio_ctx = encoder_ctx->enc_audio_ctx;
+    encoder_resampler_t *rs = (encoder_resampler_t *) enc_audio_ctx->resampler;
+
+    if (rs == NULL || data == NULL)
+        return encoder_encode_audio(encoder_ctx, data);
+
+    /*capture buffers hold one codec frame at the capture rate*/
+    int ret = encoder_resampler_push(rs, data,
+                                     encoder_get_audio_frame_size(encoder_ctx),
+                                     enc_audio_ctx->pts,
+                                     enc_audio_ctx->capture_ts);
+    if (ret < 0)
+        return ret;
+
+    ret = 0;
+    uint8_t *frame = NULL;
+    int64_t pts = 0;
+    while ((frame = encoder_resampler_pull(rs, &pts)) != NULL) {
+        enc_audio_ctx->pts = pts;
+        ret = encoder_encode_audio(encoder_ctx, frame);
+    }
+
+    return ret;
 
     // int ret = encoder_write_audio_data(encoder_ctx);
 
@@ -2015,6 +2389,8 @@ void encoder_close(encoder_context_t *encoder_ctx)
         if (enc_audio_ctx->outbuf)
             free(enc_audio_ctx->outbuf);
 
+        encoder_resampler_close((encoder_resampler_t *) enc_audio_ctx->resampler);
+
         free(enc_audio_ctx);
     }
 
@@ -2035,6 +2411,11 @@ void encoder_close(encoder_context_t *encoder_ctx)
     video_write_index = 0;
     video_scheduler = 0;
 
+    stats_window_start = 0;
+    stats_busy_time = 0;
+    stats_frames = 0;
+    stats_encode_fps = 0;
+
     if (HW_VAAPI_OK == is_vaapi)
         vaapi_over();
 }
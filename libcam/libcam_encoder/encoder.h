@@ -209,6 +209,37 @@ int avpriv_split_xiph_headers(
     uint8_t *header_start[3],
     int header_len[3]);
 
+/*
+ * remove the OBUs that must not be stored in a container
+ *   (temporal delimiters, redundant frame headers, tile lists
+ *   and padding), as libavformat does for Matroska and MP4
+ * args:
+ *    buf - pointer to the temporal unit (filtered in place)
+ *    size - temporal unit size
+ *
+ * asserts:
+ *    buf is not null
+ *
+ * returns: filtered size (the original size if the data can't be parsed)
+ */
+int av1_filter_obus(uint8_t *buf, int size);
+
+/*
+ * build the AV1 codec configuration record (av1C) from the encoder extradata
+ *   the record fields are parsed from the sequence header, which is
+ *   stored as the (only) config OBU
+ * args:
+ *    extradata - encoder extradata (sequence header OBU or av1C)
+ *    extradata_size - extradata size
+ *    av1c - pointer to store the record (at least extradata_size + 4 bytes)
+ *
+ * asserts:
+ *    av1c is not null
+ *
+ * returns: av1C size or -1 if no sequence header was found
+ */
+int av1_get_codec_config(const uint8_t *extradata, int extradata_size, uint8_t *av1c);
+
 /*
  * set yu12 frame in codec data frame
  * args:
@@ -334,4 +365,151 @@ int encoder_get_audio_bits(int codec_ind);
  */
 int encoder_get_audio_bit_rate(int codec_ind);
 
+/*audio resampler (capture rate -> codec rate with clock drift correction)*/
+typedef struct _encoder_resampler_t encoder_resampler_t;
+
+/*
+ * create the audio resampler
+ * args:
+ *   channels - number of channels
+ *   in_rate - capture sample rate
+ *   out_rate - codec sample rate
+ *   sample_fmt - codec sample format (input is in the same format)
+ *   frame_size - codec frame size (frames)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to resampler (or NULL if not available)
+ */
+encoder_resampler_t *encoder_resampler_init(int channels, int in_rate, int out_rate,
+        int sample_fmt, int frame_size);
+
+/*
+ * push a captured audio buffer into the resampler
+ * args:
+ *   rs - pointer to resampler
+ *   data - captured samples (codec sample format)
+ *     or NULL to flush: drains the resampler delay and pads
+ *     the last partial frame with silence
+ *   in_frames - number of frames in data
+ *   pts - buffer pts (nanosec)
+ *   capture_ts - capture (monotonic) time of the buffer end (<= 0 if unknown)
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: number of output frames added (or < 0 on error)
+ */
+int encoder_resampler_push(encoder_resampler_t *rs, const void *data, int in_frames,
+                           int64_t pts, int64_t capture_ts);
+
+/*
+ * pull one encoder frame from the resampler
+ * args:
+ *   rs - pointer to resampler
+ *   pts - pointer to frame pts (nanosec)
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: pointer to frame_size frames in the codec layout
+ *   (or NULL if there is not enough data)
+ */
+uint8_t *encoder_resampler_pull(encoder_resampler_t *rs, int64_t *pts);
+
+/*
+ * get the measured audio clock drift
+ * args:
+ *   rs - pointer to resampler
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: drift of the capture device clock in ppm
+ */
+double encoder_resampler_get_drift(encoder_resampler_t *rs);
+
+/*
+ * free the audio resampler
+ * args:
+ *   rs - pointer to resampler
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_resampler_close(encoder_resampler_t *rs);
+
+/*live stream sink (MPEG-TS over udp/rtp fed with the encoded packets)*/
+typedef struct _encoder_stream_sink_t encoder_stream_sink_t;
+
+/*
+ * create the stream sink and start its sender thread
+ * args:
+ *   url - destination (udp://host:port or rtp://host:port)
+ *   video_codec_context - video encoder context (NULL for camera encoded data)
+ *   video_codec_id - video codec id
+ *   width - video width
+ *   height - video height
+ *   audio_codec_context - audio encoder context (NULL if no audio)
+ *
+ * asserts:
+ *   url is not null
+ *
+ * returns: pointer to stream sink (or NULL on error)
+ */
+encoder_stream_sink_t *encoder_stream_sink_init(const char *url,
+        AVCodecContext *video_codec_context, int video_codec_id, int width, int height,
+        AVCodecContext *audio_codec_context);
+
+/*
+ * queue an encoded packet for the stream sink (copies the data)
+ *   never blocks on the network: drops the packet if the queue is full
+ * args:
+ *   sink - pointer to stream sink
+ *   stream_index - 0 for video, 1 for audio
+ *   data - encoded packet data
+ *   size - packet size
+ *   pts - packet pts (nanosec)
+ *   flags - packet flags
+ *
+ * asserts:
+ *   sink is not null
+ *
+ * returns: 0 if queued, -1 if dropped
+ */
+int encoder_stream_sink_push(encoder_stream_sink_t *sink, int stream_index,
+        const uint8_t *data, int size, int64_t pts, int flags);
+
+/*
+ * get the stream sink stats
+ * args:
+ *   sink - pointer to stream sink
+ *   sent - pointer to sent packets count (can be NULL)
+ *   dropped - pointer to dropped packets count (can be NULL)
+ *
+ * asserts:
+ *   sink is not null
+ *
+ * returns: none
+ */
+void encoder_stream_sink_get_stats(encoder_stream_sink_t *sink, uint64_t *sent, uint64_t *dropped);
+
+/*
+ * stop the stream sink: discards the queued packets and sends the trailer
+ * args:
+ *   sink - pointer to stream sink
+ *   sent - pointer to final sent packets count (can be NULL)
+ *   dropped - pointer to final dropped packets count (can be NULL)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_stream_sink_close(encoder_stream_sink_t *sink, uint64_t *sent, uint64_t *dropped);
+
 #endif
+
@@ -39,30 +39,34 @@
 
 
 /*
- * get the file position pointer
+ * write data straight to the file and update the logical offsets
+ *   (the file position is tracked, no fflush/ftello round trips)
  * args:
  *   writer - pointer to io_writer
+ *   data - pointer to data
+ *   nitems - number of bytes to write
  *
  * asserts:
  *   writer is not null
  *
- * returns: the file position pointer
+ * returns: error code
  */
-static int64_t io_tell(io_writer_t *writer)
+static int io_write_file(io_writer_t *writer, const uint8_t *data, size_t nitems)
 {
 	/*assertions*/
 	assert(writer != NULL);
 
-	if(writer->fp == NULL)
+	if(fwrite(data, 1, nitems, writer->fp) < nitems)
 	{
-		fprintf(stderr, "ENCODER: (io_tell) no file pointer associated with io_writer (mem only ?)\n");
+		fprintf(stderr, "ENCODER: (io_write_file) file write error: %s\n", strerror(errno));
 		return -1;
 	}
-	/*flush the file buffer*/
-	fflush(writer->fp);
 
-	/*return the file pointer position*/
-	return ((int64_t) ftello(writer->fp));
+	writer->position += (int64_t) nitems;
+	if(writer->position > writer->size)
+		writer->size = writer->position;
+
+	return 0;
 }
 
 /* flush a mem only writer(buf_writer) into a file writer
@@ -126,9 +130,15 @@ io_writer_t *io_create_writer(const char *filename, int max_size)
 		{
 			fprintf(stderr, "ENCODER: Could not open file for writing: %s\n",
 				strerror(errno));
+			free(writer->buffer);
 			free(writer);
 			return NULL;
 		}
+		/*
+		 * we already buffer in writer->buffer and bypass it for large
+		 * writes: don't copy everything again into the stdio buffer
+		 */
+		setvbuf(writer->fp, NULL, _IONBF, 0);
 	}
 	else
 		writer->fp = NULL; /*mem only writer (must be flushed to a file writer*/
@@ -166,6 +176,77 @@ void io_destroy_writer(io_writer_t *writer)
     free(writer);
 }
 
+/*
+ * create a new writer on an anonymous temporary file
+ *   (the file is removed when the writer is destroyed)
+ * args:
+ *   max_size - mem buffer size (if 0 use default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to io_writer (NULL on error)
+ */
+io_writer_t *io_create_tmp_writer(int max_size)
+{
+	io_writer_t *writer = io_create_writer(NULL, max_size);
+
+	writer->fp = tmpfile();
+	if(writer->fp == NULL)
+	{
+		fprintf(stderr, "ENCODER: Could not create temporary file: %s\n",
+			strerror(errno));
+		free(writer->buffer);
+		free(writer);
+		return NULL;
+	}
+	setvbuf(writer->fp, NULL, _IONBF, 0);
+
+	return writer;
+}
+
+/*
+ * append the file contents of src to writer
+ * args:
+ *   writer - pointer to io_writer
+ *   src - pointer to a file io_writer (left positioned at its end)
+ *
+ * asserts:
+ *   writer is not null
+ *   src is not null
+ *
+ * returns: number of bytes copied (-1 on error)
+ */
+int64_t io_write_writer(io_writer_t *writer, io_writer_t *src)
+{
+	/*assertions*/
+	assert(writer != NULL);
+	assert(src != NULL);
+
+	if(src->fp == NULL || io_flush_buffer(src) < 0)
+		return -1;
+
+	if(fseeko(src->fp, 0, SEEK_SET) != 0)
+	{
+		fprintf(stderr, "ENCODER: (io_write_writer) rewind failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/*the (empty) src buffer is used for reading*/
+	int64_t total = 0;
+	size_t nitems = 0;
+	while((nitems = fread(src->buffer, 1, (size_t) src->buffer_size, src->fp)) > 0)
+	{
+		io_write_buf(writer, src->buffer, (int) nitems);
+		total += (int64_t) nitems;
+	}
+
+	fseeko(src->fp, 0, SEEK_END);
+	src->position = src->size;
+
+	return total;
+}
+
 /*
  * flush the writer buffer to disk
  * args:
@@ -188,15 +269,14 @@ int64_t io_flush_buffer(io_writer_t *writer)
 		return -1;
 	}
 
-	size_t nitems = 0;
 	if (writer->buf_ptr > writer->buffer)
 	{
-        nitems= (size_t)(writer->buf_ptr - writer->buffer);
-		if(fwrite(writer->buffer, 1, nitems, writer->fp) < nitems)
+		size_t nitems = (size_t)(writer->buf_ptr - writer->buffer);
+		if(io_write_file(writer, writer->buffer, nitems) < 0)
 		{
-			fprintf(stderr, "ENCODER: (io_flush) file write error: %s\n", strerror(errno));
-            //stop_encoder_thread();
-            return -1;
+			fprintf(stderr, "ENCODER: (io_flush) file write error\n");
+			//stop_encoder_thread();
+			return -1;
 		}
 	}
 	else if (writer->buf_ptr < writer->buffer)
@@ -206,21 +286,8 @@ int64_t io_flush_buffer(io_writer_t *writer)
 		return -1;
 	}
 
-    int64_t size_inc = (int64_t)nitems - (writer->size - writer->position);
-	if(size_inc > 0)
-		writer->size += size_inc;
-
-	writer->position = io_tell(writer); /*update current file pointer position*/
-
 	writer->buf_ptr = writer->buffer;
 
-	/*should never happen*/
-	if(writer->position > writer->size)
-	{
-		fprintf(stderr, "ENCODER: (io_flush) file pointer ( %" PRIu64 " ) above expected file size ( %" PRIu64 " )\n", writer->position, writer->size);
-		writer->size = writer->position;
-	}
-
 	return writer->position;
 }
 
@@ -252,11 +319,11 @@ int io_seek(io_writer_t *writer, int64_t position)
 		/*flush the memory buffer (we need an empty buffer)*/
 		io_flush_buffer(writer);
 		/*try to move the file pointer to position*/
-		int ret = fseeko(writer->fp, position, SEEK_SET);
+		ret = fseeko(writer->fp, position, SEEK_SET);
 		if(ret != 0)
 			fprintf(stderr, "ENCODER: (io_seek) seek to file position %" PRIu64 "failed\n", position);
 		else
-			writer->position = io_tell(writer); /*update current file pointer position*/
+			writer->position = position; /*update current file pointer position*/
 
 		/*we are now on position with an empty memory buffer*/
 	}
@@ -302,8 +369,12 @@ int io_skip(io_writer_t *writer, int offset)
 	int ret = fseeko(writer->fp, offset, SEEK_CUR);
 	if(ret != 0)
 		fprintf(stderr, "ENCODER: (io_skip) skip file pointer by 0x%x failed\n", offset);
-
-	writer->position = io_tell(writer); //update current file pointer position
+	else
+	{
+		writer->position += offset; //update current file pointer position
+		if(writer->position > writer->size)
+			writer->size = writer->position;
+	}
 
 	/*we are on position with an empty memory buffer*/
 	return ret;
@@ -372,6 +443,18 @@ void io_write_buf(io_writer_t *writer, uint8_t *buf, int size)
 {
 	while (size > 0)
 	{
+		/*
+		 * large payloads (e.g. compressed video frames) go straight to the
+		 * file once the buffer is empty: no copy and a single write
+		 */
+		if(writer->fp != NULL &&
+			writer->buf_ptr == writer->buffer &&
+			size >= writer->buffer_size)
+		{
+			io_write_file(writer, buf, (size_t) size);
+			return;
+		}
+
         int len = (int)(writer->buf_end - writer->buf_ptr);
 		if(len < 0)
 			fprintf(stderr,"ENCODER: (io_write_buf) buff pointer outside buffer\n");
@@ -470,6 +553,18 @@ void io_write_wb16(io_writer_t *writer, uint16_t val)
  */
 void io_write_wl32(io_writer_t *writer, uint32_t val)
 {
+    if(writer->buf_end - writer->buf_ptr >= 4)
+    {
+        writer->buf_ptr[0] = (uint8_t) val;
+        writer->buf_ptr[1] = (uint8_t) (val >> 8);
+        writer->buf_ptr[2] = (uint8_t) (val >> 16);
+        writer->buf_ptr[3] = (uint8_t) (val >> 24);
+        writer->buf_ptr += 4;
+        if (writer->buf_ptr >= writer->buf_end)
+            io_flush_buffer(writer);
+        return;
+    }
+
     io_write_w8(writer, (uint8_t) val);
     io_write_w8(writer, (uint8_t) (val >> 8));
     io_write_w8(writer, (uint8_t) (val >> 16));
@@ -68,6 +68,33 @@ io_writer_t *io_create_writer(const char *filename, int max_size);
  */
 void io_destroy_writer(io_writer_t *writer);
 
+/*
+ * create a new writer on an anonymous temporary file
+ *   (the file is removed when the writer is destroyed)
+ * args:
+ *   max_size - mem buffer size (if 0 use default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to io_writer (NULL on error)
+ */
+io_writer_t *io_create_tmp_writer(int max_size);
+
+/*
+ * append the file contents of src to writer
+ * args:
+ *   writer - pointer to io_writer
+ *   src - pointer to a file io_writer (left positioned at its end)
+ *
+ * asserts:
+ *   writer is not null
+ *   src is not null
+ *
+ * returns: number of bytes copied (-1 on error)
+ */
+int64_t io_write_writer(io_writer_t *writer, io_writer_t *src);
+
 /*
  * flush the writer buffer to disk
  * args:
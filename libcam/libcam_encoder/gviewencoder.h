@@ -54,6 +54,19 @@ __BEGIN_DECLS
 #define ENCODER_SCHED_LIN  (0)
 #define ENCODER_SCHED_EXP  (1)
 
+/*video encoder thread types*/
+#define ENCODER_THREAD_AUTO   (0) //codec default
+#define ENCODER_THREAD_SLICE  (1) //slice threads (no added latency)
+#define ENCODER_THREAD_FRAME  (2) //frame threads (one frame delay per thread)
+
+/*video rate control modes*/
+#define ENCODER_RC_DEFAULT (0) //codec bit_rate
+#define ENCODER_RC_CRF     (1) //constant quality (crf or qscale)
+#define ENCODER_RC_CBR     (2) //constant bit rate
+#define ENCODER_RC_VBR     (3) //average bit rate
+
+#define ENCODER_MAX_AUTO_THREADS (16) /*max threads for auto thread count*/
+
 /*audio sample format*/
 #ifndef GV_SAMPLE_TYPE_INT16
 #define GV_SAMPLE_TYPE_INT16  (0) //interleaved
@@ -108,7 +121,14 @@ typedef struct _video_codec_t {
     int me_method;            //lavc motion estimation method
     int mpeg_quant;           //lavc mpeg quantization
     int max_b_frames;         //lavc max b frames
-    int num_threads;          //lavc num threads
+    int num_threads;          //lavc num threads (0 - auto: one per core)
+    int thread_type;          //ENCODER_THREAD_* thread type
+    char preset[16];          //encoder preset (empty - codec default)
+    char tune[16];            //encoder tune (empty - codec default)
+    int rc_mode;              //ENCODER_RC_* rate control mode
+    int rc_value;             //crf/qscale or bit rate (bps) for rc_mode
+    int lookahead;            //max lookahead frames (0 - codec default)
+    int speed;                //encoder speed level: cpu-used or svt preset (0 - codec default)
     int flags;                //lavc flags
     int monotonic_pts;        //use monotonic pts instead of timestamp based
 } video_codec_t;
@@ -187,6 +207,9 @@ typedef struct _encoder_audio_context_t {
     int flags;
     int duration;
 
+    void *resampler;     /*capture -> codec rate resampler (encoder_resampler_t)*/
+    int64_t capture_ts;  /*real (monotonic) capture time of the current buffer end*/
+
 } encoder_audio_context_t;
 
 
@@ -204,7 +227,8 @@ typedef struct _encoder_context_t {
     int fps_den;
 
     int audio_channels;
-    int audio_samprate;
+    int audio_samprate;       /*codec sample rate*/
+    int audio_in_samprate;    /*capture sample rate*/
 
     encoder_video_context_t *enc_video_ctx;
     encoder_audio_context_t *enc_audio_ctx;
@@ -358,6 +382,152 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename);
  */
 void encoder_muxer_close(encoder_context_t *encoder_ctx);
 
+/*
+ * set fragmented mp4 output (frag_keyframe+empty_moov)
+ *   takes effect on the next encoder_muxer_init
+ * args:
+ *   value - 1 to write a fragment per key frame, 0 for a single moov
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_mp4_fragmented(int value);
+
+/*
+ * get fragmented mp4 output flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if mp4 output is fragmented, 0 otherwise
+ */
+int encoder_get_mp4_fragmented();
+
+/*
+ * set segmented recording limits (takes effect on the next recording)
+ *   segments roll at the first key frame past a limit and are
+ *   self-contained files: <name>.<ext>, <name>_002.<ext>, ...
+ * args:
+ *   seconds - roll to a new file after seconds (0 - no limit)
+ *   mbytes - roll to a new file after mbytes (0 - no limit)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_segment_limits(int seconds, int mbytes);
+
+/*
+ * enable the index journal (takes effect on the next recording)
+ *   <filename>.journal logs segments, key frame offsets and synced
+ *   file sizes, persisted periodically (write only: a log for external
+ *   tools). With the journal on the recording is always segmented
+ *   (every 5 minutes if no segment limit is set), so a crash only
+ *   leaves the last segment without its index
+ * args:
+ *   value - 1 to enable, 0 to disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_index_journal(int value);
+
+/*
+ * get the number of segments in the current (or last) recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of segment files
+ */
+int encoder_get_segment_count();
+
+/*
+ * set the pre-roll limits (takes effect on the next encoder_muxer_arm)
+ * args:
+ *   seconds - seconds kept before the recording starts (0 - disabled)
+ *   mbytes - memory limit for the pre-roll packets (0 - default: 32 MB)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_preroll(int seconds, int mbytes);
+
+/*
+ * get the pre-roll duration
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pre-roll seconds (0 - disabled)
+ */
+int encoder_get_preroll();
+
+/*
+ * arm the muxer: keep the encoded packets in the pre-roll ring
+ *   until encoder_muxer_init opens the file
+ *   (with the pre-roll disabled only the current key frame group is kept)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_muxer_arm(encoder_context_t *encoder_ctx);
+
+/*
+ * disarm the muxer without recording (drops the pre-roll packets)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_muxer_disarm();
+
+/*
+ * set the live stream sink (takes effect on the next recording)
+ *   the encoded packets are also sent as MPEG-TS to url
+ * args:
+ *   url - udp://host:port or rtp://host:port (NULL or empty to disable)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_stream_sink(const char *url);
+
+/*
+ * get the live stream sink stats for the current (or last) recording
+ * args:
+ *   sent - pointer to sent packets count (can be NULL)
+ *   dropped - pointer to packets dropped with the queue full (can be NULL)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if the sink is (was) active, 0 otherwise
+ */
+int encoder_get_stream_sink_stats(uint64_t *sent, uint64_t *dropped);
+
 /*
  * get video list codec entry for codec index
  * args:
@@ -370,6 +540,75 @@ void encoder_muxer_close(encoder_context_t *encoder_ctx);
  */
 video_codec_t *encoder_get_video_codec_defaults(int codec_ind);
 
+/*
+ * set the video codec threads (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   threads - number of threads (0 - auto: one per core)
+ *   thread_type - ENCODER_THREAD_AUTO, ENCODER_THREAD_SLICE or ENCODER_THREAD_FRAME
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_threads(int codec_ind, int threads, int thread_type);
+
+/*
+ * set the video codec preset and tune (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   preset - encoder preset (NULL or empty - codec default)
+ *   tune - encoder tune (NULL or empty - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_preset(int codec_ind, const char *preset, const char *tune);
+
+/*
+ * set the video codec rate control (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   rc_mode - ENCODER_RC_DEFAULT, ENCODER_RC_CRF, ENCODER_RC_CBR or ENCODER_RC_VBR
+ *   rc_value - crf/qscale (ENCODER_RC_CRF) or bit rate in bps
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_rate_control(int codec_ind, int rc_mode, int rc_value);
+
+/*
+ * set the video codec lookahead cap (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   frames - max lookahead frames (0 - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_lookahead(int codec_ind, int frames);
+
+/*
+ * set the video codec speed level (takes effect on the next encoder_init)
+ *   libvpx and libaom cpu-used, SVT-AV1 preset
+ * args:
+ *   codec_ind - codec list index
+ *   speed - speed level (0 - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_speed(int codec_ind, int speed);
+
 /*
  * get audio list codec entry for codec index
  * args:
@@ -463,6 +702,19 @@ int encoder_get_audio_codec_ind_name(const char *codec_name);
  */
 int encoder_get_audio_frame_size(encoder_context_t *encoder_ctx);
 
+/*
+ * get the measured audio clock drift
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: drift of the audio capture clock against
+ *   the video (monotonic) clock in ppm (0 if not measured)
+ */
+double encoder_get_audio_drift_ppm(encoder_context_t *encoder_ctx);
+
 /*
  * get the audio encoder input sample format
  * args:
@@ -575,6 +827,39 @@ int encoder_set_audio_mkvCodecPriv(encoder_context_t *encoder_ctx);
  */
 double encoder_buff_scheduler(int mode, double thresh, double max_time);
 
+/*
+ * get the video encoder statistics
+ * args:
+ *   encode_fps - pointer to encoder throughput (frames per second
+ *      of encoding time, measured over the last second) or NULL
+ *   queue_depth - pointer to frames waiting in the ring buffer or NULL
+ *   queue_size - pointer to ring buffer size or NULL
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_get_video_stats(double *encode_fps, int *queue_depth, int *queue_size);
+
+/*
+ * encode synthetic frames (packets are dropped) to measure the encoder speed
+ * args:
+ *   video_codec_ind - video codec list index
+ *   width - frame width
+ *   height - frame height
+ *   fps_num - fps numerator
+ *   fps_den - fps denominator
+ *   frames - number of frames to encode
+ *
+ * asserts:
+ *   none
+ *
+ * returns: encoded frames per second (-1 on error)
+ */
+double encoder_benchmark_video(int video_codec_ind, int width, int height,
+    int fps_num, int fps_den, int frames);
+
 /*
  * store unprocessed input video frame in video ring buffer
  * args:
@@ -133,3 +133,320 @@ int avpriv_split_xiph_headers(
     return 0;
 }
 
+/*AV1 OBU types (AV1 bitstream spec 6.2.2)*/
+#define AV1_OBU_SEQUENCE_HEADER        1
+#define AV1_OBU_TEMPORAL_DELIMITER     2
+#define AV1_OBU_REDUNDANT_FRAME_HEADER 7
+#define AV1_OBU_TILE_LIST              8
+#define AV1_OBU_PADDING                15
+
+/*
+ * parse an AV1 OBU header (low overhead bitstream format)
+ * args:
+ *    buf - pointer to the OBU
+ *    size - available data size
+ *    obu_type - pointer to store the OBU type
+ *    header_size - pointer to store the OBU header size (with the size field)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: OBU size including the header or -1 on error
+ */
+static int av1_parse_obu_header(const uint8_t *buf, int size, int *obu_type, int *header_size)
+{
+	if(size < 1 || (buf[0] & 0x80)) /*forbidden bit*/
+		return -1;
+
+	*obu_type = (buf[0] >> 3) & 0x0f;
+	int extension_flag = (buf[0] >> 2) & 0x01;
+	int has_size_field = (buf[0] >> 1) & 0x01;
+
+	int pos = 1 + extension_flag;
+	if(pos > size)
+		return -1;
+
+	int64_t obu_size = size - pos;
+	if(has_size_field)
+	{
+		/*leb128*/
+		obu_size = 0;
+		int i = 0;
+		for(i = 0; i < 8; ++i)
+		{
+			if(pos >= size)
+				return -1;
+			uint8_t byte = buf[pos++];
+			obu_size |= (int64_t) (byte & 0x7f) << (i * 7);
+			if(!(byte & 0x80))
+				break;
+		}
+		if(i == 8)
+			return -1;
+	}
+
+	if(obu_size > size - pos)
+		return -1;
+
+	*header_size = pos;
+	return pos + (int) obu_size;
+}
+
+/*
+ * remove the OBUs that must not be stored in a container
+ *   (temporal delimiters, redundant frame headers, tile lists
+ *   and padding), as libavformat does for Matroska and MP4
+ * args:
+ *    buf - pointer to the temporal unit (filtered in place)
+ *    size - temporal unit size
+ *
+ * asserts:
+ *    buf is not null
+ *
+ * returns: filtered size (the original size if the data can't be parsed)
+ */
+int av1_filter_obus(uint8_t *buf, int size)
+{
+	/*assertions*/
+	assert(buf != NULL);
+
+	int in = 0;
+	int out = 0;
+	while(in < size)
+	{
+		int obu_type = 0;
+		int header_size = 0;
+		int obu_size = av1_parse_obu_header(buf + in, size - in, &obu_type, &header_size);
+		if(obu_size < 0)
+		{
+			/*keep the rest as is*/
+			if(out != in)
+				memmove(buf + out, buf + in, size - in);
+			return out + (size - in);
+		}
+
+		switch(obu_type)
+		{
+			case AV1_OBU_TEMPORAL_DELIMITER:
+			case AV1_OBU_REDUNDANT_FRAME_HEADER:
+			case AV1_OBU_TILE_LIST:
+			case AV1_OBU_PADDING:
+				break;
+			default:
+				if(out != in)
+					memmove(buf + out, buf + in, obu_size);
+				out += obu_size;
+				break;
+		}
+		in += obu_size;
+	}
+
+	return out;
+}
+
+typedef struct _av1_bits_t
+{
+	const uint8_t *buf;
+	int size;
+	int pos; /*bit position*/
+} av1_bits_t;
+
+static uint32_t av1_get_bits(av1_bits_t *bits, int n)
+{
+	uint32_t value = 0;
+	while(n-- > 0)
+	{
+		int bit = 0;
+		if(bits->pos < bits->size * 8)
+			bit = (bits->buf[bits->pos >> 3] >> (7 - (bits->pos & 7))) & 0x01;
+		bits->pos++;
+		value = (value << 1) | (uint32_t) bit;
+	}
+	return value;
+}
+
+static void av1_skip_uvlc(av1_bits_t *bits)
+{
+	int leading_zeros = 0;
+	while(leading_zeros < 32 && !av1_get_bits(bits, 1))
+		leading_zeros++;
+	if(leading_zeros < 32)
+		av1_get_bits(bits, leading_zeros);
+}
+
+/*
+ * build the AV1 codec configuration record (av1C) from the encoder extradata
+ *   the record fields are parsed from the sequence header, which is
+ *   stored as the (only) config OBU
+ * args:
+ *    extradata - encoder extradata (sequence header OBU or av1C)
+ *    extradata_size - extradata size
+ *    av1c - pointer to store the record (at least extradata_size + 4 bytes)
+ *
+ * asserts:
+ *    av1c is not null
+ *
+ * returns: av1C size or -1 if no sequence header was found
+ */
+int av1_get_codec_config(const uint8_t *extradata, int extradata_size, uint8_t *av1c)
+{
+	/*assertions*/
+	assert(av1c != NULL);
+
+	if(extradata == NULL || extradata_size <= 0)
+		return -1;
+
+	/*already a codec configuration record (marker bit set)*/
+	if(extradata_size >= 4 && (extradata[0] & 0x80))
+	{
+		memcpy(av1c, extradata, extradata_size);
+		return extradata_size;
+	}
+
+	int pos = 0;
+	while(pos < extradata_size)
+	{
+		int obu_type = 0;
+		int header_size = 0;
+		int obu_size = av1_parse_obu_header(extradata + pos, extradata_size - pos, &obu_type, &header_size);
+		if(obu_size < 0)
+			return -1;
+		if(obu_type == AV1_OBU_SEQUENCE_HEADER)
+			break;
+		pos += obu_size;
+	}
+	if(pos >= extradata_size)
+		return -1;
+
+	int obu_type = 0;
+	int header_size = 0;
+	int obu_size = av1_parse_obu_header(extradata + pos, extradata_size - pos, &obu_type, &header_size);
+
+	av1_bits_t bits = {extradata + pos + header_size, obu_size - header_size, 0};
+
+	int seq_profile = av1_get_bits(&bits, 3);
+	av1_get_bits(&bits, 1); /*still_picture*/
+	int reduced_still_picture_header = av1_get_bits(&bits, 1);
+	int seq_level_idx_0 = 0;
+	int seq_tier_0 = 0;
+	if(reduced_still_picture_header)
+		seq_level_idx_0 = av1_get_bits(&bits, 5);
+	else
+	{
+		int decoder_model_info_present = 0;
+		int buffer_delay_length = 0;
+		if(av1_get_bits(&bits, 1)) /*timing_info_present_flag*/
+		{
+			av1_get_bits(&bits, 32); /*num_units_in_display_tick*/
+			av1_get_bits(&bits, 32); /*time_scale*/
+			if(av1_get_bits(&bits, 1)) /*equal_picture_interval*/
+				av1_skip_uvlc(&bits);
+			decoder_model_info_present = av1_get_bits(&bits, 1);
+			if(decoder_model_info_present)
+			{
+				buffer_delay_length = av1_get_bits(&bits, 5) + 1;
+				av1_get_bits(&bits, 32); /*num_units_in_decoding_tick*/
+				av1_get_bits(&bits, 10); /*removal and presentation time lengths*/
+			}
+		}
+		int initial_display_delay_present = av1_get_bits(&bits, 1);
+		int operating_points = av1_get_bits(&bits, 5) + 1;
+		int i = 0;
+		for(i = 0; i < operating_points; ++i)
+		{
+			av1_get_bits(&bits, 12); /*operating_point_idc*/
+			int seq_level_idx = av1_get_bits(&bits, 5);
+			int seq_tier = seq_level_idx > 7 ? av1_get_bits(&bits, 1) : 0;
+			if(decoder_model_info_present && av1_get_bits(&bits, 1))
+				av1_get_bits(&bits, 2 * buffer_delay_length + 1);
+			if(initial_display_delay_present && av1_get_bits(&bits, 1))
+				av1_get_bits(&bits, 4);
+			if(i == 0)
+			{
+				seq_level_idx_0 = seq_level_idx;
+				seq_tier_0 = seq_tier;
+			}
+		}
+	}
+
+	int frame_width_bits = av1_get_bits(&bits, 4) + 1;
+	int frame_height_bits = av1_get_bits(&bits, 4) + 1;
+	av1_get_bits(&bits, frame_width_bits);  /*max_frame_width_minus_1*/
+	av1_get_bits(&bits, frame_height_bits); /*max_frame_height_minus_1*/
+	if(!reduced_still_picture_header && av1_get_bits(&bits, 1)) /*frame_id_numbers_present_flag*/
+		av1_get_bits(&bits, 7);
+	av1_get_bits(&bits, 3); /*128x128 superblock, filter intra, intra edge filter*/
+	if(!reduced_still_picture_header)
+	{
+		av1_get_bits(&bits, 4); /*interintra, masked compound, warped motion, dual filter*/
+		int enable_order_hint = av1_get_bits(&bits, 1);
+		if(enable_order_hint)
+			av1_get_bits(&bits, 2); /*jnt_comp, ref_frame_mvs*/
+		int seq_force_screen_content_tools = 2; /*SELECT_SCREEN_CONTENT_TOOLS*/
+		if(!av1_get_bits(&bits, 1)) /*seq_choose_screen_content_tools*/
+			seq_force_screen_content_tools = av1_get_bits(&bits, 1);
+		if(seq_force_screen_content_tools > 0 && !av1_get_bits(&bits, 1)) /*seq_choose_integer_mv*/
+			av1_get_bits(&bits, 1); /*seq_force_integer_mv*/
+		if(enable_order_hint)
+			av1_get_bits(&bits, 3); /*order_hint_bits_minus_1*/
+	}
+	av1_get_bits(&bits, 3); /*superres, cdef, restoration*/
+
+	/*color config*/
+	int high_bitdepth = av1_get_bits(&bits, 1);
+	int twelve_bit = (seq_profile == 2 && high_bitdepth) ? av1_get_bits(&bits, 1) : 0;
+	int monochrome = seq_profile == 1 ? 0 : av1_get_bits(&bits, 1);
+	int color_primaries = 2;  /*unspecified*/
+	int transfer_characteristics = 2;
+	int matrix_coefficients = 2;
+	if(av1_get_bits(&bits, 1)) /*color_description_present_flag*/
+	{
+		color_primaries = av1_get_bits(&bits, 8);
+		transfer_characteristics = av1_get_bits(&bits, 8);
+		matrix_coefficients = av1_get_bits(&bits, 8);
+	}
+	int subsampling_x = 1;
+	int subsampling_y = 1;
+	int chroma_sample_position = 0;
+	if(monochrome)
+		av1_get_bits(&bits, 1); /*color_range*/
+	else if(color_primaries == 1 && transfer_characteristics == 13 && matrix_coefficients == 0)
+	{
+		/*sRGB: 4:4:4*/
+		subsampling_x = 0;
+		subsampling_y = 0;
+	}
+	else
+	{
+		av1_get_bits(&bits, 1); /*color_range*/
+		if(seq_profile == 1)
+		{
+			subsampling_x = 0;
+			subsampling_y = 0;
+		}
+		else if(seq_profile == 2)
+		{
+			if(twelve_bit)
+			{
+				subsampling_x = av1_get_bits(&bits, 1);
+				subsampling_y = subsampling_x ? av1_get_bits(&bits, 1) : 0;
+			}
+			else
+				subsampling_y = 0;
+		}
+		if(subsampling_x && subsampling_y)
+			chroma_sample_position = av1_get_bits(&bits, 2);
+	}
+
+	if(bits.pos > bits.size * 8)
+		return -1; /*truncated sequence header*/
+
+	av1c[0] = 0x81; /*marker (1) + version (0000001)*/
+	av1c[1] = (uint8_t) ((seq_profile << 5) | seq_level_idx_0);
+	av1c[2] = (uint8_t) ((seq_tier_0 << 7) | (high_bitdepth << 6) | (twelve_bit << 5) |
+		(monochrome << 4) | (subsampling_x << 3) | (subsampling_y << 2) | chroma_sample_position);
+	av1c[3] = 0x00; /*no initial presentation delay*/
+	memcpy(av1c + 4, extradata + pos, obu_size);
+
+	return 4 + obu_size;
+}
@@ -17,5 +17,7 @@ SOURCES += \
     $$PWD/matroska.c \
     $$PWD/mp4.c \
     $$PWD/muxer.c \
+    $$PWD/resampler.c \
     $$PWD/stream_io.c \
+    $$PWD/stream_sink.c \
     $$PWD/video_codecs.c
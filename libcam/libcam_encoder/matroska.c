@@ -62,6 +62,16 @@
  */
 #define PKT_BUFFER_DEF_SIZE 156
 
+/*
+ * cue points kept in memory, full blocks are written (as CuePoint
+ * elements) to a temporary file and copied into Cues on close,
+ * so memory stays flat on long recordings
+ */
+#define MKV_CUES_BLOCK_SIZE 4096
+
+/*smallest size class for cached packet buffers*/
+#define PKT_BUFFER_MIN_CLASS 4096
+
 /** 2 bytes * 3 for EBML IDs, 3 1-byte EBML lengths, 8 bytes for 64 bit
  * offset, 4 bytes for target EBML ID */
 #define MAX_SEEKENTRY_SIZE 21
@@ -402,44 +412,30 @@ static mkv_cues_t *mkv_start_cues(int64_t segment_offset)
 		exit(-1);
 	}
 
-    cues->segment_offset = segment_offset;
-    return cues;
-}
-
-static int mkv_add_cuepoint(mkv_cues_t *cues, int stream, int64_t ts, int64_t cluster_pos)
-{
-    mkv_cuepoint_t *entries = cues->entries;
-
-    if (ts < 0)
-        return 0;
-
-    entries = realloc(entries, (size_t)(cues->num_entries + 1) * sizeof(mkv_cuepoint_t));
-
-    if (entries == NULL)
+    cues->entries = calloc(MKV_CUES_BLOCK_SIZE, sizeof(mkv_cuepoint_t));
+    if (cues->entries == NULL)
 	{
-		fprintf(stderr, "ENCODER: FATAL memory allocation failure (mkv_add_cuepoint): %s\n", strerror(errno));
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (mkv_start_cues): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-    entries[cues->num_entries].pts = (uint64_t)ts;
-    entries[cues->num_entries].tracknum = stream + 1;
-    entries[cues->num_entries].cluster_pos = cluster_pos - cues->segment_offset;
-
-	cues->num_entries++;
+    cues->segment_offset = segment_offset;
+    return cues;
+}
 
-    cues->entries = entries;
-    return 0;
+static void mkv_free_cues(mkv_cues_t *cues)
+{
+    if (cues->spill)
+        io_destroy_writer(cues->spill);
+    free(cues->entries);
+    free(cues);
 }
 
-static int64_t mkv_write_cues(mkv_context_t *mkv_ctx, mkv_cues_t *cues, int num_tracks)
+/* write the CuePoint elements of the in memory block */
+static void mkv_write_cue_entries(mkv_context_t *mkv_ctx, mkv_cues_t *cues, int num_tracks)
 {
-    ebml_master_t cues_element;
-    int64_t currentpos;
     int i, j;
 
-    currentpos = io_get_offset(mkv_ctx->writer);
-    cues_element = mkv_start_ebml_master(mkv_ctx, MATROSKA_ID_CUES, 0);
-
     for (i = 0; i < cues->num_entries; i++)
     {
         ebml_master_t cuepoint, track_positions;
@@ -461,6 +457,70 @@ static int64_t mkv_write_cues(mkv_context_t *mkv_ctx, mkv_cues_t *cues, int num_
         i += j - 1;
         mkv_end_ebml_master(mkv_ctx, cuepoint);
     }
+}
+
+/* move the in memory cue points to the spill file */
+static int mkv_spill_cues(mkv_context_t *mkv_ctx, mkv_cues_t *cues)
+{
+    if (cues->spill == NULL)
+    {
+        cues->spill = io_create_tmp_writer(0);
+        if (cues->spill == NULL)
+            return -1;
+    }
+
+    /*serialize with the regular ebml writers*/
+    io_writer_t *writer = mkv_ctx->writer;
+    mkv_ctx->writer = cues->spill;
+    mkv_write_cue_entries(mkv_ctx, cues, mkv_ctx->stream_list_size);
+    mkv_ctx->writer = writer;
+
+    if (verbosity > 1)
+        printf("ENCODER: (matroska) spilled %i cue points (%" PRId64 " bytes)\n",
+            cues->num_entries, io_get_offset(cues->spill));
+
+    cues->num_entries = 0;
+    return 0;
+}
+
+static int mkv_add_cuepoint(mkv_context_t *mkv_ctx, int stream, int64_t ts, int64_t cluster_pos)
+{
+    mkv_cues_t *cues = mkv_ctx->cues;
+
+    if (ts < 0)
+        return 0;
+
+    if (cues->num_entries >= MKV_CUES_BLOCK_SIZE &&
+        mkv_spill_cues(mkv_ctx, cues) < 0)
+    {
+        /*cues are optional: keep muxing without them*/
+        fprintf(stderr, "ENCODER: (matroska) couldn't spill cue points - dropping cue\n");
+        return 0;
+    }
+
+    mkv_cuepoint_t *entry = &cues->entries[cues->num_entries];
+    entry->pts = (uint64_t)ts;
+    entry->tracknum = stream + 1;
+    entry->cluster_pos = cluster_pos - cues->segment_offset;
+
+	cues->num_entries++;
+
+    return 0;
+}
+
+static int64_t mkv_write_cues(mkv_context_t *mkv_ctx, mkv_cues_t *cues, int num_tracks)
+{
+    ebml_master_t cues_element;
+    int64_t currentpos;
+
+    currentpos = io_get_offset(mkv_ctx->writer);
+    cues_element = mkv_start_ebml_master(mkv_ctx, MATROSKA_ID_CUES, 0);
+
+    /*spilled cue points (sequential copy) followed by the last block*/
+    if (cues->spill)
+        io_write_writer(mkv_ctx->writer, cues->spill);
+    mkv_write_cue_entries(mkv_ctx, cues, num_tracks);
+
     mkv_end_ebml_master(mkv_ctx, cues_element);
 
     return currentpos;
@@ -528,10 +588,13 @@ static int mkv_write_tracks(mkv_context_t *mkv_ctx)
         if ((mkv_ctx->mode == ENCODER_MUX_WEBM) && !(stream->codec_id == AV_CODEC_ID_VP8 ||
 #if LIBAVCODEC_VER_AT_LEAST(54,42)
 										stream->codec_id == AV_CODEC_ID_VP9 ||
+#endif
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+										stream->codec_id == AV_CODEC_ID_AV1 ||
 #endif
                                         stream->codec_id == AV_CODEC_ID_VORBIS))
 		{
-            fprintf(stderr, "ENCODER: (matroska) Only VP8 or VP9 video and Vorbis audio are supported for WebM.\n");
+            fprintf(stderr, "ENCODER: (matroska) Only VP8, VP9 or AV1 video and Vorbis audio are supported for WebM.\n");
             return -2;
         }
 
@@ -743,6 +806,19 @@ static int mkv_blockgroup_size(int pkt_size)
     return size;
 }
 
+/*
+ * rewrite the segment duration in the header
+ *   (seeks back: done on cluster close, not for every packet)
+ */
+static void mkv_update_duration(mkv_context_t* mkv_ctx)
+{
+    int64_t currentpos = io_get_offset(mkv_ctx->writer);
+    io_seek(mkv_ctx->writer, mkv_ctx->duration_offset);
+
+    mkv_put_ebml_float(mkv_ctx, MATROSKA_ID_DURATION, (double) mkv_ctx->duration);
+    io_seek(mkv_ctx->writer, currentpos);
+}
+
 static void mkv_write_block(mkv_context_t* mkv_ctx,
                             unsigned int blockid,
                             int stream_index,
@@ -785,6 +861,12 @@ static int mkv_write_packet_internal(mkv_context_t* mkv_ctx,
 	stream_io_t *stream = get_stream(mkv_ctx->stream_list, stream_index);
 	stream->packet_count++;
 
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+	/*temporal delimiters are implied by the blocks*/
+	if(stream->codec_id == AV_CODEC_ID_AV1)
+		size = av1_filter_obus(data, size);
+#endif
+
     if (!mkv_ctx->cluster_pos)
     {
         mkv_ctx->cluster_pos = io_get_offset(mkv_ctx->writer);
@@ -807,7 +889,7 @@ static int mkv_write_packet_internal(mkv_context_t* mkv_ctx,
     if (get_stream(mkv_ctx->stream_list, stream_index)->type == STREAM_TYPE_VIDEO && keyframe)
     {
 		//fprintf(stderr,"mkv_ctx: add a cue point\n");
-        int ret = mkv_add_cuepoint(mkv_ctx->cues, stream_index, (int64_t)ts, mkv_ctx->cluster_pos);
+        int ret = mkv_add_cuepoint(mkv_ctx, stream_index, (int64_t)ts, mkv_ctx->cluster_pos);
         if (ret < 0) 
 			return ret;
     }
@@ -816,13 +898,6 @@ static int mkv_write_packet_internal(mkv_context_t* mkv_ctx,
     double strsa = (double) mkv_ctx->duration/1000;
     set_video_time_capture(strsa);
 
-    //    update duration
-    int64_t currentpos = io_get_offset(mkv_ctx->writer);
-    io_seek(mkv_ctx->writer, mkv_ctx->duration_offset);
-
-    mkv_put_ebml_float(mkv_ctx, MATROSKA_ID_DURATION, (double) mkv_ctx->duration);
-    io_seek(mkv_ctx->writer, currentpos);
-
     return 0;
 }
 
@@ -862,25 +937,28 @@ static int mkv_cache_packet(mkv_context_t* mkv_ctx,
 
 	}
 
-    if(size > (int)mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].max_size)
-	{
-        mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].max_size = (unsigned int)size;
-
-		if(mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].data == NULL)
-            mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].data = calloc((size_t)size, sizeof(size_t));
-		else
-			mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].data = realloc(
-				mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].data,
-                (uint8_t)size * sizeof(uint8_t));
-	}
-	
-	if (mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index].data == NULL)
+    mkv_packet_buff_t *pkt_buff = &mkv_ctx->pkt_buffer_list[mkv_ctx->pkt_buffer_write_index];
+    if(size > (int)pkt_buff->max_size)
 	{
-		fprintf(stderr, "ENCODER: FATAL memory allocation failure (mkv_cache_packet): %s\n", strerror(errno));
-		exit(-1);
+		/*
+		 * grow to the next size class (power of 2): ring slots
+		 * settle after a few packets and never reallocate again
+		 */
+		unsigned int size_class = PKT_BUFFER_MIN_CLASS;
+		while(size_class < (unsigned int) size)
+			size_class <<= 1;
+
+		free(pkt_buff->data);
+		pkt_buff->data = malloc(size_class);
+		pkt_buff->max_size = size_class;
+
+		if (pkt_buff->data == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (mkv_cache_packet): %s\n", strerror(errno));
+			exit(-1);
+		}
 	}
 
-
 	if(verbosity > 3)
 		printf("ENCODER: (matroska) caching packet [%i]\n", mkv_ctx->pkt_buffer_write_index);
 
@@ -906,9 +984,8 @@ int mkv_write_packet(mkv_context_t* mkv_ctx,
                     int flags)
 {
     int ret, keyframe = !!(flags & AV_PKT_FLAG_KEY);
-    uint64_t ts = pts;
-
-	ts -= mkv_ctx->first_pts;
+    /*packets queued before the first one (e.g. audio) start at 0*/
+    uint64_t ts = pts > mkv_ctx->first_pts ? pts - mkv_ctx->first_pts : 0;
 
     int cluster_size = (int)(io_get_offset(mkv_ctx->writer) - mkv_ctx->cluster_pos);
 
@@ -957,6 +1034,8 @@ int mkv_write_packet(mkv_context_t* mkv_ctx,
     {
         mkv_end_ebml_master(mkv_ctx, mkv_ctx->cluster);
         mkv_ctx->cluster_pos = 0;
+        //    update duration
+        mkv_update_duration(mkv_ctx);
     }
 
     /*
@@ -973,7 +1052,7 @@ int mkv_write_packet(mkv_context_t* mkv_ctx,
 
 int mkv_close(mkv_context_t* mkv_ctx)
 {
-    int64_t currentpos, cuespos;
+    int64_t cuespos;
     int ret;
 	printf("ENCODER: (matroska) closing context\n");
 
@@ -1006,7 +1085,7 @@ int mkv_close(mkv_context_t* mkv_ctx)
 	if(mkv_ctx->cluster_pos)
 		mkv_end_ebml_master(mkv_ctx, mkv_ctx->cluster);
 
-	if (mkv_ctx->cues->num_entries)
+	if (mkv_ctx->cues->num_entries || mkv_ctx->cues->spill)
 	{
 		printf("ENCODER: (matroska)writing cues\n");
 		cuespos = mkv_write_cues(mkv_ctx, mkv_ctx->cues, mkv_ctx->stream_list_size);
@@ -1019,18 +1098,14 @@ int mkv_close(mkv_context_t* mkv_ctx)
 
     // update the duration
     fprintf(stderr,"ENCODER: (matroska) end duration = %" PRIu64 " (%f) \n", mkv_ctx->duration, (double) mkv_ctx->duration);
-    currentpos = io_get_offset(mkv_ctx->writer);
-    io_seek(mkv_ctx->writer, mkv_ctx->duration_offset);
-
     double strsa = (double) mkv_ctx->duration/1000;
     set_video_time_capture(strsa);
 
-    mkv_put_ebml_float(mkv_ctx, MATROSKA_ID_DURATION, (double) mkv_ctx->duration);
-	io_seek(mkv_ctx->writer, currentpos);
+    mkv_update_duration(mkv_ctx);
 
     mkv_end_ebml_master(mkv_ctx, mkv_ctx->segment);
-    getAvutil()->m_av_freep(&mkv_ctx->cues->entries);
-    getAvutil()->m_av_freep(&mkv_ctx->cues);
+    mkv_free_cues(mkv_ctx->cues);
+    mkv_ctx->cues = NULL;
 
     return 0;
 }
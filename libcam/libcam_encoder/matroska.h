@@ -257,8 +257,9 @@ typedef struct mkv_cuepoint_t
 typedef struct mkv_cues_t
 {
     int64_t         segment_offset;
-    mkv_cuepoint_t  *entries;
-    int             num_entries;
+    mkv_cuepoint_t  *entries;           ///< fixed block of MKV_CUES_BLOCK_SIZE entries
+    int             num_entries;        ///< entries in the block
+    io_writer_t     *spill;             ///< cue points spilled from full blocks (NULL if none)
 } mkv_cues_t;
 
 typedef struct mkv_packet_buff_t
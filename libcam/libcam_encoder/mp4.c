@@ -26,7 +26,11 @@
 static int64_t video_pts = 0;
 static int64_t audio_pts = 0;
 static int64_t first_pts = 0;
-static int64_t last_pts = 0;
+static int64_t last_pts = -1; /*no video packet written yet*/
+static int first_pts_set = 0; /*capture ts may legitimately start at 0*/
+
+/*capture timestamps are in nanoseconds*/
+#define MP4_CAPTURE_TIME_BASE ((AVRational){1, 1000000000})
 
 AVFormatContext *mp4_create_context(const char *filename)
 {
@@ -101,63 +105,66 @@ int mp4_write_packet(
         uint64_t pts,
         int flags)
 {
+    int ret = 0;
     AVPacket *outpacket = codec_data->outpkt;
-    outpacket->data = (uint8_t*)calloc((unsigned int)outbuf_size, sizeof(uint8_t));
+    AVRational stream_time = mp4_ctx->streams[stream_index]->time_base;
+    AVRational time_base = codec_data->codec_context->time_base;
+
+    /*
+     * wrap the encoded buffer: the packet is not refcounted so
+     * av_write_frame uses the data in place without copying it
+     */
+    outpacket->buf = NULL;
+    outpacket->data = outbuf;
+    outpacket->size = (int)outbuf_size;
+    outpacket->flags = flags;
+    outpacket->stream_index = stream_index;
+
+    if(codec_data->codec_context->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        if(!first_pts_set)
+        {
+            first_pts = (int64_t) pts;
+            first_pts_set = 1;
+        }
 
-    memcpy(outpacket->data, outbuf, outbuf_size);
-    outpacket->size =(int)outbuf_size;
+        /*capture time to the stream time base (no fixed frame rate)*/
+        video_pts = getAvutil()->m_av_rescale_q((int64_t) pts - first_pts, MP4_CAPTURE_TIME_BASE, stream_time);
+        if(video_pts <= last_pts) //pts must be strictly incremented
+            video_pts = last_pts + 1;
 
-    if(codec_data->codec_context->codec_type == AVMEDIA_TYPE_VIDEO){
         outpacket->pts = video_pts;
         outpacket->dts = video_pts;
-        outpacket->duration = 0;
-        outpacket->flags = flags;
-        outpacket->stream_index = stream_index;
-        AVRational video_time = mp4_ctx->streams[stream_index]->time_base;
-        AVRational time_base = codec_data->codec_context->time_base;
-
-        if (video_pts > last_pts || video_pts == 0) {
-            getLoadLibsInstance()->m_av_packet_rescale_ts(outpacket, time_base, video_time);
-            getAvformat()->m_av_write_frame(mp4_ctx, outpacket);
-            set_video_time_capture((double)(pts)/1000/1000000);
-        } else {
-            fprintf(stderr,"pts err:video_pts: %d  last_pts: %d\n", video_pts, last_pts);
-        }
+        outpacket->duration = getAvutil()->m_av_rescale_q(1, time_base, stream_time);
+
+        ret = getAvformat()->m_av_write_frame(mp4_ctx, outpacket);
+        set_video_time_capture((double)(pts)/1000/1000000);
 
         last_pts = video_pts;
-        if (first_pts == 0) {
-            first_pts = pts;
-        } else {
-            video_pts = (double)(pts - first_pts) / 1000000.0 / 33.0;
-            if (video_pts == last_pts)  //pts must be strictly incremented
-                video_pts++;
-            if(video_pts < last_pts)
-                video_pts = last_pts + 1;
-        }
     }
 
-    if(codec_data->codec_context->codec_type == AVMEDIA_TYPE_AUDIO) {
-
-        outpacket->pts = audio_pts;
-        outpacket->flags = flags;
-        outpacket->stream_index = stream_index;
-        AVRational audio_time = mp4_ctx->streams[stream_index]->time_base;
-        AVRational time_base = codec_data->codec_context->time_base;
+    if(codec_data->codec_context->codec_type == AVMEDIA_TYPE_AUDIO)
+    {
+        outpacket->pts = getAvutil()->m_av_rescale_q(audio_pts, time_base, stream_time);
+        outpacket->dts = outpacket->pts;
+        outpacket->duration = 0;
 
-        getLoadLibsInstance()->m_av_packet_rescale_ts(outpacket, time_base, audio_time);
-        getAvformat()->m_av_write_frame(mp4_ctx, outpacket);
+        ret = getAvformat()->m_av_write_frame(mp4_ctx, outpacket);
 
-        //AAC音频标准是1024
-        //MP3音频标准是1152
-        audio_pts+= 1024;
+        /*samples per frame (AAC 1024, MP3 1152)*/
+        audio_pts += codec_data->codec_context->frame_size > 0 ?
+            codec_data->codec_context->frame_size : 1024;
     }
 
-    if(outpacket->data){
-        free(outpacket->data);
-        outpacket->data = NULL;
-        getLoadLibsInstance()->m_av_packet_unref(outpacket);
-    }
-    return 0;
+    /*the data belongs to the encoder: just detach it*/
+    outpacket->data = NULL;
+    outpacket->size = 0;
+    getLoadLibsInstance()->m_av_packet_unref(outpacket);
+
+    if(ret < 0)
+        fprintf(stderr, "ENCODER: (mp4) error writing packet to stream %i (%i)\n", stream_index, ret);
+
+    return ret;
 }
 
 
@@ -166,6 +173,8 @@ void mp4_destroy_context(AVFormatContext *mp4_ctx)
     video_pts = 0;
     audio_pts = 0;
     first_pts = 0;
+    last_pts = -1;
+    first_pts_set = 0;
     if(mp4_ctx != NULL)
     {
         getAvformat()->m_avformat_free_context(mp4_ctx);
@@ -31,12 +31,14 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <linux/videodev2.h>
 #include <string.h>
-//#include <errno.h>
+#include <errno.h>
 #include <assert.h>
 #include <sys/statfs.h>
 #include <libavformat/avformat.h>
@@ -78,57 +80,298 @@ static OutputStream *mp4_audio_stream = NULL;
 //static AVCodec *video_codec = NULL;
 static AVDictionary** opt = NULL;
 
+/*mp4: a fragment per key frame instead of a moov written on close*/
+static int mp4_fragmented = 0;
+
+/*
+ * segmented recording: roll to a new, self-contained file at a key frame
+ * so finalization (cues, indexes, moov) only covers the last segment
+ */
+static int segment_seconds = 0;         /*segment duration limit (0 - no limit)*/
+static int segment_mbytes = 0;          /*segment size limit (0 - no limit)*/
+static char *segment_basename = NULL;   /*filename of the first segment*/
+static int segment_index = 0;           /*current segment (1 based)*/
+static int64_t segment_start_pts = -1;  /*pts of the first video frame in segment*/
+static int64_t segment_bytes = 0;       /*coded bytes muxed in segment*/
+
+/*
+ * index journal: append only text file (<filename>.journal) with the
+ * segments and key frame offsets, buffered in memory and persisted
+ * every ENCODER_JOURNAL_PERIOD; it's a log for external tools, nothing
+ * here reads it back. With the journal on recordings are always
+ * segmented (ENCODER_JOURNAL_SEGMENT if no limit is set), so a crash
+ * only leaves the last segment without its index
+ */
+#define ENCODER_JOURNAL_PERIOD (2 * NSEC_PER_SEC)
+#define ENCODER_JOURNAL_BUF_SIZE (16384)
+#define ENCODER_JOURNAL_SEGMENT (300) /*seconds*/
+
+static int journal_enabled = 0;
+static FILE *journal_fp = NULL;
+static char journal_buf[ENCODER_JOURNAL_BUF_SIZE];
+static int journal_len = 0;
+static int64_t journal_sync_pts = 0;    /*pts of the last persisted sync*/
+
+/*
+ * get the segment duration limit for the current recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: segment duration limit in seconds (0 - no limit)
+ */
+static int muxer_segment_seconds()
+{
+	if(journal_enabled && segment_seconds <= 0 && segment_mbytes <= 0)
+		return ENCODER_JOURNAL_SEGMENT;
+
+	return segment_seconds;
+}
+
+/*
+ * live stream sink: the encoded packets are also queued (copied)
+ * for a MPEG-TS over udp/rtp sender thread that never blocks muxing
+ */
+static char *sink_url = NULL;
+static encoder_stream_sink_t *stream_sink = NULL;
+static int sink_active = 0;             /*sink started for the last recording*/
+static uint64_t sink_sent = 0;
+static uint64_t sink_dropped = 0;
+
+/*
+ * pre-roll: while armed (no file open yet) the encoded packets are kept
+ * in a ring bounded by time and memory, and spliced into the file from
+ * the oldest key frame when recording starts
+ */
+#define ENCODER_PREROLL_PACKETS (4096)
+
+typedef struct _muxer_packet_t
+{
+	uint8_t *data;
+	int max_size;       /*allocated size (pre-roll ring)*/
+	int size;
+	int stream_index;   /*0 - video; 1 - audio*/
+	int64_t pts;
+	int64_t dts;
+	int flags;
+	int duration;
+} muxer_packet_t;
+
+static int preroll_seconds = 0;         /*pre-roll duration (0 - disabled)*/
+static int preroll_mbytes = 32;         /*pre-roll memory limit*/
+static int preroll_armed = 0;
+static muxer_packet_t preroll_ring[ENCODER_PREROLL_PACKETS];
+static int preroll_read = 0;
+static int preroll_write = 0;
+static int preroll_count = 0;
+static int64_t preroll_bytes = 0;       /*bytes queued in the ring*/
+static int64_t preroll_alloc = 0;       /*bytes allocated by the slots (>= preroll_bytes)*/
+
 /*file mutex*/
 static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
 #define __PMUTEX &mutex
 
+static void muxer_open(encoder_context_t *encoder_ctx, const char *filename);
+static void muxer_finish(encoder_context_t *encoder_ctx);
+static void muxer_roll(encoder_context_t *encoder_ctx, int64_t pts);
+
 /*
- * mux a video frame
+ * get the current muxer file offset
  * args:
  *   encoder_ctx - pointer to encoder context
  *
  * asserts:
- *   encoder_ctx is not null;
+ *   encoder_ctx is not null
  *
- * returns: error code
+ * returns: current offset in the segment file
  */
-int encoder_write_video_data(encoder_context_t *encoder_ctx)
+static int64_t muxer_get_offset(encoder_context_t *encoder_ctx)
 {
-	/*assertions*/
-	assert(encoder_ctx);
+	switch (encoder_ctx->muxer_id)
+	{
+		case ENCODER_MUX_AVI:
+			return avi_ctx ? io_get_offset(avi_ctx->writer) : 0;
 
-	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
-	assert(enc_video_ctx);
-     //cheese_print_log("encoder_write_video_data");
-    if(enc_video_ctx->outbuf_coded_size <= 0){
-         //cheese_print_log("enc_video_ctx->outbuf_coded_size <= 0");
-		return -1;
-    }
-    //else {
-        //cheese_print_log("enc_video_ctx->outbuf_coded_size >= 0");
-    //}
-	enc_video_ctx->framecount++;
+		case ENCODER_MUX_MP4:
+			if(mp4_ctx && mp4_ctx->pb)
+				return mp4_ctx->pb->pos + (mp4_ctx->pb->buf_ptr - mp4_ctx->pb->buffer);
+			return 0;
+
+		default:
+			return mkv_ctx ? io_get_offset(mkv_ctx->writer) : 0;
+	}
+}
+
+/*
+ * persist the journal buffer
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   sync - flush the muxer and log the synced file offset
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void journal_persist(encoder_context_t *encoder_ctx, int sync)
+{
+	if(journal_fp == NULL)
+		return;
+
+	if(sync)
+	{
+		/*make the muxed data reach the file before logging its size*/
+		switch (encoder_ctx->muxer_id)
+		{
+			case ENCODER_MUX_AVI:
+				if(avi_ctx)
+					io_flush_buffer(avi_ctx->writer);
+				break;
+			case ENCODER_MUX_MP4:
+				break; /*avio writes whole fragments*/
+			default:
+				if(mkv_ctx)
+					io_flush_buffer(mkv_ctx->writer);
+				break;
+		}
+
+		journal_len += snprintf(journal_buf + journal_len,
+			(size_t)(ENCODER_JOURNAL_BUF_SIZE - journal_len),
+			"sync %i %" PRId64 "\n", segment_index, muxer_get_offset(encoder_ctx));
+	}
+
+	if(journal_len > 0)
+	{
+		if(fwrite(journal_buf, 1, (size_t) journal_len, journal_fp) < (size_t) journal_len)
+			fprintf(stderr, "ENCODER: (journal) write error: %s\n", strerror(errno));
+		fflush(journal_fp);
+	}
+	journal_len = 0;
+}
 
+/*
+ * add a line to the journal buffer (persisted when full or periodically)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   format - printf format
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void journal_log(encoder_context_t *encoder_ctx, const char *format, ...)
+{
+	if(journal_fp == NULL)
+		return;
+
+	/*keep room for a line with a full path*/
+	if(ENCODER_JOURNAL_BUF_SIZE - journal_len < PATH_MAX + 256)
+		journal_persist(encoder_ctx, 0);
+
+	/*and for a sync entry*/
+	int room = ENCODER_JOURNAL_BUF_SIZE - journal_len - 128;
+
+	va_list ap;
+	va_start(ap, format);
+	int len = vsnprintf(journal_buf + journal_len, (size_t) room, format, ap);
+	va_end(ap);
+
+	if(len > 0)
+		journal_len += MIN(len, room - 1);
+}
+
+/*
+ * build the filename for a segment
+ *   segment 1 keeps the recording filename, next ones get a _NNN suffix
+ * args:
+ *   basename - recording filename
+ *   index - segment index (1 based)
+ *
+ * asserts:
+ *   basename is not null
+ *
+ * returns: pointer to newly allocated filename (must be freed)
+ */
+static char *segment_filename(const char *basename, int index)
+{
+	assert(basename != NULL);
+
+	size_t len = strlen(basename);
+	char *name = calloc(len + 16, sizeof(char));
+	if(name == NULL)
+	{
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (segment_filename): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	if(index <= 1)
+	{
+		memcpy(name, basename, len);
+		return name;
+	}
+
+	/*insert the suffix before the extension (if any)*/
+	const char *slash = strrchr(basename, '/');
+	const char *ext = strrchr(basename, '.');
+	if(ext == NULL || (slash != NULL && ext < slash))
+		ext = basename + len;
+
+	snprintf(name, len + 16, "%.*s_%03d%s", (int)(ext - basename), basename, index, ext);
+	return name;
+}
+
+/*
+ * mux a video packet (called with the file mutex locked)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   pkt - pointer to the encoded packet
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int muxer_write_video(encoder_context_t *encoder_ctx, muxer_packet_t *pkt)
+{
 	int ret =0;
 	int block_align = 1;
 
-	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) enc_video_ctx->codec_data;
+	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_video_ctx->codec_data;
 
 	if(video_codec_data)
 		block_align = video_codec_data->codec_context->block_align;
 
-	__LOCK_MUTEX( __PMUTEX );
+	/*segmented recording: roll at a key frame once a limit is reached*/
+	int keyframe = (pkt->flags & AV_PKT_FLAG_KEY) ? 1 : 0;
+	if(segment_start_pts < 0)
+		segment_start_pts = pkt->pts;
+	else if(keyframe &&
+		((muxer_segment_seconds() > 0 &&
+			pkt->pts - segment_start_pts >= (int64_t) muxer_segment_seconds() * NSEC_PER_SEC) ||
+		 (segment_mbytes > 0 &&
+			segment_bytes >= (int64_t) segment_mbytes * 1024 * 1024)))
+		muxer_roll(encoder_ctx, pkt->pts);
+
+	segment_bytes += pkt->size;
+
+	if(keyframe)
+		journal_log(encoder_ctx, "key %i %" PRId64 " %" PRId64 "\n",
+			segment_index, pkt->pts, muxer_get_offset(encoder_ctx));
+
 	switch (encoder_ctx->muxer_id)
 	{
 		case ENCODER_MUX_AVI:
 			ret = avi_write_packet(
 					avi_ctx,
 					0,
-					enc_video_ctx->outbuf,
-          (uint32_t)enc_video_ctx->outbuf_coded_size,
-					enc_video_ctx->dts,
+					pkt->data,
+          (uint32_t)pkt->size,
+					pkt->dts,
 					block_align,
-					enc_video_ctx->flags);
+					pkt->flags);
 			break;
 
         case ENCODER_MUX_MP4:
@@ -136,10 +379,10 @@ int encoder_write_video_data(encoder_context_t *encoder_ctx)
             ret = mp4_write_packet(mp4_ctx,
                          video_codec_data,
                          0,
-                         enc_video_ctx->outbuf,
-                 (uint32_t)enc_video_ctx->outbuf_coded_size,
-                 (uint64_t)enc_video_ctx->pts,
-                         enc_video_ctx->flags);
+                         pkt->data,
+                 (uint32_t)pkt->size,
+                 (uint64_t)pkt->pts,
+                         pkt->flags);
             break;
 
 		case ENCODER_MUX_MKV:
@@ -147,121 +390,464 @@ int encoder_write_video_data(encoder_context_t *encoder_ctx)
 			ret = mkv_write_packet(
 					mkv_ctx,
 					0,
-					enc_video_ctx->outbuf,
-					enc_video_ctx->outbuf_coded_size,
-					enc_video_ctx->duration,
-          (uint64_t)enc_video_ctx->pts,
-					enc_video_ctx->flags);
+					pkt->data,
+					pkt->size,
+					pkt->duration,
+          (uint64_t)pkt->pts,
+					pkt->flags);
 			break;
 
 		default:
 
 			break;
 	}
-	__UNLOCK_MUTEX( __PMUTEX );
+
+	if(stream_sink != NULL)
+		encoder_stream_sink_push(stream_sink, 0,
+			pkt->data,
+			pkt->size,
+			pkt->pts,
+			pkt->flags);
+
+	if(journal_fp != NULL &&
+		pkt->pts - journal_sync_pts >= ENCODER_JOURNAL_PERIOD)
+	{
+		journal_persist(encoder_ctx, 1);
+		journal_sync_pts = pkt->pts;
+	}
 
 	return (ret);
 }
 
 /*
- * mux a audio frame
+ * mux a audio packet (called with the file mutex locked)
  * args:
  *   encoder_ctx - pointer to encoder context
+ *   pkt - pointer to the encoded packet
  *
  * asserts:
- *   encoder_ctx is not null;
+ *   none
  *
  * returns: error code
  */
-int encoder_write_audio_data(encoder_context_t *encoder_ctx)
+static int muxer_write_audio(encoder_context_t *encoder_ctx, muxer_packet_t *pkt)
 {
-	/*assertions*/
-	assert(encoder_ctx != NULL);
-
-	encoder_audio_context_t *enc_audio_ctx = encoder_ctx->enc_audio_ctx;
-
-	if(!enc_audio_ctx || encoder_ctx->audio_channels <= 0)
-		return -1;
-
-	if(enc_audio_ctx->outbuf_coded_size <= 0)
-		return -1;
-	
-	if(verbosity > 3)
-		printf("ENCODER: writing %i bytes of audio data\n", enc_audio_ctx->outbuf_coded_size);
-
 	int ret =0;
 	int block_align = 1;
 
-	encoder_codec_data_t *audio_codec_data = (encoder_codec_data_t *) enc_audio_ctx->codec_data;
+	encoder_codec_data_t *audio_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_audio_ctx->codec_data;
 
 	if(audio_codec_data)
 		block_align = audio_codec_data->codec_context->block_align;
 
-	__LOCK_MUTEX( __PMUTEX );
+	segment_bytes += pkt->size;
+
 	switch (encoder_ctx->muxer_id)
 	{
 		case ENCODER_MUX_AVI:
 			ret = avi_write_packet(
 					avi_ctx,
 					1,
-					enc_audio_ctx->outbuf,
-          (uint32_t)enc_audio_ctx->outbuf_coded_size,
-					enc_audio_ctx->dts,
+					pkt->data,
+          (uint32_t)pkt->size,
+					pkt->dts,
 					block_align,
-					enc_audio_ctx->flags);
+					pkt->flags);
 			break;
         case ENCODER_MUX_MP4:
 //        cheese_print_log("write audio data");
-            mp4_write_packet(
+            ret = mp4_write_packet(
                     mp4_ctx,
                     audio_codec_data,
                     1,
-                    enc_audio_ctx->outbuf,
-            (uint32_t)enc_audio_ctx->outbuf_coded_size,
-            (uint64_t)enc_audio_ctx->pts,
-                    enc_audio_ctx->flags);
+                    pkt->data,
+            (uint32_t)pkt->size,
+            (uint64_t)pkt->pts,
+                    pkt->flags);
             break;
 
-		case ENCODER_MUX_MKV:
-		case ENCODER_MUX_WEBM:
-			ret = mkv_write_packet(
-					mkv_ctx,
-					1,
-					enc_audio_ctx->outbuf,
-					enc_audio_ctx->outbuf_coded_size,
-					enc_audio_ctx->duration,
-          (uint64_t)enc_audio_ctx->pts,
-					enc_audio_ctx->flags);
-			break;
+		case ENCODER_MUX_MKV:
+		case ENCODER_MUX_WEBM:
+			ret = mkv_write_packet(
+					mkv_ctx,
+					1,
+					pkt->data,
+					pkt->size,
+					pkt->duration,
+          (uint64_t)pkt->pts,
+					pkt->flags);
+			break;
+
+		default:
+
+			break;
+	}
+
+	if(stream_sink != NULL)
+		encoder_stream_sink_push(stream_sink, 1,
+			pkt->data,
+			pkt->size,
+			pkt->pts,
+			pkt->flags);
+
+	return (ret);
+}
+
+/*
+ * free a pre-roll slot buffer (called with the file mutex locked)
+ * args:
+ *   slot - pointer to the ring slot
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void preroll_release(muxer_packet_t *slot)
+{
+	preroll_alloc -= slot->max_size;
+	free(slot->data);
+	slot->data = NULL;
+	slot->max_size = 0;
+}
+
+/*
+ * drop the oldest pre-roll packet (called with the file mutex locked)
+ *   the slot keeps its buffer for reuse unless the ring is over its
+ *   memory budget
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void preroll_pop()
+{
+	muxer_packet_t *slot = &preroll_ring[preroll_read];
+	preroll_bytes -= slot->size;
+	slot->size = 0;
+	if(preroll_alloc > (int64_t) preroll_mbytes * 1024 * 1024)
+		preroll_release(slot);
+	NEXT_IND(preroll_read, ENCODER_PREROLL_PACKETS);
+	preroll_count--;
+}
+
+/*
+ * empty the pre-roll ring and free its buffers (called with the file mutex locked)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void preroll_reset()
+{
+	int i = 0;
+	for(i = 0; i < ENCODER_PREROLL_PACKETS; i++)
+	{
+		free(preroll_ring[i].data);
+		preroll_ring[i].data = NULL;
+		preroll_ring[i].max_size = 0;
+		preroll_ring[i].size = 0;
+	}
+
+	preroll_read = 0;
+	preroll_write = 0;
+	preroll_count = 0;
+	preroll_bytes = 0;
+	preroll_alloc = 0;
+}
+
+/*
+ * store an encoded packet in the pre-roll ring (called with the file mutex locked)
+ *   keeps the packets from the newest key frame at least preroll_seconds
+ *   old (so the spliced video always starts at a key frame)
+ * args:
+ *   pkt - pointer to the encoded packet (data is copied)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void preroll_push(muxer_packet_t *pkt)
+{
+	if(pkt->data == NULL || pkt->size <= 0)
+		return;
+
+	/*grow to the next size class: slots settle after a few packets*/
+	int size_class = 4096;
+	while(size_class < pkt->size)
+		size_class <<= 1;
+
+	/*
+	 * bounded by memory: the slot allocations (not only the queued bytes)
+	 * count against the budget, so drop the oldest packets and free their
+	 * buffers until the new packet fits
+	 */
+	int64_t budget = (int64_t) preroll_mbytes * 1024 * 1024;
+	muxer_packet_t *slot = &preroll_ring[preroll_write];
+	while(preroll_count > 0 &&
+		(preroll_count >= ENCODER_PREROLL_PACKETS ||
+		 preroll_alloc + (pkt->size > slot->max_size ? size_class - slot->max_size : 0) > budget))
+	{
+		muxer_packet_t *old = &preroll_ring[preroll_read];
+		preroll_pop();
+		if(old->data != NULL && old != slot)
+			preroll_release(old);
+	}
+
+	/*ring is empty: only idle slots hold memory*/
+	if(pkt->size > slot->max_size && preroll_alloc + size_class - slot->max_size > budget)
+	{
+		int i = 0;
+		for(i = 0; i < ENCODER_PREROLL_PACKETS; i++)
+			if(&preroll_ring[i] != slot && preroll_ring[i].data != NULL)
+				preroll_release(&preroll_ring[i]);
+	}
+
+	if(pkt->size > slot->max_size)
+	{
+		preroll_release(slot);
+		slot->data = malloc(size_class);
+		slot->max_size = size_class;
+		preroll_alloc += size_class;
+		if(slot->data == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (preroll_push): %s\n", strerror(errno));
+			exit(-1);
+		}
+	}
+
+	memcpy(slot->data, pkt->data, pkt->size);
+	slot->size = pkt->size;
+	slot->stream_index = pkt->stream_index;
+	slot->pts = pkt->pts;
+	slot->dts = pkt->dts;
+	slot->flags = pkt->flags;
+	slot->duration = pkt->duration;
+
+	preroll_bytes += pkt->size;
+	NEXT_IND(preroll_write, ENCODER_PREROLL_PACKETS);
+	preroll_count++;
+
+	if(pkt->stream_index != 0 || !(pkt->flags & AV_PKT_FLAG_KEY))
+		return;
+
+	/*bounded by time: start at the newest key frame older than the window*/
+	int64_t limit = pkt->pts - (int64_t) preroll_seconds * NSEC_PER_SEC;
+	int start = -1;
+	int i = 0;
+	int ind = preroll_read;
+	for(i = 0; i < preroll_count; i++)
+	{
+		muxer_packet_t *p = &preroll_ring[ind];
+		if(p->stream_index == 0 && (p->flags & AV_PKT_FLAG_KEY))
+		{
+			if(p->pts > limit)
+				break;
+			start = i;
+		}
+		NEXT_IND(ind, ENCODER_PREROLL_PACKETS);
+	}
+
+	for(i = 0; i < start; i++)
+		preroll_pop();
+}
+
+/*
+ * mux the pre-roll packets from the first key frame (called with the file mutex locked)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: number of spliced video packets
+ */
+static int preroll_splice(encoder_context_t *encoder_ctx)
+{
+	/*video must start at a key frame*/
+	while(preroll_count > 0 &&
+		!(preroll_ring[preroll_read].stream_index == 0 &&
+		  (preroll_ring[preroll_read].flags & AV_PKT_FLAG_KEY)))
+		preroll_pop();
+
+	if(preroll_count <= 0)
+		return 0;
+
+	int64_t start_pts = preroll_ring[preroll_read].pts;
+
+	/*the file starts at the spliced key frame*/
+	segment_start_pts = start_pts;
+	if(mkv_ctx && (encoder_ctx->muxer_id == ENCODER_MUX_MKV || encoder_ctx->muxer_id == ENCODER_MUX_WEBM))
+		mkv_ctx->first_pts = (uint64_t) start_pts;
+
+	int frames = 0;
+	while(preroll_count > 0)
+	{
+		muxer_packet_t *pkt = &preroll_ring[preroll_read];
+		if(pkt->stream_index == 0)
+		{
+			muxer_write_video(encoder_ctx, pkt);
+			frames++;
+		}
+		else if(pkt->pts >= start_pts && encoder_ctx->enc_audio_ctx != NULL)
+			muxer_write_audio(encoder_ctx, pkt);
+		preroll_pop();
+	}
+
+	if(verbosity > 0)
+		printf("ENCODER: spliced %i pre-roll video frames (%.2f sec)\n", frames,
+			(double) (encoder_ctx->enc_video_ctx->pts - start_pts) / NSEC_PER_SEC);
+
+	return frames;
+}
+
+/*
+ * mux a video frame
+ *   (stored in the pre-roll ring if the muxer is armed)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null;
+ *
+ * returns: error code
+ */
+int encoder_write_video_data(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx);
+
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+	assert(enc_video_ctx);
+     //cheese_print_log("encoder_write_video_data");
+    if(enc_video_ctx->outbuf_coded_size <= 0){
+         //cheese_print_log("enc_video_ctx->outbuf_coded_size <= 0");
+		return -1;
+    }
+    //else {
+        //cheese_print_log("enc_video_ctx->outbuf_coded_size >= 0");
+    //}
+	enc_video_ctx->framecount++;
+
+	muxer_packet_t pkt = {
+		.data = enc_video_ctx->outbuf,
+		.size = enc_video_ctx->outbuf_coded_size,
+		.stream_index = 0,
+		.pts = enc_video_ctx->pts,
+		.dts = enc_video_ctx->dts,
+		.flags = enc_video_ctx->flags,
+		.duration = enc_video_ctx->duration};
+
+	int ret = 0;
+
+	__LOCK_MUTEX( __PMUTEX );
+	if(preroll_armed)
+		preroll_push(&pkt);
+	else
+		ret = muxer_write_video(encoder_ctx, &pkt);
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return (ret);
+}
+
+/*
+ * mux a audio frame
+ *   (stored in the pre-roll ring if the muxer is armed)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null;
+ *
+ * returns: error code
+ */
+int encoder_write_audio_data(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	encoder_audio_context_t *enc_audio_ctx = encoder_ctx->enc_audio_ctx;
+
+	if(!enc_audio_ctx || encoder_ctx->audio_channels <= 0)
+		return -1;
 
-		default:
+	if(enc_audio_ctx->outbuf_coded_size <= 0)
+		return -1;
+	
+	if(verbosity > 3)
+		printf("ENCODER: writing %i bytes of audio data\n", enc_audio_ctx->outbuf_coded_size);
 
-			break;
-	}
+	muxer_packet_t pkt = {
+		.data = enc_audio_ctx->outbuf,
+		.size = enc_audio_ctx->outbuf_coded_size,
+		.stream_index = 1,
+		.pts = enc_audio_ctx->pts,
+		.dts = enc_audio_ctx->dts,
+		.flags = enc_audio_ctx->flags,
+		.duration = enc_audio_ctx->duration};
+
+	int ret = 0;
+
+	__LOCK_MUTEX( __PMUTEX );
+	if(preroll_armed)
+		preroll_push(&pkt);
+	else
+		ret = muxer_write_audio(encoder_ctx, &pkt);
 	__UNLOCK_MUTEX( __PMUTEX );
 
 	return (ret);
 }
+/*
+ * set fragmented mp4 output (frag_keyframe+empty_moov)
+ *   takes effect on the next encoder_muxer_init
+ * args:
+ *   value - 1 to write a fragment per key frame, 0 for a single moov
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_mp4_fragmented(int value)
+{
+	mp4_fragmented = value ? 1 : 0;
+}
 
 /*
- * initialization of the file muxer
+ * get fragmented mp4 output flag
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if mp4 output is fragmented, 0 otherwise
+ */
+int encoder_get_mp4_fragmented()
+{
+	return mp4_fragmented;
+}
+
+/*
+ * get the codec id of the muxed video
  * args:
  *   encoder_ctx - pointer to encoder context
- *   filename - video filename
  *
  * asserts:
  *   encoder_ctx is not null
  *   encoder_ctx->enc_video_ctx is not null
  *
- * returns: none
+ * returns: libav codec id (AV_CODEC_ID_NONE for raw camera frames)
  */
-void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
+static int muxer_video_codec_id(encoder_context_t *encoder_ctx)
 {
-
-	/*assertions*/
-	assert(encoder_ctx != NULL);
-	assert(encoder_ctx->enc_video_ctx != NULL);
-
 	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_video_ctx->codec_data;
 
 	int video_codec_id = AV_CODEC_ID_NONE;
@@ -280,6 +866,32 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
         video_codec_id = (int)video_codec_data->codec_context->codec_id;
 	}
 
+	return video_codec_id;
+}
+
+/*
+ * open the muxer for a (segment) file
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   filename - video filename
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *   encoder_ctx->enc_video_ctx is not null
+ *
+ * returns: none
+ */
+static void muxer_open(encoder_context_t *encoder_ctx, const char *filename)
+{
+
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+	assert(encoder_ctx->enc_video_ctx != NULL);
+
+	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_video_ctx->codec_data;
+
+	int video_codec_id = muxer_video_codec_id(encoder_ctx);
+
 	if(verbosity > 1)
 		printf("ENCODER: initializing muxer(%i)\n", encoder_ctx->muxer_id);
 
@@ -393,7 +1005,20 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
                 //fprintf(stderr, "Could not open '%s': %s\n", filename,
                         //av_err2str(ret));
             }
-            ret= getAvformat()->m_avformat_write_header(mp4_ctx, opt);
+            if(mp4_fragmented || muxer_segment_seconds() > 0 || segment_mbytes > 0)
+            {
+                /*
+                 * the moov only describes the tracks, samples go in moof
+                 * fragments: nothing to rewrite on close and the file
+                 * is playable up to the last complete fragment
+                 */
+                AVDictionary *mux_opts = NULL;
+                getAvutil()->m_av_dict_set(&mux_opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+                ret = getAvformat()->m_avformat_write_header(mp4_ctx, &mux_opts);
+                getAvutil()->m_av_dict_free(&mux_opts);
+            }
+            else
+                ret= getAvformat()->m_avformat_write_header(mp4_ctx, opt);
             if(ret < 0)
             {
 //                fprintf(stderr, "Error occurred when opening output file: %s\n",
@@ -468,7 +1093,7 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 }
 
 /*
- * close the file muxer
+ * finalize the muxer (segment) file
  * args:
  *   encoder_ctx - pointer to encoder context
  *
@@ -477,7 +1102,7 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
  *
  * returns: none
  */
-void encoder_muxer_close(encoder_context_t *encoder_ctx)
+static void muxer_finish(encoder_context_t *encoder_ctx)
 {
 
 	switch (encoder_ctx->muxer_id)
@@ -569,6 +1194,337 @@ void encoder_muxer_close(encoder_context_t *encoder_ctx)
 	}
 }
 
+/*
+ * roll to the next segment file (called with the file mutex locked)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   pts - pts of the key frame starting the segment
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void muxer_roll(encoder_context_t *encoder_ctx, int64_t pts)
+{
+	journal_log(encoder_ctx, "close %i %" PRId64 "\n", segment_index, muxer_get_offset(encoder_ctx));
+	muxer_finish(encoder_ctx);
+
+	segment_index++;
+	segment_bytes = 0;
+	segment_start_pts = pts;
+
+	char *filename = segment_filename(segment_basename, segment_index);
+	if(verbosity > 0)
+		printf("ENCODER: rolling to segment %i (%s)\n", segment_index, filename);
+	muxer_open(encoder_ctx, filename);
+	/*matroska timestamps start at the segment*/
+	if(mkv_ctx && (encoder_ctx->muxer_id == ENCODER_MUX_MKV || encoder_ctx->muxer_id == ENCODER_MUX_WEBM))
+		mkv_ctx->first_pts = (uint64_t) segment_start_pts;
+	journal_log(encoder_ctx, "segment %i %" PRId64 " %s\n", segment_index, segment_start_pts, filename);
+	free(filename);
+
+	journal_persist(encoder_ctx, 0);
+}
+
+/*
+ * initialization of the file muxer
+ *   if armed, the pre-roll packets are muxed first
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   filename - video filename
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *   encoder_ctx->enc_video_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	free(segment_basename);
+	segment_basename = strdup(filename);
+	segment_index = 1;
+	segment_start_pts = -1;
+	segment_bytes = 0;
+
+	muxer_open(encoder_ctx, filename);
+
+	sink_active = 0;
+	sink_sent = 0;
+	sink_dropped = 0;
+	if(sink_url != NULL)
+	{
+		encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_video_ctx->codec_data;
+		encoder_codec_data_t *audio_codec_data = NULL;
+		if(encoder_ctx->enc_audio_ctx != NULL && encoder_ctx->audio_channels > 0)
+			audio_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_audio_ctx->codec_data;
+
+		/*
+		 * the recording goes on without the sink if it can't start
+		 * opening can block (host resolution): only publish under the lock
+		 */
+		encoder_stream_sink_t *sink = encoder_stream_sink_init(
+			sink_url,
+			(encoder_ctx->video_codec_ind != 0 && video_codec_data) ? video_codec_data->codec_context : NULL,
+			muxer_video_codec_id(encoder_ctx),
+			encoder_ctx->video_width,
+			encoder_ctx->video_height,
+			audio_codec_data ? audio_codec_data->codec_context : NULL);
+
+		__LOCK_MUTEX( __PMUTEX );
+		stream_sink = sink;
+		sink_active = sink != NULL ? 1 : 0;
+		__UNLOCK_MUTEX( __PMUTEX );
+	}
+
+	if(journal_enabled)
+	{
+		size_t name_size = strlen(filename) + 9;
+		char *journal_name = calloc(name_size, sizeof(char));
+		if(journal_name == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_muxer_init): %s\n", strerror(errno));
+			exit(-1);
+		}
+		snprintf(journal_name, name_size, "%s.journal", filename);
+		journal_fp = fopen(journal_name, "w");
+		if(journal_fp == NULL)
+			fprintf(stderr, "ENCODER: (journal) couldn't open %s: %s\n", journal_name, strerror(errno));
+		free(journal_name);
+
+		journal_len = 0;
+		journal_sync_pts = 0;
+		journal_log(encoder_ctx, "journal %i %i %i\n", encoder_ctx->muxer_id, muxer_segment_seconds(), segment_mbytes);
+		journal_log(encoder_ctx, "segment %i 0 %s\n", segment_index, filename);
+		journal_persist(encoder_ctx, 0);
+	}
+
+	/*armed: mux the pre-roll and go live (audio is still being queued)*/
+	__LOCK_MUTEX( __PMUTEX );
+	if(preroll_armed)
+	{
+		preroll_splice(encoder_ctx);
+		preroll_reset();
+		preroll_armed = 0;
+	}
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
+/*
+ * close the file muxer
+ *   with segments (always on with the journal) this only finalizes
+ *   the last segment, so the time depends on the segment limits and
+ *   not on the recording length
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_muxer_close(encoder_context_t *encoder_ctx)
+{
+	journal_log(encoder_ctx, "close %i %" PRId64 "\n", segment_index, muxer_get_offset(encoder_ctx));
+
+	muxer_finish(encoder_ctx);
+
+	if(stream_sink != NULL)
+	{
+		__LOCK_MUTEX( __PMUTEX );
+		encoder_stream_sink_t *sink = stream_sink;
+		stream_sink = NULL;
+		__UNLOCK_MUTEX( __PMUTEX );
+
+		/*joins the sender thread: no muxer lock held*/
+		encoder_stream_sink_close(sink, &sink_sent, &sink_dropped);
+	}
+
+	if(journal_fp != NULL)
+	{
+		journal_log(encoder_ctx, "end %i\n", segment_index);
+		journal_persist(encoder_ctx, 0);
+		fclose(journal_fp);
+		journal_fp = NULL;
+	}
+
+	free(segment_basename);
+	segment_basename = NULL;
+}
+
+/*
+ * set segmented recording limits (takes effect on the next recording)
+ * args:
+ *   seconds - roll to a new file after seconds (0 - no limit)
+ *   mbytes - roll to a new file after mbytes (0 - no limit)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_segment_limits(int seconds, int mbytes)
+{
+	segment_seconds = seconds > 0 ? seconds : 0;
+	segment_mbytes = mbytes > 0 ? mbytes : 0;
+}
+
+/*
+ * enable the index journal (takes effect on the next recording)
+ * args:
+ *   value - 1 to write <filename>.journal, 0 to disable
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_index_journal(int value)
+{
+	journal_enabled = value ? 1 : 0;
+}
+
+/*
+ * get the number of segments in the current (or last) recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of segment files
+ */
+int encoder_get_segment_count()
+{
+	return segment_index;
+}
+
+/*
+ * set the pre-roll limits (takes effect on the next encoder_muxer_arm)
+ * args:
+ *   seconds - seconds kept before the recording starts (0 - disabled)
+ *   mbytes - memory limit for the pre-roll packets (0 - default: 32 MB)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_preroll(int seconds, int mbytes)
+{
+	preroll_seconds = seconds > 0 ? seconds : 0;
+	preroll_mbytes = mbytes > 0 ? mbytes : 32;
+}
+
+/*
+ * get the pre-roll duration
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pre-roll seconds (0 - disabled)
+ */
+int encoder_get_preroll()
+{
+	return preroll_seconds;
+}
+
+/*
+ * arm the muxer: keep the encoded packets in the pre-roll ring
+ *   until encoder_muxer_init opens the file
+ *   (with the pre-roll disabled only the current key frame group is kept)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_muxer_arm(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	__LOCK_MUTEX( __PMUTEX );
+	preroll_reset();
+	preroll_armed = 1;
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	if(verbosity > 0)
+		printf("ENCODER: muxer armed (pre-roll %i sec, %i MB)\n", preroll_seconds, preroll_mbytes);
+}
+
+/*
+ * disarm the muxer without recording (drops the pre-roll packets)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_muxer_disarm()
+{
+	__LOCK_MUTEX( __PMUTEX );
+	preroll_reset();
+	preroll_armed = 0;
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
+/*
+ * set the live stream sink (takes effect on the next recording)
+ *   the encoded packets are also sent as MPEG-TS to url
+ * args:
+ *   url - udp://host:port or rtp://host:port (NULL or empty to disable)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_stream_sink(const char *url)
+{
+	free(sink_url);
+	sink_url = NULL;
+
+	if(url != NULL && url[0] != '\0')
+		sink_url = strdup(url);
+}
+
+/*
+ * get the live stream sink stats for the current (or last) recording
+ * args:
+ *   sent - pointer to sent packets count (can be NULL)
+ *   dropped - pointer to packets dropped with the queue full (can be NULL)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if the sink is (was) active, 0 otherwise
+ */
+int encoder_get_stream_sink_stats(uint64_t *sent, uint64_t *dropped)
+{
+	__LOCK_MUTEX( __PMUTEX );
+	if(stream_sink != NULL)
+		encoder_stream_sink_get_stats(stream_sink, &sink_sent, &sink_dropped);
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	if(sent)
+		*sent = sink_sent;
+	if(dropped)
+		*dropped = sink_dropped;
+
+	return sink_active;
+}
+
 /*
  * function to determine if enought free space is available
  * args:
@@ -0,0 +1,510 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#           Nobuhiro Iwamatsu <iwamatsu@nigauri.org>                            #
+#                             Add UYVY color support(Macbook iSight)            #
+#           Flemming Frandsen <dren.dk@gmail.com>                               #
+#                             Add VU meter OSD                                  #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Encoder library - audio resampler                                            #
+#                                                                               #
+#  converts captured audio to the codec sample rate and corrects the drift     #
+#  of the audio device clock against the monotonic clock (video timestamps)    #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <math.h>
+
+#include "cameraconfig.h"
+#include "gviewencoder.h"
+#include "encoder.h"
+#include "gview.h"
+#include "load_libs.h"
+
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libswresample/swresample.h>
+
+#define RESAMPLER_MAX_COMP_PPM    (1000) /*max rate correction (0.1%)*/
+#define RESAMPLER_MIN_MEASURE_NS  (2 * NSEC_PER_SEC) /*min time for a drift estimate*/
+#define RESAMPLER_ERR_GAIN        (0.2)  /*share of the offset error corrected per update*/
+#define RESAMPLER_REPORT_UPDATES  (10)   /*updates between drift reports (verbosity > 1)*/
+
+extern int verbosity;
+
+struct _encoder_resampler_t
+{
+    struct SwrContext *swr;
+
+    int channels;
+    int in_rate;
+    int out_rate;
+    int sample_fmt;
+    int frame_size;       /*output frames per encoder frame*/
+
+    int planar;
+    int bps;              /*bytes per sample*/
+
+    /*output fifo (same layout as the encoder input)*/
+    uint8_t *fifo;
+    int fifo_size;        /*capacity in frames (per plane)*/
+    int fifo_count;       /*frames in fifo*/
+    uint8_t *frame;       /*one encoder frame*/
+
+    /*output timeline*/
+    int64_t pts_base;     /*pts of the first frame pulled since base*/
+    int64_t pulled;       /*frames pulled since base*/
+    int64_t next_in_pts;  /*expected pts of the next input buffer*/
+
+    /*drift measurement (against capture timestamps)*/
+    int64_t produced;     /*total output frames*/
+    int64_t anchor_ts;    /*capture ts at the start of a continuous run*/
+    int64_t anchor_out;   /*output position at anchor_ts*/
+    int64_t anchor_in;    /*input frames since anchor_ts*/
+    int64_t last_ts;      /*last capture ts*/
+    double err_sum;       /*sum of offset errors since last update*/
+    int err_count;
+    int64_t next_update;  /*output position of the next compensation update*/
+    int updates;
+
+    double drift_ppm;     /*measured drift (device vs monotonic clock)*/
+    int comp_delta;       /*current compensation (frames per second of output)*/
+};
+
+/*
+ * get the layout of an encoder sample format
+ * args:
+ *   sample_fmt - AVSampleFormat
+ *   planar - pointer to planar flag
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bytes per sample (or 0 if not supported)
+ */
+static int resampler_fmt_layout(int sample_fmt, int *planar)
+{
+    switch (sample_fmt) {
+    case AV_SAMPLE_FMT_S16:
+        *planar = 0;
+        return 2;
+    case AV_SAMPLE_FMT_S16P:
+        *planar = 1;
+        return 2;
+    case AV_SAMPLE_FMT_FLT:
+        *planar = 0;
+        return 4;
+    case AV_SAMPLE_FMT_FLTP:
+        *planar = 1;
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * set the plane pointers for a buffer of frames
+ * args:
+ *   rs - pointer to resampler
+ *   base - buffer start
+ *   stride - frames per plane
+ *   offset - frame offset
+ *   ptr - plane pointers (channels entries for planar formats)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void resampler_planes(encoder_resampler_t *rs, uint8_t *base, int stride,
+                             int offset, uint8_t **ptr)
+{
+    int ch = 0;
+
+    if (!rs->planar) {
+        ptr[0] = base + offset * rs->channels * rs->bps;
+        return;
+    }
+
+    for (ch = 0; ch < rs->channels; ch++)
+        ptr[ch] = base + (ch * stride + offset) * rs->bps;
+}
+
+/*
+ * create the audio resampler
+ * args:
+ *   channels - number of channels
+ *   in_rate - capture sample rate
+ *   out_rate - codec sample rate
+ *   sample_fmt - codec sample format (input is in the same format)
+ *   frame_size - codec frame size (frames)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to resampler (or NULL if not available)
+ */
+encoder_resampler_t *encoder_resampler_init(int channels, int in_rate, int out_rate,
+        int sample_fmt, int frame_size)
+{
+    LoadLibs *libs = getLoadLibsInstance();
+
+    if (!libs->m_swr_alloc_set_opts || !libs->m_swr_init || !libs->m_swr_convert ||
+            !libs->m_swr_set_compensation || !libs->m_swr_get_delay || !libs->m_swr_free) {
+        fprintf(stderr, "ENCODER: libswresample not available: no audio resampling\n");
+        return NULL;
+    }
+
+    int planar = 0;
+    int bps = resampler_fmt_layout(sample_fmt, &planar);
+    /*encoder channel layouts are mono or stereo*/
+    if (channels <= 0 || channels > 2 || in_rate <= 0 || out_rate <= 0 || frame_size <= 0 || bps == 0) {
+        fprintf(stderr, "ENCODER: can't resample audio: channels(%d) rate(%d -> %d) frame(%d) fmt(%d)\n",
+                channels, in_rate, out_rate, frame_size, sample_fmt);
+        return NULL;
+    }
+
+    int64_t layout = (channels < 2) ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
+
+    struct SwrContext *swr = libs->m_swr_alloc_set_opts(NULL,
+                             layout, sample_fmt, out_rate,
+                             layout, sample_fmt, in_rate,
+                             0, NULL);
+
+    if (!swr || libs->m_swr_init(swr) < 0) {
+        fprintf(stderr, "ENCODER: couldn't init audio resampler (%d -> %d Hz)\n", in_rate, out_rate);
+        if (swr)
+            libs->m_swr_free(&swr);
+        return NULL;
+    }
+
+    encoder_resampler_t *rs = calloc(1, sizeof(encoder_resampler_t));
+    if (rs == NULL) {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_resampler_init): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    rs->swr = swr;
+    rs->channels = channels;
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->sample_fmt = sample_fmt;
+    rs->frame_size = frame_size;
+    rs->planar = planar;
+    rs->bps = bps;
+
+    /*
+     * room for a leftover frame plus one converted capture buffer
+     * (capture buffers hold frame_size frames at the input rate)
+     */
+    rs->fifo_size = 2 * frame_size +
+                    (int)(((int64_t) frame_size * out_rate) / in_rate) * 2 + 256;
+    rs->fifo = calloc((size_t) rs->fifo_size * channels, bps);
+    rs->frame = calloc((size_t) frame_size * channels, bps);
+    if (rs->fifo == NULL || rs->frame == NULL) {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_resampler_init): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    rs->pts_base = -1;
+    rs->anchor_ts = -1;
+    rs->next_update = out_rate;
+
+    if (verbosity > 0)
+        printf("ENCODER: audio resampler %d -> %d Hz (%d channels)\n", in_rate, out_rate, channels);
+
+    return rs;
+}
+
+/*
+ * update the drift estimate and the resampler compensation
+ *   called after each input buffer with a valid capture timestamp
+ * args:
+ *   rs - pointer to resampler
+ *   in_frames - frames in the input buffer
+ *   capture_ts - capture (monotonic) time of the buffer end
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void resampler_update_drift(encoder_resampler_t *rs, int in_frames, int64_t capture_ts)
+{
+    int64_t out_pos = rs->produced + getLoadLibsInstance()->m_swr_get_delay(rs->swr, rs->out_rate);
+    int64_t buff_ns = ((int64_t) in_frames * NSEC_PER_SEC) / rs->in_rate;
+
+    /*
+     * capture time must advance by about one buffer,
+     * otherwise (pause, dropped buffers) start a new run
+     */
+    if (rs->anchor_ts < 0 || llabs(capture_ts - rs->last_ts - buff_ns) > buff_ns) {
+        rs->anchor_ts = capture_ts;
+        rs->anchor_out = out_pos;
+        rs->anchor_in = 0;
+        rs->last_ts = capture_ts;
+        rs->err_sum = 0;
+        rs->err_count = 0;
+        return;
+    }
+
+    rs->last_ts = capture_ts;
+    rs->anchor_in += in_frames;
+
+    int64_t elapsed = capture_ts - rs->anchor_ts;
+
+    /*offset (in output frames) between the output and the capture clock*/
+    double err = (double)(out_pos - rs->anchor_out) -
+                 (double) elapsed * rs->out_rate / NSEC_PER_SEC;
+    rs->err_sum += err;
+    rs->err_count++;
+
+    if (elapsed >= RESAMPLER_MIN_MEASURE_NS)
+        rs->drift_ppm = ((double) rs->anchor_in * NSEC_PER_SEC /
+                         ((double) elapsed * rs->in_rate) - 1.0) * 1000000.0;
+
+    if (rs->produced < rs->next_update)
+        return;
+
+    /*new compensation for the next second of output*/
+    int distance = rs->out_rate;
+    double delta = - rs->drift_ppm * distance / 1000000.0;
+    if (rs->err_count > 0)
+        delta -= RESAMPLER_ERR_GAIN * rs->err_sum / rs->err_count;
+
+    double max_delta = (double) RESAMPLER_MAX_COMP_PPM * distance / 1000000.0;
+    if (delta > max_delta)
+        delta = max_delta;
+    if (delta < -max_delta)
+        delta = -max_delta;
+
+    rs->comp_delta = (int) lrint(delta);
+    if (getLoadLibsInstance()->m_swr_set_compensation(rs->swr, rs->comp_delta, distance) < 0)
+        rs->comp_delta = 0;
+
+    rs->err_sum = 0;
+    rs->err_count = 0;
+    rs->next_update = rs->produced + distance;
+
+    if (verbosity > 1 && (++rs->updates % RESAMPLER_REPORT_UPDATES) == 0)
+        printf("ENCODER: audio clock drift %.1f ppm (offset %.1f frames, compensation %d/%d)\n",
+               rs->drift_ppm, err, rs->comp_delta, distance);
+}
+
+/*
+ * drain the resampler delay into the fifo and complete
+ * the last encoder frame with silence
+ * args:
+ *   rs - pointer to resampler
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of output frames added (or < 0 on error)
+ */
+static int resampler_drain(encoder_resampler_t *rs)
+{
+    uint8_t *out[AV_NUM_DATA_POINTERS];
+    int nplanes = rs->planar ? rs->channels : 1;
+    int width = rs->planar ? rs->bps : rs->bps * rs->channels; /*bytes per frame and plane*/
+    int p = 0;
+
+    resampler_planes(rs, rs->fifo, rs->fifo_size, rs->fifo_count, out);
+
+    int ret = getLoadLibsInstance()->m_swr_convert(rs->swr, out,
+              rs->fifo_size - rs->fifo_count, NULL, 0);
+    if (ret < 0) {
+        fprintf(stderr, "ENCODER: audio resampler flush error (%d)\n", ret);
+        return ret;
+    }
+
+    rs->fifo_count += ret;
+    rs->produced += ret;
+
+    int pad = (rs->frame_size - rs->fifo_count % rs->frame_size) % rs->frame_size;
+    if (rs->fifo_count + pad > rs->fifo_size)
+        pad = 0;
+
+    if (pad > 0) {
+        resampler_planes(rs, rs->fifo, rs->fifo_size, rs->fifo_count, out);
+        for (p = 0; p < nplanes; p++)
+            memset(out[p], 0, (size_t) pad * width);
+        rs->fifo_count += pad;
+    }
+
+    return ret + pad;
+}
+
+/*
+ * push a captured audio buffer into the resampler
+ * args:
+ *   rs - pointer to resampler
+ *   data - captured samples (codec sample format)
+ *     or NULL to flush: drains the resampler delay and pads
+ *     the last partial frame with silence
+ *   in_frames - number of frames in data
+ *   pts - buffer pts (nanosec)
+ *   capture_ts - capture (monotonic) time of the buffer end (<= 0 if unknown)
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: number of output frames added (or < 0 on error)
+ */
+int encoder_resampler_push(encoder_resampler_t *rs, const void *data, int in_frames,
+                           int64_t pts, int64_t capture_ts)
+{
+    /*assertions*/
+    assert(rs != NULL);
+
+    if (data == NULL)
+        return resampler_drain(rs);
+
+    /*
+     * pts continuity: on a jump restart the output timeline
+     * so the next frame pulled gets the jump
+     */
+    int64_t tol = ((int64_t) in_frames * NSEC_PER_SEC) / (2 * rs->in_rate);
+    if (rs->pts_base < 0 || llabs(pts - rs->next_in_pts) > tol) {
+        int64_t pending = rs->fifo_count +
+                          getLoadLibsInstance()->m_swr_get_delay(rs->swr, rs->out_rate);
+        rs->pts_base = pts - (pending * NSEC_PER_SEC) / rs->out_rate;
+        rs->pulled = 0;
+    }
+    rs->next_in_pts = pts + ((int64_t) in_frames * NSEC_PER_SEC) / rs->in_rate;
+
+    const uint8_t *in[AV_NUM_DATA_POINTERS];
+    uint8_t *out[AV_NUM_DATA_POINTERS];
+    resampler_planes(rs, (uint8_t *) data, in_frames, 0, (uint8_t **) in);
+    resampler_planes(rs, rs->fifo, rs->fifo_size, rs->fifo_count, out);
+
+    int ret = getLoadLibsInstance()->m_swr_convert(rs->swr, out,
+              rs->fifo_size - rs->fifo_count, in, in_frames);
+    if (ret < 0) {
+        fprintf(stderr, "ENCODER: audio resampler error (%d)\n", ret);
+        return ret;
+    }
+
+    rs->fifo_count += ret;
+    rs->produced += ret;
+
+    if (capture_ts > 0)
+        resampler_update_drift(rs, in_frames, capture_ts);
+
+    return ret;
+}
+
+/*
+ * pull one encoder frame from the resampler
+ * args:
+ *   rs - pointer to resampler
+ *   pts - pointer to frame pts (nanosec)
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: pointer to frame_size frames in the codec layout
+ *   (or NULL if there is not enough data)
+ */
+uint8_t *encoder_resampler_pull(encoder_resampler_t *rs, int64_t *pts)
+{
+    /*assertions*/
+    assert(rs != NULL);
+
+    if (rs->fifo_count < rs->frame_size)
+        return NULL;
+
+    uint8_t *src[AV_NUM_DATA_POINTERS];
+    uint8_t *dst[AV_NUM_DATA_POINTERS];
+    int left = rs->fifo_count - rs->frame_size;
+    int nplanes = rs->planar ? rs->channels : 1;
+    int width = rs->planar ? rs->bps : rs->bps * rs->channels; /*bytes per frame and plane*/
+    int p = 0;
+
+    resampler_planes(rs, rs->fifo, rs->fifo_size, 0, src);
+    resampler_planes(rs, rs->frame, rs->frame_size, 0, dst);
+
+    for (p = 0; p < nplanes; p++) {
+        memcpy(dst[p], src[p], (size_t) rs->frame_size * width);
+        if (left > 0)
+            memmove(src[p], src[p] + (size_t) rs->frame_size * width, (size_t) left * width);
+    }
+
+    rs->fifo_count = left;
+
+    if (pts)
+        *pts = rs->pts_base + (rs->pulled * NSEC_PER_SEC) / rs->out_rate;
+    rs->pulled += rs->frame_size;
+
+    return rs->frame;
+}
+
+/*
+ * get the measured audio clock drift
+ * args:
+ *   rs - pointer to resampler
+ *
+ * asserts:
+ *   rs is not null
+ *
+ * returns: drift of the capture device clock in ppm
+ *   (> 0 device runs fast against the monotonic clock)
+ */
+double encoder_resampler_get_drift(encoder_resampler_t *rs)
+{
+    /*assertions*/
+    assert(rs != NULL);
+
+    return rs->drift_ppm;
+}
+
+/*
+ * free the audio resampler
+ * args:
+ *   rs - pointer to resampler
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_resampler_close(encoder_resampler_t *rs)
+{
+    if (rs == NULL)
+        return;
+
+    if (verbosity > 0)
+        printf("ENCODER: audio resampler closed: clock drift %.1f ppm\n", rs->drift_ppm);
+
+    if (rs->swr)
+        getLoadLibsInstance()->m_swr_free(&rs->swr);
+
+    free(rs->fifo);
+    free(rs->frame);
+    free(rs);
+}
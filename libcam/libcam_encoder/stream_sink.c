@@ -0,0 +1,560 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#           Nobuhiro Iwamatsu <iwamatsu@nigauri.org>                            #
+#                             Add UYVY color support(Macbook iSight)            #
+#           Flemming Frandsen <dren.dk@gmail.com>                               #
+#                             Add VU meter OSD                                  #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Encoder library - live stream sink                                           #
+#                                                                               #
+#  sends the already encoded packets as MPEG-TS over UDP (udp://) or RTP        #
+#  (rtp://) from its own thread, fed through a bounded packet queue            #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "cameraconfig.h"
+#include "gviewencoder.h"
+#include "encoder.h"
+#include "gview.h"
+#include "load_libs.h"
+
+#include <libavformat/avformat.h>
+#include <libavutil/mathematics.h>
+
+#define SINK_QUEUE_SIZE      (256)              /*max queued packets*/
+#define SINK_QUEUE_MAX_BYTES (16 * 1024 * 1024) /*max queued payload*/
+#define SINK_BUFFER_MIN_CLASS (4096)            /*smallest packet buffer*/
+#define SINK_UDP_PKT_SIZE    "1316"             /*7 TS packets per datagram*/
+
+/*sink timestamps are in nanoseconds*/
+#define SINK_TIME_BASE ((AVRational){1, 1000000000})
+
+extern int verbosity;
+
+typedef struct _sink_packet_t
+{
+    uint8_t *data;
+    int max_size;         /*allocated size (size class)*/
+    int size;
+    int stream_index;     /*0 - video; 1 - audio*/
+    int64_t pts;          /*nanosec*/
+    int flags;
+} sink_packet_t;
+
+struct _encoder_stream_sink_t
+{
+    AVFormatContext *ctx;
+    int audio_index;      /*sink stream index for audio (-1 if none)*/
+
+    /*packet ring: the sender owns the slot at read_index while count > 0*/
+    sink_packet_t queue[SINK_QUEUE_SIZE];
+    int write_index;
+    int read_index;
+    int count;
+    int64_t queued_bytes;
+
+    int wait_keyframe;    /*drop video until the next key frame*/
+    int64_t first_pts;    /*pts of the first sent video frame*/
+    int64_t last_pts[2];  /*last muxed pts (sink time base) per stream*/
+
+    /*stats*/
+    uint64_t sent;
+    uint64_t dropped;
+    uint64_t errors;
+
+    int stop;
+
+    __THREAD_TYPE thread;
+    __MUTEX_TYPE mutex;
+    __COND_TYPE cond;
+};
+
+/*
+ * check if a codec can be carried in MPEG-TS
+ * args:
+ *   codec_id - libav codec id
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if supported, 0 otherwise
+ */
+static int sink_codec_supported(int codec_id)
+{
+    switch(codec_id)
+    {
+        case AV_CODEC_ID_H264:
+        case AV_CODEC_ID_HEVC:
+        case AV_CODEC_ID_MPEG1VIDEO:
+        case AV_CODEC_ID_MPEG2VIDEO:
+        case AV_CODEC_ID_MPEG4:
+        case AV_CODEC_ID_MP2:
+        case AV_CODEC_ID_MP3:
+        case AV_CODEC_ID_AAC:
+        case AV_CODEC_ID_AC3:
+        case AV_CODEC_ID_OPUS:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * mux one queued packet (sender thread)
+ * args:
+ *   sink - pointer to stream sink
+ *   pkt - pointer to an AVPacket used as wrapper
+ *   qpkt - pointer to the queued packet
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code from av_write_frame
+ */
+static int sink_send_packet(encoder_stream_sink_t *sink, AVPacket *pkt, sink_packet_t *qpkt)
+{
+    int index = qpkt->stream_index == 0 ? 0 : sink->audio_index;
+    AVRational stream_time = sink->ctx->streams[index]->time_base;
+
+    int64_t pts = getAvutil()->m_av_rescale_q(qpkt->pts - sink->first_pts, SINK_TIME_BASE, stream_time);
+    if(pts <= sink->last_pts[qpkt->stream_index]) //pts must be strictly incremented
+        pts = sink->last_pts[qpkt->stream_index] + 1;
+    sink->last_pts[qpkt->stream_index] = pts;
+
+    /*the queue owns the data: wrap it without a reference*/
+    pkt->buf = NULL;
+    pkt->data = qpkt->data;
+    pkt->size = qpkt->size;
+    pkt->flags = qpkt->flags;
+    pkt->stream_index = index;
+    pkt->pts = pts;
+    pkt->dts = pts;
+    pkt->duration = 0;
+
+    int ret = getAvformat()->m_av_write_frame(sink->ctx, pkt);
+
+    pkt->data = NULL;
+    pkt->size = 0;
+    getLoadLibsInstance()->m_av_packet_unref(pkt);
+
+    return ret;
+}
+
+/*
+ * sender thread: network stalls only fill the queue
+ * args:
+ *   data - pointer to stream sink
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *sink_thread(void *data)
+{
+    encoder_stream_sink_t *sink = (encoder_stream_sink_t *) data;
+    AVPacket *pkt = getLoadLibsInstance()->m_av_packet_alloc();
+
+    __LOCK_MUTEX(&sink->mutex);
+    while(1)
+    {
+        while(sink->count == 0 && !sink->stop)
+            pthread_cond_wait(&sink->cond, &sink->mutex);
+
+        /*
+         * stale packets are useless for a live stream: on stop discard
+         * the queue, so closing never waits for a slow network
+         */
+        if(sink->stop)
+        {
+            sink->dropped += sink->count;
+            sink->count = 0;
+            sink->queued_bytes = 0;
+            break;
+        }
+
+        sink_packet_t *qpkt = &sink->queue[sink->read_index];
+        __UNLOCK_MUTEX(&sink->mutex);
+
+        int ret = pkt ? sink_send_packet(sink, pkt, qpkt) : -1;
+
+        __LOCK_MUTEX(&sink->mutex);
+        if(ret < 0)
+        {
+            /*report the first error only (e.g. no listener on loopback)*/
+            if(sink->errors == 0)
+                fprintf(stderr, "ENCODER: (stream sink) error sending packet (%i)\n", ret);
+            sink->errors++;
+        }
+        else
+            sink->sent++;
+
+        sink->queued_bytes -= qpkt->size;
+        sink->read_index = (sink->read_index + 1) % SINK_QUEUE_SIZE;
+        sink->count--;
+    }
+    __UNLOCK_MUTEX(&sink->mutex);
+
+    if(pkt)
+        getLoadLibsInstance()->m_av_packet_free(&pkt);
+
+    return NULL;
+}
+
+/*
+ * add a stream to the sink
+ * args:
+ *   sink - pointer to stream sink
+ *   codec_context - encoder codec context (NULL for camera encoded data)
+ *   codec_id - codec id (used if codec_context is null)
+ *   width - video width (used if codec_context is null)
+ *   height - video height (used if codec_context is null)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to the new stream (NULL on error)
+ */
+static AVStream *sink_add_stream(encoder_stream_sink_t *sink, AVCodecContext *codec_context,
+        int codec_id, int width, int height)
+{
+    AVStream *st = getAvformat()->m_avformat_new_stream(sink->ctx, NULL);
+    if(st == NULL)
+        return NULL;
+
+    if(codec_context != NULL)
+    {
+        if(getLoadLibsInstance()->m_avcodec_parameters_from_context(st->codecpar, codec_context) < 0)
+            return NULL;
+    }
+    else
+    {
+        st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+        st->codecpar->codec_id = codec_id;
+        st->codecpar->width = width;
+        st->codecpar->height = height;
+    }
+
+    st->codecpar->codec_tag = 0; /*let the muxer choose*/
+    st->time_base = (AVRational){1, 90000};
+    return st;
+}
+
+/*
+ * create the stream sink and start its sender thread
+ * args:
+ *   url - destination (udp://host:port or rtp://host:port)
+ *   video_codec_context - video encoder context (NULL for camera encoded data)
+ *   video_codec_id - video codec id
+ *   width - video width
+ *   height - video height
+ *   audio_codec_context - audio encoder context (NULL if no audio)
+ *
+ * asserts:
+ *   url is not null
+ *
+ * returns: pointer to stream sink (or NULL on error)
+ */
+encoder_stream_sink_t *encoder_stream_sink_init(const char *url,
+        AVCodecContext *video_codec_context, int video_codec_id, int width, int height,
+        AVCodecContext *audio_codec_context)
+{
+    /*assertions*/
+    assert(url != NULL);
+
+    if(!sink_codec_supported(video_codec_id))
+    {
+        fprintf(stderr, "ENCODER: (stream sink) video codec %i can't be sent in MPEG-TS\n",
+            video_codec_id);
+        return NULL;
+    }
+
+    /*rtp: one TS payload per rtp packet; udp: raw TS datagrams*/
+    const char *format = strncmp(url, "rtp://", 6) == 0 ? "rtp_mpegts" : "mpegts";
+
+    /*keep datagrams below the usual MTU*/
+    char *sink_url = NULL;
+    if(strncmp(url, "udp://", 6) == 0 && strchr(url, '?') == NULL)
+    {
+        size_t url_size = strlen(url) + strlen("?pkt_size=" SINK_UDP_PKT_SIZE) + 1;
+        sink_url = calloc(url_size, sizeof(char));
+        if(sink_url == NULL)
+        {
+            fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_stream_sink_init): %s\n", strerror(errno));
+            exit(-1);
+        }
+        snprintf(sink_url, url_size, "%s?pkt_size=" SINK_UDP_PKT_SIZE, url);
+    }
+    else
+        sink_url = strdup(url);
+
+    encoder_stream_sink_t *sink = calloc(1, sizeof(encoder_stream_sink_t));
+    if(sink == NULL || sink_url == NULL)
+    {
+        fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_stream_sink_init): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    getAvformat()->m_avformat_alloc_output_context2(&sink->ctx, NULL, format, sink_url);
+    if(sink->ctx == NULL)
+    {
+        fprintf(stderr, "ENCODER: (stream sink) %s muxer not available\n", format);
+        free(sink_url);
+        free(sink);
+        return NULL;
+    }
+
+    if(sink_add_stream(sink, video_codec_context, video_codec_id, width, height) == NULL)
+    {
+        fprintf(stderr, "ENCODER: (stream sink) couldn't add video stream\n");
+        goto error;
+    }
+
+    sink->audio_index = -1;
+    if(audio_codec_context != NULL)
+    {
+        if(!sink_codec_supported(audio_codec_context->codec_id))
+            fprintf(stderr, "ENCODER: (stream sink) audio codec %i can't be sent in MPEG-TS - video only\n",
+                audio_codec_context->codec_id);
+        else
+        {
+            AVStream *st = sink_add_stream(sink, audio_codec_context, 0, 0, 0);
+            if(st == NULL)
+            {
+                fprintf(stderr, "ENCODER: (stream sink) couldn't add audio stream\n");
+                goto error;
+            }
+            sink->audio_index = st->index;
+        }
+    }
+
+    int ret = getAvformat()->m_avio_open(&sink->ctx->pb, sink_url, AVIO_FLAG_WRITE);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ENCODER: (stream sink) couldn't open %s (%i)\n", sink_url, ret);
+        goto error;
+    }
+
+    ret = getAvformat()->m_avformat_write_header(sink->ctx, NULL);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ENCODER: (stream sink) couldn't write header (%i)\n", ret);
+        getAvformat()->m_avio_closep(&sink->ctx->pb);
+        goto error;
+    }
+
+    /*start sending at the first key frame*/
+    sink->wait_keyframe = 1;
+    sink->first_pts = -1;
+    sink->last_pts[0] = -1;
+    sink->last_pts[1] = -1;
+
+    __INIT_MUTEX(&sink->mutex);
+    __INIT_COND(&sink->cond);
+    if(__THREAD_CREATE(&sink->thread, sink_thread, (void *) sink) != 0)
+    {
+        fprintf(stderr, "ENCODER: (stream sink) couldn't start sender thread\n");
+        __CLOSE_COND(&sink->cond);
+        __CLOSE_MUTEX(&sink->mutex);
+        getAvformat()->m_avio_closep(&sink->ctx->pb);
+        goto error;
+    }
+
+    if(verbosity > 0)
+        printf("ENCODER: (stream sink) sending %s to %s\n", format, sink_url);
+
+    free(sink_url);
+    return sink;
+
+error:
+    getAvformat()->m_avformat_free_context(sink->ctx);
+    free(sink_url);
+    free(sink);
+    return NULL;
+}
+
+/*
+ * queue an encoded packet for the stream sink (copies the data)
+ *   never blocks on the network: drops the packet if the queue is full
+ * args:
+ *   sink - pointer to stream sink
+ *   stream_index - 0 for video, 1 for audio
+ *   data - encoded packet data
+ *   size - packet size
+ *   pts - packet pts (nanosec)
+ *   flags - packet flags
+ *
+ * asserts:
+ *   sink is not null
+ *
+ * returns: 0 if queued, -1 if dropped
+ */
+int encoder_stream_sink_push(encoder_stream_sink_t *sink, int stream_index,
+        const uint8_t *data, int size, int64_t pts, int flags)
+{
+    /*assertions*/
+    assert(sink != NULL);
+
+    if(data == NULL || size <= 0)
+        return -1;
+
+    if(stream_index != 0 && sink->audio_index < 0)
+        return -1; /*video only*/
+
+    __LOCK_MUTEX(&sink->mutex);
+
+    if(stream_index == 0)
+    {
+        if(sink->wait_keyframe && !(flags & AV_PKT_FLAG_KEY))
+            goto drop;
+        if(sink->count >= SINK_QUEUE_SIZE || sink->queued_bytes + size > SINK_QUEUE_MAX_BYTES)
+        {
+            /*the next frames would reference this one*/
+            sink->wait_keyframe = 1;
+            goto drop;
+        }
+        sink->wait_keyframe = 0;
+        if(sink->first_pts < 0)
+            sink->first_pts = pts;
+    }
+    else if(sink->first_pts < 0 || pts < sink->first_pts ||
+        sink->count >= SINK_QUEUE_SIZE || sink->queued_bytes + size > SINK_QUEUE_MAX_BYTES)
+        goto drop;
+
+    sink_packet_t *qpkt = &sink->queue[sink->write_index];
+    if(size > qpkt->max_size)
+    {
+        /*grow to the next size class: slots settle after a few packets*/
+        int size_class = SINK_BUFFER_MIN_CLASS;
+        while(size_class < size)
+            size_class <<= 1;
+
+        free(qpkt->data);
+        qpkt->data = malloc(size_class);
+        qpkt->max_size = size_class;
+        if(qpkt->data == NULL)
+        {
+            fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_stream_sink_push): %s\n", strerror(errno));
+            exit(-1);
+        }
+    }
+
+    memcpy(qpkt->data, data, size);
+    qpkt->size = size;
+    qpkt->stream_index = stream_index ? 1 : 0;
+    qpkt->pts = pts;
+    qpkt->flags = flags;
+
+    sink->queued_bytes += size;
+    sink->write_index = (sink->write_index + 1) % SINK_QUEUE_SIZE;
+    sink->count++;
+
+    __COND_SIGNAL(&sink->cond);
+    __UNLOCK_MUTEX(&sink->mutex);
+    return 0;
+
+drop:
+    sink->dropped++;
+    __UNLOCK_MUTEX(&sink->mutex);
+
+    if(verbosity > 1)
+        printf("ENCODER: (stream sink) dropped packet (stream %i)\n", stream_index);
+    return -1;
+}
+
+/*
+ * get the stream sink stats
+ * args:
+ *   sink - pointer to stream sink
+ *   sent - pointer to sent packets count (can be NULL)
+ *   dropped - pointer to dropped packets count (can be NULL)
+ *
+ * asserts:
+ *   sink is not null
+ *
+ * returns: none
+ */
+void encoder_stream_sink_get_stats(encoder_stream_sink_t *sink, uint64_t *sent, uint64_t *dropped)
+{
+    /*assertions*/
+    assert(sink != NULL);
+
+    __LOCK_MUTEX(&sink->mutex);
+    if(sent)
+        *sent = sink->sent;
+    if(dropped)
+        *dropped = sink->dropped;
+    __UNLOCK_MUTEX(&sink->mutex);
+}
+
+/*
+ * stop the stream sink: discards the queued packets and sends the trailer
+ * args:
+ *   sink - pointer to stream sink
+ *   sent - pointer to final sent packets count (can be NULL)
+ *   dropped - pointer to final dropped packets count (can be NULL)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_stream_sink_close(encoder_stream_sink_t *sink, uint64_t *sent, uint64_t *dropped)
+{
+    if(sink == NULL)
+        return;
+
+    __LOCK_MUTEX(&sink->mutex);
+    sink->stop = 1;
+    __COND_SIGNAL(&sink->cond);
+    __UNLOCK_MUTEX(&sink->mutex);
+
+    __THREAD_JOIN(sink->thread);
+
+    if(verbosity > 0)
+        printf("ENCODER: (stream sink) sent %" PRIu64 " packets, dropped %" PRIu64 " (%" PRIu64 " errors)\n",
+            sink->sent, sink->dropped, sink->errors);
+    if(sent)
+        *sent = sink->sent;
+    if(dropped)
+        *dropped = sink->dropped;
+
+    getAvformat()->m_av_write_trailer(sink->ctx);
+    getAvformat()->m_avio_closep(&sink->ctx->pb);
+    getAvformat()->m_avformat_free_context(sink->ctx);
+
+    int i = 0;
+    for(i = 0; i < SINK_QUEUE_SIZE; i++)
+        free(sink->queue[i].data);
+
+    __CLOSE_COND(&sink->cond);
+    __CLOSE_MUTEX(&sink->mutex);
+    free(sink);
+}
@@ -388,7 +388,12 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = X264_ME_HEX,
 		.mpeg_quant   = 1,
 		.max_b_frames = 4,
-		.num_threads  = 4,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_SLICE,
+		.preset       = "ultrafast",
+		.tune         = "zerolatency",
+		.rc_mode      = ENCODER_RC_CRF,
+		.rc_value     = 23,
 #if LIBAVCODEC_VER_AT_LEAST(54,01)
 		.flags        = CODEC_FLAG2_INTRA_REFRESH
 #else
@@ -429,7 +434,10 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = 0,
 		.mpeg_quant   = 1,
 		.max_b_frames = 16,
-		.num_threads  = 4,
+		.num_threads  = 0,
+		.preset       = "ultrafast",
+		.rc_mode      = ENCODER_RC_CRF,
+		.rc_value     = 28,
 		.flags        = CODEC_FLAG2_INTRA_REFRESH
 	},
 #endif
@@ -466,7 +474,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = 0,
 		.mpeg_quant   = 1,
 		.max_b_frames = 0,
-		.num_threads  = 4,
+		.num_threads  = 0,
+		.preset       = "realtime",
+		.speed        = 10,
 		.flags        = 0
 	},
 #if LIBAVCODEC_VER_AT_LEAST(54,42)
@@ -503,9 +513,51 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = 0,
 		.mpeg_quant   = 1,
 		.max_b_frames = 16,
-		.num_threads  = 4,
+		.num_threads  = 0,
+		.preset       = "realtime",
+		.speed        = 8,
 		.flags        = 0
 	},
+#endif
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+	{
+		.valid        = 1,
+		.compressor   = "AV01",
+		.mkv_4cc      = v4l2_fourcc('A','V','0','1'),
+		.mkv_codec    = "V_AV1",
+		.mkv_codecPriv= NULL,
+		.description  = N_("AV1 (AV1)"),
+		.pix_fmt      = AV_PIX_FMT_YUV420P,
+		.fps          = 0,
+		.monotonic_pts= 1,
+		.bit_rate     = 1000000,
+		.qmax         = 63,
+		.qmin         = 10,
+		.max_qdiff    = 4,
+		.dia          = 2,
+		.pre_dia      = 2,
+		.pre_me       = 2,
+		.me_pre_cmp   = 0,
+		.me_cmp       = 3,
+		.me_sub_cmp   = 3,
+		.last_pred    = 2,
+		.gop_size     = 120,
+		.qcompress    = 0.8,
+		.qblur        = 0.5,
+		.subq         = 5,
+		.framerefs    = 0,
+		.codec_id     = AV_CODEC_ID_AV1,
+		.codec_name   = "libsvtav1", /*else any AV1 encoder (libaom-av1)*/
+		.mb_decision  = FF_MB_DECISION_RD,
+		.trellis      = 0,
+		.me_method    = 0,
+		.mpeg_quant   = 1,
+		.max_b_frames = 0,
+		.num_threads  = 0,
+		.preset       = "realtime",
+		.speed        = 8,
+		.flags        = AV_CODEC_FLAG_GLOBAL_HEADER /*sequence header for the av1C*/
+	},
 #endif
 	{
 		.valid        = 1,
@@ -842,6 +894,37 @@ int encoder_set_video_mkvCodecPriv(encoder_context_t *encoder_ctx)
 
 		listSupCodecs[real_index].mkv_codecPriv = encoder_ctx->enc_video_ctx->priv_data;
 	}
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+	else if(codec_id == AV_CODEC_ID_AV1)
+	{
+		/*
+		 * av1C: the 4 byte header and the sequence header as config OBU
+		 *   (from the encoder global header)
+		 */
+		AVCodecContext *codec_context = video_codec_data->codec_context;
+		int extradata_size = codec_context->extradata != NULL ? codec_context->extradata_size : 0;
+		encoder_ctx->enc_video_ctx->priv_data = calloc(extradata_size + 4, sizeof(uint8_t));
+		if (encoder_ctx->enc_video_ctx->priv_data == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_set_video_mkvCodecPriv): %s\n", strerror(errno));
+			exit(-1);
+		}
+		uint8_t *tp = encoder_ctx->enc_video_ctx->priv_data;
+		size = av1_get_codec_config(codec_context->extradata, extradata_size, tp);
+		if(size < 0)
+		{
+			/*no sequence header: it is only sent in band with the key frames*/
+			fprintf(stderr, "ENCODER: (av1 codec) no sequence header in extradata - using default av1C\n");
+			size = 4;
+			tp[0] = 0x81; /* marker (1) + version (0000001) */
+			tp[1] = 0x1f; /* seq_profile main (000) + seq_level_idx_0 unconstrained (11111) */
+			tp[2] = 0x0c; /* tier, bit depth and monochrome (0000) + 4:2:0 subsampling (11) + sample position (00) */
+			tp[3] = 0x00; /* reserved (000) + no initial presentation delay (00000) */
+		}
+
+		listSupCodecs[real_index].mkv_codecPriv = encoder_ctx->enc_video_ctx->priv_data;
+	}
+#endif
 	else if(listSupCodecs[real_index].mkv_codecPriv != NULL)
 	{
 		bmp_info_header_t *mkv_codecPriv = get_default_mkv_codecPriv();
@@ -859,7 +942,7 @@ int encoder_set_video_mkvCodecPriv(encoder_context_t *encoder_ctx)
 }
 
 /*
- * checks if the video codec index corresponds to VP8 or VP9 (webm) codec
+ * checks if the video codec index corresponds to VP8, VP9 or AV1 (webm) codec
  * args:
  *    codec_ind - video codec list index
  *
@@ -877,6 +960,9 @@ int encoder_check_webm_video_codec(int codec_ind)
 		ret = ((listSupCodecs[real_index].codec_id == AV_CODEC_ID_VP8)
 #if LIBAVCODEC_VER_AT_LEAST(54,42)
 				|| (listSupCodecs[real_index].codec_id == AV_CODEC_ID_VP9)
+#endif
+#if LIBAVCODEC_VER_AT_LEAST(58,18)
+				|| (listSupCodecs[real_index].codec_id == AV_CODEC_ID_AV1)
 #endif
 			 ) ? 1: 0;
 
@@ -958,6 +1044,129 @@ video_codec_t *encoder_get_video_codec_defaults(int codec_ind)
 	}
 }
 
+/*
+ * set the video codec threads (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   threads - number of threads (0 - auto: one per core)
+ *   thread_type - ENCODER_THREAD_AUTO, ENCODER_THREAD_SLICE or ENCODER_THREAD_FRAME
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_threads(int codec_ind, int threads, int thread_type)
+{
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(codec_ind);
+	if(!video_defaults)
+		return -1;
+
+	video_defaults->num_threads = threads > 0 ? threads : 0;
+	video_defaults->thread_type = thread_type;
+
+	return 0;
+}
+
+/*
+ * set the video codec preset and tune (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   preset - encoder preset (NULL or empty - codec default)
+ *   tune - encoder tune (NULL or empty - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_preset(int codec_ind, const char *preset, const char *tune)
+{
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(codec_ind);
+	if(!video_defaults)
+		return -1;
+
+	snprintf(video_defaults->preset, sizeof(video_defaults->preset), "%s", preset ? preset : "");
+	snprintf(video_defaults->tune, sizeof(video_defaults->tune), "%s", tune ? tune : "");
+
+	return 0;
+}
+
+/*
+ * set the video codec rate control (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   rc_mode - ENCODER_RC_DEFAULT, ENCODER_RC_CRF, ENCODER_RC_CBR or ENCODER_RC_VBR
+ *   rc_value - crf/qscale (ENCODER_RC_CRF) or bit rate in bps
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_rate_control(int codec_ind, int rc_mode, int rc_value)
+{
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(codec_ind);
+	if(!video_defaults)
+		return -1;
+
+	if(rc_mode != ENCODER_RC_DEFAULT && rc_value <= 0)
+	{
+		fprintf(stderr, "ENCODER: (video rate control) bad value (%i) for mode %i\n", rc_value, rc_mode);
+		return -1;
+	}
+
+	video_defaults->rc_mode = rc_mode;
+	video_defaults->rc_value = rc_value;
+
+	return 0;
+}
+
+/*
+ * set the video codec lookahead cap (takes effect on the next encoder_init)
+ * args:
+ *   codec_ind - codec list index
+ *   frames - max lookahead frames (0 - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_lookahead(int codec_ind, int frames)
+{
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(codec_ind);
+	if(!video_defaults)
+		return -1;
+
+	video_defaults->lookahead = frames > 0 ? frames : 0;
+
+	return 0;
+}
+
+/*
+ * set the video codec speed level (takes effect on the next encoder_init)
+ *   libvpx and libaom cpu-used, SVT-AV1 preset
+ * args:
+ *   codec_ind - codec list index
+ *   speed - speed level (0 - codec default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int encoder_set_video_speed(int codec_ind, int speed)
+{
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(codec_ind);
+	if(!video_defaults)
+		return -1;
+
+	video_defaults->speed = speed;
+
+	return 0;
+}
+
 /*
  * sets the valid flag in the video codecs list
  * args:
@@ -75,6 +75,9 @@ __BEGIN_DECLS
 #define REND_OSD_VUMETER_STEREO (1<<1)
 #define REND_OSD_CROSSHAIR      (1<<2)
 
+/*compiled 3D lut (opaque)*/
+typedef struct _render_lut_t render_lut_t;
+
 typedef int (*render_event_callback)(void *data);
 
 typedef struct _render_events_t
@@ -311,6 +314,239 @@ void render_get_vu_level(float vu_level[2]);
  */
 void render_clean_fx();
 
+/*
+ * load a 3D lut from a .cube file and compile it
+ * args:
+ *   filename - path to the .cube file
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: pointer to the compiled lut (NULL on error)
+ */
+render_lut_t *render_lut_load(const char *filename);
+
+/*
+ * free a lut loaded with render_lut_load
+ * args:
+ *   lut - pointer to lut
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_free(render_lut_t *lut);
+
+/*
+ * set the directory used by render_lut_get
+ * args:
+ *   dir - directory with the <name>.cube files
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_set_dir(const char *dir);
+
+/*
+ * get a named lut (<dir>/<name>.cube), loading it on first use
+ *   luts are kept until render_lut_clean
+ * args:
+ *   name - filter name
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to the compiled lut (NULL if not available)
+ */
+render_lut_t *render_lut_get(const char *name);
+
+/*
+ * clean the lut cache and stop the worker pool
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_clean();
+
+/*
+ * fill a grid with the identity lut nodes
+ *   the grid is a size^3 pixels rgb24 image (red varies fastest),
+ *   it can be passed through any per pixel rgb operation and then
+ *   compiled with render_lut_create_rgb24
+ * args:
+ *   grid - pointer to grid (size^3 * 3 bytes)
+ *   size - grid points per axis (2 to 256)
+ *
+ * asserts:
+ *   grid is not null
+ *
+ * returns: none
+ */
+void render_lut_identity_rgb24(uint8_t *grid, int size);
+
+/*
+ * compile a lut from a grid of output values
+ * args:
+ *   grid - size^3 rgb24 output values for the identity nodes
+ *          (see render_lut_identity_rgb24)
+ *   size - grid points per axis (2 to 256)
+ *
+ * asserts:
+ *   grid is not null
+ *
+ * returns: pointer to the compiled lut (NULL on error)
+ */
+render_lut_t *render_lut_create_rgb24(const uint8_t *grid, int size);
+
+/*
+ * apply a lut to a rgb24 frame (in place)
+ * args:
+ *   lut - pointer to lut
+ *   frame - pointer to rgb24 frame data
+ *   width - frame width
+ *   height - frame height
+ *   stride - line size in bytes (0 - width * 3)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   lut is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_rgb24(const render_lut_t *lut, uint8_t *frame,
+	int width, int height, int stride, int threads);
+
+/*
+ * apply a lut to a yu12 frame (in place)
+ *   the filter is compiled for the yuv domain, so no rgb
+ *   conversion is needed
+ * args:
+ *   lut - pointer to lut
+ *   frame - pointer to yu12 frame data
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   lut is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_yu12(const render_lut_t *lut, uint8_t *frame,
+	int width, int height, int threads);
+
+/*
+ * process a yu12 frame in a single pass: horizontal mirror, lut and
+ *   output to yu12 and/or rgb24, row strips run on the worker pool
+ * args:
+ *   lut - pointer to lut (NULL - no color change)
+ *   in - pointer to yu12 input frame
+ *   out_yuv - pointer to yu12 output frame (NULL - none, may be in if not mirrored)
+ *   out_rgb - pointer to rgb24 output frame (NULL - none)
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   mirror - horizontal mirror (0 - no, 1 - yes)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   in is not null
+ *   in and out_yuv are different if mirror is set
+ *
+ * returns: none
+ */
+void render_lut_process_yu12(const render_lut_t *lut, const uint8_t *in,
+	uint8_t *out_yuv, uint8_t *out_rgb, int width, int height, int mirror, int threads);
+
+/*
+ * render a strip of filtered thumbnails in a single pass
+ *   every source pixel is read once and written, through each lut,
+ *   to its tile of the atlas (tile i starts at column i * width)
+ * args:
+ *   luts - array of n luts (NULL entries copy the source)
+ *   n - number of tiles
+ *   src - pointer to rgb24 source (tile sized)
+ *   width - source width
+ *   height - source height
+ *   src_stride - source line size in bytes (0 - width * 3)
+ *   atlas - pointer to rgb24 atlas (n * width x height)
+ *   atlas_stride - atlas line size in bytes (0 - n * width * 3)
+ *
+ * asserts:
+ *   luts is not null
+ *   src is not null
+ *   atlas is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_atlas(render_lut_t *const *luts, int n, const uint8_t *src,
+	int width, int height, int src_stride, uint8_t *atlas, int atlas_stride);
+
+/*
+ * mirror (horizontal flip) a plane - simd byte reversal
+ * args:
+ *   dst - pointer to destination plane (can be src for in place)
+ *   src - pointer to source plane
+ *   width - plane width in pixels
+ *   height - plane height
+ *   bpp - bytes per pixel (1 to 4)
+ *   src_stride - source line size in bytes (0 - width * bpp)
+ *   dst_stride - destination line size in bytes (0 - width * bpp)
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_mirror_plane(uint8_t *dst, const uint8_t *src, int width, int height,
+	int bpp, int src_stride, int dst_stride);
+
+/*
+ * upturn (vertical flip) a plane
+ * args:
+ *   dst - pointer to destination plane (can be src for in place)
+ *   src - pointer to source plane
+ *   line_size - bytes to copy per line
+ *   height - plane height
+ *   src_stride - source line size in bytes (0 - line_size)
+ *   dst_stride - destination line size in bytes (0 - line_size)
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_flip_plane(uint8_t *dst, const uint8_t *src, int line_size, int height,
+	int src_stride, int dst_stride);
+
+/*
+ * mirror and/or upturn a yu12 frame
+ *   (mirror + upturn = 180 degree rotation)
+ * args:
+ *   dst - pointer to destination frame (can be src for in place)
+ *   src - pointer to source frame
+ *   width - frame width
+ *   height - frame height
+ *   mask - REND_FX_YUV_MIRROR and/or REND_FX_YUV_UPTURN
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_yu12_transform(uint8_t *dst, const uint8_t *src, int width, int height, uint32_t mask);
+
 /*
  * clean render data
  * args:
@@ -7,6 +7,8 @@ HEADERS += \
 
 SOURCES += \
     $$PWD/render_fx.c \
+    $$PWD/render_lut.c \
+    $$PWD/render_mirror.c \
     $$PWD/render_osd_crosshair.c \
     $$PWD/render_osd_vu_meter.c \
     $$PWD/render_sdl2.c
@@ -88,52 +88,7 @@ static void fx_yu12_mirror (uint8_t *frame, int width, int height)
 	/*asserts*/
 	assert(frame != NULL);
 
-	int h=0;
-	int w=0;
-//LMH消除警告
-//    int y_sizeline = width;
-//    int c_sizeline = width/2;
-
-	uint8_t *end = NULL;
-	uint8_t *end2 = NULL;
-
-	uint8_t *py = frame;
-	uint8_t *pu = frame + (width * height);
-	uint8_t *pv = pu + ((width * height) / 4);
-
-	uint8_t pixel =0;
-	uint8_t pixel2=0;
-
-	/*mirror y*/
-	for(h = 0; h < height; h++)
-	{
-		py = frame + (h * width);
-		end = py + width - 1;
-		for(w = 0; w < width/2; w++)
-		{
-			pixel = *py;
-			*py++ = *end;
-			*end-- = pixel;
-		}
-	}
-
-	/*mirror u v*/
-	for(h = 0; h < height; h+=2)
-	{
-		pu = frame + (width * height) + ((h * width) / 4);
-		pv = pu + ((width * height) / 4);
-		end  = pu + (width / 2) - 1;
-		end2 = pv + (width / 2) -1;
-		for(w = 0; w < width/2; w+=2)
-		{
-			pixel  = *pu;
-			pixel2 = *pv;
-			*pu++ = *end;
-			*pv++ = *end2;
-			*end-- = pixel;
-			*end2-- = pixel2;
-		}
-	}
+	render_yu12_transform(frame, frame, width, height, REND_FX_YUV_MIRROR);
 }
 
 /*
@@ -234,51 +189,7 @@ static void fx_yu12_upturn(uint8_t *frame, int width, int height)
 	/*asserts*/
 	assert(frame != NULL);
 
-	int h = 0;
-
-	uint8_t line[width]; /*line1 buffer*/
-
-	uint8_t *pi = frame; //begin of first y line
-	uint8_t *pf = pi + (width * (height - 1)); //begin of last y line
-
-	/*upturn y*/
-	for ( h = 0; h < height / 2; ++h)
-	{	/*line iterator*/
-        memcpy(line, pi,(size_t) width);
-        memcpy(pi, pf, (size_t)width);
-        memcpy(pf, line, (size_t)width);
-
-		pi+=width;
-		pf-=width;
-
-	}
-
-	/*upturn u*/
-	pi = frame + (width * height); //begin of first u line
-	pf = pi + ((width * height) / 4) - (width / 2); //begin of last u line
-	for ( h = 0; h < height / 2; h += 2) //every two lines = height / 4
-	{	/*line iterator*/
-        memcpy(line, pi, (size_t)width / 2);
-        memcpy(pi, pf, (size_t)width / 2);
-        memcpy(pf, line,(size_t) width / 2);
-
-		pi+=width/2;
-		pf-=width/2;
-	}
-
-	/*upturn v*/
-	pi = frame + ((width * height * 5) / 4); //begin of first v line
-	pf = pi + ((width * height) / 4) - (width / 2); //begin of last v line
-	for ( h = 0; h < height / 2; h += 2) //every two lines = height / 4
-	{	/*line iterator*/
-        memcpy(line, pi, (size_t)width / 2);
-        memcpy(pi, pf, (size_t)width / 2);
-        memcpy(pf, line, (size_t)width / 2);
-
-		pi+=width/2;
-		pf-=width/2;
-	}
-
+	render_yu12_transform(frame, frame, width, height, REND_FX_YUV_UPTURN);
 }
 
 /*
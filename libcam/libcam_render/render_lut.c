@@ -0,0 +1,1265 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Render library - 3D LUT (.cube) color filters                                #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "gviewrender.h"
+#include "gview.h"
+
+extern int verbosity;
+
+/*maximum grid points per axis*/
+#define LUT_MAX_SIZE      256
+/*maximum number of cached filters*/
+#define LUT_MAX_CACHED    32
+/*minimum frame size (in pixels) for splitting the work in row strips*/
+#define LUT_MT_MIN_PIXELS (1280 * 720)
+/*maximum number of row strips (threads)*/
+#define LUT_MAX_THREADS   8
+/*fixed point precision of the table nodes*/
+#define LUT_NODE_SHIFT    7
+
+/*
+ * compiled 3D lut
+ *   all tables have size^3 nodes of 4 int16 (x, y, z, pad) in Q7,
+ *   first axis varies fastest, aligned to the cache line size
+ */
+struct _render_lut_t
+{
+	int size;            //grid points per axis
+	int16_t *rgb;        //rgb -> rgb table
+	int16_t *yuv;        //yu12 -> yu12 table (same filter in the yuv domain)
+	int16_t *yuv2rgb;    //yu12 -> rgb table (filter fused with the color conversion)
+	int32_t ofs[3][256]; //node offset (in int16 units) of each 8 bit input per axis
+	int16_t frac[256];   //interpolation weight (Q8) of each 8 bit input
+};
+
+typedef struct _lut_cache_t
+{
+	char name[64];
+	render_lut_t *lut; //NULL if the file failed to load
+} lut_cache_t;
+
+static char *lut_dir = NULL;
+static lut_cache_t lut_cache[LUT_MAX_CACHED];
+static int lut_cached = 0;
+static __MUTEX_TYPE lut_mutex = __STATIC_MUTEX_INIT;
+
+typedef struct _lut_strip_t
+{
+	const render_lut_t *lut;
+	const uint8_t *in;   //input frame (rgb24 or yu12)
+	uint8_t *out_yuv;    //yu12 output (may be the input frame)
+	uint8_t *out_rgb;    //rgb24 output (may be the input frame)
+	int width;
+	int height;
+	int stride;          //rgb24 line size
+	int yu12;            //input is yu12
+	int mirror;          //horizontal mirror (yu12 input)
+	int row_start;
+	int row_end;
+} lut_strip_t;
+
+/*worker job: process job number index of the batch*/
+typedef void (*lut_job_t)(void *data, int index);
+
+/*
+ * persistent worker pool: threads are started on first use and wait
+ *   for batches of jobs, the calling thread also takes jobs
+ */
+typedef struct _lut_pool_t
+{
+	__THREAD_TYPE threads[LUT_MAX_THREADS];
+	int nthreads;        //started worker threads
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_work;
+	__COND_TYPE cond_done;
+	lut_job_t job;
+	void *data;
+	int njobs;
+	int next;            //next job to run
+	int running;         //jobs not finished yet
+	int quit;
+} lut_pool_t;
+
+static lut_pool_t lut_pool =
+{
+	.mutex = __STATIC_MUTEX_INIT,
+	.cond_work = PTHREAD_COND_INITIALIZER,
+	.cond_done = PTHREAD_COND_INITIALIZER
+};
+/*only one batch runs in the pool at a time*/
+static __MUTEX_TYPE lut_pool_batch = __STATIC_MUTEX_INIT;
+
+/*
+ * parse a float in C locale notation (the application locale may
+ *   use a different decimal separator)
+ * args:
+ *   p - pointer to string pointer (advanced past the number)
+ *   value - pointer to store the parsed value
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 on success, -1 if no number was found
+ */
+static int parse_float(const char **p, float *value)
+{
+	const char *s = *p;
+	double v = 0;
+	double sign = 1;
+	int digits = 0;
+
+	while(*s == ' ' || *s == '\t')
+		s++;
+
+	if(*s == '-' || *s == '+')
+	{
+		if(*s == '-')
+			sign = -1;
+		s++;
+	}
+
+	while(*s >= '0' && *s <= '9')
+	{
+		v = v * 10 + (*s++ - '0');
+		digits++;
+	}
+
+	if(*s == '.')
+	{
+		double scale = 0.1;
+		s++;
+		while(*s >= '0' && *s <= '9')
+		{
+			v += (*s++ - '0') * scale;
+			scale *= 0.1;
+			digits++;
+		}
+	}
+
+	if(!digits)
+		return -1;
+
+	if(*s == 'e' || *s == 'E')
+	{
+		int esign = 1;
+		int e = 0;
+		s++;
+		if(*s == '-' || *s == '+')
+		{
+			if(*s == '-')
+				esign = -1;
+			s++;
+		}
+		while(*s >= '0' && *s <= '9')
+			e = e * 10 + (*s++ - '0');
+		while(e-- > 0)
+			v = (esign > 0) ? v * 10 : v / 10;
+	}
+
+	*value = (float) (sign * v);
+	*p = s;
+	return 0;
+}
+
+/*
+ * tetrahedral interpolation on the source (float) cube
+ * args:
+ *   cube - source table (size^3 rgb triplets, red varies fastest)
+ *   size - grid points per axis
+ *   x - input coordinates in grid units
+ *   out - interpolated rgb triplet
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void cube_sample(const float *cube, int size, const float x[3], float out[3])
+{
+	int i[3];
+	float f[3];
+	int stride[3] = {1, size, size * size};
+	int c = 0;
+
+	for(c = 0; c < 3; c++)
+	{
+		float v = x[c];
+		if(v < 0)
+			v = 0;
+		if(v > size - 1)
+			v = (float) (size - 1);
+		i[c] = (int) v;
+		if(i[c] > size - 2)
+			i[c] = size - 2;
+		f[c] = v - i[c];
+	}
+
+	/*sort the axes by weight*/
+	int a0 = 0, a1 = 1, a2 = 2, t = 0;
+	if(f[a0] < f[a1]) { t = a0; a0 = a1; a1 = t; }
+	if(f[a1] < f[a2]) { t = a1; a1 = a2; a2 = t; }
+	if(f[a0] < f[a1]) { t = a0; a0 = a1; a1 = t; }
+
+	int n0 = i[0] + i[1] * stride[1] + i[2] * stride[2];
+	int n1 = n0 + stride[a0];
+	int n2 = n1 + stride[a1];
+	int n3 = n2 + stride[a2];
+
+	for(c = 0; c < 3; c++)
+		out[c] = cube[n0 * 3 + c] * (1 - f[a0]) +
+			cube[n1 * 3 + c] * (f[a0] - f[a1]) +
+			cube[n2 * 3 + c] * (f[a1] - f[a2]) +
+			cube[n3 * 3 + c] * f[a2];
+}
+
+static int16_t to_node(float v)
+{
+	if(v < 0)
+		v = 0;
+	if(v > 255)
+		v = 255;
+	return (int16_t) (v * (1 << LUT_NODE_SHIFT) + 0.5f);
+}
+
+/*
+ * compile the 8 bit rgb and yu12 tables from the source cube
+ * args:
+ *   lut - pointer to lut (size and tables already allocated)
+ *   cube - source table
+ *   dmin - input domain min
+ *   dmax - input domain max
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void compile_lut(render_lut_t *lut, const float *cube, const float dmin[3], const float dmax[3])
+{
+	int n = lut->size;
+	int x = 0, y = 0, z = 0, c = 0;
+	float scale = 255.0f / (n - 1);
+
+	for(z = 0; z < n; z++)
+		for(y = 0; y < n; y++)
+			for(x = 0; x < n; x++)
+			{
+				int16_t *prgb = lut->rgb + 4 * (x + y * n + z * n * n);
+				int16_t *pyuv = lut->yuv + 4 * (x + y * n + z * n * n);
+				int16_t *pyuv2rgb = lut->yuv2rgb + 4 * (x + y * n + z * n * n);
+				float in[3] = {x * scale, y * scale, z * scale};
+				float pos[3];
+				float out[3];
+
+				/*rgb -> rgb*/
+				for(c = 0; c < 3; c++)
+					pos[c] = (in[c] / 255.0f - dmin[c]) / (dmax[c] - dmin[c]) * (n - 1);
+				cube_sample(cube, n, pos, out);
+				for(c = 0; c < 3; c++)
+					prgb[c] = to_node(out[c] * 255.0f);
+				prgb[3] = 0;
+
+				/*yuv -> yuv: jpeg (full range bt.601) conversion around the filter*/
+				float yv = in[0];
+				float u = in[1] - 128.0f;
+				float v = in[2] - 128.0f;
+				float rgb[3] =
+				{
+					yv + 1.402f * v,
+					yv - 0.34414f * u - 0.71414f * v,
+					yv + 1.772f * u
+				};
+				for(c = 0; c < 3; c++)
+				{
+					if(rgb[c] < 0)
+						rgb[c] = 0;
+					if(rgb[c] > 255)
+						rgb[c] = 255;
+					pos[c] = (rgb[c] / 255.0f - dmin[c]) / (dmax[c] - dmin[c]) * (n - 1);
+				}
+				cube_sample(cube, n, pos, out);
+				for(c = 0; c < 3; c++)
+				{
+					out[c] *= 255.0f;
+					if(out[c] < 0)
+						out[c] = 0;
+					if(out[c] > 255)
+						out[c] = 255;
+					pyuv2rgb[c] = to_node(out[c]);
+				}
+				pyuv2rgb[3] = 0;
+				pyuv[0] = to_node(0.299f * out[0] + 0.587f * out[1] + 0.114f * out[2]);
+				pyuv[1] = to_node(-0.168736f * out[0] - 0.331264f * out[1] + 0.5f * out[2] + 128.0f);
+				pyuv[2] = to_node(0.5f * out[0] - 0.418688f * out[1] - 0.081312f * out[2] + 128.0f);
+				pyuv[3] = 0;
+			}
+
+	/*8 bit input -> node offset and weight*/
+	int v = 0;
+	for(v = 0; v < 256; v++)
+	{
+		int p = (v * (n - 1) * 256 + 127) / 255;
+		int i = p >> 8;
+		int f = p & 0xff;
+		if(i > n - 2)
+		{
+			i = n - 2;
+			f = 256;
+		}
+		lut->ofs[0][v] = 4 * i;
+		lut->ofs[1][v] = 4 * i * n;
+		lut->ofs[2][v] = 4 * i * n * n;
+		lut->frac[v] = (int16_t) f;
+	}
+}
+
+/*
+ * allocate and compile a lut
+ * args:
+ *   cube - source table (size^3 rgb triplets, red varies fastest)
+ *   size - grid points per axis
+ *   dmin - input domain min
+ *   dmax - input domain max
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to the new lut
+ */
+static render_lut_t *new_lut(const float *cube, int size, const float dmin[3], const float dmax[3])
+{
+	render_lut_t *lut = NULL;
+	size_t table_size = (size_t) size * size * size * 4 * sizeof(int16_t);
+	if(posix_memalign((void **) &lut, 64, sizeof(render_lut_t)) ||
+		posix_memalign((void **) &lut->rgb, 64, table_size) ||
+		posix_memalign((void **) &lut->yuv, 64, table_size) ||
+		posix_memalign((void **) &lut->yuv2rgb, 64, table_size))
+	{
+		fprintf(stderr, "RENDER: FATAL memory allocation failure (new_lut): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	lut->size = size;
+	compile_lut(lut, cube, dmin, dmax);
+
+	return lut;
+}
+
+/*
+ * load a 3D lut from a .cube file and compile it
+ * args:
+ *   filename - path to the .cube file
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: pointer to the compiled lut (NULL on error)
+ */
+render_lut_t *render_lut_load(const char *filename)
+{
+	/*assertions*/
+	assert(filename != NULL);
+
+	FILE *fp = fopen(filename, "r");
+	if(fp == NULL)
+	{
+		if(verbosity > 0)
+			fprintf(stderr, "RENDER: (lut) couldn't open %s: %s\n", filename, strerror(errno));
+		return NULL;
+	}
+
+	char line[256];
+	int size = 0;
+	int count = 0;
+	int err = 0;
+	float *cube = NULL;
+	float dmin[3] = {0, 0, 0};
+	float dmax[3] = {1, 1, 1};
+
+	while(!err && fgets(line, sizeof(line), fp) != NULL)
+	{
+		const char *p = line;
+		while(*p == ' ' || *p == '\t')
+			p++;
+
+		if(*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+			continue;
+
+		if(strncmp(p, "TITLE", 5) == 0)
+			continue;
+		else if(strncmp(p, "LUT_3D_SIZE", 11) == 0)
+		{
+			size = atoi(p + 11);
+			if(size < 2 || size > LUT_MAX_SIZE || cube != NULL)
+				err = 1;
+			else
+			{
+				cube = calloc((size_t) size * size * size * 3, sizeof(float));
+				if(cube == NULL)
+				{
+					fprintf(stderr, "RENDER: FATAL memory allocation failure (render_lut_load): %s\n", strerror(errno));
+					exit(-1);
+				}
+			}
+		}
+		else if(strncmp(p, "DOMAIN_MIN", 10) == 0 || strncmp(p, "DOMAIN_MAX", 10) == 0)
+		{
+			float *d = (p[8] == 'I') ? dmin : dmax;
+			p += 10;
+			if(parse_float(&p, &d[0]) || parse_float(&p, &d[1]) || parse_float(&p, &d[2]))
+				err = 1;
+		}
+		else if(strncmp(p, "LUT_3D_INPUT_RANGE", 18) == 0)
+		{
+			float lo = 0, hi = 1;
+			p += 18;
+			if(parse_float(&p, &lo) || parse_float(&p, &hi))
+				err = 1;
+			dmin[0] = dmin[1] = dmin[2] = lo;
+			dmax[0] = dmax[1] = dmax[2] = hi;
+		}
+		else if((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.')
+		{
+			float *pc = cube + 3 * count;
+			if(cube == NULL || count >= size * size * size ||
+				parse_float(&p, &pc[0]) || parse_float(&p, &pc[1]) || parse_float(&p, &pc[2]))
+				err = 1;
+			else
+				count++;
+		}
+		else
+		{
+			/*LUT_1D_SIZE and any other unknown keyword*/
+			if(verbosity > 0)
+				fprintf(stderr, "RENDER: (lut) unsupported line in %s: %s", filename, line);
+			err = 1;
+		}
+	}
+
+	fclose(fp);
+
+	if(!err && (cube == NULL || count != size * size * size))
+		err = 1;
+	int c = 0;
+	for(c = 0; c < 3 && !err; c++)
+		if(dmax[c] <= dmin[c])
+			err = 1;
+
+	if(err)
+	{
+		fprintf(stderr, "RENDER: (lut) invalid cube file %s\n", filename);
+		free(cube);
+		return NULL;
+	}
+
+	render_lut_t *lut = new_lut(cube, size, dmin, dmax);
+	free(cube);
+
+	if(verbosity > 0)
+		printf("RENDER: (lut) loaded %s (%i^3)\n", filename, size);
+
+	return lut;
+}
+
+/*
+ * fill a grid with the identity lut nodes
+ *   the grid is a size^3 pixels rgb24 image (red varies fastest),
+ *   it can be passed through any per pixel rgb operation and then
+ *   compiled with render_lut_create_rgb24
+ * args:
+ *   grid - pointer to grid (size^3 * 3 bytes)
+ *   size - grid points per axis (2 to 256)
+ *
+ * asserts:
+ *   grid is not null
+ *
+ * returns: none
+ */
+void render_lut_identity_rgb24(uint8_t *grid, int size)
+{
+	/*assertions*/
+	assert(grid != NULL);
+
+	int x = 0, y = 0, z = 0;
+	for(z = 0; z < size; z++)
+		for(y = 0; y < size; y++)
+			for(x = 0; x < size; x++)
+			{
+				*grid++ = (uint8_t) ((x * 255 + (size - 1) / 2) / (size - 1));
+				*grid++ = (uint8_t) ((y * 255 + (size - 1) / 2) / (size - 1));
+				*grid++ = (uint8_t) ((z * 255 + (size - 1) / 2) / (size - 1));
+			}
+}
+
+/*
+ * compile a lut from a grid of output values
+ * args:
+ *   grid - size^3 rgb24 output values for the identity nodes
+ *          (see render_lut_identity_rgb24)
+ *   size - grid points per axis (2 to 256)
+ *
+ * asserts:
+ *   grid is not null
+ *
+ * returns: pointer to the compiled lut (NULL on error)
+ */
+render_lut_t *render_lut_create_rgb24(const uint8_t *grid, int size)
+{
+	/*assertions*/
+	assert(grid != NULL);
+
+	if(size < 2 || size > LUT_MAX_SIZE)
+		return NULL;
+
+	size_t i = 0;
+	size_t count = (size_t) size * size * size * 3;
+	float dmin[3] = {0, 0, 0};
+	float dmax[3] = {1, 1, 1};
+	float *cube = malloc(count * sizeof(float));
+	if(cube == NULL)
+	{
+		fprintf(stderr, "RENDER: FATAL memory allocation failure (render_lut_create_rgb24): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	for(i = 0; i < count; i++)
+		cube[i] = grid[i] / 255.0f;
+
+	render_lut_t *lut = new_lut(cube, size, dmin, dmax);
+	free(cube);
+
+	return lut;
+}
+
+/*
+ * free a lut loaded with render_lut_load
+ * args:
+ *   lut - pointer to lut
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_free(render_lut_t *lut)
+{
+	if(lut == NULL)
+		return;
+
+	free(lut->rgb);
+	free(lut->yuv);
+	free(lut->yuv2rgb);
+	free(lut);
+}
+
+/*
+ * set the directory used by render_lut_get
+ * args:
+ *   dir - directory with the <name>.cube files
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_set_dir(const char *dir)
+{
+	__LOCK_MUTEX(&lut_mutex);
+	free(lut_dir);
+	lut_dir = (dir != NULL) ? strdup(dir) : NULL;
+	__UNLOCK_MUTEX(&lut_mutex);
+}
+
+/*
+ * get a named lut (<dir>/<name>.cube), loading it on first use
+ *   luts are kept until render_lut_clean
+ * args:
+ *   name - filter name
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to the compiled lut (NULL if not available)
+ */
+render_lut_t *render_lut_get(const char *name)
+{
+	if(name == NULL || name[0] == '\0')
+		return NULL;
+
+	render_lut_t *lut = NULL;
+	int i = 0;
+
+	__LOCK_MUTEX(&lut_mutex);
+
+	for(i = 0; i < lut_cached; i++)
+	{
+		if(strcmp(lut_cache[i].name, name) == 0)
+		{
+			lut = lut_cache[i].lut;
+			__UNLOCK_MUTEX(&lut_mutex);
+			return lut;
+		}
+	}
+
+	if(lut_dir != NULL && lut_cached < LUT_MAX_CACHED &&
+		strlen(name) < sizeof(lut_cache[0].name))
+	{
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s/%s.cube", lut_dir, name);
+		lut = render_lut_load(filename);
+
+		/*failures are cached too, so the file is only tried once*/
+		strcpy(lut_cache[lut_cached].name, name);
+		lut_cache[lut_cached].lut = lut;
+		lut_cached++;
+	}
+
+	__UNLOCK_MUTEX(&lut_mutex);
+
+	return lut;
+}
+
+/*
+ * clean the lut cache and stop the worker pool
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void render_lut_clean()
+{
+	int i = 0;
+
+	__LOCK_MUTEX(&lut_mutex);
+	for(i = 0; i < lut_cached; i++)
+		render_lut_free(lut_cache[i].lut);
+	lut_cached = 0;
+	free(lut_dir);
+	lut_dir = NULL;
+	__UNLOCK_MUTEX(&lut_mutex);
+
+	/*stop the worker pool*/
+	__LOCK_MUTEX(&lut_pool_batch);
+	__LOCK_MUTEX(&lut_pool.mutex);
+	lut_pool.quit = 1;
+	__COND_BCAST(&lut_pool.cond_work);
+	__UNLOCK_MUTEX(&lut_pool.mutex);
+
+	for(i = 0; i < lut_pool.nthreads; i++)
+		__THREAD_JOIN(lut_pool.threads[i]);
+
+	lut_pool.nthreads = 0;
+	lut_pool.quit = 0;
+	__UNLOCK_MUTEX(&lut_pool_batch);
+}
+
+/*
+ * tetrahedral interpolation of one 8 bit triplet
+ * args:
+ *   lut - pointer to lut
+ *   table - compiled table (rgb or yuv)
+ *   a, b, c - input values (first, second and third axis)
+ *   out - output triplet
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static inline void lut_pixel(const render_lut_t *lut, const int16_t *table,
+	int a, int b, int c, uint8_t out[3])
+{
+	int f0 = lut->frac[a];
+	int f1 = lut->frac[b];
+	int f2 = lut->frac[c];
+	int s0 = 4;
+	int s1 = 4 * lut->size;
+	int s2 = s1 * lut->size;
+
+	const int16_t *n0 = table + lut->ofs[0][a] + lut->ofs[1][b] + lut->ofs[2][c];
+
+	/*order the axes by weight: n0 -> n1 -> n2 -> n3 walks the tetrahedron*/
+	int fmax, fmid, fmin, smax, smid;
+	if(f0 >= f1)
+	{
+		if(f1 >= f2)      { fmax = f0; fmid = f1; fmin = f2; smax = s0; smid = s1; }
+		else if(f0 >= f2) { fmax = f0; fmid = f2; fmin = f1; smax = s0; smid = s2; }
+		else              { fmax = f2; fmid = f0; fmin = f1; smax = s2; smid = s0; }
+	}
+	else
+	{
+		if(f0 >= f2)      { fmax = f1; fmid = f0; fmin = f2; smax = s1; smid = s0; }
+		else if(f1 >= f2) { fmax = f1; fmid = f2; fmin = f0; smax = s1; smid = s2; }
+		else              { fmax = f2; fmid = f1; fmin = f0; smax = s2; smid = s1; }
+	}
+
+	const int16_t *n1 = n0 + smax;
+	const int16_t *n2 = n1 + smid;
+	const int16_t *n3 = n0 + s0 + s1 + s2;
+	int w0 = 256 - fmax;
+	int w1 = fmax - fmid;
+	int w2 = fmid - fmin;
+	int w3 = fmin;
+
+#if defined(__SSE2__)
+	__m128i a01 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) n0),
+		_mm_loadl_epi64((const __m128i *) n1));
+	__m128i a23 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) n2),
+		_mm_loadl_epi64((const __m128i *) n3));
+	__m128i sum = _mm_add_epi32(
+		_mm_madd_epi16(a01, _mm_set1_epi32((w1 << 16) | w0)),
+		_mm_madd_epi16(a23, _mm_set1_epi32((w3 << 16) | w2)));
+	sum = _mm_srai_epi32(_mm_add_epi32(sum,
+		_mm_set1_epi32(1 << (LUT_NODE_SHIFT + 7))), LUT_NODE_SHIFT + 8);
+	sum = _mm_packs_epi32(sum, sum);
+	uint32_t px = (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+	out[0] = (uint8_t) px;
+	out[1] = (uint8_t) (px >> 8);
+	out[2] = (uint8_t) (px >> 16);
+#else
+	int i = 0;
+	for(i = 0; i < 3; i++)
+	{
+		int v = (n0[i] * w0 + n1[i] * w1 + n2[i] * w2 + n3[i] * w3 +
+			(1 << (LUT_NODE_SHIFT + 7))) >> (LUT_NODE_SHIFT + 8);
+		out[i] = (uint8_t) ((v > 255) ? 255 : v);
+	}
+#endif
+}
+
+
+/*
+ * worker pool thread
+ * args:
+ *   data - not used
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *lut_pool_thread(void *data)
+{
+	(void) data;
+
+	__LOCK_MUTEX(&lut_pool.mutex);
+	while(!lut_pool.quit)
+	{
+		if(lut_pool.next < lut_pool.njobs)
+		{
+			int index = lut_pool.next++;
+			__UNLOCK_MUTEX(&lut_pool.mutex);
+
+			lut_pool.job(lut_pool.data, index);
+
+			__LOCK_MUTEX(&lut_pool.mutex);
+			lut_pool.running--;
+			if(lut_pool.running == 0)
+				__COND_BCAST(&lut_pool.cond_done);
+		}
+		else
+			pthread_cond_wait(&lut_pool.cond_work, &lut_pool.mutex);
+	}
+	__UNLOCK_MUTEX(&lut_pool.mutex);
+
+	return NULL;
+}
+
+/*
+ * run a batch of jobs on the worker pool and wait for it to finish
+ * args:
+ *   job - job function
+ *   data - job data
+ *   njobs - number of jobs in the batch
+ *   nthreads - number of threads to use (including the caller)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void lut_pool_run(lut_job_t job, void *data, int njobs, int nthreads)
+{
+	int index = 0;
+
+	if(njobs <= 1 || nthreads <= 1)
+	{
+		for(index = 0; index < njobs; index++)
+			job(data, index);
+		return;
+	}
+
+	__LOCK_MUTEX(&lut_pool_batch);
+	__LOCK_MUTEX(&lut_pool.mutex);
+
+	/*start the missing workers (the caller is one of the threads)*/
+	while(lut_pool.nthreads < nthreads - 1)
+	{
+		if(__THREAD_CREATE(&lut_pool.threads[lut_pool.nthreads], lut_pool_thread, NULL))
+		{
+			if(verbosity > 0)
+				fprintf(stderr, "RENDER: (lut) couldn't start pool thread - using %i threads\n",
+					lut_pool.nthreads + 1);
+			break;
+		}
+		lut_pool.nthreads++;
+	}
+
+	lut_pool.job = job;
+	lut_pool.data = data;
+	lut_pool.njobs = njobs;
+	lut_pool.next = 0;
+	lut_pool.running = njobs;
+	__COND_BCAST(&lut_pool.cond_work);
+
+	while(lut_pool.next < lut_pool.njobs)
+	{
+		index = lut_pool.next++;
+		__UNLOCK_MUTEX(&lut_pool.mutex);
+
+		job(data, index);
+
+		__LOCK_MUTEX(&lut_pool.mutex);
+		lut_pool.running--;
+	}
+
+	while(lut_pool.running > 0)
+		pthread_cond_wait(&lut_pool.cond_done, &lut_pool.mutex);
+
+	lut_pool.njobs = 0;
+	lut_pool.next = 0;
+
+	__UNLOCK_MUTEX(&lut_pool.mutex);
+	__UNLOCK_MUTEX(&lut_pool_batch);
+}
+
+/*
+ * apply the lut to a range of rgb24 rows (in place)
+ * args:
+ *   strip - pointer to strip data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void rgb_rows(lut_strip_t *strip)
+{
+	const render_lut_t *lut = strip->lut;
+	int h = 0, w = 0;
+
+	for(h = strip->row_start; h < strip->row_end; h++)
+	{
+		uint8_t *p = strip->out_rgb + (size_t) h * strip->stride;
+		for(w = 0; w < strip->width; w++, p += 3)
+			lut_pixel(lut, lut->rgb, p[0], p[1], p[2], p);
+	}
+}
+
+/*
+ * convert one yuv pixel to rgb (jpeg full range bt.601, Q16)
+ * args:
+ *   y, u, v - pixel values
+ *   out - rgb output
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static inline void yuv_pixel_to_rgb(int y, int u, int v, uint8_t *out)
+{
+	u -= 128;
+	v -= 128;
+
+	int r = y + ((91881 * v + 32768) >> 16);
+	int g = y - ((22554 * u + 46802 * v + 32768) >> 16);
+	int b = y + ((116130 * u + 32768) >> 16);
+
+	out[0] = (uint8_t) ((r < 0) ? 0 : ((r > 255) ? 255 : r));
+	out[1] = (uint8_t) ((g < 0) ? 0 : ((g > 255) ? 255 : g));
+	out[2] = (uint8_t) ((b < 0) ? 0 : ((b > 255) ? 255 : b));
+}
+
+/*
+ * process a range of yu12 row pairs: mirror, lut and output
+ *   conversion in a single pass over the input
+ *   each 2x2 block shares its chroma - luma per pixel, chroma averaged
+ * args:
+ *   strip - pointer to strip data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void yu12_rows(lut_strip_t *strip)
+{
+	const render_lut_t *lut = strip->lut;
+	int width = strip->width;
+	int height = strip->height;
+	int cwidth = width / 2;
+	int h = 0, w = 0, i = 0;
+
+	const uint8_t *in_u = strip->in + width * height;
+	const uint8_t *in_v = in_u + cwidth * (height / 2);
+	uint8_t *out_u = strip->out_yuv ? strip->out_yuv + width * height : NULL;
+	uint8_t *out_v = strip->out_yuv ? out_u + cwidth * (height / 2) : NULL;
+
+	for(h = strip->row_start; h < strip->row_end; h += 2)
+	{
+		const uint8_t *py1 = strip->in + (size_t) h * width;
+		const uint8_t *py2 = py1 + width;
+		const uint8_t *pu = in_u + (size_t) (h / 2) * cwidth;
+		const uint8_t *pv = in_v + (size_t) (h / 2) * cwidth;
+
+		for(w = 0; w < width; w += 2)
+		{
+			int y[4];
+			int sx = w;
+
+			if(strip->mirror)
+			{
+				sx = width - 2 - w;
+				y[0] = py1[sx + 1];
+				y[1] = py1[sx];
+				y[2] = py2[sx + 1];
+				y[3] = py2[sx];
+			}
+			else
+			{
+				y[0] = py1[sx];
+				y[1] = py1[sx + 1];
+				y[2] = py2[sx];
+				y[3] = py2[sx + 1];
+			}
+
+			int u = pu[sx / 2];
+			int v = pv[sx / 2];
+
+			if(strip->out_yuv)
+			{
+				uint8_t *oy1 = strip->out_yuv + (size_t) h * width + w;
+				uint8_t *oy2 = oy1 + width;
+				size_t co = (size_t) (h / 2) * cwidth + w / 2;
+
+				if(lut)
+				{
+					uint8_t o[4][3];
+					for(i = 0; i < 4; i++)
+						lut_pixel(lut, lut->yuv, y[i], u, v, o[i]);
+
+					oy1[0] = o[0][0];
+					oy1[1] = o[1][0];
+					oy2[0] = o[2][0];
+					oy2[1] = o[3][0];
+					out_u[co] = (uint8_t) ((o[0][1] + o[1][1] + o[2][1] + o[3][1] + 2) >> 2);
+					out_v[co] = (uint8_t) ((o[0][2] + o[1][2] + o[2][2] + o[3][2] + 2) >> 2);
+				}
+				else
+				{
+					oy1[0] = (uint8_t) y[0];
+					oy1[1] = (uint8_t) y[1];
+					oy2[0] = (uint8_t) y[2];
+					oy2[1] = (uint8_t) y[3];
+					out_u[co] = (uint8_t) u;
+					out_v[co] = (uint8_t) v;
+				}
+			}
+
+			if(strip->out_rgb)
+			{
+				uint8_t *o1 = strip->out_rgb + ((size_t) h * width + w) * 3;
+				uint8_t *o2 = o1 + width * 3;
+
+				if(lut)
+				{
+					lut_pixel(lut, lut->yuv2rgb, y[0], u, v, o1);
+					lut_pixel(lut, lut->yuv2rgb, y[1], u, v, o1 + 3);
+					lut_pixel(lut, lut->yuv2rgb, y[2], u, v, o2);
+					lut_pixel(lut, lut->yuv2rgb, y[3], u, v, o2 + 3);
+				}
+				else
+				{
+					yuv_pixel_to_rgb(y[0], u, v, o1);
+					yuv_pixel_to_rgb(y[1], u, v, o1 + 3);
+					yuv_pixel_to_rgb(y[2], u, v, o2);
+					yuv_pixel_to_rgb(y[3], u, v, o2 + 3);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * pool job: process one row strip
+ * args:
+ *   data - pointer to the strips array
+ *   index - strip index
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void lut_strip_job(void *data, int index)
+{
+	lut_strip_t *strip = ((lut_strip_t *) data) + index;
+
+	if(strip->yu12)
+		yu12_rows(strip);
+	else
+		rgb_rows(strip);
+}
+
+/*
+ * split the frame in row strips and process them on the worker pool
+ * args:
+ *   proto - strip data shared by all strips (rows are set here)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void lut_apply(const lut_strip_t *proto, int threads)
+{
+	int step = proto->yu12 ? 2 : 1;
+	int width = proto->width;
+	int height = proto->height;
+
+	if(threads <= 0)
+	{
+		threads = 1;
+		if(width * height >= LUT_MT_MIN_PIXELS)
+		{
+			long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = (ncpu > 0) ? (int) ncpu : 1;
+		}
+	}
+	if(threads > LUT_MAX_THREADS)
+		threads = LUT_MAX_THREADS;
+	if(threads > height / step)
+		threads = height / step;
+	if(threads < 1)
+		threads = 1;
+
+	lut_strip_t strips[LUT_MAX_THREADS];
+
+	int units = height / step;
+	int i = 0;
+	for(i = 0; i < threads; i++)
+	{
+		strips[i] = *proto;
+		strips[i].row_start = step * ((units * i) / threads);
+		strips[i].row_end = step * ((units * (i + 1)) / threads);
+	}
+
+	lut_pool_run(lut_strip_job, strips, threads, threads);
+}
+
+/*
+ * apply a lut to a rgb24 frame (in place)
+ * args:
+ *   lut - pointer to lut
+ *   frame - pointer to rgb24 frame data
+ *   width - frame width
+ *   height - frame height
+ *   stride - line size in bytes (0 - width * 3)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   lut is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_rgb24(const render_lut_t *lut, uint8_t *frame,
+	int width, int height, int stride, int threads)
+{
+	/*assertions*/
+	assert(lut != NULL);
+	assert(frame != NULL);
+
+	lut_strip_t strip;
+	memset(&strip, 0, sizeof(lut_strip_t));
+
+	strip.lut = lut;
+	strip.in = frame;
+	strip.out_rgb = frame;
+	strip.width = width;
+	strip.height = height;
+	strip.stride = (stride > 0) ? stride : width * 3;
+
+	lut_apply(&strip, threads);
+}
+
+/*
+ * apply a lut to a yu12 frame (in place)
+ *   the filter is compiled for the yuv domain, so no rgb
+ *   conversion is needed
+ * args:
+ *   lut - pointer to lut
+ *   frame - pointer to yu12 frame data
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   lut is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_yu12(const render_lut_t *lut, uint8_t *frame,
+	int width, int height, int threads)
+{
+	/*assertions*/
+	assert(lut != NULL);
+	assert(frame != NULL);
+
+	render_lut_process_yu12(lut, frame, frame, NULL, width, height, 0, threads);
+}
+
+/*
+ * process a yu12 frame in a single pass: horizontal mirror, lut and
+ *   output to yu12 and/or rgb24, row strips run on the worker pool
+ * args:
+ *   lut - pointer to lut (NULL - no color change)
+ *   in - pointer to yu12 input frame
+ *   out_yuv - pointer to yu12 output frame (NULL - none, may be in if not mirrored)
+ *   out_rgb - pointer to rgb24 output frame (NULL - none)
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   mirror - horizontal mirror (0 - no, 1 - yes)
+ *   threads - number of threads (0 - auto)
+ *
+ * asserts:
+ *   in is not null
+ *   in and out_yuv are different if mirror is set
+ *
+ * returns: none
+ */
+void render_lut_process_yu12(const render_lut_t *lut, const uint8_t *in,
+	uint8_t *out_yuv, uint8_t *out_rgb, int width, int height, int mirror, int threads)
+{
+	/*assertions*/
+	assert(in != NULL);
+	assert(!mirror || in != out_yuv);
+
+	if(out_yuv == NULL && out_rgb == NULL)
+		return;
+
+	lut_strip_t strip;
+	memset(&strip, 0, sizeof(lut_strip_t));
+
+	strip.lut = lut;
+	strip.in = in;
+	strip.out_yuv = out_yuv;
+	strip.out_rgb = out_rgb;
+	strip.width = width;
+	strip.height = height;
+	strip.stride = width * 3;
+	strip.yu12 = 1;
+	strip.mirror = mirror;
+
+	lut_apply(&strip, threads);
+}
+
+/*
+ * render a strip of filtered thumbnails in a single pass
+ *   every source pixel is read once and written, through each lut,
+ *   to its tile of the atlas (tile i starts at column i * width)
+ * args:
+ *   luts - array of n luts (NULL entries copy the source)
+ *   n - number of tiles
+ *   src - pointer to rgb24 source (tile sized)
+ *   width - source width
+ *   height - source height
+ *   src_stride - source line size in bytes (0 - width * 3)
+ *   atlas - pointer to rgb24 atlas (n * width x height)
+ *   atlas_stride - atlas line size in bytes (0 - n * width * 3)
+ *
+ * asserts:
+ *   luts is not null
+ *   src is not null
+ *   atlas is not null
+ *
+ * returns: none
+ */
+void render_lut_apply_atlas(render_lut_t *const *luts, int n, const uint8_t *src,
+	int width, int height, int src_stride, uint8_t *atlas, int atlas_stride)
+{
+	/*assertions*/
+	assert(luts != NULL);
+	assert(src != NULL);
+	assert(atlas != NULL);
+
+	if(src_stride <= 0)
+		src_stride = width * 3;
+	if(atlas_stride <= 0)
+		atlas_stride = n * width * 3;
+
+	int h = 0, w = 0, i = 0;
+	for(h = 0; h < height; h++)
+	{
+		const uint8_t *ps = src + (size_t) h * src_stride;
+		uint8_t *pa = atlas + (size_t) h * atlas_stride;
+
+		for(w = 0; w < width; w++, ps += 3, pa += 3)
+		{
+			uint8_t *pt = pa;
+			for(i = 0; i < n; i++, pt += width * 3)
+			{
+				if(luts[i])
+					lut_pixel(luts[i], luts[i]->rgb, ps[0], ps[1], ps[2], pt);
+				else
+				{
+					pt[0] = ps[0];
+					pt[1] = ps[1];
+					pt[2] = ps[2];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,302 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+
+/*******************************************************************************#
+#                                                                               #
+#  Render library - mirror and flip kernels                                     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "gviewrender.h"
+
+#define FLIP_LINE_STACK 4096 /*line swap buffer size on the stack*/
+
+#if defined(__SSE2__)
+/*
+ * reverse the pixels of a 16 byte block
+ * args:
+ *   v - block
+ *   bpp - bytes per pixel (1, 2 or 4)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: reversed block
+ */
+static inline __m128i reverse_block(__m128i v, int bpp)
+{
+	/*reverse 32 bit words*/
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	if(bpp == 4)
+		return v;
+
+	/*swap 16 bit words inside each 32 bit word*/
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	if(bpp == 2)
+		return v;
+
+	/*swap bytes inside each 16 bit word*/
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+/*
+ * mirror one line out of place
+ * args:
+ *   dst - pointer to destination line
+ *   src - pointer to source line
+ *   width - line width in pixels
+ *   bpp - bytes per pixel
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void mirror_line(uint8_t *dst, const uint8_t *src, int width, int bpp)
+{
+	int len = width * bpp;
+	int x = 0;
+
+#if defined(__SSE2__)
+	if(bpp == 1 || bpp == 2 || bpp == 4)
+	{
+		for(; x + 16 <= len; x += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *) (src + len - x - 16));
+			_mm_storeu_si128((__m128i *) (dst + x), reverse_block(v, bpp));
+		}
+	}
+#endif
+
+	int b = 0;
+	for(; x < len; x += bpp)
+		for(b = 0; b < bpp; b++)
+			dst[x + b] = src[len - x - bpp + b];
+}
+
+/*
+ * mirror one line in place
+ *   swaps blocks from both ends towards the middle
+ * args:
+ *   line - pointer to line
+ *   width - line width in pixels
+ *   bpp - bytes per pixel
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void mirror_line_inplace(uint8_t *line, int width, int bpp)
+{
+	int len = width * bpp;
+	int x = 0;
+
+#if defined(__SSE2__)
+	if(bpp == 1 || bpp == 2 || bpp == 4)
+	{
+		for(; x + 32 <= len - x; x += 16)
+		{
+			__m128i l = _mm_loadu_si128((const __m128i *) (line + x));
+			__m128i r = _mm_loadu_si128((const __m128i *) (line + len - x - 16));
+			_mm_storeu_si128((__m128i *) (line + x), reverse_block(r, bpp));
+			_mm_storeu_si128((__m128i *) (line + len - x - 16), reverse_block(l, bpp));
+		}
+	}
+#endif
+
+	int b = 0;
+	for(; x + bpp <= len - x - bpp; x += bpp)
+	{
+		for(b = 0; b < bpp; b++)
+		{
+			uint8_t tmp = line[x + b];
+			line[x + b] = line[len - x - bpp + b];
+			line[len - x - bpp + b] = tmp;
+		}
+	}
+}
+
+/*
+ * mirror (horizontal flip) a plane
+ * args:
+ *   dst - pointer to destination plane (can be src for in place)
+ *   src - pointer to source plane
+ *   width - plane width in pixels
+ *   height - plane height
+ *   bpp - bytes per pixel (1 to 4)
+ *   src_stride - source line size in bytes (0 - width * bpp)
+ *   dst_stride - destination line size in bytes (0 - width * bpp)
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_mirror_plane(uint8_t *dst, const uint8_t *src, int width, int height,
+	int bpp, int src_stride, int dst_stride)
+{
+	/*asserts*/
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(bpp > 0 && bpp <= 4);
+
+	if(src_stride <= 0)
+		src_stride = width * bpp;
+	if(dst_stride <= 0)
+		dst_stride = width * bpp;
+
+	int h = 0;
+	for(h = 0; h < height; h++)
+	{
+		if(dst == src && src_stride == dst_stride)
+			mirror_line_inplace(dst + h * dst_stride, width, bpp);
+		else
+			mirror_line(dst + h * dst_stride, src + h * src_stride, width, bpp);
+	}
+}
+
+/*
+ * upturn (vertical flip) a plane
+ * args:
+ *   dst - pointer to destination plane (can be src for in place)
+ *   src - pointer to source plane
+ *   line_size - bytes to copy per line
+ *   height - plane height
+ *   src_stride - source line size in bytes (0 - line_size)
+ *   dst_stride - destination line size in bytes (0 - line_size)
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_flip_plane(uint8_t *dst, const uint8_t *src, int line_size, int height,
+	int src_stride, int dst_stride)
+{
+	/*asserts*/
+	assert(dst != NULL);
+	assert(src != NULL);
+
+	if(src_stride <= 0)
+		src_stride = line_size;
+	if(dst_stride <= 0)
+		dst_stride = line_size;
+
+	int h = 0;
+	if(dst != src)
+	{
+		for(h = 0; h < height; h++)
+			memcpy(dst + h * dst_stride, src + (height - 1 - h) * src_stride, line_size);
+		return;
+	}
+
+	uint8_t stack_line[FLIP_LINE_STACK];
+	uint8_t *line = stack_line;
+	if(line_size > FLIP_LINE_STACK)
+	{
+		line = malloc(line_size);
+		if(line == NULL)
+		{
+			fprintf(stderr, "RENDER: FATAL memory allocation failure (render_flip_plane): %s\n", strerror(errno));
+			exit(-1);
+		}
+	}
+
+	uint8_t *pi = dst;
+	uint8_t *pf = dst + (height - 1) * dst_stride;
+	for(h = 0; h < height / 2; h++)
+	{
+		memcpy(line, pi, line_size);
+		memcpy(pi, pf, line_size);
+		memcpy(pf, line, line_size);
+		pi += dst_stride;
+		pf -= dst_stride;
+	}
+
+	if(line != stack_line)
+		free(line);
+}
+
+/*
+ * mirror and/or upturn a yu12 frame
+ *   (mirror + upturn = 180 degree rotation)
+ * args:
+ *   dst - pointer to destination frame (can be src for in place)
+ *   src - pointer to source frame
+ *   width - frame width
+ *   height - frame height
+ *   mask - REND_FX_YUV_MIRROR and/or REND_FX_YUV_UPTURN
+ *
+ * asserts:
+ *   dst is not null
+ *   src is not null
+ *
+ * returns: none
+ */
+void render_yu12_transform(uint8_t *dst, const uint8_t *src, int width, int height, uint32_t mask)
+{
+	/*asserts*/
+	assert(dst != NULL);
+	assert(src != NULL);
+
+	int mirror = (mask & REND_FX_YUV_MIRROR) != 0;
+	int upturn = (mask & REND_FX_YUV_UPTURN) != 0;
+
+	int plane = 0;
+	for(plane = 0; plane < 3; plane++)
+	{
+		int w = plane ? width / 2 : width;
+		int h = plane ? height / 2 : height;
+		int offset = plane ? width * height + (plane - 1) * (w * h) : 0;
+
+		const uint8_t *ps = src + offset;
+		uint8_t *pd = dst + offset;
+
+		if(mirror && upturn)
+		{
+			/*mirror into place, then upturn in place*/
+			render_mirror_plane(pd, ps, w, h, 1, w, w);
+			render_flip_plane(pd, pd, w, h, w, w);
+		}
+		else if(mirror)
+			render_mirror_plane(pd, ps, w, h, 1, w, w);
+		else if(upturn)
+			render_flip_plane(pd, ps, w, h, w, w);
+		else if(pd != ps)
+			memcpy(pd, ps, w * h);
+	}
+}
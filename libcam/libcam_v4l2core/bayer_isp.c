@@ -0,0 +1,749 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "gview.h"
+#include "bayer_isp.h"
+
+extern int verbosity;
+
+/*minimum frame size (in pixels) for splitting the work in row strips*/
+#define ISP_MT_MIN_PIXELS (1280 * 720)
+/*maximum number of row strips (threads)*/
+#define ISP_MAX_THREADS   8
+/*maximum effective gain (Q8) - keeps the simd products in range*/
+#define ISP_MAX_GAIN      32767
+
+#define ISP_AVG(a,b) (((a) + (b) + 1) >> 1)
+
+/*
+ * all bayer layouts are handled as bggr:
+ *   gbrg/grbg are shifted by one column (xo = 1)
+ *   rggb/grbg have red and blue swapped (swap_rb = 1)
+ * the interpolation only mixes samples of the same color, so
+ * black level and gains can be applied after the demosaic
+ */
+typedef struct _isp_ctx_t
+{
+	uint8_t *out;           //yu12 output
+	uint8_t *in;            //raw bayer input
+	int width;
+	int height;
+	int xo;                 //column offset to the bggr layout
+	int swap_rb;            //swap red and blue
+	int apply_gains;        //flag black level/gains are not identity
+	int black_level;
+	int gain[3];            //effective gains (Q8) for r, g and b
+	uint8_t lut[3][256];    //scalar lookup for the same transform
+} isp_ctx_t;
+
+typedef struct _isp_strip_t
+{
+	isp_ctx_t *ctx;
+	uint8_t *scratch;       //two lines of r, g and b (width * 6)
+	int row_start;          //first row of the strip (even)
+	int row_end;            //last row of the strip + 1 (even)
+} isp_strip_t;
+
+/*
+ * persistent worker pool: threads are started on first use and wait
+ *   for a batch of row strips, the calling thread also takes strips
+ *   (scratch lines are kept per strip and only grow with the width)
+ */
+typedef struct _isp_pool_t
+{
+	__THREAD_TYPE threads[ISP_MAX_THREADS];
+	int nthreads;           //started worker threads
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_work;
+	__COND_TYPE cond_done;
+	isp_strip_t *strips;
+	int nstrips;
+	int next;               //next strip to process
+	int running;            //strips not finished yet
+	int quit;
+	uint8_t *scratch[ISP_MAX_THREADS];
+	size_t scratch_size[ISP_MAX_THREADS];
+} isp_pool_t;
+
+static isp_pool_t isp_pool =
+{
+	.mutex = __STATIC_MUTEX_INIT,
+	.cond_work = PTHREAD_COND_INITIALIZER,
+	.cond_done = PTHREAD_COND_INITIALIZER
+};
+/*only one frame is processed in the pool at a time*/
+static __MUTEX_TYPE isp_pool_batch = __STATIC_MUTEX_INIT;
+
+/*
+ * bilinear demosaic of a bggr line (scalar)
+ * args:
+ *   up - previous raw line
+ *   cur - current raw line
+ *   down - next raw line
+ *   width - line width
+ *   x0 - first pixel
+ *   x1 - last pixel + 1
+ *   xo - column offset to the bggr layout
+ *   brow - 1 if cur is a blue/green line, 0 for a green/red line
+ *   r, g, b - output color lines
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void demosaic_line_scalar(const uint8_t *up, const uint8_t *cur, const uint8_t *down,
+	int width, int x0, int x1, int xo, int brow, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+	int x = 0;
+	for(x = x0; x < x1; x++)
+	{
+		/*mirror at the borders (keeps the bayer parity)*/
+		int xl = (x > 0) ? x - 1 : 1;
+		int xr = (x < width - 1) ? x + 1 : width - 2;
+
+		int c = cur[x];
+		int h = ISP_AVG(cur[xl], cur[xr]);
+		int v = ISP_AVG(up[x], down[x]);
+		int even = !((x + xo) & 1);
+
+		if(brow)
+		{
+			if(even) /*blue site*/
+			{
+				b[x] = c;
+				g[x] = ISP_AVG(h, v);
+				r[x] = ISP_AVG(ISP_AVG(up[xl], up[xr]), ISP_AVG(down[xl], down[xr]));
+			}
+			else /*green site on a blue line*/
+			{
+				g[x] = c;
+				b[x] = h;
+				r[x] = v;
+			}
+		}
+		else
+		{
+			if(even) /*green site on a red line*/
+			{
+				g[x] = c;
+				r[x] = h;
+				b[x] = v;
+			}
+			else /*red site*/
+			{
+				r[x] = c;
+				g[x] = ISP_AVG(h, v);
+				b[x] = ISP_AVG(ISP_AVG(up[xl], up[xr]), ISP_AVG(down[xl], down[xr]));
+			}
+		}
+	}
+}
+
+#if defined(__SSE2__)
+/*select a where the mask is set, b otherwise*/
+static inline __m128i isp_sel(__m128i m, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+#endif
+
+/*
+ * bilinear demosaic of a bggr line
+ * args:
+ *   up - previous raw line
+ *   cur - current raw line
+ *   down - next raw line
+ *   width - line width
+ *   xo - column offset to the bggr layout
+ *   brow - 1 if cur is a blue/green line, 0 for a green/red line
+ *   r, g, b - output color lines
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void demosaic_line(const uint8_t *up, const uint8_t *cur, const uint8_t *down,
+	int width, int xo, int brow, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+	int x = 0;
+
+#if defined(__SSE2__)
+	if(width >= 20)
+	{
+		demosaic_line_scalar(up, cur, down, width, 0, 2, xo, brow, r, g, b);
+
+		/*lanes holding the even (blue or green/red) sites*/
+		__m128i m = _mm_set1_epi16(xo ? (short) 0xFF00 : (short) 0x00FF);
+
+		for(x = 2; x + 17 <= width; x += 16)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i *) (cur + x));
+			__m128i h = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i *) (cur + x - 1)),
+				_mm_loadu_si128((const __m128i *) (cur + x + 1)));
+			__m128i v = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i *) (up + x)),
+				_mm_loadu_si128((const __m128i *) (down + x)));
+			__m128i x4 = _mm_avg_epu8(h, v);
+			__m128i d = _mm_avg_epu8(
+				_mm_avg_epu8(
+					_mm_loadu_si128((const __m128i *) (up + x - 1)),
+					_mm_loadu_si128((const __m128i *) (up + x + 1))),
+				_mm_avg_epu8(
+					_mm_loadu_si128((const __m128i *) (down + x - 1)),
+					_mm_loadu_si128((const __m128i *) (down + x + 1))));
+
+			if(brow)
+			{
+				_mm_storeu_si128((__m128i *) (b + x), isp_sel(m, c, h));
+				_mm_storeu_si128((__m128i *) (g + x), isp_sel(m, x4, c));
+				_mm_storeu_si128((__m128i *) (r + x), isp_sel(m, d, v));
+			}
+			else
+			{
+				_mm_storeu_si128((__m128i *) (g + x), isp_sel(m, c, x4));
+				_mm_storeu_si128((__m128i *) (r + x), isp_sel(m, h, c));
+				_mm_storeu_si128((__m128i *) (b + x), isp_sel(m, v, d));
+			}
+		}
+	}
+#endif
+
+	demosaic_line_scalar(up, cur, down, width, x, width, xo, brow, r, g, b);
+}
+
+/*
+ * apply black level and gain to a color line
+ * args:
+ *   p - color line
+ *   width - line width
+ *   black_level - black level
+ *   gain - effective gain (Q8)
+ *   lut - lookup table for the same transform
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void gain_line(uint8_t *p, int width, int black_level, int gain, const uint8_t *lut)
+{
+	int x = 0;
+
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	__m128i bl = _mm_set1_epi8((char) black_level);
+	__m128i gv = _mm_set1_epi16((short) gain);
+
+	for(; x + 16 <= width; x += 16)
+	{
+		__m128i v = _mm_subs_epu8(_mm_loadu_si128((const __m128i *) (p + x)), bl);
+		/*(v << 8) * gain >> 16 = v * gain >> 8*/
+		__m128i lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, v), gv);
+		__m128i hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, v), gv);
+		_mm_storeu_si128((__m128i *) (p + x), _mm_packus_epi16(lo, hi));
+	}
+#else
+	(void) black_level;
+	(void) gain;
+#endif
+
+	for(; x < width; x++)
+		p[x] = lut[p[x]];
+}
+
+#if defined(__SSE2__)
+/*y = (77 r + 150 g + 29 b + 128) >> 8 for 16 pixels*/
+static inline __m128i isp_luma(__m128i r, __m128i g, __m128i b)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i cr = _mm_set1_epi16(77);
+	__m128i cg = _mm_set1_epi16(150);
+	__m128i cb = _mm_set1_epi16(29);
+	__m128i rnd = _mm_set1_epi16(128);
+
+	/*sums fit in 16 bit unsigned (max 65408)*/
+	__m128i lo = _mm_add_epi16(
+		_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(r, zero), cr),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(g, zero), cg)),
+		_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), cb), rnd));
+	__m128i hi = _mm_add_epi16(
+		_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(r, zero), cr),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(g, zero), cg)),
+		_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), cb), rnd));
+
+	return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+/*average of horizontal pixel pairs (8 bit to 16 bit lanes)*/
+static inline __m128i isp_pair_avg(__m128i a)
+{
+	__m128i lo_mask = _mm_set1_epi16(0x00FF);
+	__m128i one = _mm_set1_epi16(1);
+
+	return _mm_srli_epi16(
+		_mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, lo_mask), _mm_srli_epi16(a, 8)), one), 1);
+}
+
+/*chroma = 128 + ((cr r + cg g + cb b + 64) >> 7) for 8 pixels (16 bit lanes)*/
+static inline __m128i isp_chroma(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb)
+{
+	__m128i s = _mm_add_epi16(
+		_mm_add_epi16(
+			_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+			_mm_mullo_epi16(g, _mm_set1_epi16(cg))),
+		_mm_add_epi16(
+			_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(64)));
+
+	return _mm_add_epi16(_mm_srai_epi16(s, 7), _mm_set1_epi16(128));
+}
+#endif
+
+/*
+ * convert two rgb lines to yu12 (two luma lines and a chroma line)
+ *   uses the same coefficients as rgb24_to_yu12
+ * args:
+ *   r0, g0, b0 - first line colors
+ *   r1, g1, b1 - second line colors
+ *   py0, py1 - luma lines
+ *   pu, pv - chroma lines
+ *   width - line width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void yu12_line_pair(const uint8_t *r0, const uint8_t *g0, const uint8_t *b0,
+	const uint8_t *r1, const uint8_t *g1, const uint8_t *b1,
+	uint8_t *py0, uint8_t *py1, uint8_t *pu, uint8_t *pv, int width)
+{
+	int x = 0;
+
+#if defined(__SSE2__)
+	for(; x + 16 <= width; x += 16)
+	{
+		__m128i R0 = _mm_loadu_si128((const __m128i *) (r0 + x));
+		__m128i G0 = _mm_loadu_si128((const __m128i *) (g0 + x));
+		__m128i B0 = _mm_loadu_si128((const __m128i *) (b0 + x));
+		__m128i R1 = _mm_loadu_si128((const __m128i *) (r1 + x));
+		__m128i G1 = _mm_loadu_si128((const __m128i *) (g1 + x));
+		__m128i B1 = _mm_loadu_si128((const __m128i *) (b1 + x));
+
+		_mm_storeu_si128((__m128i *) (py0 + x), isp_luma(R0, G0, B0));
+		_mm_storeu_si128((__m128i *) (py1 + x), isp_luma(R1, G1, B1));
+
+		__m128i ra = isp_pair_avg(_mm_avg_epu8(R0, R1));
+		__m128i ga = isp_pair_avg(_mm_avg_epu8(G0, G1));
+		__m128i ba = isp_pair_avg(_mm_avg_epu8(B0, B1));
+
+		__m128i u = isp_chroma(ra, ga, ba, -19, -37, 56);
+		__m128i v = isp_chroma(ra, ga, ba, 79, -66, -13);
+
+		_mm_storel_epi64((__m128i *) (pu + x / 2), _mm_packus_epi16(u, u));
+		_mm_storel_epi64((__m128i *) (pv + x / 2), _mm_packus_epi16(v, v));
+	}
+#endif
+
+	for(; x + 1 < width; x += 2)
+	{
+		py0[x]   = (uint8_t) ((77 * r0[x] + 150 * g0[x] + 29 * b0[x] + 128) >> 8);
+		py0[x+1] = (uint8_t) ((77 * r0[x+1] + 150 * g0[x+1] + 29 * b0[x+1] + 128) >> 8);
+		py1[x]   = (uint8_t) ((77 * r1[x] + 150 * g1[x] + 29 * b1[x] + 128) >> 8);
+		py1[x+1] = (uint8_t) ((77 * r1[x+1] + 150 * g1[x+1] + 29 * b1[x+1] + 128) >> 8);
+
+		int ra = ISP_AVG(ISP_AVG(r0[x], r1[x]), ISP_AVG(r0[x+1], r1[x+1]));
+		int ga = ISP_AVG(ISP_AVG(g0[x], g1[x]), ISP_AVG(g0[x+1], g1[x+1]));
+		int ba = ISP_AVG(ISP_AVG(b0[x], b1[x]), ISP_AVG(b0[x+1], b1[x+1]));
+
+		pu[x/2] = CLIP(((-19 * ra - 37 * ga + 56 * ba + 64) >> 7) + 128);
+		pv[x/2] = CLIP(((79 * ra - 66 * ga - 13 * ba + 64) >> 7) + 128);
+	}
+}
+
+/*
+ * process a strip of row pairs
+ * args:
+ *   ctx - pointer to isp context
+ *   scratch - two lines of r, g and b (width * 6 bytes)
+ *   row_start - first row (even)
+ *   row_end - last row + 1 (even)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void process_rows(isp_ctx_t *ctx, uint8_t *scratch, int row_start, int row_end)
+{
+	int width = ctx->width;
+	int height = ctx->height;
+
+	uint8_t *r0 = scratch;
+	uint8_t *g0 = r0 + width;
+	uint8_t *b0 = g0 + width;
+	uint8_t *r1 = b0 + width;
+	uint8_t *g1 = r1 + width;
+	uint8_t *b1 = g1 + width;
+
+	/*demosaic writes bggr colors, swap the red and blue outputs if needed*/
+	uint8_t *dr0 = ctx->swap_rb ? b0 : r0;
+	uint8_t *db0 = ctx->swap_rb ? r0 : b0;
+	uint8_t *dr1 = ctx->swap_rb ? b1 : r1;
+	uint8_t *db1 = ctx->swap_rb ? r1 : b1;
+
+	uint8_t *pu_plane = ctx->out + (width * height);
+	uint8_t *pv_plane = pu_plane + ((width * height) / 4);
+
+	int y = 0;
+	for(y = row_start; y < row_end; y += 2)
+	{
+		/*mirror at the borders (keeps the bayer parity)*/
+		const uint8_t *prev = ctx->in + (y > 0 ? y - 1 : 1) * width;
+		const uint8_t *line0 = ctx->in + y * width;
+		const uint8_t *line1 = line0 + width;
+		const uint8_t *next = ctx->in + (y + 2 < height ? y + 2 : height - 2) * width;
+
+		demosaic_line(prev, line0, line1, width, ctx->xo, 1, dr0, g0, db0);
+		demosaic_line(line0, line1, next, width, ctx->xo, 0, dr1, g1, db1);
+
+		if(ctx->apply_gains)
+		{
+			gain_line(r0, width, ctx->black_level, ctx->gain[0], ctx->lut[0]);
+			gain_line(g0, width, ctx->black_level, ctx->gain[1], ctx->lut[1]);
+			gain_line(b0, width, ctx->black_level, ctx->gain[2], ctx->lut[2]);
+			gain_line(r1, width, ctx->black_level, ctx->gain[0], ctx->lut[0]);
+			gain_line(g1, width, ctx->black_level, ctx->gain[1], ctx->lut[1]);
+			gain_line(b1, width, ctx->black_level, ctx->gain[2], ctx->lut[2]);
+		}
+
+		yu12_line_pair(r0, g0, b0, r1, g1, b1,
+			ctx->out + y * width,
+			ctx->out + (y + 1) * width,
+			pu_plane + (y / 2) * (width / 2),
+			pv_plane + (y / 2) * (width / 2),
+			width);
+	}
+}
+
+/*
+ * worker pool thread
+ * args:
+ *   data - not used
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *isp_pool_thread(void *data)
+{
+	(void) data;
+
+	__LOCK_MUTEX(&isp_pool.mutex);
+	while(!isp_pool.quit)
+	{
+		if(isp_pool.next < isp_pool.nstrips)
+		{
+			isp_strip_t *strip = &isp_pool.strips[isp_pool.next++];
+			__UNLOCK_MUTEX(&isp_pool.mutex);
+
+			process_rows(strip->ctx, strip->scratch, strip->row_start, strip->row_end);
+
+			__LOCK_MUTEX(&isp_pool.mutex);
+			isp_pool.running--;
+			if(isp_pool.running == 0)
+				__COND_BCAST(&isp_pool.cond_done);
+		}
+		else
+			pthread_cond_wait(&isp_pool.cond_work, &isp_pool.mutex);
+	}
+	__UNLOCK_MUTEX(&isp_pool.mutex);
+
+	return NULL;
+}
+
+/*
+ * process the row strips on the worker pool and wait for them
+ *   (called with isp_pool_batch locked)
+ * args:
+ *   strips - row strips
+ *   nstrips - number of strips (threads to use, including the caller)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void isp_pool_run(isp_strip_t *strips, int nstrips)
+{
+	int i = 0;
+
+	if(nstrips <= 1)
+	{
+		for(i = 0; i < nstrips; i++)
+			process_rows(strips[i].ctx, strips[i].scratch, strips[i].row_start, strips[i].row_end);
+		return;
+	}
+
+	__LOCK_MUTEX(&isp_pool.mutex);
+
+	/*start the missing workers (the caller is one of the threads)*/
+	while(isp_pool.nthreads < nstrips - 1)
+	{
+		if(__THREAD_CREATE(&isp_pool.threads[isp_pool.nthreads], isp_pool_thread, NULL))
+		{
+			if(verbosity > 0)
+				fprintf(stderr, "V4L2_CORE: (bayer_to_yu12) couldn't start pool thread - using %i threads\n",
+					isp_pool.nthreads + 1);
+			break;
+		}
+		isp_pool.nthreads++;
+	}
+
+	isp_pool.strips = strips;
+	isp_pool.nstrips = nstrips;
+	isp_pool.next = 0;
+	isp_pool.running = nstrips;
+	__COND_BCAST(&isp_pool.cond_work);
+
+	while(isp_pool.next < isp_pool.nstrips)
+	{
+		isp_strip_t *strip = &strips[isp_pool.next++];
+		__UNLOCK_MUTEX(&isp_pool.mutex);
+
+		process_rows(strip->ctx, strip->scratch, strip->row_start, strip->row_end);
+
+		__LOCK_MUTEX(&isp_pool.mutex);
+		isp_pool.running--;
+	}
+
+	while(isp_pool.running > 0)
+		pthread_cond_wait(&isp_pool.cond_done, &isp_pool.mutex);
+
+	isp_pool.strips = NULL;
+	isp_pool.nstrips = 0;
+	isp_pool.next = 0;
+
+	__UNLOCK_MUTEX(&isp_pool.mutex);
+}
+
+/*
+ * software isp: convert raw 8 bit bayer data to yu12
+ *   demosaic (bilinear), black level, white balance and
+ *   color conversion are done in a single pass over row pairs,
+ *   with row strips processed on a persistent worker pool for
+ *   large frames
+ * args:
+ *   out - pointer to output yu12 planar data buffer
+ *   in - pointer to input raw bayer data buffer
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   pix_order - bayer pixel order (0=gb/rg   1=gr/bg  2=bg/gr  3=rg/bg)
+ *   params - pointer to isp parameters (NULL for defaults)
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void bayer_to_yu12(uint8_t *out, uint8_t *in, int width, int height,
+	int pix_order, const v4l2_isp_params_t *params)
+{
+	/*assertions*/
+	assert(out);
+	assert(in);
+
+	if(width < 2 || height < 2)
+		return;
+
+	isp_ctx_t ctx;
+	memset(&ctx, 0, sizeof(isp_ctx_t));
+
+	ctx.out = out;
+	ctx.in = in;
+	ctx.width = width;
+	ctx.height = height;
+
+	switch (pix_order)
+	{
+		case 1: /* grgrgr... | bgbgbg... (V4L2_PIX_FMT_SGRBG8)*/
+			ctx.xo = 1;
+			ctx.swap_rb = 1;
+			break;
+
+		case 2: /* bgbgbg... | grgrgr... (V4L2_PIX_FMT_SBGGR8)*/
+			ctx.xo = 0;
+			ctx.swap_rb = 0;
+			break;
+
+		case 3: /* rgrgrg... ! gbgbgb... (V4L2_PIX_FMT_SRGGB8)*/
+			ctx.xo = 0;
+			ctx.swap_rb = 1;
+			break;
+
+		case 0: /* gbgbgb... | rgrgrg... (V4L2_PIX_FMT_SGBRG8)*/
+		default: /* default is 0*/
+			ctx.xo = 1;
+			ctx.swap_rb = 0;
+			break;
+	}
+
+	int threads = 0;
+	int gain[3] = {256, 256, 256};
+	if(params)
+	{
+		ctx.black_level = params->black_level;
+		gain[0] = params->gain_r;
+		gain[1] = params->gain_g;
+		gain[2] = params->gain_b;
+		threads = params->threads;
+	}
+
+	if(ctx.black_level < 0)
+		ctx.black_level = 0;
+	if(ctx.black_level > 254)
+		ctx.black_level = 254;
+
+	ctx.apply_gains = (ctx.black_level > 0 ||
+		gain[0] != 256 || gain[1] != 256 || gain[2] != 256);
+
+	if(ctx.apply_gains)
+	{
+		int c = 0;
+		int range = 255 - ctx.black_level;
+		for(c = 0; c < 3; c++)
+		{
+			/*stretch the range left by the black level back to 0-255*/
+			int g = (gain[c] < 0) ? 0 : gain[c];
+			int eff = (g * 255 + range / 2) / range;
+			ctx.gain[c] = (eff > ISP_MAX_GAIN) ? ISP_MAX_GAIN : eff;
+
+			int v = 0;
+			for(v = 0; v < 256; v++)
+			{
+				int s = (v > ctx.black_level) ? v - ctx.black_level : 0;
+				int t = ((s << 8) * ctx.gain[c]) >> 16;
+				ctx.lut[c][v] = (uint8_t) ((t > 255) ? 255 : t);
+			}
+		}
+	}
+
+	if(threads <= 0)
+	{
+		threads = 1;
+		if(width * height >= ISP_MT_MIN_PIXELS)
+		{
+			long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = (ncpu > 0) ? (int) ncpu : 1;
+		}
+	}
+	if(threads > ISP_MAX_THREADS)
+		threads = ISP_MAX_THREADS;
+	if(threads > height / 2)
+		threads = height / 2;
+
+	isp_strip_t strips[ISP_MAX_THREADS];
+
+	__LOCK_MUTEX(&isp_pool_batch);
+
+	int pairs = height / 2;
+	int i = 0;
+	for(i = 0; i < threads; i++)
+	{
+		/*scratch lines are reused from frame to frame*/
+		size_t size = (size_t) width * 6;
+		if(isp_pool.scratch_size[i] < size)
+		{
+			free(isp_pool.scratch[i]);
+			isp_pool.scratch[i] = malloc(size);
+			isp_pool.scratch_size[i] = size;
+			if(isp_pool.scratch[i] == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (bayer_to_yu12): %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+
+		strips[i].ctx = &ctx;
+		strips[i].scratch = isp_pool.scratch[i];
+		strips[i].row_start = 2 * ((pairs * i) / threads);
+		strips[i].row_end = 2 * ((pairs * (i + 1)) / threads);
+	}
+
+	isp_pool_run(strips, threads);
+
+	__UNLOCK_MUTEX(&isp_pool_batch);
+}
+
+/*
+ * stop the software isp worker pool and free the scratch lines
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void bayer_isp_clean()
+{
+	int i = 0;
+
+	__LOCK_MUTEX(&isp_pool_batch);
+	__LOCK_MUTEX(&isp_pool.mutex);
+	isp_pool.quit = 1;
+	__COND_BCAST(&isp_pool.cond_work);
+	__UNLOCK_MUTEX(&isp_pool.mutex);
+
+	for(i = 0; i < isp_pool.nthreads; i++)
+		__THREAD_JOIN(isp_pool.threads[i]);
+
+	isp_pool.nthreads = 0;
+	isp_pool.quit = 0;
+
+	for(i = 0; i < ISP_MAX_THREADS; i++)
+	{
+		free(isp_pool.scratch[i]);
+		isp_pool.scratch[i] = NULL;
+		isp_pool.scratch_size[i] = 0;
+	}
+	__UNLOCK_MUTEX(&isp_pool_batch);
+}
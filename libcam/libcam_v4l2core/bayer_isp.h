@@ -0,0 +1,63 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef BAYER_ISP_H
+#define BAYER_ISP_H
+
+#include "gviewv4l2core.h"
+
+/*
+ * software isp: convert raw 8 bit bayer data to yu12
+ *   demosaic (bilinear), black level, white balance and
+ *   color conversion are done in a single pass over row pairs,
+ *   with row strips processed on a persistent worker pool for
+ *   large frames
+ * args:
+ *   out - pointer to output yu12 planar data buffer
+ *   in - pointer to input raw bayer data buffer
+ *   width - frame width (must be even)
+ *   height - frame height (must be even)
+ *   pix_order - bayer pixel order (0=gb/rg   1=gr/bg  2=bg/gr  3=rg/bg)
+ *   params - pointer to isp parameters (NULL for defaults)
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void bayer_to_yu12(uint8_t *out, uint8_t *in, int width, int height,
+	int pix_order, const v4l2_isp_params_t *params);
+
+/*
+ * stop the software isp worker pool and free the scratch lines
+ *   (restarted on the next bayer_to_yu12 call)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void bayer_isp_clean();
+
+#endif
@@ -26,6 +26,13 @@
 #include <errno.h>
 #include <assert.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#endif
+
 #include "gview.h"
 #include "cameraconfig.h"
 
@@ -1319,9 +1326,150 @@ static inline void convert_packed_to_16bit(uint8_t *raw, uint16_t *unpacked, int
 	}
 }
 
+#if defined(__x86_64__) || defined(__i386__)
 /*
- * convert y10b (bit-packed array greyscale format) to yu12
+ * Unpack y10b (big endian 10 bit packed) pixels (ssse3)
+ *   8 pixels (10 bytes) per iteration
+ * args:
+ *    raw - pointer to input raw packed data buffer
+ *    unpacked - pointer to unpacked output data buffer (10 bit values)
+ *    npix - number of pixels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of unpacked pixels
+ */
+__attribute__((target("ssse3")))
+static int unpack_y10b_ssse3(const uint8_t *raw, uint16_t *unpacked, int npix)
+{
+	/*
+	 * each 16 bit lane gets the two bytes holding the pixel (big endian)
+	 * the multiply drops the bits of the previous pixel and the shift
+	 * drops the bits of the next one
+	 */
+	const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 3, 2, 4, 3, 6, 5, 7, 6, 8, 7, 9, 8);
+	const __m128i mul = _mm_setr_epi16(1, 4, 16, 64, 1, 4, 16, 64);
+
+	int i = 0;
+	/*the 16 byte load must stay inside the packed buffer*/
+	for(i = 0; i + 16 <= npix; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (raw + (i / 4) * 5));
+		v = _mm_shuffle_epi8(v, shuf);
+		v = _mm_srli_epi16(_mm_mullo_epi16(v, mul), 6);
+		_mm_storeu_si128((__m128i *) (unpacked + i), v);
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Unpack y10b (big endian 10 bit packed) pixels
+ *   4 pixels are packed in 5 bytes
+ * args:
+ *    raw - pointer to input raw packed data buffer
+ *    unpacked - pointer to unpacked output data buffer (10 bit values)
+ *    npix - number of pixels (multiple of 4)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void unpack_y10b(const uint8_t *raw, uint16_t *unpacked, int npix)
+{
+	int i = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	static int has_ssse3 = -1;
+	if(has_ssse3 < 0)
+	{
+		__builtin_cpu_init();
+		has_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+	}
+
+	if(has_ssse3)
+		i = unpack_y10b_ssse3(raw, unpacked, npix);
+#endif
+
+	const uint8_t *p = raw + (i / 4) * 5;
+	uint16_t *u = unpacked + i;
+	for(; i + 4 <= npix; i += 4)
+	{
+		u[0] = (uint16_t) ((p[0] << 2) | (p[1] >> 6));
+		u[1] = (uint16_t) (((p[1] & 0x3F) << 4) | (p[2] >> 4));
+		u[2] = (uint16_t) (((p[2] & 0x0F) << 6) | (p[3] >> 2));
+		u[3] = (uint16_t) (((p[3] & 0x03) << 8) | p[4]);
+		p += 5;
+		u += 4;
+	}
+}
+
+/*
+ * convert 16 bit samples to 8 bit (sample >> shift)
+ * args:
+ *    out - pointer to 8 bit output buffer
+ *    in - pointer to 16 bit input buffer
+ *    npix - number of samples
+ *    shift - right shift (2 for 10 bit, 8 for 16 bit)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void samples16_to_8bit(uint8_t *out, const uint16_t *in, int npix, int shift)
+{
+	int i = 0;
+
+#if defined(__SSE2__)
+	__m128i sh = _mm_cvtsi32_si128(shift);
+	for(; i + 16 <= npix; i += 16)
+	{
+		__m128i lo = _mm_srl_epi16(_mm_loadu_si128((const __m128i *) (in + i)), sh);
+		__m128i hi = _mm_srl_epi16(_mm_loadu_si128((const __m128i *) (in + i + 8)), sh);
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for(; i < npix; i++)
+		out[i] = (uint8_t) (in[i] >> shift);
+}
+
+/*
+ * set neutral chroma on yu12 and (optional) p010/p016 frames
  * args:
+ *    out - pointer to yu12 frame
+ *    out16 - pointer to p010/p016 frame (can be NULL)
+ *    width - picture width
+ *    height - picture height
+ *
+ * asserts:
+ *    out is not null
+ *
+ * returns: none
+ */
+static void set_grey_chroma(uint8_t *out, uint16_t *out16, int width, int height)
+{
+	memset(out + (width * height), 0x80, (size_t) (width * height / 2));
+
+	if(out16)
+	{
+		uint16_t *puv = out16 + (width * height);
+		int i = 0;
+		for(i = 0; i < (width * height / 2); i++)
+			puv[i] = 0x8000;
+	}
+}
+
+/*
+ * convert y10b (bit-packed array greyscale format) to p010 and yu12
+ *   p010: 16 bit luma plane followed by a 16 bit interleaved
+ *   chroma plane, with 10 significant bits (msb aligned)
+ * args:
+ *   out16: pointer to output buffer (p010) - can be NULL
  *   out: pointer to output buffer (yu12)
  *   in: pointer to input buffer containing y10b (bit-packed array) data frame
  *   width: picture width
@@ -1333,52 +1481,97 @@ static inline void convert_packed_to_16bit(uint8_t *raw, uint16_t *unpacked, int
  *
  * returns: none
  */
-void y10b_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void y10b_to_p010(uint16_t *out16, uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
 	assert(out);
-	
-	uint16_t *unpacked_buffer = NULL;
-	uint16_t *ptmp;
-	uint8_t *py = out;
-	uint8_t *pu = out + (width * height);
-	uint8_t *pv = pu + ((width * height) / 4);
-	
-	int h = 0;
 
-	unpacked_buffer = malloc(width * height * sizeof(uint16_t));
-	
-	if (unpacked_buffer == NULL)
+	if(width % 4)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (y10b_to_yu12): %s\n", strerror(errno));
-		exit(-1);
-	}
-	
-	convert_packed_to_16bit(in, unpacked_buffer, 10, width * height);
+		/*rows don't start on a byte boundary, unpack the whole frame*/
+		uint16_t *unpacked_buffer = out16 ? out16 :
+			(uint16_t *) calloc(width * height, sizeof(uint16_t));
 
-	ptmp = unpacked_buffer;
+		if (unpacked_buffer == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (y10b_to_p010): %s\n", strerror(errno));
+			exit(-1);
+		}
 
-	for (h = 0; h < height; h++)
+		convert_packed_to_16bit(in, unpacked_buffer, 10, width * height);
+		samples16_to_8bit(out, unpacked_buffer, width * height, 2);
+
+		if(out16)
+		{
+			int i = 0;
+			for(i = 0; i < width * height; i++)
+				out16[i] <<= 6;
+		}
+		else
+			free(unpacked_buffer);
+
+		set_grey_chroma(out, out16, width, height);
+		return;
+	}
+
+	/*unpack line by line (stays in cache)*/
+	uint16_t *line = NULL;
+	if(out16 == NULL)
 	{
-		int w=0;
-		for (w = 0; w < width; w++)
+		line = malloc(width * sizeof(uint16_t));
+		if (line == NULL)
 		{
-			/* Y */
-			*py++ = (uint8_t) ((*ptmp++ & 0x3FF) >> 2);
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (y10b_to_p010): %s\n", strerror(errno));
+			exit(-1);
 		}
 	}
-	
-	for(h=0; h < (width * height / 4); h++)
+
+	int bytes_per_line = (width * 10) / 8;
+	int h = 0;
+	for(h = 0; h < height; h++)
 	{
-		/* U */
-		*pu++ = 0x80;
-		/* V */
-		*pv++ = 0x80;
+		uint16_t *pline = out16 ? out16 + (h * width) : line;
+
+		unpack_y10b(in + (h * bytes_per_line), pline, width);
+		samples16_to_8bit(out + (h * width), pline, width, 2);
+
+		if(out16)
+		{
+			int w = 0;
+#if defined(__SSE2__)
+			for(; w + 8 <= width; w += 8)
+				_mm_storeu_si128((__m128i *) (pline + w),
+					_mm_slli_epi16(_mm_loadu_si128((const __m128i *) (pline + w)), 6));
+#endif
+			for(; w < width; w++)
+				pline[w] <<= 6;
+		}
 	}
 
+	if(line)
+		free(line);
 
-	free(unpacked_buffer);
+	set_grey_chroma(out, out16, width, height);
+}
+
+/*
+ * convert y10b (bit-packed array greyscale format) to yu12
+ * args:
+ *   out: pointer to output buffer (yu12)
+ *   in: pointer to input buffer containing y10b (bit-packed array) data frame
+ *   width: picture width
+ *   height: picture height
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void y10b_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	y10b_to_p010(NULL, out, in, width, height);
 }
 
 /*
@@ -1491,8 +1684,10 @@ void grey_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 }
 
 /*
- * convert y16 (16 bit greyscale format) to yu12
+ * convert y16 (16 bit greyscale format) to p016 and yu12
+ *   p016: 16 bit luma plane followed by a 16 bit interleaved chroma plane
  * args:
+ *   out16: pointer to output buffer (p016) - can be NULL
  *   out: pointer to output buffer (yu12)
  *   in: pointer to input buffer containing y16 (16 bit greyscale) data frame
  *   width: picture width
@@ -1504,36 +1699,37 @@ void grey_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
  *
  * returns: none
  */
-void y16_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void y16_to_p016(uint16_t *out16, uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
 	assert(out);
-	
-	uint16_t *ptmp = (uint16_t *) in;
-	uint8_t *py = out;
-	uint8_t *pu = out + (width * height);
-	uint8_t *pv = pu + ((width * height) / 4);
-	
-	int h = 0;
 
-	for (h = 0; h < height; h++)
-	{
-		int w=0;
-		for (w = 0; w < width; w++)
-		{
-			/* Y */
-			*py++ = (uint8_t) ((*ptmp++ & 0xFF00) >> 8);
-		}
-	}
-	
-	for(h=0; h < (width * height / 4); h++)
-	{
-		/* U */
-		*pu++ = 0x80;
-		/* V */
-		*pv++ = 0x80;
-	}
+	if(out16)
+		memcpy(out16, in, width * height * sizeof(uint16_t));
+
+	samples16_to_8bit(out, (uint16_t *) in, width * height, 8);
+
+	set_grey_chroma(out, out16, width, height);
+}
+
+/*
+ * convert y16 (16 bit greyscale format) to yu12
+ * args:
+ *   out: pointer to output buffer (yu12)
+ *   in: pointer to input buffer containing y16 (16 bit greyscale) data frame
+ *   width: picture width
+ *   height: picture height
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void y16_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	y16_to_p016(NULL, out, in, width, height);
 }
 
 /*
@@ -313,6 +313,25 @@ void nv61_to_yu12 (uint8_t *out, uint8_t *in, int width, int height);
  */
 void y10b_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ * convert y10b (bit-packed array greyscale format) to p010 and yu12
+ *   p010: 16 bit luma plane followed by a 16 bit interleaved
+ *   chroma plane, with 10 significant bits (msb aligned)
+ * args:
+ *   out16: pointer to output buffer (p010) - can be NULL
+ *   out: pointer to output buffer (yu12)
+ *   in: pointer to input buffer containing y10b (bit-packed array) data frame
+ *   width: picture width
+ *   height: picture height
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void y10b_to_p010(uint16_t *out16, uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  * convert yuv 411 packed (y41p) to planar yuv 420 (yu12)
  * args:
@@ -361,6 +380,24 @@ void grey_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  */
 void y16_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ * convert y16 (16 bit greyscale format) to p016 and yu12
+ *   p016: 16 bit luma plane followed by a 16 bit interleaved chroma plane
+ * args:
+ *   out16: pointer to output buffer (p016) - can be NULL
+ *   out: pointer to output buffer (yu12)
+ *   in: pointer to input buffer containing y16 (16 bit greyscale) data frame
+ *   width: picture width
+ *   height: picture height
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void y16_to_p016(uint16_t *out16, uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  * convert y16x (16 bit greyscale format - be) to yu12
  * args:
@@ -36,13 +36,162 @@
 #include "frame_decoder.h"
 #include "jpeg_decoder.h"
 #include "colorspaces.h"
+#include "bayer_isp.h"
 #include "cameraconfig.h"
 #include "load_libs.h"
 extern int verbosity;
 extern int encodeenv;
 
+/*
+ * set the frame queue buffers to black (y=0x00 u=0x80 v=0x80)
+ * args:
+ *   vd - pointer to video device data
+ *   width - frame width
+ *   height - frame height
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+static void set_black_frames(v4l2_dev_t *vd, int width, int height)
+{
+	int i = 0;
+
+	for(i=0; i<vd->frame_queue_size; ++i)
+	{
+		uint8_t *pframe = vd->frame_queue[i].yuv_frame;
+		if(pframe == NULL)
+			continue;
+
+		memset(pframe, 0x00, (size_t) (width * height)); //Y
+		memset(pframe + (width * height), 0x80, (size_t) (width * height / 2)); //U V
+	}
+}
+
+/*
+ * alloc (or free) the high bit depth (p010/p016) frame buffers
+ *   according to the device flag and the requested format
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+static void alloc_yuv16_frames(v4l2_dev_t *vd)
+{
+	int i = 0;
+	int enable = 0;
+
+	if(vd->high_bit_depth)
+	{
+		switch (vd->requested_fmt)
+		{
+			case V4L2_PIX_FMT_Y10BPACK:
+			case V4L2_PIX_FMT_Y16:
+				enable = 1;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	for(i=0; i<vd->frame_queue_size; ++i)
+	{
+		if(!enable)
+		{
+			if(vd->frame_queue[i].yuv16_frame)
+				free(vd->frame_queue[i].yuv16_frame);
+			vd->frame_queue[i].yuv16_frame = NULL;
+		}
+		else if(vd->frame_queue[i].yuv16_frame == NULL)
+		{
+			/*sized for the frame queue capacity (kept on reuse)*/
+			vd->frame_queue[i].yuv16_frame = calloc((size_t) (vd->frames_capacity * 3 / 2), sizeof(uint16_t));
+			if(vd->frame_queue[i].yuv16_frame == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+		vd->frame_queue[i].yuv16_bits = 0;
+	}
+}
+
+/*
+ * reuse the frame queue from a previous allocation
+ *   (only the decoder context is reset if the frame size changed)
+ * args:
+ *   vd - pointer to video device data
+ *   width - new frame width
+ *   height - new frame height
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int reuse_v4l2_frames(v4l2_dev_t *vd, int width, int height)
+{
+	int ret = E_OK;
+	int i = 0;
+
+	if(width != vd->frames_width || height != vd->frames_height)
+	{
+		/*decoder contexts depend on the frame size*/
+		switch (vd->requested_fmt)
+		{
+			case V4L2_PIX_FMT_H264:
+				ret = h264_init_decoder(width, height);
+				break;
+
+			case V4L2_PIX_FMT_JPEG:
+			case V4L2_PIX_FMT_MJPEG:
+				if (0 == encodeenv)
+					ret = jpeg_init_decoder(width, height);
+				break;
+
+			default:
+				break;
+		}
+
+		if(ret != E_OK)
+			return ret;
+	}
+
+	for(i=0; i<vd->frame_queue_size; ++i)
+		vd->frame_queue[i].raw_frame = NULL;
+
+	vd->h264_last_IDR_size = 0; /*reset (no frame stored)*/
+
+	/*SPS and PPS are retrieved again from the new stream*/
+	if(vd->h264_SPS)
+	{
+		free(vd->h264_SPS);
+		vd->h264_SPS = NULL;
+	}
+	vd->h264_SPS_size = 0;
+
+	if(vd->h264_PPS)
+	{
+		free(vd->h264_PPS);
+		vd->h264_PPS = NULL;
+	}
+	vd->h264_PPS_size = 0;
+
+	vd->frames_width = width;
+	vd->frames_height = height;
+
+	return E_OK;
+}
+
 /*
  * Alloc image buffers for decoding video stream
+ *   buffers (and the decoder context) from a previous allocation
+ *   are kept if the format didn't change and the new frame size fits
  * args:
  *   vd - pointer to video device data
  *
@@ -56,11 +205,6 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 	/*assertions*/
 	assert(vd != NULL);
 
-	if(verbosity > 2)
-		printf("V4L2_CORE: allocating frame buffers\n");
-	/*clean any previous frame buffers*/
-	clean_v4l2_frames(vd);
-
 	int ret = E_OK;
 
 	int i = 0;
@@ -72,6 +216,28 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 	if(width <= 0 || height <= 0)
 		return E_ALLOC_ERR;
 
+	if(vd->frame_queue_size > 0 &&
+	   vd->frame_queue[0].yuv_frame != NULL &&
+	   vd->frames_fmt == vd->requested_fmt &&
+	   width * height <= vd->frames_capacity)
+	{
+		if(reuse_v4l2_frames(vd, width, height) == E_OK)
+		{
+			if(verbosity > 2)
+				printf("V4L2_CORE: reusing frame buffers (%ix%i)\n", width, height);
+
+			set_black_frames(vd, width, height);
+			alloc_yuv16_frames(vd);
+			return E_OK;
+		}
+		/*fall back to a full allocation*/
+	}
+
+	if(verbosity > 2)
+		printf("V4L2_CORE: allocating frame buffers\n");
+	/*clean any previous frame buffers*/
+	clean_v4l2_frames(vd);
+
 	int framesizeIn = (width * height * 3/2); /* 3/2 bytes per pixel*/
 
 	switch (vd->requested_fmt)
@@ -99,7 +265,7 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 					exit(-1);
 				}
 
-                vd->frame_queue[i].yuv_frame = calloc((uint8_t)framesizeIn, sizeof(uint8_t));
+                vd->frame_queue[i].yuv_frame = calloc((size_t) framesizeIn, sizeof(uint8_t));
 				if(vd->frame_queue[i].yuv_frame == NULL)
 				{
 					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
@@ -108,7 +274,7 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 
 			}
 
-            vd->h264_last_IDR = calloc((uint8_t)(width * height), sizeof(uint8_t));
+            vd->h264_last_IDR = calloc((size_t) (width * height), sizeof(uint8_t));
 			if(vd->h264_last_IDR == NULL)
 			{
 				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
@@ -216,9 +382,8 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 
 		case V4L2_PIX_FMT_YUYV:
 			/*
-			 * YUYV doesn't need a temp buffer but we will set it if/when
-			 *  video processing disable is set (bayer processing).
-			 *            (logitech cameras only)
+			 * YUYV doesn't need a temp buffer, bayer data in a yuyv
+			 *  frame (logitech cameras only) is also converted in place
 			 */
             framebuf_size = (size_t) framesizeIn;
 			/*frame queue*/
@@ -240,22 +405,13 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 			/*
 			 * Raw 8 bit bayer
 			 * when grabbing use:
-			 *    bayer_to_rgb24(bayer_data, RGB24_data, width, height, 0..3)
-			 *    rgb2yuyv(RGB24_data, vd->framebuffer, width, height)
+			 *    bayer_to_yu12(yu12_data, bayer_data, width, height, 0..3, isp_params)
+			 *    (no temp buffer is needed)
 			 */
             framebuf_size = (size_t) framesizeIn;
 			/*frame queue*/
 			for(i=0; i<vd->frame_queue_size; ++i)
 			{
-				/* alloc a temp buffer for converting to YUYV*/
-				/* rgb buffer for decoding bayer data*/
-                vd->frame_queue[i].tmp_buffer_max_size =(size_t) (width * height * 3);
-				vd->frame_queue[i].tmp_buffer = calloc(vd->frame_queue[i].tmp_buffer_max_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].tmp_buffer == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
 				vd->frame_queue[i].yuv_frame = calloc(framebuf_size, sizeof(uint8_t));
 				if(vd->frame_queue[i].yuv_frame == NULL)
 				{
@@ -293,18 +449,17 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 			return (ret);
 	}
 
-	for(i=0; i<vd->frame_queue_size; ++i)
-	{
-		int j = 0;
-		/* set framebuffer to black (y=0x00 u=0x80 v=0x80) by default*/
-		uint8_t *pframe = vd->frame_queue[i].yuv_frame;
-		for (j=0; j<width*height; j++)
-		*pframe++=0x00; //Y
-		for(j=0; j<width*height/2; j++)
-		{
-			*pframe++=0x80; //U V
-		}
-	}
+	/* set framebuffer to black (y=0x00 u=0x80 v=0x80) by default*/
+	set_black_frames(vd, width, height);
+
+	/*store the allocation data (for reuse on the next format switch)*/
+	vd->frames_fmt = vd->requested_fmt;
+	vd->frames_width = width;
+	vd->frames_height = height;
+	vd->frames_capacity = width * height;
+
+	alloc_yuv16_frames(vd);
+
 	return (ret);
 }
 
@@ -346,6 +501,13 @@ void clean_v4l2_frames(v4l2_dev_t *vd)
 			free(vd->frame_queue[i].yuv_frame);
 			vd->frame_queue[i].yuv_frame = NULL;
 		}
+
+		if(vd->frame_queue[i].yuv16_frame)
+		{
+			free(vd->frame_queue[i].yuv16_frame);
+			vd->frame_queue[i].yuv16_frame = NULL;
+		}
+		vd->frame_queue[i].yuv16_bits = 0;
 	}
 
 	if(vd->h264_last_IDR)
@@ -366,12 +528,23 @@ void clean_v4l2_frames(v4l2_dev_t *vd)
 		vd->h264_PPS = NULL;
 	}
 
-	if(vd->requested_fmt == V4L2_PIX_FMT_H264)
+	/*
+	 * close the decoder for the format the frames were allocated for
+	 * (requested_fmt may already be set to the next format)
+	 */
+	int fmt = vd->frames_fmt ? vd->frames_fmt : vd->requested_fmt;
+
+	if(fmt == V4L2_PIX_FMT_H264)
 		h264_close_decoder();
 
-	if(vd->requested_fmt == V4L2_PIX_FMT_JPEG ||
-	   vd->requested_fmt == V4L2_PIX_FMT_MJPEG)
+	if(fmt == V4L2_PIX_FMT_JPEG ||
+	   fmt == V4L2_PIX_FMT_MJPEG)
 		jpeg_close_decoder();
+
+	vd->frames_fmt = 0;
+	vd->frames_width = 0;
+	vd->frames_height = 0;
+	vd->frames_capacity = 0;
 }
 
 /*
@@ -767,6 +940,7 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
     int height = (int)vd->format.fmt.pix.height;
 
 	frame->isKeyframe = 0; /*reset*/
+	frame->yuv16_bits = 0; /*reset (set by high bit depth formats)*/
 
 	/*
 	 * use the requested format since it may differ
@@ -910,11 +1084,23 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 			break;
 
 		case V4L2_PIX_FMT_Y10BPACK:
-			y10b_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
+			if(frame->yuv16_frame)
+			{
+				y10b_to_p010(frame->yuv16_frame, frame->yuv_frame, frame->raw_frame, width, height);
+				frame->yuv16_bits = 10;
+			}
+			else
+				y10b_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 			break;
 
 	    case V4L2_PIX_FMT_Y16:
-			y16_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
+			if(frame->yuv16_frame)
+			{
+				y16_to_p016(frame->yuv16_frame, frame->yuv_frame, frame->raw_frame, width, height);
+				frame->yuv16_bits = 16;
+			}
+			else
+				y16_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 			break;
 //#ifdef V4L2_PIX_FMT_Y16_BE
 //		case V4L2_PIX_FMT_Y16_BE:
@@ -936,42 +1122,26 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 		case V4L2_PIX_FMT_YUYV:
 			if(vd->isbayer>0)
 			{
-				if (!(frame->tmp_buffer))
-				{
-					/* rgb buffer for decoding bayer data*/
-                    frame->tmp_buffer_max_size = (size_t)(width * height * 3);
-					frame->tmp_buffer = calloc(frame->tmp_buffer_max_size, sizeof(uint8_t));
-					if(frame->tmp_buffer == NULL)
-					{
-						fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_frame_decode): %s\n", strerror(errno));
-						exit(-1);
-					}
-				}
 				/*convert raw bayer to iyuv*/
-				bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, vd->bayer_pix_order);
-				rgb24_to_yu12(frame->yuv_frame, frame->tmp_buffer, width, height);
+				bayer_to_yu12(frame->yuv_frame, frame->raw_frame, width, height, vd->bayer_pix_order, &vd->isp);
 			}
 			else
 				yuyv_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 			break;
 
 		case V4L2_PIX_FMT_SGBRG8: //0
-			bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, 0);
-			rgb24_to_yu12(frame->yuv_frame, frame->tmp_buffer, width, height);
+			bayer_to_yu12(frame->yuv_frame, frame->raw_frame, width, height, 0, &vd->isp);
 			break;
 
 		case V4L2_PIX_FMT_SGRBG8: //1
-			bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, 1);
-			rgb24_to_yu12(frame->yuv_frame, frame->tmp_buffer, width, height);
+			bayer_to_yu12(frame->yuv_frame, frame->raw_frame, width, height, 1, &vd->isp);
 			break;
 
 		case V4L2_PIX_FMT_SBGGR8: //2
-			bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, 2);
-			rgb24_to_yu12(frame->yuv_frame, frame->tmp_buffer, width, height);
+			bayer_to_yu12(frame->yuv_frame, frame->raw_frame, width, height, 2, &vd->isp);
 			break;
 		case V4L2_PIX_FMT_SRGGB8: //3
-			bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, 3);
-			rgb24_to_yu12(frame->yuv_frame, frame->tmp_buffer, width, height);
+			bayer_to_yu12(frame->yuv_frame, frame->raw_frame, width, height, 3, &vd->isp);
 			break;
 
 		case V4L2_PIX_FMT_RGB24:
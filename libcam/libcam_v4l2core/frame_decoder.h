@@ -55,6 +55,7 @@ int libav_decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket
 
 /*
  * Alloc image buffers for decoding video stream
+ *   (buffers from a previous allocation are reused if possible)
  * args:
  *   vd - pointer to video device data
  *
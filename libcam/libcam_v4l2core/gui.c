@@ -634,7 +634,7 @@ int get_photo_format()
 /*
  * sets photo format
  * args:
- *   format - photo format (IMG_FMT_[JPG|BMP|PNG|RAW])
+ *   format - photo format (IMG_FMT_[JPG|BMP|PNG|RAW|TIFF])
  *
  * asserts:
  *   none
@@ -702,6 +702,9 @@ void set_photo_name(const char *name)
 			case IMG_FMT_BMP:
 				photo_name = set_file_extension(name, "bmp");
 				break;
+			case IMG_FMT_TIFF:
+				photo_name = set_file_extension(name, "tif");
+				break;
 			default:
 				photo_name = set_file_extension(name, "raw");
 				break;
@@ -714,6 +717,9 @@ void set_photo_name(const char *name)
 		set_photo_format(IMG_FMT_PNG);
 	else if ( strcasecmp(ext, "bmp") == 0 )
 		set_photo_format(IMG_FMT_BMP);
+	else if ( strcasecmp(ext, "tif") == 0 ||
+			  strcasecmp(ext, "tiff") == 0 )
+		set_photo_format(IMG_FMT_TIFF);
 	else if ( strcasecmp(ext, "raw") == 0 )
 		set_photo_format(IMG_FMT_RAW);
 
@@ -253,7 +253,7 @@ int get_photo_format();
 /*
  * sets photo format
  * args:
- *   format - photo format (IMG_FMT_[JPG|BMP|PNG|RAW])
+ *   format - photo format (IMG_FMT_[JPG|BMP|PNG|RAW|TIFF])
  *
  * asserts:
  *   none
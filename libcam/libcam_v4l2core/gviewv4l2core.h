@@ -131,6 +131,7 @@ __BEGIN_DECLS
 #define IMG_FMT_JPG     (1)
 #define IMG_FMT_PNG     (2)
 #define IMG_FMT_BMP     (3)
+#define IMG_FMT_TIFF    (4)
 
 
 /*
@@ -225,6 +226,7 @@ typedef struct _v4l2_ctrl_t {
     int32_t value; //also used for string max size
     int64_t value64;
     char *string;
+    int event_sub; //set if control events are subscribed (value kept current by events)
 
     /*localization*/
     char *name; /*gettext translated name*/
@@ -235,6 +237,33 @@ typedef struct _v4l2_ctrl_t {
     struct _v4l2_ctrl_t *next;
 } v4l2_ctrl_t;
 
+/*
+ * control batch timing/result data (from the last committed batch)
+ */
+typedef struct _v4l2_ctrl_batch_stats_t {
+    int num_controls;        //number of controls in the batch
+    int num_skipped;         //controls skipped (grabbed by their auto control)
+    int num_failed;          //controls rejected by the driver
+    int num_batches;         //number of (class, phase) groups
+    int num_ioctls;          //number of set ioctls issued
+    uint64_t total_time;     //time spent applying the batch (ns)
+    uint64_t max_batch_time; //time spent on the slowest group (ns)
+} v4l2_ctrl_batch_stats_t;
+
+/* control batch - opaque data structure*/
+typedef struct _v4l2_ctrl_batch_t v4l2_ctrl_batch_t;
+
+/*
+ * software isp parameters for raw bayer streams
+ */
+typedef struct _v4l2_isp_params_t {
+    int black_level;         //sensor black level (0-254), subtracted from the raw data
+    int gain_r;              //red white balance gain (Q8: 256 = 1.0)
+    int gain_g;              //green white balance gain (Q8: 256 = 1.0)
+    int gain_b;              //blue white balance gain (Q8: 256 = 1.0)
+    int threads;             //number of row strips processed in parallel (0 - auto)
+} v4l2_isp_params_t;
+
 /*
  * frame buffer struct
  */
@@ -260,6 +289,9 @@ typedef struct _v4l2_frame_buff_t {
     uint8_t *h264_frame; // pointer to regular or demultiplexed h264 frame
     uint8_t *tmp_buffer; //temporary buffer used in decoding
 
+    uint16_t *yuv16_frame; // high bit depth frame (p010/p016 layout: 16 bit y plane + 16 bit interleaved uv plane) or NULL
+    int yuv16_bits; // significant (msb aligned) bits in yuv16_frame for the current frame (0 - not available)
+
 } v4l2_frame_buff_t;
 
 /*
@@ -407,6 +439,60 @@ void v4l2core_set_isbayer(v4l2_dev_t *vd, uint8_t flag);
  */
 uint8_t v4l2core_get_isbayer(v4l2_dev_t *vd);
 
+/*
+ * enable the high bit depth (p010/p016) frame buffers for 10 and 16 bit
+ *   formats (takes effect on the next stream format update)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   enable - 1 to decode to frame->yuv16_frame (besides frame->yuv_frame), 0 to disable
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns - void
+ */
+void v4l2core_set_high_bit_depth(v4l2_dev_t *vd, int enable);
+
+/*
+ * gets the high bit depth (p010/p016) frame buffers flag
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns - 1 if enabled, 0 otherwise
+ */
+int v4l2core_get_high_bit_depth(v4l2_dev_t *vd);
+
+/*
+ * sets the software isp parameters (raw bayer streams)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   params - pointer to isp parameters
+ *
+ * asserts:
+ *   vd is not null
+ *   params is not null
+ *
+ * returns - void
+ */
+void v4l2core_set_isp_params(v4l2_dev_t *vd, const v4l2_isp_params_t *params);
+
+/*
+ * gets the software isp parameters (raw bayer streams)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   params - pointer to isp parameters to fill
+ *
+ * asserts:
+ *   vd is not null
+ *   params is not null
+ *
+ * returns - void
+ */
+void v4l2core_get_isp_params(v4l2_dev_t *vd, v4l2_isp_params_t *params);
+
 /*
  * gets current device index
  * args:
@@ -808,6 +894,36 @@ int v4l2core_update_old_format(v4l2_dev_t *vd, int width, int height, int pixelf
  */
 int v4l2core_update_current_format(v4l2_dev_t *vd);
 
+/*
+ * switch to the format and resolution prepared with
+ *   v4l2core_prepare_new_format/resolution, keeping the stream,
+ *   frame buffers and decoder context whenever possible
+ *   (falls back to the first listed format on error)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns:
+ *    error code (stream is restarted on E_OK)
+ */
+int v4l2core_switch_format(v4l2_dev_t *vd);
+
+/*
+ * get the time of the last format switch
+ *   (from v4l2core_switch_format to the first decoded frame)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns:
+ *    switch time in ns (0 if none completed)
+ */
+uint64_t v4l2core_get_format_switch_time(v4l2_dev_t *vd);
+
 /*
  * gets the next video frame (must be released after processing)
  * args:
@@ -847,6 +963,7 @@ v4l2_frame_buff_t *v4l2core_get_decoded_frame(v4l2_dev_t *vd);
 
 /*
  * clean v4l2 buffers
+ *   (decoded frame buffers are kept for reuse until the device is closed)
  * args:
  *    vd - pointer to v4l2 device handler
  *
@@ -986,6 +1103,88 @@ int v4l2core_get_control_value_by_id(v4l2_dev_t *vd, int id);
  */
 void v4l2core_set_control_defaults(v4l2_dev_t *vd);
 
+/*
+ * get the cached value of control id (no ioctl, safe to call from any thread)
+ *  values are kept current by control events, processed while streaming
+ *  or on v4l2core_check_control_events
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   id - control id
+ *   value - pointer to value (set on return)
+ *
+ * asserts:
+ *   vd is not null
+ *   value is not null
+ *
+ * returns: E_OK if the cached value is event backed, E_NO_DATA if it may be
+ *   stale (use v4l2core_get_control_value_by_id), E_UNKNOWN_CID_ERR if unknown
+ */
+int v4l2core_get_control_cached_value(v4l2_dev_t *vd, int id, int32_t *value);
+
+/*
+ * start a new control batch
+ *  controls added to the batch are written on commit, grouped by
+ *  control class in single VIDIOC_S_EXT_CTRLS calls and ordered so
+ *  that auto controls never block their manual counterparts
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to new batch or null on error
+ */
+v4l2_ctrl_batch_t *v4l2core_control_batch_begin(v4l2_dev_t *vd);
+
+/*
+ * add control id to the batch, using its current value from the control list
+ * args:
+ *   batch - pointer to control batch
+ *   id - control id
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: error code (E_OK or E_UNKNOWN_CID_ERR)
+ */
+int v4l2core_control_batch_add(v4l2_ctrl_batch_t *batch, int id);
+
+/*
+ * write all controls in the batch to the device and free the batch
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: number of controls that failed to set
+ */
+int v4l2core_control_batch_commit(v4l2_ctrl_batch_t *batch);
+
+/*
+ * free the batch without writing any control
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void v4l2core_control_batch_abort(v4l2_ctrl_batch_t *batch);
+
+/*
+ * get timing/result data of the last committed control batch
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to control batch stats
+ */
+const v4l2_ctrl_batch_stats_t *v4l2core_get_control_batch_stats(v4l2_dev_t *vd);
+
 /*
  * set autofocus sort method
  * args:
@@ -1408,7 +1607,7 @@ int v4l2core_save_data_to_file(const char *filename, uint8_t *data, int size);
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
- *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP, IMG_FMT_TIFF)
  *
  * asserts:
  *    none
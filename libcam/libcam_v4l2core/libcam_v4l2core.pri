@@ -1,4 +1,5 @@
 HEADERS += \
+    $$PWD/bayer_isp.h \
     $$PWD/colorspaces.h \
     $$PWD/control_profile.h \
     $$PWD/core_io.h \
@@ -19,6 +20,7 @@ HEADERS += \
     $$PWD/v4l2_xu_ctrls.h
 
 SOURCES += \
+    $$PWD/bayer_isp.c \
     $$PWD/colorspaces.c \
     $$PWD/control_profile.c \
     $$PWD/core_io.c \
@@ -30,7 +32,8 @@ SOURCES += \
     $$PWD/save_image_bmp.c \
     $$PWD/save_image.c \
     $$PWD/save_image_jpeg.c \
-#    $$PWD/save_image_png.c \
+    $$PWD/save_image_png.c \
+    $$PWD/save_image_tiff.c \
     $$PWD/soft_autofocus.c \
     $$PWD/uvc_h264.c \
     $$PWD/v4l2_controls.c \
@@ -75,7 +75,7 @@ int v4l2core_save_data_to_file(const char *filename, uint8_t *data, int size)
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
- *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP, IMG_FMT_TIFF)
  *
  * asserts:
  *    none
@@ -106,11 +106,17 @@ int save_frame_image(v4l2_frame_buff_t *frame, const char *filename, int format)
 			ret = save_image_bmp(frame, filename);
 			break;
 
-//		case IMG_FMT_PNG:
-//			if(verbosity > 0)
-//				printf("V4L2_CORE: saving png frame to %s\n", filename);
-//			ret = save_image_png(frame, filename);
-//			break;
+		case IMG_FMT_PNG:
+			if(verbosity > 0)
+				printf("V4L2_CORE: saving png frame to %s\n", filename);
+			ret = save_image_png(frame, filename);
+			break;
+
+		case IMG_FMT_TIFF:
+			if(verbosity > 0)
+				printf("V4L2_CORE: saving tiff frame to %s\n", filename);
+			ret = save_image_tiff(frame, filename);
+			break;
 
 		default:
 			fprintf(stderr, "V4L2_CORE: (save_image) Image format %i not supported\n", format);
@@ -72,7 +72,7 @@ typedef struct _jpeg_encoder_ctx_t {
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
- *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP, IMG_FMT_TIFF)
  *
  * asserts:
  *    vd is not null
@@ -109,16 +109,31 @@ int save_image_bmp(v4l2_frame_buff_t *frame, const char *filename);
 
 /*
  * save frame data into a png file
+ *   high bit depth frames are saved as 16 bit greyscale
  * args:
  *    frame - pointer to frame buffer
  *    filename - string with png filename name
  *
  * asserts:
- *   vd is not null
+ *   frame is not null
  *
  * returns: error code
  */
-//int save_image_png(v4l2_frame_buff_t *frame, const char *filename);
+int save_image_png(v4l2_frame_buff_t *frame, const char *filename);
+
+/*
+ * save frame data into a tiff file
+ *   high bit depth frames are saved as 16 bit greyscale
+ * args:
+ *    frame - pointer to frame buffer
+ *    filename - string with tiff filename name
+ *
+ * asserts:
+ *   frame is not null
+ *
+ * returns: error code
+ */
+int save_image_tiff(v4l2_frame_buff_t *frame, const char *filename);
 
 /*
  * encode jpeg
@@ -0,0 +1,355 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gviewv4l2core.h"
+#include "save_image.h"
+#include "colorspaces.h"
+
+extern int verbosity;
+
+/*max data in a deflate stored block*/
+#define PNG_STORED_BLOCK_MAX 65535
+
+static uint32_t crc_table[256];
+static int crc_table_computed = 0;
+
+/*
+ * build the png crc table
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void make_crc_table(void)
+{
+	uint32_t n = 0;
+	for (n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		int k = 0;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320L ^ (c >> 1) : c >> 1;
+		crc_table[n] = c;
+	}
+	crc_table_computed = 1;
+}
+
+/*
+ * update a running png crc
+ * args:
+ *   crc - current crc
+ *   buf - pointer to data
+ *   len - data length
+ *
+ * asserts:
+ *   none
+ *
+ * returns: updated crc
+ */
+static uint32_t update_crc(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	size_t n = 0;
+
+	if (!crc_table_computed)
+		make_crc_table();
+
+	for (n = 0; n < len; n++)
+		crc = crc_table[(crc ^ buf[n]) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+/*
+ * compute the zlib adler32 checksum
+ * args:
+ *   buf - pointer to data
+ *   len - data length
+ *
+ * asserts:
+ *   none
+ *
+ * returns: adler32 checksum
+ */
+static uint32_t adler32(const uint8_t *buf, size_t len)
+{
+	uint32_t a = 1;
+	uint32_t b = 0;
+
+	while(len > 0)
+	{
+		/*largest block that can't overflow b*/
+		size_t n = len < 5552 ? len : 5552;
+		len -= n;
+		while(n--)
+		{
+			a += *buf++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t) (v >> 24);
+	p[1] = (uint8_t) (v >> 16);
+	p[2] = (uint8_t) (v >> 8);
+	p[3] = (uint8_t) v;
+}
+
+/*
+ * write a png chunk
+ * args:
+ *   fp - pointer to output file
+ *   type - chunk type (4 chars)
+ *   data - chunk data
+ *   len - chunk data length
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of failed writes
+ */
+static int write_chunk(FILE *fp, const char *type, const uint8_t *data, uint32_t len)
+{
+	uint8_t head[8];
+	uint8_t tail[4];
+
+	put_be32(head, len);
+	memcpy(head + 4, type, 4);
+
+	uint32_t crc = update_crc(0xffffffffL, head + 4, 4);
+	crc = update_crc(crc, data, len) ^ 0xffffffffL;
+	put_be32(tail, crc);
+
+	int err = 0;
+	if(fwrite(head, 8, 1, fp) < 1)
+		err++;
+	if(len > 0 && fwrite(data, len, 1, fp) < 1)
+		err++;
+	if(fwrite(tail, 4, 1, fp) < 1)
+		err++;
+
+	return err;
+}
+
+/*
+ * save png image data to file
+ *   (stored deflate blocks - no compression library needed)
+ * args:
+ *   filename - png file name
+ *   rows - image rows, each prefixed with its filter byte
+ *   rows_size - size of rows data
+ *   width - image width
+ *   height - image height
+ *   bit_depth - bits per sample (8 or 16)
+ *   color_type - png color type (0 - grey, 2 - rgb)
+ *   sig_bits - significant bits per sample (sBIT), 0 if all
+ *
+ * asserts:
+ *   rows is not null
+ *
+ * returns: error code
+ */
+static int save_png(const char *filename, const uint8_t *rows, size_t rows_size,
+	int width, int height, int bit_depth, int color_type, int sig_bits)
+{
+	/*assertions*/
+	assert(rows != NULL);
+
+	static const uint8_t png_sig[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+	size_t nblocks = (rows_size + PNG_STORED_BLOCK_MAX - 1) / PNG_STORED_BLOCK_MAX;
+	if(nblocks == 0)
+		nblocks = 1;
+	size_t zsize = 2 + rows_size + (5 * nblocks) + 4;
+
+	uint8_t *zdata = malloc(zsize);
+	if(zdata == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_png): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/*zlib header: deflate, 32K window, no preset dictionary*/
+	uint8_t *pz = zdata;
+	*pz++ = 0x78;
+	*pz++ = 0x01;
+
+	size_t left = rows_size;
+	const uint8_t *prow = rows;
+	do
+	{
+		uint16_t n = (uint16_t) (left < PNG_STORED_BLOCK_MAX ? left : PNG_STORED_BLOCK_MAX);
+		left -= n;
+
+		*pz++ = (left == 0) ? 1 : 0; /*BFINAL, BTYPE = 00 (stored)*/
+		*pz++ = (uint8_t) (n & 0xff);
+		*pz++ = (uint8_t) (n >> 8);
+		*pz++ = (uint8_t) (~n & 0xff);
+		*pz++ = (uint8_t) ((~n >> 8) & 0xff);
+		memcpy(pz, prow, n);
+		pz += n;
+		prow += n;
+	}
+	while(left > 0);
+
+	put_be32(pz, adler32(rows, rows_size));
+
+	uint8_t ihdr[13];
+	put_be32(ihdr, (uint32_t) width);
+	put_be32(ihdr + 4, (uint32_t) height);
+	ihdr[8] = (uint8_t) bit_depth;
+	ihdr[9] = (uint8_t) color_type;
+	ihdr[10] = 0; /*compression: deflate*/
+	ihdr[11] = 0; /*filter: adaptive (all rows use none)*/
+	ihdr[12] = 0; /*no interlace*/
+
+	int ret = E_OK;
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: (save png) could not open file %s for write \n",
+			filename);
+		free(zdata);
+		return E_FILE_IO_ERR;
+	}
+
+	int err = 0;
+	if(fwrite(png_sig, 8, 1, fp) < 1)
+		err++;
+	err += write_chunk(fp, "IHDR", ihdr, 13);
+	if(sig_bits > 0 && sig_bits < bit_depth)
+	{
+		uint8_t sbit[3] = {(uint8_t) sig_bits, (uint8_t) sig_bits, (uint8_t) sig_bits};
+		err += write_chunk(fp, "sBIT", sbit, (color_type == 2) ? 3 : 1);
+	}
+	err += write_chunk(fp, "IDAT", zdata, (uint32_t) zsize);
+	err += write_chunk(fp, "IEND", NULL, 0);
+
+	if(err)
+		ret = E_FILE_IO_ERR;
+
+	fflush(fp); //flush data stream to file system
+	if(fsync(fileno(fp)) || fclose(fp))
+	{
+		fprintf(stderr, "V4L2_CORE: (save png) couldn't write to file %s: %s\n",
+			filename, strerror(errno));
+		ret = E_FILE_IO_ERR;
+	}
+
+	free(zdata);
+	return ret;
+}
+
+/*
+ * save frame data into a png file
+ *   high bit depth frames (frame->yuv16_bits > 0) are saved as
+ *   16 bit greyscale, all others as 8 bit rgb
+ * args:
+ *    frame - pointer to frame buffer
+ *    filename - string with png filename name
+ *
+ * asserts:
+ *   frame is not null
+ *
+ * returns: error code
+ */
+int save_image_png(v4l2_frame_buff_t *frame, const char *filename)
+{
+	/*assertions*/
+	assert(frame != NULL);
+
+	int ret = E_OK;
+	int width = frame->width;
+	int height = frame->height;
+	int h = 0;
+	int w = 0;
+
+	if(frame->yuv16_frame && frame->yuv16_bits > 0)
+	{
+		size_t row_size = 1 + (size_t) width * 2;
+		uint8_t *rows = malloc(row_size * height);
+		if(rows == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		/*png samples are big endian*/
+		uint16_t *py = frame->yuv16_frame;
+		for(h = 0; h < height; h++)
+		{
+			uint8_t *prow = rows + (h * row_size);
+			*prow++ = 0; /*filter: none*/
+			for(w = 0; w < width; w++)
+			{
+				*prow++ = (uint8_t) (*py >> 8);
+				*prow++ = (uint8_t) (*py & 0xff);
+				py++;
+			}
+		}
+
+		ret = save_png(filename, rows, row_size * height, width, height, 16, 0, frame->yuv16_bits);
+		free(rows);
+	}
+	else
+	{
+		size_t row_size = 1 + (size_t) width * 3;
+		uint8_t *rgb = calloc(width * height * 3, sizeof(uint8_t));
+		uint8_t *rows = malloc(row_size * height);
+		if(rgb == NULL || rows == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		yu12_to_rgb24(rgb, frame->yuv_frame, width, height);
+
+		for(h = 0; h < height; h++)
+		{
+			uint8_t *prow = rows + (h * row_size);
+			prow[0] = 0; /*filter: none*/
+			memcpy(prow + 1, rgb + (h * width * 3), width * 3);
+		}
+
+		ret = save_png(filename, rows, row_size * height, width, height, 8, 2, 0);
+		free(rows);
+		free(rgb);
+	}
+
+	return ret;
+}
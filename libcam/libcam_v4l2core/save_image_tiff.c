@@ -0,0 +1,202 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gviewv4l2core.h"
+#include "save_image.h"
+#include "colorspaces.h"
+
+extern int verbosity;
+
+/*tiff tags*/
+#define TIFF_TAG_IMAGE_WIDTH       256
+#define TIFF_TAG_IMAGE_LENGTH      257
+#define TIFF_TAG_BITS_PER_SAMPLE   258
+#define TIFF_TAG_COMPRESSION       259
+#define TIFF_TAG_PHOTOMETRIC       262
+#define TIFF_TAG_STRIP_OFFSETS     273
+#define TIFF_TAG_SAMPLES_PER_PIXEL 277
+#define TIFF_TAG_ROWS_PER_STRIP    278
+#define TIFF_TAG_STRIP_BYTE_COUNTS 279
+#define TIFF_TAG_PLANAR_CONFIG     284
+
+/*tiff field types*/
+#define TIFF_SHORT 3
+#define TIFF_LONG  4
+
+#define TIFF_NUM_ENTRIES 10
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+/*
+ * fill a tiff ifd entry
+ * args:
+ *   p - pointer to entry (12 bytes)
+ *   tag - tiff tag
+ *   type - field type (TIFF_SHORT or TIFF_LONG)
+ *   count - number of values
+ *   value - value (or offset to the values)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void put_entry(uint8_t *p, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+{
+	put_le16(p, tag);
+	put_le16(p + 2, type);
+	put_le32(p + 4, count);
+	if(type == TIFF_SHORT && count == 1)
+	{
+		put_le16(p + 8, (uint16_t) value);
+		put_le16(p + 10, 0);
+	}
+	else
+		put_le32(p + 8, value);
+}
+
+/*
+ * save frame data into a tiff file (uncompressed, single strip)
+ *   high bit depth frames (frame->yuv16_bits > 0) are saved as
+ *   16 bit greyscale, all others as 8 bit rgb
+ * args:
+ *    frame - pointer to frame buffer
+ *    filename - string with tiff filename name
+ *
+ * asserts:
+ *   frame is not null
+ *
+ * returns: error code
+ */
+int save_image_tiff(v4l2_frame_buff_t *frame, const char *filename)
+{
+	/*assertions*/
+	assert(frame != NULL);
+
+	int width = frame->width;
+	int height = frame->height;
+	int hbd = (frame->yuv16_frame && frame->yuv16_bits > 0);
+
+	int spp = hbd ? 1 : 3; /*samples per pixel*/
+	int bps = hbd ? 16 : 8; /*bits per sample*/
+	uint32_t data_size = (uint32_t) width * height * spp * (bps / 8);
+
+	/*header | ifd | bits per sample values (rgb) | image data*/
+	uint32_t ifd_offset = 8;
+	uint32_t ifd_size = 2 + (TIFF_NUM_ENTRIES * 12) + 4;
+	uint32_t bps_offset = ifd_offset + ifd_size;
+	uint32_t data_offset = bps_offset + ((spp > 1) ? 6 : 0);
+
+	uint8_t *tiff = calloc(data_offset + data_size, sizeof(uint8_t));
+	if(tiff == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_tiff): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/*little endian header*/
+	tiff[0] = 'I';
+	tiff[1] = 'I';
+	put_le16(tiff + 2, 42);
+	put_le32(tiff + 4, ifd_offset);
+
+	uint8_t *p = tiff + ifd_offset;
+	put_le16(p, TIFF_NUM_ENTRIES);
+	p += 2;
+	put_entry(p, TIFF_TAG_IMAGE_WIDTH, TIFF_LONG, 1, (uint32_t) width); p += 12;
+	put_entry(p, TIFF_TAG_IMAGE_LENGTH, TIFF_LONG, 1, (uint32_t) height); p += 12;
+	if(spp > 1)
+		put_entry(p, TIFF_TAG_BITS_PER_SAMPLE, TIFF_SHORT, (uint32_t) spp, bps_offset);
+	else
+		put_entry(p, TIFF_TAG_BITS_PER_SAMPLE, TIFF_SHORT, 1, (uint32_t) bps);
+	p += 12;
+	put_entry(p, TIFF_TAG_COMPRESSION, TIFF_SHORT, 1, 1); p += 12; /*none*/
+	put_entry(p, TIFF_TAG_PHOTOMETRIC, TIFF_SHORT, 1, (spp > 1) ? 2 : 1); p += 12; /*rgb : black is zero*/
+	put_entry(p, TIFF_TAG_STRIP_OFFSETS, TIFF_LONG, 1, data_offset); p += 12;
+	put_entry(p, TIFF_TAG_SAMPLES_PER_PIXEL, TIFF_SHORT, 1, (uint32_t) spp); p += 12;
+	put_entry(p, TIFF_TAG_ROWS_PER_STRIP, TIFF_LONG, 1, (uint32_t) height); p += 12;
+	put_entry(p, TIFF_TAG_STRIP_BYTE_COUNTS, TIFF_LONG, 1, data_size); p += 12;
+	put_entry(p, TIFF_TAG_PLANAR_CONFIG, TIFF_SHORT, 1, 1); p += 12; /*chunky*/
+	put_le32(p, 0); /*no next ifd*/
+
+	if(spp > 1)
+	{
+		int i = 0;
+		for(i = 0; i < spp; i++)
+			put_le16(tiff + bps_offset + (i * 2), (uint16_t) bps);
+	}
+
+	uint8_t *pdata = tiff + data_offset;
+	if(hbd)
+	{
+		int i = 0;
+		for(i = 0; i < width * height; i++)
+			put_le16(pdata + (i * 2), frame->yuv16_frame[i]);
+	}
+	else
+		yu12_to_rgb24(pdata, frame->yuv_frame, width, height);
+
+	int ret = E_OK;
+	FILE *fp = fopen(filename, "wb");
+	if(fp != NULL)
+	{
+		if(fwrite(tiff, data_offset + data_size, 1, fp) < 1)
+			ret = E_FILE_IO_ERR;
+
+		fflush(fp); //flush data stream to file system
+		if(fsync(fileno(fp)) || fclose(fp))
+		{
+			fprintf(stderr, "V4L2_CORE: (save tiff) couldn't write to file %s: %s\n",
+				filename, strerror(errno));
+			ret = E_FILE_IO_ERR;
+		}
+	}
+	else
+	{
+		fprintf(stderr, "V4L2_CORE: (save tiff) could not open file %s for write \n",
+			filename);
+		ret = E_FILE_IO_ERR;
+	}
+
+	free(tiff);
+	return ret;
+}
@@ -38,6 +38,7 @@
 #include "v4l2_xu_ctrls.h"
 #include "cameraconfig.h"
 #include "load_libs.h"
+#include "core_time.h"
 
 #ifndef V4L2_CTRL_ID2CLASS
 #define V4L2_CTRL_ID2CLASS(id)    ((id) & 0x0fff0000UL)
@@ -315,9 +316,9 @@ static uint8_t get_logitech_peripheral_unit_id (v4l2_dev_t *vd)
  * asserts:
  *  vd is not null
  *
- * return: none
+ * return: ioctl result
  */
-void v4l2_subscribe_control_events(v4l2_dev_t *vd, unsigned int control_id)
+int v4l2_subscribe_control_events(v4l2_dev_t *vd, unsigned int control_id)
 {
 	vd->evsub.type = V4L2_EVENT_CTRL;
 	vd->evsub.id = control_id;
@@ -327,6 +328,8 @@ void v4l2_subscribe_control_events(v4l2_dev_t *vd, unsigned int control_id)
 	if(ret)
 		fprintf(stderr, "V4L2_CORE: failed to subscribe events for control 0x%08x: %s\n",
 			control_id, strerror(errno));
+
+	return ret;
 }
 
 /*
@@ -515,11 +518,71 @@ static v4l2_ctrl_t *add_control(v4l2_dev_t *vd, struct v4l2_queryctrl* queryctrl
     }
 
 	//subscribe control events
-	v4l2_subscribe_control_events(vd, queryctrl->id);
+	control->event_sub = (v4l2_subscribe_control_events(vd, queryctrl->id) == 0);
 
     return control;
 }
 
+/*
+ * control id hash
+ * args:
+ *   id - control id
+ *
+ * asserts:
+ *   none
+ *
+ * returns: hash value
+ */
+static inline uint32_t control_id_hash(uint32_t id)
+{
+	/*control ids are mostly sequential within a class*/
+	id ^= id >> 16;
+	id *= 0x45d9f3bU;
+	id ^= id >> 16;
+	return id;
+}
+
+/*
+ * build the control id hash table (vd->ctrl_hash)
+ *  the table is never modified after this, so lookups need no locking
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->ctrl_hash is null
+ *
+ * returns: void
+ */
+static void build_control_hash(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+	assert(vd->ctrl_hash == NULL);
+
+	/*keep the load factor under 0.5*/
+	uint32_t size = 16;
+	while(size < (uint32_t) vd->num_controls * 2)
+		size <<= 1;
+
+	vd->ctrl_hash = calloc(size, sizeof(v4l2_ctrl_t *));
+	if(vd->ctrl_hash == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (build_control_hash): %s\n", strerror(errno));
+		exit(-1);
+	}
+	vd->ctrl_hash_mask = size - 1;
+
+	v4l2_ctrl_t *current = vd->list_device_controls;
+	for(; current != NULL; current = current->next)
+	{
+		uint32_t i = control_id_hash(current->control.id) & vd->ctrl_hash_mask;
+		while(vd->ctrl_hash[i] != NULL)
+			i = (i + 1) & vd->ctrl_hash_mask;
+		vd->ctrl_hash[i] = current;
+	}
+}
+
 /*
  * enumerate device (read/write) controls
  * args:
@@ -562,6 +625,7 @@ int enumerate_v4l2_control(v4l2_dev_t *vd)
 	if (queryctrl.id != V4L2_CTRL_FLAG_NEXT_CTRL)
 	{
 		vd->num_controls = n;
+		build_control_hash(vd);
 		if(verbosity > 0)
 			print_control_list(vd);
 		return E_OK;
@@ -605,6 +669,7 @@ int enumerate_v4l2_control(v4l2_dev_t *vd)
 	}
 
     vd->num_controls = n;
+    build_control_hash(vd);
 
     if(verbosity > 0)
 		print_control_list(vd);
@@ -987,7 +1052,7 @@ void get_v4l2_control_values (v4l2_dev_t *vd)
                         ctrl->value64 = clist[i].value64;
                         break;
                     default:
-                        ctrl->value = clist[i].value;
+                        __atomic_store_n(&ctrl->value, clist[i].value, __ATOMIC_RELEASE);
                         //printf("V4L2_CORE: control %i [0x%08x] = %i\n",
                         //    i, clist[i].id, clist[i].value);
                         break;
@@ -1017,12 +1082,20 @@ v4l2_ctrl_t *get_control_by_id(v4l2_dev_t *vd, int id)
 	/*asserts*/
 	assert(vd != NULL);
 	
+	if(vd->ctrl_hash != NULL)
+	{
+		uint32_t i = control_id_hash((uint32_t) id) & vd->ctrl_hash_mask;
+		for(; vd->ctrl_hash[i] != NULL; i = (i + 1) & vd->ctrl_hash_mask)
+		{
+			if(vd->ctrl_hash[i]->control.id == (__u32)id)
+				return vd->ctrl_hash[i];
+		}
+		return(NULL);
+	}
+
 	v4l2_ctrl_t *current = vd->list_device_controls;
     for(; current != NULL; current = current->next)
     {
-//		if(current == NULL)
-//			break;
-
         if(current->control.id == (__u32)id)
             return (current);
     }
@@ -1030,6 +1103,36 @@ v4l2_ctrl_t *get_control_by_id(v4l2_dev_t *vd, int id)
     return(NULL);
 }
 
+/*
+ * get the cached value of control id (no ioctl)
+ *  the value is read atomically, so this can be called from any thread
+ * args:
+ *   vd - pointer to video device data
+ *   id - control id
+ *   value - pointer to value (set on return)
+ *
+ * asserts:
+ *   vd is not null
+ *   value is not null
+ *
+ * returns: E_OK if event backed, E_NO_DATA if it may be stale
+ *   or E_UNKNOWN_CID_ERR
+ */
+int get_control_cached_value(v4l2_dev_t *vd, int id, int32_t *value)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(value != NULL);
+
+	v4l2_ctrl_t *control = get_control_by_id(vd, id);
+	if(!control)
+		return E_UNKNOWN_CID_ERR;
+
+	*value = __atomic_load_n(&control->value, __ATOMIC_ACQUIRE);
+
+	return control->event_sub ? E_OK : E_NO_DATA;
+}
+
 /*
  * updates the value for control id from the device
  * also updates control flags
@@ -1069,7 +1172,7 @@ int get_control_value_by_id (v4l2_dev_t *vd, int id)
             fprintf(stderr, "V4L2_CORE: control id: 0x%08x failed to get value (error %i)\n",
                 ctrl.id, ret);
         else
-            control->value = ctrl.value;
+            __atomic_store_n(&control->value, ctrl.value, __ATOMIC_RELEASE);
     }
     else
     {
@@ -1113,7 +1216,7 @@ int get_control_value_by_id (v4l2_dev_t *vd, int id)
                     break;
 
                 default:
-                    control->value = ctrl.value;
+                    __atomic_store_n(&control->value, ctrl.value, __ATOMIC_RELEASE);
                     //printf("V4L2_CORE: control %i [0x%08x] = %i\n",
                     //    i, clist[i].id, clist[i].value);
                     break;
@@ -1127,150 +1230,581 @@ int get_control_value_by_id (v4l2_dev_t *vd, int id)
 }
 
 /*
- * goes trough the control list and sets values in device
+ * control batch phases (applied in this order)
+ */
+#define CTRL_PHASE_AUTO_OFF (0) /*auto controls going to manual mode*/
+#define CTRL_PHASE_REGULAR  (1) /*everything else*/
+#define CTRL_PHASE_AUTO_ON  (2) /*auto controls going to an automatic mode*/
+
+/*
+ * control batch entry
+ */
+typedef struct _v4l2_ctrl_batch_entry_t
+{
+    int index;                   //insertion order (keeps sort stable)
+    int phase;                   //CTRL_PHASE_XXX
+    int failed;                  //set if the driver rejected the control
+    int32_t cclass;              //control class
+    struct v4l2_ext_control ctrl;//control data (string is owned by the entry)
+} v4l2_ctrl_batch_entry_t;
+
+/*
+ * control batch
+ */
+struct _v4l2_ctrl_batch_t
+{
+    v4l2_dev_t *vd;
+    v4l2_ctrl_batch_entry_t *entries;
+    int count;
+    int size;
+};
+
+/*
+ * auto controls and the manual controls they may take over
+ */
+static const struct
+{
+    int auto_id;
+    int manual_id[3];
+} auto_ctrl_deps[] =
+{
+    {V4L2_CID_EXPOSURE_AUTO, {V4L2_CID_EXPOSURE_ABSOLUTE, V4L2_CID_IRIS_ABSOLUTE, V4L2_CID_IRIS_RELATIVE}},
+    {V4L2_CID_FOCUS_AUTO, {V4L2_CID_FOCUS_ABSOLUTE, V4L2_CID_FOCUS_RELATIVE, 0}},
+    {V4L2_CID_HUE_AUTO, {V4L2_CID_HUE, 0, 0}},
+    {V4L2_CID_AUTO_WHITE_BALANCE, {V4L2_CID_WHITE_BALANCE_TEMPERATURE, V4L2_CID_BLUE_BALANCE, V4L2_CID_RED_BALANCE}},
+    {V4L2_CID_AUTOGAIN, {V4L2_CID_GAIN, 0, 0}},
+};
+
+#define N_AUTO_CTRL_DEPS ((int)(sizeof(auto_ctrl_deps)/sizeof(auto_ctrl_deps[0])))
+
+/*
+ * check if auto control auto_id set to value takes over control id
+ *  (same rules as update_ctrl_flags)
  * args:
- *   vd - pointer to video device data
+ *   auto_id - auto control id
+ *   value - auto control value
+ *   id - manual control id
  *
  * asserts:
- *   vd is not null
- *   vd->fd is valid
+ *   none
  *
- * returns: void
+ * returns: 1 if id is grabbed, 0 otherwise
  */
-void set_v4l2_control_values (v4l2_dev_t *vd)
+static int auto_ctrl_grabs(int auto_id, int32_t value, int id)
 {
-	/*asserts*/
-	assert(vd != NULL);
-	assert(vd->fd > 0);
-	
-	if(vd->list_device_controls == NULL)
-	{
-		printf("V4L2_CORE: (set control values) empty control list\n");
-		return;
-	}
+    if(auto_id == V4L2_CID_EXPOSURE_AUTO)
+    {
+        switch(value)
+        {
+            case V4L2_EXPOSURE_AUTO:
+                return (id == V4L2_CID_EXPOSURE_ABSOLUTE ||
+                    id == V4L2_CID_IRIS_ABSOLUTE || id == V4L2_CID_IRIS_RELATIVE);
+            case V4L2_EXPOSURE_APERTURE_PRIORITY:
+                return (id == V4L2_CID_EXPOSURE_ABSOLUTE);
+            case V4L2_EXPOSURE_SHUTTER_PRIORITY:
+                return (id == V4L2_CID_IRIS_ABSOLUTE || id == V4L2_CID_IRIS_RELATIVE);
+            default:
+                return 0;
+        }
+    }
 
-    int ret = 0;
-    struct v4l2_ext_control clist[vd->num_controls];
-    v4l2_ctrl_t *current = vd->list_device_controls;
+    return (value > 0);
+}
 
-    int count = 0;
+/*
+ * get the target value for control id: from the batch if queued there,
+ *  otherwise the current value in the control list
+ * args:
+ *   batch - pointer to control batch
+ *   id - control id
+ *   value - pointer to value (set on return)
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: 1 if the control exists, 0 otherwise
+ */
+static int control_batch_target_value(v4l2_ctrl_batch_t *batch, int id, int32_t *value)
+{
     int i = 0;
+    for(i = 0; i < batch->count; i++)
+    {
+        if(batch->entries[i].ctrl.id == (__u32)id)
+        {
+            *value = batch->entries[i].ctrl.value;
+            return 1;
+        }
+    }
 
-	if(verbosity > 0)
-		printf("V4L2_CORE: setting control values\n");
+    v4l2_ctrl_t *control = get_control_by_id(batch->vd, id);
+    if(!control)
+        return 0;
 
-    for(; current != NULL; current = current->next)
+    *value = control->value;
+    return 1;
+}
+
+/*
+ * set the apply phase for every batch entry
+ *  auto controls going manual are set first so the manual values stick,
+ *  auto controls going automatic are set last; manual controls that
+ *  will end up grabbed by their auto control are skipped
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: number of skipped controls
+ */
+static int control_batch_set_phases(v4l2_ctrl_batch_t *batch)
+{
+    int skipped = 0;
+    int i = 0;
+
+    for(i = 0; i < batch->count; i++)
     {
-        if(current->control.flags & V4L2_CTRL_FLAG_READ_ONLY)
-            continue;
+        v4l2_ctrl_batch_entry_t *entry = &batch->entries[i];
+        int id = (int) entry->ctrl.id;
+        entry->phase = CTRL_PHASE_REGULAR;
 
-        clist[count].id = current->control.id;
-        switch (current->control.type)
+        int j = 0;
+        for(j = 0; j < N_AUTO_CTRL_DEPS; j++)
         {
-            case V4L2_CTRL_TYPE_STRING:
+            if(auto_ctrl_deps[j].auto_id == id)
             {
-                unsigned len = (unsigned)strlen(current->string);
-                unsigned max_len = (unsigned)current->control.maximum;
+                int grabs = 0;
+                int k = 0;
+                for(k = 0; k < 3 && auto_ctrl_deps[j].manual_id[k]; k++)
+                    grabs |= auto_ctrl_grabs(id, entry->ctrl.value, auto_ctrl_deps[j].manual_id[k]);
 
-				if(len > max_len)
-				{
-					clist[count].size = max_len + 1;
-					clist[count].string = (char *) calloc(max_len + 1, sizeof(char));
-					if(clist[count].string == NULL)
-					{
-						fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (set_v4l2_control_values): %s\n", strerror(errno));
-						exit(-1);
-					}
-					clist[count].string = strncpy(clist[count].string, current->string, max_len);
-					clist[count].string[max_len + 1] = 0; /*NULL terminated*/
-                    fprintf(stderr, "V4L2_CORE: control (0x%08x) trying to set string size of %u when max is %u (clip)\n",
-						current->control.id, len, max_len);
-				}
-				else
-				{
-					clist[count].size = len + 1;
-					clist[count].string = (char *) strdup(current->string);
-				}
+                entry->phase = grabs ? CTRL_PHASE_AUTO_ON : CTRL_PHASE_AUTO_OFF;
                 break;
             }
-            case V4L2_CTRL_TYPE_INTEGER64:
-                clist[count].value64 = current->value64;
-                break;
-            default:
-				if(verbosity > 0)
-					printf("\tcontrol[%i] = %i\n", count, current->value);
-                clist[count].value = current->value;
+
+            int k = 0;
+            for(k = 0; k < 3 && auto_ctrl_deps[j].manual_id[k]; k++)
+            {
+                int32_t auto_value = 0;
+                if(auto_ctrl_deps[j].manual_id[k] == id &&
+                    control_batch_target_value(batch, auto_ctrl_deps[j].auto_id, &auto_value) &&
+                    auto_ctrl_grabs(auto_ctrl_deps[j].auto_id, auto_value, id))
+                {
+                    entry->phase = -1; /*skip*/
+                    skipped++;
+                    break;
+                }
+            }
+            if(entry->phase < 0)
                 break;
         }
-        count++;
+    }
 
-        if((current->next == NULL) || (current->next->cclass != current->cclass))
+    return skipped;
+}
+
+/*
+ * sort batch entries by phase, class and insertion order
+ */
+static int control_batch_entry_cmp(const void *a, const void *b)
+{
+    const v4l2_ctrl_batch_entry_t *ea = (const v4l2_ctrl_batch_entry_t *) a;
+    const v4l2_ctrl_batch_entry_t *eb = (const v4l2_ctrl_batch_entry_t *) b;
+
+    if(ea->phase != eb->phase)
+        return ea->phase - eb->phase;
+    if(ea->cclass != eb->cclass)
+        return (ea->cclass < eb->cclass) ? -1 : 1;
+    return ea->index - eb->index;
+}
+
+/*
+ * set a group of controls one at a time (drivers without a working
+ *  VIDIOC_S_EXT_CTRLS for the class)
+ * args:
+ *   vd - pointer to video device data
+ *   group - pointer to first entry of the group
+ *   count - number of entries in the group
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of ioctls issued
+ */
+static int control_batch_set_single(v4l2_dev_t *vd, v4l2_ctrl_batch_entry_t *group, int count)
+{
+    int i = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        if(group[i].failed)
+            continue;
+
+        v4l2_ctrl_t *control = get_control_by_id(vd, (int) group[i].ctrl.id);
+        int ret = 0;
+
+        if( group[i].cclass == V4L2_CTRL_CLASS_USER && control
+            && control->control.type != V4L2_CTRL_TYPE_STRING
+            && control->control.type != V4L2_CTRL_TYPE_INTEGER64)
         {
-            struct v4l2_ext_controls ctrls /*= {0}*/;
-            ctrls.ctrl_class = (__u32)current->cclass;
-            ctrls.count = (__u32)count;
-            ctrls.controls = clist;
+            struct v4l2_control ctrl;
+            ctrl.id = group[i].ctrl.id;
+            ctrl.value = group[i].ctrl.value;
+            ret = xioctl(vd->fd, (int)VIDIOC_S_CTRL, &ctrl);
+        }
+        else
+        {
+            struct v4l2_ext_controls ctrls;
+            memset(&ctrls, 0, sizeof(struct v4l2_ext_controls));
+            ctrls.ctrl_class = (__u32) group[i].cclass;
+            ctrls.count = 1;
+            ctrls.controls = &group[i].ctrl;
             ret = xioctl(vd->fd, (int)VIDIOC_S_EXT_CTRLS, &ctrls);
-            if(ret)
+        }
+
+        if(ret)
+        {
+            group[i].failed = 1;
+            fprintf(stderr, "V4L2_CORE: control(0x%08x) \"%s\" failed to set (error %i)\n",
+                group[i].ctrl.id, control ? (char *) control->control.name : "", ret);
+        }
+    }
+
+    return count;
+}
+
+/*
+ * set a group of controls (same phase and class)
+ *  with a single VIDIOC_S_EXT_CTRLS call, if the driver rejects
+ *  a control it is dropped and the rest of the group is retried
+ * args:
+ *   vd - pointer to video device data
+ *   group - pointer to first entry of the group
+ *   count - number of entries in the group
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of ioctls issued
+ */
+static int control_batch_set_group(v4l2_dev_t *vd, v4l2_ctrl_batch_entry_t *group, int count)
+{
+    struct v4l2_ext_control clist[count];
+    int map[count];
+    int n_ioctl = 0;
+
+    while(1)
+    {
+        int n = 0;
+        int i = 0;
+        for(i = 0; i < count; i++)
+        {
+            if(group[i].failed)
+                continue;
+            clist[n] = group[i].ctrl;
+            map[n] = i;
+            n++;
+        }
+
+        if(n == 0)
+            return n_ioctl;
+
+        struct v4l2_ext_controls ctrls;
+        memset(&ctrls, 0, sizeof(struct v4l2_ext_controls));
+        ctrls.ctrl_class = (__u32) group[0].cclass;
+        ctrls.count = (__u32) n;
+        ctrls.controls = clist;
+
+        n_ioctl++;
+        if(xioctl(vd->fd, (int)VIDIOC_S_EXT_CTRLS, &ctrls) == 0)
+            return n_ioctl;
+
+        /*
+         * error_idx == count means the request failed validation
+         * before anything was written: ask the driver which one
+         */
+        if(ctrls.error_idx >= ctrls.count)
+        {
+            ctrls.error_idx = ctrls.count;
+            n_ioctl++;
+            if(xioctl(vd->fd, (int)VIDIOC_TRY_EXT_CTRLS, &ctrls) == 0 ||
+                ctrls.error_idx >= ctrls.count)
             {
-                fprintf(stderr, "V4L2_CORE: VIDIOC_S_EXT_CTRLS for multiple controls failed (error %i)\n", ret);
-                struct v4l2_control ctrl;
-                /*set the controls one by one*/
-                if( current->cclass == V4L2_CTRL_CLASS_USER
-					&& current->control.type != V4L2_CTRL_TYPE_STRING
-					&& current->control.type != V4L2_CTRL_TYPE_INTEGER64)
-                {
-                    fprintf(stderr, "V4L2_CORE: using VIDIOC_S_CTRL for user class controls\n");
-                    for(i=0;i < count; i++)
-                    {
-                        ctrl.id = clist[i].id;
-                        ctrl.value = clist[i].value;
-                        ret = xioctl(vd->fd, (int)VIDIOC_S_CTRL, &ctrl);
-                        if(ret)
-                        {
-                            v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(vd, (int)clist[i].id);
-                            if(ctrl)
-                                fprintf(stderr, "V4L2_CORE: control(0x%08x) \"%s\" failed to set (error %i)\n",
-                                    clist[i].id, ctrl->control.name, ret);
-                            else
-								fprintf(stderr, "V4L2_CORE: control(0x%08x) failed to set (error %i)\n",
-                                    clist[i].id, ret);
-                        }
-                    }
-                }
-                else
-                {
-                    fprintf(stderr, "V4L2_CORE: using VIDIOC_S_EXT_CTRLS on single controls for class: 0x%08x\n",
-                        current->cclass);
-                    for(i=0;i < count; i++)
-                    {
-                        ctrls.count = 1;
-                        ctrls.controls = &clist[i];
-                        ret = xioctl(vd->fd, (int)VIDIOC_S_EXT_CTRLS, &ctrls);
+                fprintf(stderr, "V4L2_CORE: VIDIOC_S_EXT_CTRLS failed for class 0x%08x - setting controls one by one\n",
+                    group[0].cclass);
+                return n_ioctl + control_batch_set_single(vd, group, count);
+            }
+        }
+        else
+        {
+            /*controls before error_idx were already applied*/
+            for(i = 0; i < (int) ctrls.error_idx; i++)
+                group[map[i]].failed = -1;
+        }
 
-                        v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(vd, (int)clist[i].id);
+        v4l2_ctrl_t *control = get_control_by_id(vd, (int) clist[ctrls.error_idx].id);
+        fprintf(stderr, "V4L2_CORE: control(0x%08x) \"%s\" failed to set\n",
+            clist[ctrls.error_idx].id, control ? (char *) control->control.name : "");
+        group[map[ctrls.error_idx]].failed = 1;
+    }
+}
 
-                        if(ret)
-                        {
-                            if(ctrl)
-                                fprintf(stderr, "V4L2_CORE: control(0x%08x) \"%s\" failed to set (error %i)\n",
-                                    clist[i].id, ctrl->control.name, ret);
-                            else
-								fprintf(stderr, "V4L2_CORE: control(0x%08x) failed to set (error %i)\n",
-                                    clist[i].id, ret);
-                        }
-                        if(ctrl && ctrl->control.type == V4L2_CTRL_TYPE_STRING)
-                        {
-							free(clist[i].string); //free allocated string
-							clist[i].string = NULL;
-						}
-                    }
-                }
+/*
+ * start a new control batch
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to new batch or null on error
+ */
+v4l2_ctrl_batch_t *control_batch_begin(v4l2_dev_t *vd)
+{
+    /*asserts*/
+    assert(vd != NULL);
+
+    v4l2_ctrl_batch_t *batch = calloc(1, sizeof(v4l2_ctrl_batch_t));
+    if(batch == NULL)
+    {
+        fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (control_batch_begin): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    batch->vd = vd;
+    batch->size = vd->num_controls > 0 ? vd->num_controls : 16;
+    batch->entries = calloc((size_t) batch->size, sizeof(v4l2_ctrl_batch_entry_t));
+    if(batch->entries == NULL)
+    {
+        fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (control_batch_begin): %s\n", strerror(errno));
+        exit(-1);
+    }
+
+    return batch;
+}
+
+/*
+ * add control id to the batch (with its current control list value)
+ * args:
+ *   batch - pointer to control batch
+ *   id - control id
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: error code
+ */
+int control_batch_add(v4l2_ctrl_batch_t *batch, int id)
+{
+    /*asserts*/
+    assert(batch != NULL);
+
+    v4l2_ctrl_t *control = get_control_by_id(batch->vd, id);
+    if(!control)
+        return E_UNKNOWN_CID_ERR;
+    if(control->control.flags & (V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_DISABLED))
+        return E_OK;
+
+    /*replace the value if the control is already queued*/
+    int i = 0;
+    for(i = 0; i < batch->count; i++)
+        if(batch->entries[i].ctrl.id == (__u32) id)
+            break;
+
+    if(i == batch->size)
+    {
+        batch->size *= 2;
+        batch->entries = realloc(batch->entries, (size_t) batch->size * sizeof(v4l2_ctrl_batch_entry_t));
+        if(batch->entries == NULL)
+        {
+            fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (control_batch_add): %s\n", strerror(errno));
+            exit(-1);
+        }
+    }
+
+    v4l2_ctrl_batch_entry_t *entry = &batch->entries[i];
+    if(i == batch->count)
+    {
+        memset(entry, 0, sizeof(v4l2_ctrl_batch_entry_t));
+        entry->index = batch->count;
+        batch->count++;
+    }
+    else if(entry->ctrl.size && entry->ctrl.string)
+        free(entry->ctrl.string);
+
+    entry->cclass = control->cclass;
+    entry->ctrl.id = control->control.id;
+    entry->ctrl.size = 0;
+
+    switch (control->control.type)
+    {
+        case V4L2_CTRL_TYPE_STRING:
+        {
+            size_t max_len = (size_t) control->control.maximum;
+            const char *str = control->string ? control->string : "";
+
+            if(strlen(str) > max_len)
+                fprintf(stderr, "V4L2_CORE: control (0x%08x) trying to set string size of %u when max is %u (clip)\n",
+                    control->control.id, (unsigned) strlen(str), (unsigned) max_len);
+
+            entry->ctrl.string = strndup(str, max_len);
+            if(entry->ctrl.string == NULL)
+            {
+                fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (control_batch_add): %s\n", strerror(errno));
+                exit(-1);
             }
-            count = 0;
+            entry->ctrl.size = (__u32) strlen(entry->ctrl.string) + 1;
+            break;
         }
+        case V4L2_CTRL_TYPE_INTEGER64:
+            entry->ctrl.value64 = control->value64;
+            break;
+        default:
+            entry->ctrl.value = control->value;
+            break;
     }
 
+    return E_OK;
+}
+
+/*
+ * free the batch without writing it
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   none
+ *
+ * returns: void
+ */
+void control_batch_abort(v4l2_ctrl_batch_t *batch)
+{
+    if(batch == NULL)
+        return;
+
+    int i = 0;
+    for(i = 0; i < batch->count; i++)
+        if(batch->entries[i].ctrl.size && batch->entries[i].ctrl.string)
+            free(batch->entries[i].ctrl.string);
+
+    free(batch->entries);
+    free(batch);
+}
+
+/*
+ * write the batch controls to the device and free the batch
+ *  controls are grouped by phase and class, each group
+ *  is written with a single VIDIOC_S_EXT_CTRLS
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   batch is not null
+ *   batch->vd->fd is valid
+ *
+ * returns: number of controls that failed to set
+ */
+int control_batch_commit(v4l2_ctrl_batch_t *batch)
+{
+    /*asserts*/
+    assert(batch != NULL);
+    assert(batch->vd->fd > 0);
+
+    v4l2_dev_t *vd = batch->vd;
+    v4l2_ctrl_batch_stats_t *stats = &vd->ctrl_batch_stats;
+    memset(stats, 0, sizeof(v4l2_ctrl_batch_stats_t));
+
+    stats->num_controls = batch->count;
+    stats->num_skipped = control_batch_set_phases(batch);
+
+    qsort(batch->entries, (size_t) batch->count, sizeof(v4l2_ctrl_batch_entry_t), control_batch_entry_cmp);
+
+    uint64_t start = ns_time_monotonic();
+
+    int first = 0;
+    while(first < batch->count)
+    {
+        v4l2_ctrl_batch_entry_t *group = &batch->entries[first];
+        int n = 1;
+        while(first + n < batch->count &&
+            group[n].phase == group[0].phase && group[n].cclass == group[0].cclass)
+            n++;
+
+        if(group[0].phase >= 0)
+        {
+            uint64_t group_start = ns_time_monotonic();
+            int n_ioctl = control_batch_set_group(vd, group, n);
+            uint64_t group_time = ns_time_monotonic() - group_start;
+
+            int i = 0;
+            for(i = 0; i < n; i++)
+                if(group[i].failed > 0)
+                    stats->num_failed++;
+
+            stats->num_batches++;
+            stats->num_ioctls += n_ioctl;
+            if(group_time > stats->max_batch_time)
+                stats->max_batch_time = group_time;
+
+            if(verbosity > 0)
+                printf("V4L2_CORE: control batch (class 0x%08x phase %i): %i controls in %i ioctl(s) - %.3f ms\n",
+                    group[0].cclass, group[0].phase, n, n_ioctl, (double) group_time / 1E6);
+        }
+
+        first += n;
+    }
+
+    stats->total_time = ns_time_monotonic() - start;
+
+    if(verbosity > 0)
+        printf("V4L2_CORE: control batch: %i controls (%i skipped, %i failed) %i groups %i ioctl(s) - %.3f ms\n",
+            stats->num_controls, stats->num_skipped, stats->num_failed,
+            stats->num_batches, stats->num_ioctls, (double) stats->total_time / 1E6);
+
+    int failed = stats->num_failed;
+    control_batch_abort(batch);
+
+    return failed;
+}
+
+/*
+ * goes trough the control list and sets values in device
+ *  (as a single control batch)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->fd is valid
+ *
+ * returns: void
+ */
+void set_v4l2_control_values (v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->fd > 0);
+	
+	if(vd->list_device_controls == NULL)
+	{
+		printf("V4L2_CORE: (set control values) empty control list\n");
+		return;
+	}
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: setting control values\n");
+
+    v4l2_ctrl_batch_t *batch = control_batch_begin(vd);
+
+    v4l2_ctrl_t *current = vd->list_device_controls;
+    for(; current != NULL; current = current->next)
+    {
+        if(verbosity > 1)
+            printf("\tcontrol[0x%08x] = %i\n", current->control.id, current->value);
+        control_batch_add(batch, (int)current->control.id);
+    }
+
+    control_batch_commit(batch);
 }
 
 /*
@@ -1315,8 +1849,10 @@ void set_control_defaults(v4l2_dev_t *vd)
             case V4L2_CTRL_TYPE_INTEGER64: /* do int64 controls have a default value?*/
                 break;
             default:
-                /*if its one of the special auto controls disable it first*/
-                disable_special_auto (vd, (int)current->control.id);
+                /*
+                 * special auto controls don't need to be disabled first,
+                 * the control batch orders them after their manual counterparts
+                 */
                 if(verbosity > 1)
 					printf("\tdefault[%i] = %i\n", i, current->control.default_value);
                 current->value = current->control.default_value;
@@ -1481,6 +2017,10 @@ void free_v4l2_control_list(v4l2_dev_t *vd)
     }
     vd->list_device_controls = NULL;
 
+	free(vd->ctrl_hash);
+	vd->ctrl_hash = NULL;
+	vd->ctrl_hash_mask = 0;
+
 	//unsubscibe control events
 	v4l2_unsubscribe_control_events(vd);
 }
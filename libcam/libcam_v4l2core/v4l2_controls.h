@@ -48,9 +48,9 @@ int enumerate_v4l2_control(v4l2_dev_t *vd);
  * asserts:
  *  vd is not null
  *
- * return: none
+ * return: ioctl result
  */
-void v4l2_subscribe_control_events(v4l2_dev_t *vd, unsigned int control_id);
+int v4l2_subscribe_control_events(v4l2_dev_t *vd, unsigned int control_id);
 
 /*
  * unsubscribev4l2 control events
@@ -77,6 +77,22 @@ void v4l2_unsubscribe_control_events(v4l2_dev_t *vd);
  */
 v4l2_ctrl_t *get_control_by_id(v4l2_dev_t *vd, int id);
 
+/*
+ * get the cached value of control id (no ioctl)
+ * args:
+ *   vd - pointer to video device data
+ *   id - control id
+ *   value - pointer to value (set on return)
+ *
+ * asserts:
+ *   vd is not null
+ *   value is not null
+ *
+ * returns: E_OK if event backed, E_NO_DATA if it may be stale
+ *   or E_UNKNOWN_CID_ERR
+ */
+int get_control_cached_value(v4l2_dev_t *vd, int id, int32_t *value);
+
 /*
  * updates the value for control id from the device
  * also updates control flags
@@ -130,6 +146,56 @@ void get_v4l2_control_values (v4l2_dev_t *vd);
  */
 void set_v4l2_control_values (v4l2_dev_t *vd);
 
+/*
+ * start a new control batch
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to new batch or null on error
+ */
+v4l2_ctrl_batch_t *control_batch_begin(v4l2_dev_t *vd);
+
+/*
+ * add control id to the batch (with its current control list value)
+ * args:
+ *   batch - pointer to control batch
+ *   id - control id
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: error code
+ */
+int control_batch_add(v4l2_ctrl_batch_t *batch, int id);
+
+/*
+ * write the batch controls to the device and free the batch
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   batch is not null
+ *   batch->vd->fd is valid
+ *
+ * returns: number of controls that failed to set
+ */
+int control_batch_commit(v4l2_ctrl_batch_t *batch);
+
+/*
+ * free the batch without writing it
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   none
+ *
+ * returns: void
+ */
+void control_batch_abort(v4l2_ctrl_batch_t *batch);
+
 /*
  * goes trough the control list and sets values in device to default
  * args:
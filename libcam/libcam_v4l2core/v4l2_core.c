@@ -50,6 +50,7 @@
 #include "core_time.h"
 #include "uvc_h264.h"
 #include "frame_decoder.h"
+#include "bayer_isp.h"
 #include "control_profile.h"
 #include "v4l2_formats.h"
 #include "v4l2_controls.h"
@@ -570,6 +571,7 @@ static int check_frame_available(v4l2_dev_t *vd)
 
 	int ret = E_OK;
 	fd_set rdset;
+	fd_set exset;
 	struct timeval timeout;
 
 	/*lock the mutex*/
@@ -597,28 +599,38 @@ static int check_frame_available(v4l2_dev_t *vd)
 		flag_fps_change = 0;
 	}
 
-	FD_ZERO(&rdset);
-	FD_SET(vd->fd, &rdset);
 	timeout.tv_sec = 1; /* 1 sec timeout*/
 	timeout.tv_usec = 0;
-	/* select - wait for data or timeout*/
-	ret = select(vd->fd + 1, &rdset, NULL, NULL, &timeout);
-	if (ret < 0)
-	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select error): %s\n", strerror(errno));
-		return E_SELECT_ERR;
-	}
 
-	if (ret == 0)
+	do
 	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select timeout): %s\n", strerror(errno));
-		return E_SELECT_TIMEOUT_ERR;
-	}
+		FD_ZERO(&rdset);
+		FD_SET(vd->fd, &rdset);
+		/*pending control events are signaled as an exception*/
+		FD_ZERO(&exset);
+		FD_SET(vd->fd, &exset);
+
+		/* select - wait for data or timeout (linux updates the remaining timeout)*/
+		ret = select(vd->fd + 1, &rdset, NULL, &exset, &timeout);
+		if (ret < 0)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (select error): %s\n", strerror(errno));
+			return E_SELECT_ERR;
+		}
 
-	if ((ret > 0) && (FD_ISSET(vd->fd, &rdset)))
-		return E_OK;
+		if (ret == 0)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (select timeout): %s\n", strerror(errno));
+			return E_SELECT_TIMEOUT_ERR;
+		}
 
-	return E_UNKNOWN_ERR;
+		/*keep the control value cache current*/
+		if (FD_ISSET(vd->fd, &exset))
+			v4l2core_check_control_events(vd);
+	}
+	while (!FD_ISSET(vd->fd, &rdset));
+
+	return E_OK;
 }
 
 /*
@@ -926,6 +938,99 @@ uint8_t v4l2core_get_isbayer(v4l2_dev_t *vd)
 	return vd->isbayer;
 }
 
+/*
+ * enable the high bit depth (p010/p016) frame buffers for 10 and 16 bit
+ *   formats (takes effect on the next stream format update)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   enable - 1 to decode to frame->yuv16_frame (besides frame->yuv_frame), 0 to disable
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns - void
+ */
+void v4l2core_set_high_bit_depth(v4l2_dev_t *vd, int enable)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	vd->high_bit_depth = enable ? 1 : 0;
+}
+
+/*
+ * gets the high bit depth (p010/p016) frame buffers flag
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns - 1 if enabled, 0 otherwise
+ */
+int v4l2core_get_high_bit_depth(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return vd->high_bit_depth;
+}
+
+/*
+ * sets the software isp parameters (raw bayer streams)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   params - pointer to isp parameters
+ *
+ * asserts:
+ *   vd is not null
+ *   params is not null
+ *
+ * returns - void
+ */
+void v4l2core_set_isp_params(v4l2_dev_t *vd, const v4l2_isp_params_t *params)
+{
+	/*assertions*/
+	assert(vd != NULL);
+	assert(params != NULL);
+
+	vd->isp = *params;
+
+	if(vd->isp.black_level < 0)
+		vd->isp.black_level = 0;
+	if(vd->isp.black_level > 254)
+		vd->isp.black_level = 254;
+	if(vd->isp.gain_r < 0)
+		vd->isp.gain_r = 0;
+	if(vd->isp.gain_g < 0)
+		vd->isp.gain_g = 0;
+	if(vd->isp.gain_b < 0)
+		vd->isp.gain_b = 0;
+	if(vd->isp.threads < 0)
+		vd->isp.threads = 0;
+}
+
+/*
+ * gets the software isp parameters (raw bayer streams)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   params - pointer to isp parameters to fill
+ *
+ * asserts:
+ *   vd is not null
+ *   params is not null
+ *
+ * returns - void
+ */
+void v4l2core_get_isp_params(v4l2_dev_t *vd, v4l2_isp_params_t *params)
+{
+	/*assertions*/
+	assert(vd != NULL);
+	assert(params != NULL);
+
+	*params = vd->isp;
+}
+
 /*
  * gets current device index
  * args:
@@ -1344,7 +1449,17 @@ v4l2_frame_buff_t *v4l2core_get_decoded_frame(v4l2_dev_t *vd)
 			fprintf(stderr, "V4L2_CORE: Error - Couldn't decode frame\n");
 		}
 	}
-	
+
+	if(frame != NULL && vd->fmt_switch_start > 0)
+	{
+		vd->fmt_switch_time = ns_time_monotonic() - vd->fmt_switch_start;
+		vd->fmt_switch_start = 0;
+
+		if(verbosity > 0)
+			printf("V4L2_CORE: format switch to first frame took %.3f ms\n",
+				(double) vd->fmt_switch_time / 1000000.0);
+	}
+
 	return frame;
 }
 
@@ -1752,6 +1867,87 @@ int v4l2core_update_current_format(v4l2_dev_t *vd)
 	return(try_video_stream_format(vd, my_width, my_height, my_pixelformat));
 }
 
+/*
+ * switch to the format and resolution prepared with
+ *   v4l2core_prepare_new_format/resolution (fast path)
+ *   if nothing changed the stream is kept running, otherwise the
+ *   device buffers are requeued and the decoded frame buffers and
+ *   decoder context are reused whenever possible; falls back to the
+ *   first listed format if the requested one fails
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns:
+ *    error code (stream is restarted on E_OK)
+ */
+int v4l2core_switch_format(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	vd->fmt_switch_start = ns_time_monotonic();
+
+	if(vd->streaming == STRM_OK &&
+	   vd->requested_fmt == my_pixelformat &&
+	   (int) vd->format.fmt.pix.width == my_width &&
+	   (int) vd->format.fmt.pix.height == my_height)
+	{
+		if(verbosity > 0)
+			printf("V4L2_CORE: format switch - requested format already set\n");
+		return E_OK;
+	}
+
+	v4l2core_stop_stream(vd);
+	v4l2core_clean_buffers(vd);
+
+	int ret = v4l2core_update_current_format(vd);
+	if(ret != E_OK)
+	{
+		fprintf(stderr, "V4L2_CORE: could not set the requested stream format (%i)\n", ret);
+		fprintf(stderr, "V4L2_CORE: trying first listed stream format\n");
+
+		v4l2core_prepare_valid_format(vd);
+		v4l2core_prepare_valid_resolution(vd);
+		ret = v4l2core_update_current_format(vd);
+
+		if(ret != E_OK)
+		{
+			fprintf(stderr, "V4L2_CORE: also could not set the first listed stream format (%i)\n", ret);
+			vd->fmt_switch_start = 0;
+			return ret;
+		}
+	}
+
+	ret = v4l2core_start_stream(vd);
+	if(ret != E_OK)
+		vd->fmt_switch_start = 0;
+
+	return ret;
+}
+
+/*
+ * get the time of the last format switch
+ *   (from v4l2core_switch_format to the first decoded frame)
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns:
+ *    switch time in ns (0 if none completed)
+ */
+uint64_t v4l2core_get_format_switch_time(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	return vd->fmt_switch_time;
+}
+
 /*
  * clean video device data allocation
  * args:
@@ -1781,7 +1977,14 @@ static void clean_v4l2_dev(v4l2_dev_t *vd)
 		free_frame_formats(vd);
 
 	if(vd->frame_queue)
+	{
+		/*decoded frame buffers are kept by v4l2core_clean_buffers*/
+		clean_v4l2_frames(vd);
 		free(vd->frame_queue);
+	}
+
+	/*stop the software isp workers (restarted by the next bayer frame)*/
+	bayer_isp_clean();
 
 	/*close descriptor*/
 	if(vd->fd > 0)
@@ -1856,6 +2059,13 @@ v4l2_dev_t* v4l2core_init_dev(const char *device)
 	vd->pan_step = 128;
 	vd->tilt_step = 128;
 
+	/*software isp: no black level, unity gains, auto threads*/
+	vd->isp.black_level = 0;
+	vd->isp.gain_r = 256;
+	vd->isp.gain_g = 256;
+	vd->isp.gain_b = 256;
+	vd->isp.threads = 0;
+
 	/*open device*/
     if ((vd->fd = getV4l2()->m_v4l2_open(vd->videodevice, O_RDWR | O_NONBLOCK, 0)) < 0)
 	{
@@ -1984,7 +2194,7 @@ int v4l2core_check_control_events(v4l2_dev_t *vd)
 					break;
 #endif
 				default:
-					control->value = ev.u.ctrl.value;
+					__atomic_store_n(&control->value, ev.u.ctrl.value, __ATOMIC_RELEASE);
 			}
 		}
 	}
@@ -2119,7 +2329,10 @@ void v4l2core_clean_buffers(v4l2_dev_t *vd)
 	if(vd->streaming == STRM_OK)
 		v4l2core_stop_stream(vd);
 
-	clean_v4l2_frames(vd);
+	/*
+	 * decoded frame buffers are kept for reuse on the next
+	 * format switch (alloc_v4l2_frames) and freed on close
+	 */
 
 	// unmap queue buffers
 	switch(vd->cap_meth)
@@ -2306,13 +2519,111 @@ int v4l2core_set_control_value_by_id(v4l2_dev_t *vd, int id)
 	return set_control_value_by_id(vd, id);
 }
 
+/*
+ * get the cached value of control id (no ioctl, safe to call from any thread)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   id - control id
+ *   value - pointer to value (set on return)
+ *
+ * asserts:
+ *   vd is not null
+ *   value is not null
+ *
+ * returns: E_OK if the cached value is event backed, E_NO_DATA if it may be
+ *   stale, E_UNKNOWN_CID_ERR if unknown
+ */
+int v4l2core_get_control_cached_value(v4l2_dev_t *vd, int id, int32_t *value)
+{
+	return get_control_cached_value(vd, id, value);
+}
+
+/*
+ * start a new control batch
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to new batch or null on error
+ */
+v4l2_ctrl_batch_t *v4l2core_control_batch_begin(v4l2_dev_t *vd)
+{
+	return control_batch_begin(vd);
+}
+
+/*
+ * add control id to the batch, using its current value from the control list
+ * args:
+ *   batch - pointer to control batch
+ *   id - control id
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: error code (E_OK or E_UNKNOWN_CID_ERR)
+ */
+int v4l2core_control_batch_add(v4l2_ctrl_batch_t *batch, int id)
+{
+	return control_batch_add(batch, id);
+}
+
+/*
+ * write all controls in the batch to the device and free the batch
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   batch is not null
+ *
+ * returns: number of controls that failed to set
+ */
+int v4l2core_control_batch_commit(v4l2_ctrl_batch_t *batch)
+{
+	return control_batch_commit(batch);
+}
+
+/*
+ * free the batch without writing any control
+ * args:
+ *   batch - pointer to control batch
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void v4l2core_control_batch_abort(v4l2_ctrl_batch_t *batch)
+{
+	control_batch_abort(batch);
+}
+
+/*
+ * get timing/result data of the last committed control batch
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pointer to control batch stats
+ */
+const v4l2_ctrl_batch_stats_t *v4l2core_get_control_batch_stats(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return &vd->ctrl_batch_stats;
+}
+
 /*
  * save the current frame to file
  * args:
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
- *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP, IMG_FMT_TIFF)
  *
  * asserts:
  *    vd is not null
@@ -63,6 +63,13 @@ struct _v4l2_dev_t
 
 	v4l2_frame_buff_t *frame_queue;     //frame queue
 	int frame_queue_size;               //size of frame queue (in frames)
+	int frames_fmt;                     //format the frame queue (and decoder) was allocated for
+	int frames_width;                   //frame width the frame queue is set for
+	int frames_height;                  //frame height the frame queue is set for
+	int frames_capacity;                //frame queue buffers capacity (in pixels)
+
+	uint64_t fmt_switch_start;          //format switch start timestamp in ns (0 if no switch is pending)
+	uint64_t fmt_switch_time;           //last format switch time in ns (from request to first decoded frame)
 
 	uint8_t h264_unit_id;  				// uvc h264 unit id, if <= 0 then uvc h264 is not supported
 	uint8_t h264_no_probe_default;      // flag core to use the preset h264_config_probe_req data (don't reset to default before commit)
@@ -78,9 +85,14 @@ struct _v4l2_dev_t
 
     v4l2_ctrl_t* list_device_controls;    //null terminated linked list of available device controls
     int num_controls;                   //number of controls in list
+    v4l2_ctrl_t **ctrl_hash;            //control id hash table (open addressing, read only after enumeration)
+    uint32_t ctrl_hash_mask;            //hash table size - 1 (size is a power of 2)
+    v4l2_ctrl_batch_stats_t ctrl_batch_stats; //timing/result data of the last control batch
 
     uint8_t isbayer;                    //flag if we are streaming bayer data in yuyv frame (logitech only)
     uint8_t bayer_pix_order;            //bayer pixel order
+    v4l2_isp_params_t isp;              //software isp parameters (bayer streams)
+    uint8_t high_bit_depth;             //flag decoding of 10/16 bit formats to p010/p016 frames
 
     int pan_step;                       //pan step for relative pan tilt controls (logitech sphere/orbit/BCC950)
     int tilt_step;                      //tilt step for relative pan tilt controls (logitech sphere/orbit/BCC950)
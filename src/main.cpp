@@ -16,6 +16,7 @@ extern "C"
 extern "C"
 {
 #include <libimagevisualresult/visualresult.h>
+#include "gviewrender.h"
 }
 
 #include <DMainWindow>
@@ -92,11 +93,49 @@ static bool CheckFFmpegEnv()
     return false;
 }
 
+//无界面编码性能测试: deepin-camera --encoder-benchmark [4cc] [width] [height] [frames] [threads] [preset]
+static int EncoderBenchmark(int argc, char *argv[])
+{
+    const char *codec4cc = argc > 2 ? argv[2] : "H264";
+    int width = argc > 3 ? atoi(argv[3]) : 1280;
+    int height = argc > 4 ? atoi(argv[4]) : 720;
+    int frames = argc > 5 ? atoi(argv[5]) : 300;
+
+    if (!CheckFFmpegEnv()) {
+        fprintf(stderr, "encoder benchmark: libavcodec not found\n");
+        return -1;
+    }
+
+    CMainWindow::initDynamicLibPath();
+    gviewencoder_init();
+
+    int codecInd = encoder_get_video_codec_ind_4cc(codec4cc);
+    if (codecInd <= 0) {
+        fprintf(stderr, "encoder benchmark: video codec %s not available\n", codec4cc);
+        return -1;
+    }
+
+    if (argc > 6)
+        encoder_set_video_threads(codecInd, atoi(argv[6]), ENCODER_THREAD_AUTO);
+    if (argc > 7)
+        encoder_set_video_preset(codecInd, argv[7], encoder_get_video_codec_defaults(codecInd)->tune);
+
+    double fps = encoder_benchmark_video(codecInd, width, height, 1, 30, frames);
+    if (fps < 0)
+        return -1;
+
+    printf("%s %dx%d: %d frames, %.1f fps\n", codec4cc, width, height, frames, fps);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     // Task 326583 不参与合成器崩溃重连
     unsetenv("QT_WAYLAND_RECONNECT");
 
+    if (argc > 1 && QString(argv[1]) == "--encoder-benchmark")
+        return EncoderBenchmark(argc, argv);
+
     QAccessible::installFactory(accessibleFactory);
     bool bWayland = CheckWayland();
     bool bFFmpegEnv = CheckFFmpegEnv();
@@ -126,6 +165,8 @@ int main(int argc, char *argv[])
     time.start();
     QString lutDir = LUT_DIR;
     initFilters(lutDir.toStdString().c_str());
+    //滤镜优先使用内置的3D LUT引擎，cube文件在首次使用时解析
+    render_lut_set_dir(lutDir.toStdString().c_str());
     qDebug() << QString("initFilters cost %1 ms").arg(time.elapsed());
 
     CApplication a(argc, argv);
@@ -176,23 +217,31 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
-    CMainWindow w;
-    a.setMainWindow(&w);
+    int ret = 0;
+    {
+        CMainWindow w;
+        a.setMainWindow(&w);
 
-    Dtk::Widget::moveToCenter(&w);
-    w.setWayland(bWayland);
-    //判断是否是平板环境
-    if (CamApp->isPanelEnvironment())
-        w.showMaximized();
-    else
-        w.setMinimumSize(CMainWindow::minWindowWidth, CMainWindow::minWindowHeight);
+        Dtk::Widget::moveToCenter(&w);
+        w.setWayland(bWayland);
+        //判断是否是平板环境
+        if (CamApp->isPanelEnvironment())
+            w.showMaximized();
+        else
+            w.setMinimumSize(CMainWindow::minWindowWidth, CMainWindow::minWindowHeight);
 
-    w.show();
-    w.loadAfterShow();
+        w.show();
+        w.loadAfterShow();
+
+        ApplicationAdaptor adaptor(&w);
+        QDBusConnection::sessionBus().registerService("com.deepin.camera");
+        QDBusConnection::sessionBus().registerObject(QDir::separator(), &w);
+
+        ret = qApp->exec();
+    }
 
-    ApplicationAdaptor adaptor(&w);
-    QDBusConnection::sessionBus().registerService("com.deepin.camera");
-    QDBusConnection::sessionBus().registerObject(QDir::separator(), &w);
+    //主窗口及其处理线程销毁后，释放3D LUT缓存并停止滤镜工作线程
+    render_lut_clean();
 
-    return qApp->exec();
+    return ret;
 }
@@ -4,15 +4,15 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "audioprocessingthread.h"
+#include "gstvideowriter.h"
 
 #define FRAME_SIZE 512
+#define AUDIO_WAIT_TIMEOUT 50 //等待音频数据超时(ms)，超时后检查停止标志
 
 AudioProcessingThread::AudioProcessingThread()
 {
     m_auidoBuffer = nullptr;
-    m_data = nullptr;
-
-    m_datasize = 0;
+    m_videoWriter = nullptr;
 
     init();
 }
@@ -58,30 +58,15 @@ void AudioProcessingThread::run()
     while (m_stopped == 0) {
         int ret = audio_get_next_buffer(audio_ctx, m_auidoBuffer, sample_type, get_audio_fx_mask());
         if (ret > 0) {
-            /*
-             * no buffers to process
-             * sleep a couple of milisec
-             */
-            struct timespec req = {
-               .tv_sec = 0,
-               .tv_nsec = 1000000};/*nanosec*/
-            nanosleep(&req, NULL);
+            // 没有可处理的音频数据，阻塞等待采集线程填充
+            audio_wait_buffer(audio_ctx, AUDIO_WAIT_TIMEOUT);
         }
         else if (ret == 0) {
-            if (m_datasize != datasize) {
-                m_datasize = datasize;
-                if (m_data != nullptr) {
-                    delete [] m_data;
-                    m_data = nullptr;
-                }
-                m_data = new uchar[datasize];
-            }
-
-            memcpy(m_data, m_auidoBuffer->data, datasize);
-
+            // 音频数据直接写入视频写入器的缓冲池
             m_rwMtxData.lock();
 
-            emit sendAudioProcessing(m_data, datasize);
+            if (m_videoWriter)
+                m_videoWriter->writeAudio(static_cast<uchar *>(m_auidoBuffer->data), datasize, m_auidoBuffer->timestamp);
 
             m_rwMtxData.unlock();
         }
@@ -95,9 +80,5 @@ void AudioProcessingThread::run()
 
 AudioProcessingThread::~AudioProcessingThread()
 {
-    if (m_data) {
-        delete [] m_data;
-        m_data = nullptr;
-    }
     qDebug() << "~AudioProcessingThread";
 }
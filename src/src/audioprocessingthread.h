@@ -20,6 +20,8 @@ extern "C" {
 }
 #endif
 
+class GstVideoWriter;
+
 /**
  * @brief 音频处理线程
  */
@@ -41,6 +43,16 @@ public:
      */
     void init();
 
+    /**
+     * @brief setVideoWriter 设置GStreamer视频写入器，音频数据直接写入其缓冲池
+     * @param writer  视频写入器，为空时不再写入
+     */
+    void setVideoWriter(GstVideoWriter *writer)
+    {
+        QMutexLocker locker(&m_rwMtxData);
+        m_videoWriter = writer;
+    }
+
     /**
      * @brief getStatus 获取状态
      */
@@ -55,17 +67,12 @@ protected:
      */
     void run();
 
-signals:
-    void sendAudioProcessing(uchar* data, uint size);
-
 public:
     QMutex            m_rwMtxData;
 private:
     QAtomicInt        m_stopped;
     audio_buff_t      *m_auidoBuffer;
-    uchar             *m_data;
-
-    uint              m_datasize;
+    GstVideoWriter    *m_videoWriter;
 };
 
 #endif // AudioProcessingThread_H
@@ -163,6 +163,16 @@ static LoadLibs *newClass(void)
     }
     pLibs->m_swr_free = (uos_swr_free)dlsym(handle3, "swr_free");
     PrintError();
+    pLibs->m_swr_alloc_set_opts = (uos_swr_alloc_set_opts)dlsym(handle3, "swr_alloc_set_opts");
+    PrintError();
+    pLibs->m_swr_init = (uos_swr_init)dlsym(handle3, "swr_init");
+    PrintError();
+    pLibs->m_swr_convert = (uos_swr_convert)dlsym(handle3, "swr_convert");
+    PrintError();
+    pLibs->m_swr_set_compensation = (uos_swr_set_compensation)dlsym(handle3, "swr_set_compensation");
+    PrintError();
+    pLibs->m_swr_get_delay = (uos_swr_get_delay)dlsym(handle3, "swr_get_delay");
+    PrintError();
 
     //libswscale
     void *handle4 = dlopen(g_ldnames.chSwscale/*"libswscale.so.5"*/,RTLD_LAZY);
@@ -242,6 +252,8 @@ static LoadAvformat *newAvformat(void)
     PrintError();
     pAvformat->m_avio_closep = (uos_avio_closep)dlsym(handle1, "avio_closep");
     PrintError();
+    pAvformat->m_av_read_frame = (uos_av_read_frame)dlsym(handle1, "av_read_frame");
+    PrintError();
 
 
 //    //libffmpegthumbnailer
@@ -344,6 +356,8 @@ static LoadAvutil *newAvutil(void)
     PrintError();
     Avutil->m_av_image_get_buffer_size = (uos_av_image_get_buffer_size)dlsym(handle5, "av_image_get_buffer_size");
     PrintError();
+    Avutil->m_av_rescale_q = (uos_av_rescale_q)dlsym(handle5, "av_rescale_q");
+    PrintError();
 //----vaapi----
     Avutil->m_av_hwdevice_ctx_create = (uos_av_hwdevice_ctx_create)dlsym(handle5, "av_hwdevice_ctx_create");  //libavutil/hwcontext.h
     PrintError();
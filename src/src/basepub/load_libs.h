@@ -72,6 +72,16 @@ typedef int (*uos_video_thumbnailer_generate_thumbnail_to_buffer)(video_thumbnai
 //lswresample
 //void swr_free(struct SwrContext **s);
 typedef void (*uos_swr_free)(struct SwrContext **s);
+//struct SwrContext *swr_alloc_set_opts(struct SwrContext *s, int64_t out_ch_layout, enum AVSampleFormat out_sample_fmt, int out_sample_rate, int64_t in_ch_layout, enum AVSampleFormat in_sample_fmt, int in_sample_rate, int log_offset, void *log_ctx);
+typedef struct SwrContext *(*uos_swr_alloc_set_opts)(struct SwrContext *s, int64_t out_ch_layout, enum AVSampleFormat out_sample_fmt, int out_sample_rate, int64_t in_ch_layout, enum AVSampleFormat in_sample_fmt, int in_sample_rate, int log_offset, void *log_ctx);
+//int swr_init(struct SwrContext *s);
+typedef int (*uos_swr_init)(struct SwrContext *s);
+//int swr_convert(struct SwrContext *s, uint8_t **out, int out_count, const uint8_t **in , int in_count);
+typedef int (*uos_swr_convert)(struct SwrContext *s, uint8_t **out, int out_count, const uint8_t **in, int in_count);
+//int swr_set_compensation(struct SwrContext *s, int sample_delta, int compensation_distance);
+typedef int (*uos_swr_set_compensation)(struct SwrContext *s, int sample_delta, int compensation_distance);
+//int64_t swr_get_delay(struct SwrContext *s, int64_t base);
+typedef int64_t (*uos_swr_get_delay)(struct SwrContext *s, int64_t base);
 
 //lswscale
 //void sws_freeContext(struct SwsContext *swsContext);
@@ -152,6 +162,11 @@ typedef struct _LoadLibs {
 
 
     uos_swr_free m_swr_free;
+    uos_swr_alloc_set_opts m_swr_alloc_set_opts;
+    uos_swr_init m_swr_init;
+    uos_swr_convert m_swr_convert;
+    uos_swr_set_compensation m_swr_set_compensation;
+    uos_swr_get_delay m_swr_get_delay;
 
     uos_sws_freeContext m_sws_freeContext;
 
@@ -181,6 +196,8 @@ typedef int (*uos_av_write_frame)(AVFormatContext *s, AVPacket *pkt);
 typedef int (*uos_av_write_trailer)(AVFormatContext *s);
 //int avio_closep(AVIOContext **s);
 typedef int (*uos_avio_closep)(AVIOContext **s);
+//int av_read_frame(AVFormatContext *s, AVPacket *pkt);
+typedef int (*uos_av_read_frame)(AVFormatContext *s, AVPacket *pkt);
 
 typedef struct _LoadAvformat {
     uos_avformat_open_input m_avformat_open_input;
@@ -196,6 +213,7 @@ typedef struct _LoadAvformat {
     uos_av_write_frame m_av_write_frame;
     uos_av_write_trailer m_av_write_trailer;
     uos_avio_closep m_avio_closep;
+    uos_av_read_frame m_av_read_frame;
 } LoadAvformat;
 LoadAvformat *getAvformat();
 
@@ -237,6 +255,8 @@ typedef int (*uos_av_samples_get_buffer_size)(int *linesize, int nb_channels, in
 typedef const char *(*uos_av_get_media_type_string)(enum AVMediaType media_type);
 //int av_image_get_buffer_size(enum AVPixelFormat pix_fmt, int width, int height, int align);
 typedef int (*uos_av_image_get_buffer_size)(enum AVPixelFormat pix_fmt, int width, int height, int align);
+//int64_t av_rescale_q(int64_t a, AVRational bq, AVRational cq);
+typedef int64_t (*uos_av_rescale_q)(int64_t a, AVRational bq, AVRational cq);
 
 typedef struct _LoadAvutil {
     uos_av_dict_get m_av_dict_get;
@@ -255,6 +275,7 @@ typedef struct _LoadAvutil {
     uos_av_samples_get_buffer_size m_av_samples_get_buffer_size;
     uos_av_get_media_type_string m_av_get_media_type_string;//
     uos_av_image_get_buffer_size m_av_image_get_buffer_size;
+    uos_av_rescale_q m_av_rescale_q;
         //----VAAPI------
     uos_av_hwdevice_ctx_create  m_av_hwdevice_ctx_create;
     uos_av_hwframe_ctx_alloc  m_av_hwframe_ctx_alloc;
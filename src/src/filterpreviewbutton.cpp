@@ -7,6 +7,7 @@
 
 extern "C" {
 #include <libimagevisualresult/visualresult.h>
+#include "gviewrender.h"
 }
 
 #include <QPainter>
@@ -27,6 +28,7 @@ filterPreviewButton::filterPreviewButton(QWidget *parent, efilterType filter/* =
     if (objName.isEmpty())
         objName = "normal";
     setObjectName(objName);
+    m_lut = render_lut_get(filterName_CUBE(filter).toStdString().c_str());
 
     m_color.setRgb(44, 44, 44);
 
@@ -51,14 +53,31 @@ void filterPreviewButton::setImage(QImage *img)
     if (isHidden() && !img->isNull())
         return;
 
+    if (img->isNull()) {
+        m_pixmap = QPixmap();
+        update();
+        return;
+    }
+
     uint8_t* frame = img->bits();
     int width = img->width();
     int height = img->height();
     QString filterName_CUBE = filterPreviewButton::filterName_CUBE(m_filterType);
-    if (!filterName_CUBE.isEmpty())
+    if (m_lut)
+        render_lut_apply_rgb24(m_lut, frame, width, height, img->bytesPerLine(), 1);
+    else if (!filterName_CUBE.isEmpty())
         imageFilter24(frame, width, height, filterName_CUBE.toStdString().c_str(), 100);
 
     m_pixmap = QPixmap::fromImage(QImage(frame, width, height, QImage::Format_RGB888));
+    m_pixmapRect = m_pixmap.rect();
+    update();
+}
+
+void filterPreviewButton::setPreview(const QPixmap &atlas, const QRect &rect)
+{
+    //QPixmap为隐式共享，所有按钮共用同一份图集数据
+    m_pixmap = atlas;
+    m_pixmapRect = rect;
     update();
 }
 
@@ -94,7 +113,7 @@ void filterPreviewButton::paintEvent(QPaintEvent *event)
     if (!m_pixmap.isNull()) {
         painter.save();
         painter.setClipPath(roundPixmapRectPath);
-        painter.drawPixmap(imageRect, m_pixmap);
+        painter.drawPixmap(imageRect, m_pixmap, m_pixmapRect);
         painter.restore();
     } else {
         painter.fillPath(roundPixmapRectPath, QBrush(QColor(m_color)));
@@ -48,6 +48,13 @@ public:
     */
     void setImage(QImage* img);
 
+    /**
+    * @brief setPreview 设置已加滤镜的预览图(共享的预览图集中的一块区域)
+    * @param atlas 预览图集
+    * @param rect 本按钮预览图在图集中的区域
+    */
+    void setPreview(const QPixmap &atlas, const QRect &rect);
+
     /**
     * @brief setSelected 设置选中
     * @param selected 是否选择
@@ -154,7 +161,9 @@ private:
     int           m_radius = 8;//按钮圆角矩形半径大小
 
     QPixmap       m_pixmap;
+    QRect         m_pixmapRect;//预览图在m_pixmap中的区域
     efilterType   m_filterType = filter_Normal;
+    struct _render_lut_t *m_lut = nullptr;//已编译的3D LUT，为空时回退到imageFilter24
 };
 
 typedef QList<filterPreviewButton*> filterPreviewBtnList;
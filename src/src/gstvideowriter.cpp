@@ -7,6 +7,7 @@
 extern "C" {
 #include <gst/app/gstappsrc.h>
 #include "v4l2_core.h"
+#include "colorspaces.h"
 #include "camview.h"
 #include "gviewaudio.h"
 #include "audio.h"
@@ -17,6 +18,8 @@ extern "C" {
 GST_DEBUG_CATEGORY(appsrc_pipeline_debug);
 
 #define NORMAL_QUANTIZER 30
+#define VIDEO_POOL_FRAMES 8   //视频缓冲池帧数，编码跟不上时丢帧而不是无限排队
+#define AUDIO_POOL_BLOCKS 32  //音频缓冲池块数
 
 static mvideo_gst_element_set_state g_mvideo_gst_element_set_state = nullptr;
 static mvideo_gst_message_parse_error g_mvideo_gst_message_parse_error = nullptr;
@@ -71,9 +74,17 @@ GstVideoWriter::GstVideoWriter(const QString& videoPath):
   , m_vp8enc(nullptr)
   , m_filesink(nullptr)
   , m_bus(nullptr)
+  , m_videoCaps(nullptr)
+  , m_audioCaps(nullptr)
+  , m_videoPool(nullptr)
+  , m_audioPool(nullptr)
+  , m_nAudioBlockSize(0)
+  , m_baseTs(0)
+  , m_nDroppedFrames(0)
 {
     QLibrary gstreamerLibrary(libPath("libgstreamer-1.0.so"));
     QLibrary gstreamerAppLibrary(libPath("libgstapp-1.0.so"));
+    QLibrary gstreamerVideoLibrary(libPath("libgstvideo-1.0.so"));
 
     g_mvideo_gst_init = (mvideo_gst_init) gstreamerLibrary.resolve("gst_init");
     g_mvideo_gst_parse_launch = (mvideo_gst_parse_launch) gstreamerLibrary.resolve("gst_parse_launch");
@@ -91,6 +102,16 @@ GstVideoWriter::GstVideoWriter(const QString& videoPath):
     g_mvideo_gst_app_src_get_type = (mvideo_gst_app_src_get_type) gstreamerAppLibrary.resolve("gst_app_src_get_type");
     g_mvideo_gst_mini_object_unref = (mvideo_gst_mini_object_unref) gstreamerAppLibrary.resolve("gst_mini_object_unref");
     g_mvideo_gst_fraction_type = (mvideo_gst_fraction_type) gstreamerLibrary.resolve("_gst_fraction_type");
+    g_mvideo_gst_buffer_pool_new = (mvideo_gst_buffer_pool_new) gstreamerLibrary.resolve("gst_buffer_pool_new");
+    g_mvideo_gst_buffer_pool_get_config = (mvideo_gst_buffer_pool_get_config) gstreamerLibrary.resolve("gst_buffer_pool_get_config");
+    g_mvideo_gst_buffer_pool_config_set_params = (mvideo_gst_buffer_pool_config_set_params) gstreamerLibrary.resolve("gst_buffer_pool_config_set_params");
+    g_mvideo_gst_buffer_pool_set_config = (mvideo_gst_buffer_pool_set_config) gstreamerLibrary.resolve("gst_buffer_pool_set_config");
+    g_mvideo_gst_buffer_pool_set_active = (mvideo_gst_buffer_pool_set_active) gstreamerLibrary.resolve("gst_buffer_pool_set_active");
+    g_mvideo_gst_buffer_pool_acquire_buffer = (mvideo_gst_buffer_pool_acquire_buffer) gstreamerLibrary.resolve("gst_buffer_pool_acquire_buffer");
+    g_mvideo_gst_buffer_map = (mvideo_gst_buffer_map) gstreamerLibrary.resolve("gst_buffer_map");
+    g_mvideo_gst_buffer_unmap = (mvideo_gst_buffer_unmap) gstreamerLibrary.resolve("gst_buffer_unmap");
+    g_mvideo_gst_buffer_resize = (mvideo_gst_buffer_resize) gstreamerLibrary.resolve("gst_buffer_resize");
+    g_mvideo_gst_buffer_add_video_meta_full = (mvideo_gst_buffer_add_video_meta_full) gstreamerVideoLibrary.resolve("gst_buffer_add_video_meta_full");
 
     g_mvideo_gst_element_set_state = (mvideo_gst_element_set_state) gstreamerLibrary.resolve("gst_element_set_state");
     g_mvideo_gst_message_parse_error = (mvideo_gst_message_parse_error) gstreamerLibrary.resolve("gst_message_parse_error");
@@ -100,6 +121,12 @@ GstVideoWriter::GstVideoWriter(const QString& videoPath):
 
 GstVideoWriter::~GstVideoWriter()
 {
+    releaseBufferPool(m_videoPool);
+    releaseBufferPool(m_audioPool);
+    if (m_videoCaps)
+        g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(m_videoCaps));
+    if (m_audioCaps)
+        g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(m_audioCaps));
     g_mvideo_gst_object_unref(m_pipeline);
     g_mvideo_gst_object_unref(m_appsrc);
     g_mvideo_gst_object_unref(m_audsrc);
@@ -113,6 +140,9 @@ void GstVideoWriter::start()
 {
     // 设置视频帧数据格式
     loadAppSrcCaps();
+    loadBufferPools();
+    m_baseTs.storeRelease(0);
+    m_nDroppedFrames.storeRelease(0);
 
 #if defined(__mips__) || defined(__aarch64__)
     // mips/arm下，牺牲了成像质量
@@ -144,6 +174,10 @@ void GstVideoWriter::stop()
     // 停止视频流
     if (m_appsrc)
         g_signal_emit_by_name(m_appsrc, "end-of-stream", &ret);
+
+    uint dropped = m_nDroppedFrames.loadAcquire();
+    if (dropped > 0)
+        g_printerr("GstVideoWriter: %u frames dropped (buffer pool exhausted)\n", dropped);
 }
 
 void GstVideoWriter::setVideoPath(const QString &videoPath)
@@ -163,48 +197,86 @@ void GstVideoWriter::setQuantizer(uint quantizer)
         g_object_set(m_vp8enc, "min-quantizer", m_nQuantizer, NULL);
 }
 
-bool GstVideoWriter::writeFrame(uchar *rgb, uint size)
+bool GstVideoWriter::writeFrame(uchar *rgb, uint width, uint height, qint64 timestamp)
 {
     GstFlowReturn ret = GST_FLOW_CUSTOM_ERROR;
-    guint8 *ptr = (guint8 *)g_malloc(size * sizeof(uchar));
-    if (ptr) {
-        memcpy(ptr, rgb, size);
-        GstBuffer *buffer = g_mvideo_gst_buffer_new_wrapped((void*)ptr, size);
+    if (!rgb || !m_appsrc)
+        return false;
+
+    // 从缓冲池取帧，池耗尽说明编码跟不上，直接丢帧
+    m_poolMtx.lock();
+    GstBuffer *buffer = nullptr;
+    if (width == m_nWidth && height == m_nHeight)
+        buffer = acquireBuffer(m_videoPool);
+    m_poolMtx.unlock();
+    if (!buffer) {
+        m_nDroppedFrames.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    // rgb24直接转换为I420写入池中的帧，省去中间拷贝和管道内的格式转换
+    GstMapInfo info;
+    if (g_mvideo_gst_buffer_map(buffer, &info, GST_MAP_WRITE)) {
+        rgb24_to_yu12(info.data, rgb, static_cast<int>(width), static_cast<int>(height));
+        g_mvideo_gst_buffer_unmap(buffer, &info);
+
+        // 池中的帧是紧凑排列的，而caps默认按4字节对齐行宽(如1366宽)，需附带实际的平面偏移和行宽
+        if (g_mvideo_gst_buffer_add_video_meta_full) {
+            gsize offset[GST_VIDEO_MAX_PLANES] = {0, width * height, width * height + (width / 2) * (height / 2)};
+            gint stride[GST_VIDEO_MAX_PLANES] = {static_cast<gint>(width),
+                                                 static_cast<gint>(width / 2),
+                                                 static_cast<gint>(width / 2)};
+            g_mvideo_gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_FORMAT_I420,
+                                                    width, height, 3, offset, stride);
+        }
 
         //设置时间戳
-        if (m_pipeline)
-            GST_BUFFER_PTS(buffer) = g_mvideo_gst_clock_get_time(m_pipeline->clock) - m_pipeline->base_time;
+        GST_BUFFER_PTS(buffer) = bufferPts(timestamp);
 
         //注入视频帧数据
-        if (m_appsrc)
-            g_signal_emit_by_name(m_appsrc, "push-buffer", buffer, &ret);
-
-        g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(buffer));
+        g_signal_emit_by_name(m_appsrc, "push-buffer", buffer, &ret);
     }
 
+    // 编码器用完后帧自动回到缓冲池
+    g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(buffer));
+
     return ret == GST_FLOW_OK;
 }
 
-bool GstVideoWriter::writeAudio(uchar *audio, uint size)
+bool GstVideoWriter::writeAudio(uchar *audio, uint size, qint64 timestamp)
 {
     GstFlowReturn ret = GST_FLOW_CUSTOM_ERROR;
-    guint8 *ptr = (guint8 *)g_malloc(size * sizeof(uchar));
-    if (ptr) {
-        memcpy(ptr, audio, size);
-        GstBuffer *buffer = g_mvideo_gst_buffer_new_wrapped((void*)ptr, size);
+    if (!audio || !m_audsrc || size == 0)
+        return false;
+
+    m_poolMtx.lock();
+    // 音频块大小在首次写入时确定
+    if (size > m_nAudioBlockSize) {
+        releaseBufferPool(m_audioPool);
+        m_audioPool = createBufferPool(m_audioCaps, size, AUDIO_POOL_BLOCKS);
+        m_nAudioBlockSize = m_audioPool ? size : 0;
+    }
+    GstBuffer *buffer = acquireBuffer(m_audioPool);
+    m_poolMtx.unlock();
+    if (!buffer)
+        return false;
+
+    GstMapInfo info;
+    if (g_mvideo_gst_buffer_map(buffer, &info, GST_MAP_WRITE)) {
+        memcpy(info.data, audio, size);
+        g_mvideo_gst_buffer_unmap(buffer, &info);
+        if (size < m_nAudioBlockSize)
+            g_mvideo_gst_buffer_resize(buffer, 0, size);
 
         // 设置时间戳
-        if (m_pipeline)
-            GST_BUFFER_PTS(buffer) = g_mvideo_gst_clock_get_time(m_pipeline->clock) - m_pipeline->base_time;
+        GST_BUFFER_PTS(buffer) = bufferPts(timestamp);
 
         // 注入音频帧数据
-        if (m_audsrc) {
-            g_signal_emit_by_name(m_audsrc, "push-buffer", buffer, &ret);
-        }
-
-        g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(buffer));
+        g_signal_emit_by_name(m_audsrc, "push-buffer", buffer, &ret);
     }
 
+    g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(buffer));
+
     return ret == GST_FLOW_OK;
 }
 
@@ -220,9 +292,9 @@ float GstVideoWriter::getRecrodTime()
 void GstVideoWriter::init()
 {
     g_mvideo_gst_init(nullptr, nullptr);
-    // 使用vp8编码录制视频裸流数据、使用vorbis编码录制音频裸流数据
+    // 使用vp8编码录制视频裸流数据(I420直接送入编码器)、使用vorbis编码录制音频裸流数据
     QString pipDesc = QString("webmmux name=mux ! filesink name=filename "
-                              "appsrc name=source ! queue ! videoconvert primaries-mode=2  name=convert ! queue ! "
+                              "appsrc name=source ! queue ! "
                               "vp8enc nd-usage=vbr min-quantizer=1 max-quantizer=50 undershoot=95 cpu-used=5 deadline=1 static-threshold=50 error-resilient=1 name=encoder ! queue ! mux.video_0 "
                               "appsrc name=audiosource ! queue ! audioconvert ! audioresample ! vorbisenc ! queue ! mux.audio_0");
     m_pipeline = g_mvideo_gst_parse_launch(pipDesc.toStdString().c_str(), NULL);
@@ -252,13 +324,13 @@ void GstVideoWriter::init()
     /* 设置音频src属性 */
     m_audsrc = g_mvideo_gst_bin_get_by_name(getGstBin(m_pipeline), "audiosource");
     if (m_audsrc) {
-        GstCaps *audiocaps = g_mvideo_gst_caps_new_simple("audio/x-raw",
+        m_audioCaps = g_mvideo_gst_caps_new_simple("audio/x-raw",
             "format", G_TYPE_STRING, "F32LE",
             "layout", G_TYPE_STRING, "interleaved",
             "channels", G_TYPE_INT, 2,
             "rate", G_TYPE_INT, 44100,
             NULL);
-        g_mvideo_gst_app_src_set_caps(getGstAppSrc(m_audsrc), audiocaps);
+        g_mvideo_gst_app_src_set_caps(getGstAppSrc(m_audsrc), m_audioCaps);
         g_object_set(m_audsrc, "format", GST_FORMAT_TIME, NULL);
         g_object_set(m_audsrc, "is-live", TRUE, NULL);
     }
@@ -270,16 +342,85 @@ void GstVideoWriter::loadAppSrcCaps()
     m_nWidth = v4l2core_get_frame_width(get_v4l2_device_handler());
     m_nHeight = v4l2core_get_frame_height(get_v4l2_device_handler());
     if (m_nWidth > 0 && m_nHeight > 0 && m_appsrc) {
-        GstCaps *caps = g_mvideo_gst_caps_new_simple("video/x-raw",
-            "format", G_TYPE_STRING, "RGB",
+        if (m_videoCaps)
+            g_mvideo_gst_mini_object_unref(GST_MINI_OBJECT_CAST(m_videoCaps));
+
+        m_videoCaps = g_mvideo_gst_caps_new_simple("video/x-raw",
+            "format", G_TYPE_STRING, "I420",
             "width", G_TYPE_INT, m_nWidth,
             "height", G_TYPE_INT, m_nHeight,
             "framerate", (*g_mvideo_gst_fraction_type), m_nFrameRate, 1,
             NULL);
-        g_mvideo_gst_app_src_set_caps(getGstAppSrc(m_appsrc), caps);
+        g_mvideo_gst_app_src_set_caps(getGstAppSrc(m_appsrc), m_videoCaps);
     }
 }
 
+void GstVideoWriter::loadBufferPools()
+{
+    QMutexLocker locker(&m_poolMtx);
+
+    // 分辨率可能已切换，旧池中未归还的帧在编码器释放后随旧池一起销毁
+    releaseBufferPool(m_videoPool);
+    m_videoPool = nullptr;
+    if (m_videoCaps && m_nWidth > 0 && m_nHeight > 0)
+        m_videoPool = createBufferPool(m_videoCaps, m_nWidth * m_nHeight * 3 / 2, VIDEO_POOL_FRAMES);
+
+    releaseBufferPool(m_audioPool);
+    m_audioPool = nullptr;
+    m_nAudioBlockSize = 0;
+}
+
+GstBufferPool *GstVideoWriter::createBufferPool(GstCaps *caps, guint size, guint count)
+{
+    GstBufferPool *pool = g_mvideo_gst_buffer_pool_new();
+    if (!pool)
+        return nullptr;
+
+    // 固定数量的缓冲在激活时一次分配，录制过程中不再申请内存
+    GstStructure *config = g_mvideo_gst_buffer_pool_get_config(pool);
+    g_mvideo_gst_buffer_pool_config_set_params(config, caps, size, count, count);
+    if (!g_mvideo_gst_buffer_pool_set_config(pool, config)
+            || !g_mvideo_gst_buffer_pool_set_active(pool, TRUE)) {
+        g_printerr("GstVideoWriter: could not activate buffer pool (%u x %u bytes)\n", count, size);
+        g_mvideo_gst_object_unref(pool);
+        return nullptr;
+    }
+
+    return pool;
+}
+
+void GstVideoWriter::releaseBufferPool(GstBufferPool *pool)
+{
+    if (!pool)
+        return;
+
+    g_mvideo_gst_buffer_pool_set_active(pool, FALSE);
+    g_mvideo_gst_object_unref(pool);
+}
+
+GstBuffer *GstVideoWriter::acquireBuffer(GstBufferPool *pool)
+{
+    if (!pool)
+        return nullptr;
+
+    GstBuffer *buffer = nullptr;
+    GstBufferPoolAcquireParams params;
+    memset(&params, 0, sizeof(params));
+    params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+    if (g_mvideo_gst_buffer_pool_acquire_buffer(pool, &buffer, &params) != GST_FLOW_OK)
+        return nullptr;
+
+    return buffer;
+}
+
+GstClockTime GstVideoWriter::bufferPts(qint64 timestamp)
+{
+    // 音视频均使用采集时的单调时钟时间戳，以本次录制的首个时间戳为起点
+    m_baseTs.testAndSetOrdered(0, timestamp);
+    qint64 pts = timestamp - m_baseTs.loadAcquire();
+    return pts > 0 ? static_cast<GstClockTime>(pts) : 0;
+}
+
 QString GstVideoWriter::libPath(const QString &strlib)
 {
     QDir  dir;
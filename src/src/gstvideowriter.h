@@ -7,11 +7,14 @@
 
 #include <gst/gst.h>
 #include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
 #include <gst/base/gstbaseparse.h>
 #include <gst/gstvalue.h>
 #include <gst/gstminiobject.h>
 
 #include <QString>
+#include <QMutex>
+#include <QAtomicInteger>
 
 typedef void (*mvideo_gst_init)(int *argc, char **argv[]);
 typedef GstElement* (*mvideo_gst_parse_launch) (const gchar *pipeline_description, GError **error) G_GNUC_MALLOC;
@@ -32,6 +35,21 @@ typedef GType (*mvideo_gst_pipeline_get_type) (void);
 typedef GType (*mvideo_gst_app_src_get_type)  (void);
 typedef void (*mvideo_gst_mini_object_unref) (GstMiniObject *mini_object);
 typedef GType (*mvideo_gst_fraction_type);
+typedef GstBufferPool* (*mvideo_gst_buffer_pool_new) (void);
+typedef GstStructure* (*mvideo_gst_buffer_pool_get_config) (GstBufferPool *pool);
+typedef void (*mvideo_gst_buffer_pool_config_set_params) (GstStructure *config, GstCaps *caps,
+                                                          guint size, guint min_buffers, guint max_buffers);
+typedef gboolean (*mvideo_gst_buffer_pool_set_config) (GstBufferPool *pool, GstStructure *config);
+typedef gboolean (*mvideo_gst_buffer_pool_set_active) (GstBufferPool *pool, gboolean active);
+typedef GstFlowReturn (*mvideo_gst_buffer_pool_acquire_buffer) (GstBufferPool *pool, GstBuffer **buffer,
+                                                                GstBufferPoolAcquireParams *params);
+typedef gboolean (*mvideo_gst_buffer_map) (GstBuffer *buffer, GstMapInfo *info, GstMapFlags flags);
+typedef void (*mvideo_gst_buffer_unmap) (GstBuffer *buffer, GstMapInfo *info);
+typedef void (*mvideo_gst_buffer_resize) (GstBuffer *buffer, gssize offset, gssize size);
+typedef GstVideoMeta* (*mvideo_gst_buffer_add_video_meta_full) (GstBuffer *buffer, GstVideoFrameFlags flags,
+                                                                 GstVideoFormat format, guint width, guint height,
+                                                                 guint n_planes, const gsize offset[GST_VIDEO_MAX_PLANES],
+                                                                 const gint stride[GST_VIDEO_MAX_PLANES]);
 
 class GstVideoWriter
 {
@@ -48,10 +66,10 @@ public:
     void setVideoPath(const QString& videoPath);
     // 设置视频成像质量
     void setQuantizer(uint quantizer);
-    // 写入视频帧数据，格式为rgb
-    bool writeFrame(uchar *rgb, uint size);
-    // 写入音频帧数据，格式为f32le
-    bool writeAudio(uchar *audio, uint size);
+    // 写入视频帧数据，rgb24直接转换为I420写入缓冲池中的帧，可在采集线程中调用
+    bool writeFrame(uchar *rgb, uint width, uint height, qint64 timestamp);
+    // 写入音频帧数据，格式为f32le，可在音频线程中调用
+    bool writeAudio(uchar *audio, uint size, qint64 timestamp);
     // 获取当前录制时长
     float getRecrodTime();
 
@@ -63,12 +81,18 @@ public:
 protected:
     void init();
     void loadAppSrcCaps();
+    // 按当前分辨率重建视频、音频缓冲池
+    void loadBufferPools();
 
 private:
     QString libPath(const QString &strlib);
     GstBin *getGstBin(GstElement *element);
     GstPipeline *getGstPipline(GstElement *element);
     GstAppSrc *getGstAppSrc(GstElement *element);
+    GstBufferPool *createBufferPool(GstCaps *caps, guint size, guint count);
+    void releaseBufferPool(GstBufferPool *pool);
+    GstBuffer *acquireBuffer(GstBufferPool *pool);
+    GstClockTime bufferPts(qint64 timestamp);
 
 private:
     QString                     m_videoPath; //视频保存路径
@@ -84,6 +108,14 @@ private:
     GstElement                 *m_vp8enc;
     GstElement                 *m_filesink;
     GstBus                     *m_bus;
+    GstCaps                    *m_videoCaps; // I420视频帧格式
+    GstCaps                    *m_audioCaps; // f32le音频格式
+    GstBufferPool              *m_videoPool; // 帧大小的视频缓冲池
+    GstBufferPool              *m_audioPool; // 音频块缓冲池
+    uint                        m_nAudioBlockSize; // 音频缓冲池块大小
+    QMutex                      m_poolMtx; // 保护缓冲池的重建与取用
+    QAtomicInteger<qint64>      m_baseTs; // 本次录制的首个时间戳(ns)，用于计算pts
+    QAtomicInteger<uint>        m_nDroppedFrames; // 缓冲池耗尽时丢弃的视频帧数
 
     mvideo_gst_init            g_mvideo_gst_init = nullptr;
     mvideo_gst_parse_launch    g_mvideo_gst_parse_launch = nullptr;
@@ -101,4 +133,14 @@ private:
     mvideo_gst_app_src_get_type g_mvideo_gst_app_src_get_type = nullptr;
     mvideo_gst_mini_object_unref g_mvideo_gst_mini_object_unref = nullptr;
     mvideo_gst_fraction_type   g_mvideo_gst_fraction_type = nullptr;
+    mvideo_gst_buffer_pool_new g_mvideo_gst_buffer_pool_new = nullptr;
+    mvideo_gst_buffer_pool_get_config g_mvideo_gst_buffer_pool_get_config = nullptr;
+    mvideo_gst_buffer_pool_config_set_params g_mvideo_gst_buffer_pool_config_set_params = nullptr;
+    mvideo_gst_buffer_pool_set_config g_mvideo_gst_buffer_pool_set_config = nullptr;
+    mvideo_gst_buffer_pool_set_active g_mvideo_gst_buffer_pool_set_active = nullptr;
+    mvideo_gst_buffer_pool_acquire_buffer g_mvideo_gst_buffer_pool_acquire_buffer = nullptr;
+    mvideo_gst_buffer_map      g_mvideo_gst_buffer_map = nullptr;
+    mvideo_gst_buffer_unmap    g_mvideo_gst_buffer_unmap = nullptr;
+    mvideo_gst_buffer_resize   g_mvideo_gst_buffer_resize = nullptr;
+    mvideo_gst_buffer_add_video_meta_full g_mvideo_gst_buffer_add_video_meta_full = nullptr;
 };
@@ -1217,6 +1217,27 @@ void CMainWindow::loadAfterShow()
     initDynamicLibPath();
     initShortcut();
     gviewencoder_init();
+    //预录制秒数，0为关闭，内存上限使用默认值
+    encoder_set_preroll(dc::Settings::get().getOption("base.general.preroll_seconds").toInt(), 0);
+    //预览时预先创建编码器，缩短开始录像的延迟
+    set_record_ready(dc::Settings::get().getOption("base.general.record_ready").toBool() ? 1 : 0);
+    //预览时计量音频电平(需要打开麦克风)
+    set_audio_metering(dc::Settings::get().getOption("base.general.audio_metering").toBool() ? 1 : 0);
+    //录像同时推流(udp://主机:端口 或 rtp://主机:端口)，为空则关闭
+    encoder_set_stream_sink(dc::Settings::get().getOption("base.general.stream_url").toString().toLocal8Bit().constData());
+    //分段录制的时长(秒)和大小(MB)上限，0为不限制
+    encoder_set_segment_limits(dc::Settings::get().getOption("base.general.segment_seconds").toInt(),
+                               dc::Settings::get().getOption("base.general.segment_mbytes").toInt());
+    //录像时写入索引日志(仅记录，不用于恢复)，开启后强制分段录制，异常退出只影响最后一段
+    encoder_set_index_journal(dc::Settings::get().getOption("base.general.index_journal").toBool() ? 1 : 0);
+    //mp4按关键帧分片写入，异常退出时已写入的部分仍可播放
+    encoder_set_mp4_fragmented(dc::Settings::get().getOption("base.general.mp4_fragmented").toBool() ? 1 : 0);
+    //10/16位格式拍照时另存16位图像(png或tif)，jpg仍用于缩略图
+    set_high_bit_depth(dc::Settings::get().getOption("base.general.high_bit_depth").toBool() ? 1 : 0);
+    if (dc::Settings::get().getOption("base.general.high_bit_depth_format").toString().startsWith("tif"))
+        set_photo_format(IMG_FMT_TIFF);
+    else
+        set_photo_format(IMG_FMT_PNG);
     v4l2core_init();
 
     m_devnumMonitor = new DevNumMonitor();
@@ -76,6 +76,17 @@ public:
     */
     static QString lastOpenedPath(QStandardPaths::StandardLocation standard);
 
+    /**
+    * @brief initDynamicLibPath 初始化动态库的路径
+    */
+    static void initDynamicLibPath();
+
+    /**
+    * @brief libPath 动态库路径
+    * @param strlib 路径的字符串
+    */
+    static QString libPath(const QString &strlib);
+
     /**
     * @brief setWayland　判断是否是wayland，并初始化对应操作
     * @param bTrue
@@ -185,17 +196,6 @@ private:
     */
     void slotPopupSettingsDialog();
 
-    /**
-    * @brief initDynamicLibPath 初始化动态库的路径
-    */
-    void initDynamicLibPath();
-
-    /**
-    * @brief libPath 动态库路径
-    * @param strlib 路径的字符串
-    */
-    QString libPath(const QString &strlib);
-
     /**
     * @brief getMediaFileInfoList　获得录像、图片文件列表
     */
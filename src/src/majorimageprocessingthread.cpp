@@ -6,6 +6,7 @@
 #include "majorimageprocessingthread.h"
 #include "datamanager.h"
 #include "camera.h"
+#include "gstvideowriter.h"
 
 extern "C" {
 #include <libimagevisualresult/visualresult.h>
@@ -14,9 +15,12 @@ extern "C" {
 #include <QFile>
 #include <QDate>
 #include <QDir>
+#include <QtConcurrent>
 #include <DSysInfo>
 DCORE_USE_NAMESPACE
 
+#define PIPELINE_LUT_SIZE 33 //滤镜+曝光编译LUT的网格大小
+
 MajorImageProcessingThread::MajorImageProcessingThread():m_bHorizontalMirror(false)
 {
     m_yuvPtr = nullptr;
@@ -47,13 +51,84 @@ void MajorImageProcessingThread::init()
     m_result = -1;
     m_nCount = 0;
     m_firstPts = 0;
+    m_bSaveFormatPending = false;
+}
+
+void MajorImageProcessingThread::saveFormatConfig()
+{
+    //在采集线程取出当前格式，配置文件的读写放到后台执行，不占用采集线程
+    int width = static_cast<int>(m_videoDevice->format.fmt.pix.width);
+    int height = static_cast<int>(m_videoDevice->format.fmt.pix.height);
+    uint format = static_cast<uint>(m_videoDevice->format.fmt.pix.pixelformat);
+    v4l2_device_list_t *devlist = get_device_list();
+    QByteArray deviceName(devlist->list_devices[get_v4l2_device_handler()->this_device].name);
+
+    qDebug() << "format switch time(ms):" << v4l2core_get_format_switch_time(m_videoDevice) / 1000000.0;
+
+    QtConcurrent::run([width, height, format, deviceName]() {
+        //连续切换时按顺序写入
+        static QMutex configMutex;
+        QMutexLocker locker(&configMutex);
+
+        //保存新的分辨率//后续修改为标准Qt用法
+        QString config_file = QString(getenv("HOME")) + QDir::separator() + QString(".config") + QDir::separator() + QString("deepin") +
+                              QDir::separator() + QString("deepin-camera") + QDir::separator() + QString("deepin-camera");
+
+        config_load(config_file.toLatin1().data());
+
+        config_t *my_config = config_get();
+
+        my_config->width = width;
+        my_config->height = height;
+        my_config->format = format;
+        set_device_name(deviceName.constData());
+        config_save(config_file.toLatin1().data());
+    });
 }
 
 void MajorImageProcessingThread::setFilter(QString filter)
 {
+    //cube文件只在首次使用时解析编译，之后从缓存获取
+    m_lut = render_lut_get(filter.toStdString().c_str());
     m_filter = filter;
 }
 
+void MajorImageProcessingThread::applyFilterRgb(uint8_t *rgb, int width, int height, int stride)
+{
+    render_lut_t *lut = m_lut;
+    if (lut)
+        render_lut_apply_rgb24(lut, rgb, width, height, stride, 0);
+    else
+        imageFilter24(rgb, width, height, m_filter.toStdString().c_str(), 100);
+}
+
+render_lut_t *MajorImageProcessingThread::pipelineLut()
+{
+    QString filter = m_filter;
+    int exposureValue = m_exposure;
+    if (filter.isEmpty() && !exposureValue)
+        return nullptr;
+
+    if (m_pipeLut && filter == m_pipeFilter && exposureValue == m_pipeExposure)
+        return m_pipeLut;
+
+    //滤镜和曝光均为逐像素运算，在LUT网格上依次执行后编译为一个3D LUT
+    const int size = PIPELINE_LUT_SIZE;
+    QVector<uint8_t> grid(size * size * size * 3);
+    render_lut_identity_rgb24(grid.data(), size);
+    if (!filter.isEmpty())
+        applyFilterRgb(grid.data(), size, size * size, size * 3);
+    if (exposureValue)
+        exposure(grid.data(), size, size * size, exposureValue);
+
+    render_lut_free(m_pipeLut);
+    m_pipeLut = render_lut_create_rgb24(grid.data(), size);
+    m_pipeFilter = filter;
+    m_pipeExposure = exposureValue;
+
+    return m_pipeLut;
+}
+
 void MajorImageProcessingThread::setExposure(int exposure)
 {
     m_exposure = exposure;
@@ -70,32 +145,48 @@ void MajorImageProcessingThread::ImageHorizontalMirror(const uint8_t* src, uint8
     yu12
     y1 y2 y3 y4                       y4 y3 y2 y1
     y5 y6 y7 y8   HorizontalMirror    y8 y7 y6 y5
-    u1 u2 u3 u4  =================>   u4 u3 u2 u1
-    v1 v2 v3 v3                       v4 v3 v2 v1
+    u1 u2                             u2 u1
+    v1 v2                             v2 v1
     */
-    int yLineStartIndex = 0;
-    int uvLineStartIndex = width * height;
-    for (int h = 0; h < height; h++) {
-        for (int w = 0; w < width; w += 2) {
-            dst[yLineStartIndex + w] = src[yLineStartIndex + width - w - 1];
-            dst[yLineStartIndex + w + 1] = src[yLineStartIndex + width - w - 2];
-            if ((h & 1) == 0) {
-                dst[uvLineStartIndex + w] = src[uvLineStartIndex + width - w - 1];
-                dst[uvLineStartIndex + w + 1] = src[uvLineStartIndex + width - w - 2];
-            }
-        }
-        yLineStartIndex += width;
-        if ((h & 1) == 0) {
-            uvLineStartIndex += width;
+    render_yu12_transform(dst, src, width, height, REND_FX_YUV_MIRROR);
+}
+
+/**
+ * @brief yu12Thumbnail 从yu12数据最近邻缩放得到rgb缩略图
+ */
+static QImage yu12Thumbnail(const uint8_t *yuv, int width, int height, int size, bool mirror)
+{
+    QImage img(size, size, QImage::Format_RGB888);
+    const uint8_t *pu = yuv + width * height;
+    const uint8_t *pv = pu + (width * height) / 4;
+
+    for (int y = 0; y < size; y++) {
+        int sy = y * height / size;
+        uchar *line = img.scanLine(y);
+        for (int x = 0; x < size; x++) {
+            int sx = x * width / size;
+            if (mirror)
+                sx = width - 1 - sx;
+            int luma = yuv[sy * width + sx];
+            int u = pu[(sy / 2) * (width / 2) + sx / 2] - 128;
+            int v = pv[(sy / 2) * (width / 2) + sx / 2] - 128;
+            int rgb[3] = {luma + ((359 * v) >> 8),
+                          luma - ((88 * u + 183 * v) >> 8),
+                          luma + ((454 * u) >> 8)};
+            for (int c = 0; c < 3; c++)
+                *line++ = static_cast<uchar>(qBound(0, rgb[c], 255));
         }
     }
+
+    return img;
 }
 
 void MajorImageProcessingThread::processingImage(QImage& img)
 {
-    // 镜像
-    if (!m_bHorizontalMirror)
-        img = img.mirrored(true,false);
+    // 镜像(原地逐行反转)
+    if (m_bHorizontalMirror && img.depth() >= 8)
+        render_mirror_plane(img.bits(), img.constBits(), img.width(), img.height(),
+                            img.depth() / 8, img.bytesPerLine(), img.bytesPerLine());
 
     if (m_bPhoto) {
         img = img.convertToFormat(QImage::Format_RGB888);
@@ -108,7 +199,7 @@ void MajorImageProcessingThread::processingImage(QImage& img)
             // 滤镜效果渲染
             uint8_t *rgb = img.bits();
             if (!m_filter.isEmpty())
-                imageFilter24(rgb, img.width(), img.height(), m_filter.toStdString().c_str(), 100);
+                applyFilterRgb(rgb, img.width(), img.height(), img.bytesPerLine());
             // 曝光强度调节
             if(m_exposure)
                 exposure(rgb, img.width(), img.height(), m_exposure);
@@ -141,53 +232,34 @@ void MajorImageProcessingThread::run()
     if (m_eEncodeEnv != QCamera_Env) {
         m_videoDevice = get_v4l2_device_handler();
         v4l2core_start_stream(m_videoDevice);
+        //预览时音频电平计量(仅FFmpeg环境，GStreamer环境的音频线程自行管理音频流)
+        if (FFmpeg_Env == m_eEncodeEnv)
+            start_audio_metering();
         int framedely = 0;
         int64_t timespausestamp = 0;
         uint yuvsize = 0;
         uint rgbsize = 0;
         uint8_t* pOldYuvFrame = nullptr;
+        render_lut_t *pipeLut = nullptr;
         while (m_stopped == 0) {
             if (get_resolution_status()) {
                 //reset
                 request_format_update(0);
-                v4l2core_stop_stream(m_videoDevice);
-                m_rwMtxImg.lock();
-                v4l2core_clean_buffers(m_videoDevice);
-                m_rwMtxImg.unlock();
-
-                int ret = v4l2core_update_current_format(m_videoDevice);
-
-                if (ret != E_OK) {
-                    fprintf(stderr, "camera: could not set the defined stream format\n");
-                    fprintf(stderr, "camera: trying first listed stream format\n");
 
-                    v4l2core_prepare_valid_format(m_videoDevice);
-                    v4l2core_prepare_valid_resolution(m_videoDevice);
-                    ret = v4l2core_update_current_format(m_videoDevice);
+                //预录编码器按旧格式创建，切换前先停止
+                stop_encoder_preroll();
 
-                    if (ret != E_OK) {
-                        fprintf(stderr, "camera: also could not set the first listed stream format\n");
-                        stop();
-                    }
+                //快速切换：格式未变时复用帧缓冲和解码器，失败时回退到第一个可用格式
+                //切换只涉及设备内部的缓冲，送显缓冲在下面尺寸变化时加锁替换
+                int ret = v4l2core_switch_format(m_videoDevice);
 
+                if (ret != E_OK) {
+                    fprintf(stderr, "camera: could not set the defined or the first listed stream format\n");
+                    stop();
                 }
 
-                v4l2core_start_stream(m_videoDevice);
-
-                //保存新的分辨率//后续修改为标准Qt用法
-                QString config_file = QString(getenv("HOME")) + QDir::separator() + QString(".config") + QDir::separator() + QString("deepin") +
-                                      QDir::separator() + QString("deepin-camera") + QDir::separator() + QString("deepin-camera");
-
-                config_load(config_file.toLatin1().data());
-
-                config_t *my_config = config_get();
-
-                my_config->width = static_cast<int>(m_videoDevice->format.fmt.pix.width);
-                my_config->height = static_cast<int>(m_videoDevice->format.fmt.pix.height);
-                my_config->format = static_cast<uint>(m_videoDevice->format.fmt.pix.pixelformat);
-                v4l2_device_list_t *devlist = get_device_list();
-                set_device_name(devlist->list_devices[get_v4l2_device_handler()->this_device].name);
-                config_save(config_file.toLatin1().data());
+                //新的分辨率在切换后的首帧送出后再保存，避免配置文件读写拖慢切换
+                m_bSaveFormatPending = (ret == E_OK);
             }
 
             m_result = -1;
@@ -210,6 +282,8 @@ void MajorImageProcessingThread::run()
             if (FFmpeg_Env == m_eEncodeEnv) {
                 // FFmpeg环境下，解码后的帧数据为yu12格式
                 if (m_nVdWidth != static_cast<unsigned int>(m_frame->width) || m_nVdHeight != static_cast<unsigned int>(m_frame->height)) {
+                    //送显缓冲可能仍被界面读取，替换时加锁
+                    QMutexLocker locker(&m_rwMtxImg);
                     m_nVdWidth = static_cast<unsigned int>(m_frame->width);
                     m_nVdHeight = static_cast<unsigned int>(m_frame->height);
                     if (m_yuvPtr != nullptr) {
@@ -230,10 +304,13 @@ void MajorImageProcessingThread::run()
                     yuvsize = m_nVdWidth * m_nVdHeight * 3 / 2;
                 }
 
-                if (m_bHorizontalMirror) {
-                    ImageHorizontalMirror(m_frame->yuv_frame, m_yuvPtr,m_frame->width,m_frame->height);
-                } else {
-                    memcpy(m_yuvPtr, m_frame->yuv_frame, yuvsize);
+                // 拍照状态下有滤镜或曝光时，镜像在后面与滤镜、曝光融合为一次处理
+                pipeLut = m_bPhoto ? pipelineLut() : nullptr;
+                if (!pipeLut) {
+                    if (m_bHorizontalMirror)
+                        ImageHorizontalMirror(m_frame->yuv_frame, m_yuvPtr,m_frame->width,m_frame->height);
+                    else
+                        memcpy(m_yuvPtr, m_frame->yuv_frame, yuvsize);
                 }
                 pOldYuvFrame = m_frame->yuv_frame;
                 m_frame->yuv_frame = m_yuvPtr;
@@ -244,7 +321,8 @@ void MajorImageProcessingThread::run()
                 jpgImage.loadFromData(temp);
                 jpgImage = jpgImage.convertToFormat(QImage::Format_RGB888);
                 if (m_bHorizontalMirror)
-                    jpgImage = jpgImage.mirrored(true, false);
+                    render_mirror_plane(jpgImage.bits(), jpgImage.constBits(), jpgImage.width(), jpgImage.height(),
+                                        3, jpgImage.bytesPerLine(), jpgImage.bytesPerLine());
             }
 
             // 判断是否使用rgb数据
@@ -258,14 +336,30 @@ void MajorImageProcessingThread::run()
             if (get_wayland_status())
                 bUseRgb = true;
 
-            if (!m_filter.isEmpty() || m_exposure)
+            // FFmpeg环境下，滤镜和曝光已编译为LUT，可直接输出yu12，无需为此转换rgb
+            if (!pipeLut && (!m_filter.isEmpty() || m_exposure))
                 bUseRgb = true;
 
             // GStreamer环境下，使用rgb格式显示帧数据
             if (GStreamer_Env == m_eEncodeEnv)
                 bUseRgb = true;
 
-            if (bUseRgb || (m_bPhoto && m_filtersGroupDislay)) {
+            // FFmpeg环境下，滤镜预览图直接从未加滤镜的yu12数据缩放得到
+            bool bYuvThumb = FFmpeg_Env == m_eEncodeEnv && m_bPhoto && m_filtersGroupDislay;
+            if (bYuvThumb) {
+                if (pipeLut)
+                    m_filterImg = yu12Thumbnail(pOldYuvFrame, m_frame->width, m_frame->height, 40, m_bHorizontalMirror);
+                else
+                    m_filterImg = yu12Thumbnail(m_frame->yuv_frame, m_frame->width, m_frame->height, 40, false);
+            }
+
+            // 融合处理：只读取一次解码帧，输出镜像、滤镜、曝光后的yu12(GL显示)
+            // 使用rgb显示时在下方同一次处理中同时输出rgb和yu12(编码输入)
+            if (pipeLut && !bUseRgb)
+                render_lut_process_yu12(pipeLut, pOldYuvFrame, m_yuvPtr, nullptr,
+                                        m_frame->width, m_frame->height, m_bHorizontalMirror, 0);
+
+            if (bUseRgb || (m_bPhoto && m_filtersGroupDislay && !bYuvThumb)) {
                 if (m_nVdWidth != static_cast<unsigned int>(m_frame->width) || m_nVdHeight != static_cast<unsigned int>(m_frame->height)) {
                     m_nVdWidth = static_cast<unsigned int>(m_frame->width);
                     m_nVdHeight = static_cast<unsigned int>(m_frame->height);
@@ -283,30 +377,42 @@ void MajorImageProcessingThread::run()
                 }
 
                 if (FFmpeg_Env == m_eEncodeEnv) {
-                    // yu12到rgb数据高性能转换
-                    yu12_to_rgb24_higheffic(m_rgbPtr, m_frame->yuv_frame, m_frame->width, m_frame->height);
+                    if (pipeLut) {
+                        // 镜像、格式转换、滤镜、曝光一次完成
+                        // 使用rgb显示时m_yuvPtr未在上方更新，同时输出yu12，保证录像(预录)取到当前帧
+                        render_lut_process_yu12(pipeLut, pOldYuvFrame, bUseRgb ? m_yuvPtr : nullptr, m_rgbPtr,
+                                                m_frame->width, m_frame->height, m_bHorizontalMirror, 0);
+                    } else {
+                        // yu12到rgb数据高性能转换
+                        yu12_to_rgb24_higheffic(m_rgbPtr, m_frame->yuv_frame, m_frame->width, m_frame->height);
+                    }
                 } else if (GStreamer_Env == m_eEncodeEnv) {
                     Q_ASSERT(m_rgbPtr);
                     memset(m_rgbPtr, 0, rgbsize * sizeof(uint8_t));
                     memcpy(m_rgbPtr, jpgImage.bits(), rgbsize);
                 }
-                m_filterImg = QImage(m_rgbPtr, m_frame->width, m_frame->height, QImage::Format_RGB888).scaled(40,40,Qt::IgnoreAspectRatio);
+                if (!bYuvThumb)
+                    m_filterImg = QImage(m_rgbPtr, m_frame->width, m_frame->height, QImage::Format_RGB888).scaled(40,40,Qt::IgnoreAspectRatio);
 
-                // 拍照状态下，曝光和滤镜功能才有效
-                if (m_bPhoto) {
+                // 拍照状态下，曝光和滤镜功能才有效(已融合处理时跳过)
+                if (m_bPhoto && !pipeLut) {
                     // 滤镜效果渲染
                     if (!m_filter.isEmpty())
-                        imageFilter24(m_rgbPtr, m_frame->width, m_frame->height, m_filter.toStdString().c_str(), 100);
+                        applyFilterRgb(m_rgbPtr, m_frame->width, m_frame->height, m_frame->width * 3);
                     // 曝光强度调节
                     if(m_exposure)
                         exposure(m_rgbPtr, m_frame->width, m_frame->height, m_exposure);
                 }
             }
 
-            /*录像*/
-            if (video_capture_get_save_video()) {
+            //启用预录或录像预备时常驻编码线程，录像结束后重新启动
+            if (m_eEncodeEnv == FFmpeg_Env && !get_encoder_status())
+                start_encoder_preroll();
+
+            /*录像(或预录)*/
+            if (video_capture_get_encoder_input()) {
 
-                if (get_myvideo_bebin_timer() == 0)
+                if (video_capture_get_save_video() && get_myvideo_bebin_timer() == 0)
                     set_myvideo_begin_timer(v4l2core_time_get_timestamp());
 
                 int size = (m_frame->width * m_frame->height * 3) / 2;
@@ -334,10 +440,12 @@ void MajorImageProcessingThread::run()
                 if (!get_capture_pause()) {
                     //设置时间戳
                     set_video_timestamptmp(static_cast<int64_t>(m_frame->timestamp));
-                    if (m_firstPts == 0) {
-                        m_firstPts = m_frame->timestamp;
+                    if (video_capture_get_save_video()) {
+                        if (m_firstPts == 0) {
+                            m_firstPts = m_frame->timestamp;
+                        }
+                        m_nCount = (m_frame->timestamp - m_firstPts) / 1000000000;
                     }
-                    m_nCount = (m_frame->timestamp - m_firstPts) / 1000000000;
                     encoder_add_video_frame(input_frame, size, static_cast<int64_t>(m_frame->timestamp), m_frame->isKeyframe);
                 } else {
                     //设置暂停时长
@@ -374,15 +482,19 @@ void MajorImageProcessingThread::run()
                 }
 
             } else if (m_bRecording) {
-                // GStreamer环境下，发送rgb格式帧数据到视频写入器，完成后续视频编码任务
-                emit sigRecordFrame(m_rgbPtr, rgbsize);
+                // GStreamer环境下，rgb帧数据直接转换写入视频写入器的缓冲池，完成后续视频编码任务
+                m_rwMtxWriter.lock();
+                if (m_videoWriter)
+                    m_videoWriter->writeFrame(m_rgbPtr, static_cast<uint>(m_frame->width), static_cast<uint>(m_frame->height),
+                                              static_cast<qint64>(m_frame->timestamp));
+                m_rwMtxWriter.unlock();
             } else {
                 m_nCount = 0;
                 m_firstPts = 0;
             }
 
             QImage* imgTmp = nullptr;
-            if (m_rgbPtr)
+            if (m_rgbPtr && bUseRgb)
                 imgTmp = new QImage(m_rgbPtr, m_frame->width, m_frame->height, QImage::Format_RGB888);
 
             /*拍照*/
@@ -426,6 +538,16 @@ void MajorImageProcessingThread::run()
                     qWarning() << "保存照片失败";
                 }
 
+                //高位深帧(p010/p016)另存为16位png/tiff，与jpg同名
+                if (nRet == 0 && FFmpeg_Env == m_eEncodeEnv && get_high_bit_depth()
+                        && m_frame->yuv16_frame && m_frame->yuv16_bits > 0) {
+                    int format = get_photo_format() == IMG_FMT_TIFF ? IMG_FMT_TIFF : IMG_FMT_PNG;
+                    QString strPath = m_strPath.left(m_strPath.lastIndexOf('.'))
+                                      + (format == IMG_FMT_TIFF ? ".tif" : ".png");
+                    if (v4l2core_save_image(m_frame, strPath.toLocal8Bit().constData(), format) < 0)
+                        qWarning() << "保存高位深照片失败";
+                }
+
                 m_bTake = false;
             }
 
@@ -463,6 +585,15 @@ void MajorImageProcessingThread::run()
 
             m_frame->yuv_frame = pOldYuvFrame;
             v4l2core_release_frame(m_videoDevice, m_frame);
+
+            //预览时将音频电平发布给vu表(录像时由音频线程发布)
+            if (FFmpeg_Env == m_eEncodeEnv)
+                update_audio_metering();
+
+            if (m_bSaveFormatPending) {
+                m_bSaveFormatPending = false;
+                saveFormatConfig();
+            }
     #ifdef UNITTEST
             break;
     #endif
@@ -470,6 +601,9 @@ void MajorImageProcessingThread::run()
             msleep(33);
         }
 
+        stop_encoder_preroll();
+        if (FFmpeg_Env == m_eEncodeEnv)
+            stop_audio_metering();
         v4l2core_stop_stream(m_videoDevice);
     }
 }
@@ -487,6 +621,9 @@ MajorImageProcessingThread::~MajorImageProcessingThread()
         m_rgbPtr = nullptr;
     }
 
+    render_lut_free(m_pipeLut);
+    m_pipeLut = nullptr;
+
     config_clean();
     qDebug() << "~MajorImageProcessingThread";
 }
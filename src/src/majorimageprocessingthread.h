@@ -31,6 +31,8 @@ extern "C" {
 }
 #endif
 
+class GstVideoWriter;
+
 /**
  * @brief stop 线程处理图片
  */
@@ -94,6 +96,15 @@ public:
         m_bRecording = bRecording;
     }
 
+    /**
+     * @brief setVideoWriter 设置GStreamer视频写入器，录制时帧数据直接写入其缓冲池
+     * @param writer  视频写入器，为空时不再写入
+     */
+    void setVideoWriter(GstVideoWriter *writer) {
+        QMutexLocker locker(&m_rwMtxWriter);
+        m_videoWriter = writer;
+    }
+
     /**
      * @brief setFilterGroupState 设置滤镜按钮组展开状态
      * @param bDisplay  true 展开 false 关闭
@@ -146,13 +157,6 @@ signals:
 
 #endif
 
-    /**
-     * @brief sigRecordFrame 发送GStreamer视频帧写入信号
-     * @param rgb  rgb24帧数据
-     * @param size yuv数据大小
-     */
-    void sigRecordFrame(uchar *rgb, uint size);
-
     /**
      * @brief reachMaxDelayedFrames 到达最大延迟信号
      */
@@ -167,6 +171,26 @@ public:
 private:
     void ImageHorizontalMirror(const uint8_t* src, uint8_t* dst, int width, int height);
 
+    /**
+     * @brief saveFormatConfig 保存当前分辨率和格式到配置文件(格式切换后首帧送出后调用，文件读写在后台执行)
+     */
+    void saveFormatConfig();
+
+    /**
+     * @brief applyFilterRgb 对rgb数据应用当前滤镜(优先使用已编译的LUT)
+     * @param rgb rgb数据
+     * @param width 宽
+     * @param height 高
+     * @param stride 每行字节数
+     */
+    void applyFilterRgb(uint8_t *rgb, int width, int height, int stride);
+
+    /**
+     * @brief pipelineLut 获取当前滤镜和曝光编译成的3D LUT(参数变化时重新编译)
+     * @return 无滤镜和曝光时返回空
+     */
+    render_lut_t *pipelineLut();
+
 public slots:
     void processingImage(QImage&);
 
@@ -176,6 +200,10 @@ private:
     uint              m_nVdHeight;
     volatile int      m_majorindex;
     QString           m_filter;//当前选择的滤镜名称
+    render_lut_t      *m_lut = nullptr;//当前滤镜已编译的3D LUT，为空时回退到imageFilter24
+    render_lut_t      *m_pipeLut = nullptr;//滤镜+曝光编译成的3D LUT，用于融合处理
+    QString           m_pipeFilter;//m_pipeLut对应的滤镜
+    int               m_pipeExposure = 0;//m_pipeLut对应的曝光值
     QAtomicInt        m_stopped;
     v4l2_dev_t        *m_videoDevice;
     v4l2_frame_buff_t *m_frame;
@@ -184,12 +212,15 @@ private:
 
     bool              m_bPhoto = true; //相机当前状态，默认为拍照状态
     bool              m_bRecording;//是否处理视频录制状态 GStreamer环境下使用
+    GstVideoWriter    *m_videoWriter = nullptr;//GStreamer视频写入器
+    QMutex            m_rwMtxWriter;//保护m_videoWriter
     bool              m_bHorizontalMirror;   //水平镜像
     EncodeEnv         m_eEncodeEnv;          //编码环境
     int               m_exposure = 0;
     bool              m_filtersGroupDislay = false;//滤镜按钮组是否显示
     int               m_nCount;
     uint64_t          m_firstPts;
+    bool              m_bSaveFormatPending; //格式切换后待保存配置
 
     QImage            m_Img;   //mips、wayland下使用该变量
     QImage            m_filterImg; //滤镜预览类使用 大小40*40
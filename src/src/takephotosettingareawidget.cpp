@@ -18,6 +18,11 @@
 #include <QScrollArea>
 #include <QVBoxLayout>
 #include <QScrollBar>
+#include <QVector>
+
+extern "C" {
+#include "gviewrender.h"
+}
 
 #define ANIMATION_DURATION 200
 #define ANIMATION_FOLD_DURATION 200
@@ -25,6 +30,7 @@
 #define ANIMATION_FILTER_DURATION 170
 #define SLIDER_ANIMATION_DURATION 50
 #define EXPOSURE_SLIDER_HEIGHT 192
+#define FILTER_PREVIEW_INTERVAL 250 //滤镜预览图刷新间隔(ms)
 
 #define LEFT_MARGIN_PIX 10
 
@@ -1227,10 +1233,55 @@ void takePhotoSettingAreaWidget::onUpdateFilterImage(QImage *img)
     if (!img)
         return;
 
-    for (auto btn : m_filterPreviewBtnList) {
-        QImage tmp = img->copy();
-        btn->setImage(&tmp);
+    //无画面时清空预览图
+    if (img->isNull()) {
+        for (auto btn : m_filterPreviewBtnList) {
+            QImage tmp;
+            btn->setImage(&tmp);
+        }
+        m_filterPreviewTimer.invalidate();
+        return;
+    }
+
+    //滤镜栏收起时不处理，展开时限制刷新频率
+    if (!m_filtersGroupDislay)
+        return;
+    if (m_filterPreviewTimer.isValid() && m_filterPreviewTimer.elapsed() < FILTER_PREVIEW_INTERVAL)
+        return;
+    m_filterPreviewTimer.start();
+
+    int count = m_filterPreviewBtnList.size();
+    QVector<render_lut_t *> luts(count);
+    bool bAtlas = true;
+    for (int i = 0; i < count; i++) {
+        QString name = filterPreviewButton::filterName_CUBE(m_filterPreviewBtnList.at(i)->getFiltertype());
+        luts[i] = render_lut_get(name.toStdString().c_str());
+        if (!name.isEmpty() && !luts[i])
+            bAtlas = false;
+    }
+
+    //cube文件不可用时，每个按钮单独处理
+    if (!bAtlas) {
+        for (auto btn : m_filterPreviewBtnList) {
+            QImage tmp = img->copy();
+            btn->setImage(&tmp);
+        }
+        return;
     }
+
+    //一次遍历源图，生成所有滤镜的预览图集
+    QImage src = img->convertToFormat(QImage::Format_RGB888);
+    int width = src.width();
+    int height = src.height();
+    if (m_filterAtlas.width() != width * count || m_filterAtlas.height() != height)
+        m_filterAtlas = QImage(width * count, height, QImage::Format_RGB888);
+
+    render_lut_apply_atlas(luts.constData(), count, src.constBits(), width, height, src.bytesPerLine(),
+                           m_filterAtlas.bits(), m_filterAtlas.bytesPerLine());
+
+    QPixmap atlas = QPixmap::fromImage(m_filterAtlas);
+    for (int i = 0; i < count; i++)
+        m_filterPreviewBtnList.at(i)->setPreview(atlas, QRect(i * width, 0, width, height));
 }
 
 void takePhotoSettingAreaWidget::onExposureValueChanged(int value)
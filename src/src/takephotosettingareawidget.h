@@ -14,6 +14,7 @@
 #include <QParallelAnimationGroup>
 #include <QEvent>
 #include <QKeyEvent>
+#include <QElapsedTimer>
 
 #include "exposureslider.h"
 
@@ -276,6 +277,8 @@ private:
     circlePushButton        *m_filtersUnfoldBtn = nullptr;//展开滤镜按钮
 
     filterPreviewBtnList     m_filterPreviewBtnList;//滤镜预览按钮列表
+    QImage                   m_filterAtlas;//所有滤镜预览图拼接的图集
+    QElapsedTimer            m_filterPreviewTimer;//滤镜预览图刷新限速
     circlePushButton        *m_filtersCloseBtn = nullptr;//关闭滤镜界面按钮
 
     circlePushButton        *m_exposureBtn = nullptr;//曝光按钮
@@ -58,8 +58,8 @@ bool VideoSurface::present(const QVideoFrame &frame) //每一帧摄像头的数
     currentFrame_ = frame;
 
     if (currentFrame_.map(QAbstractVideoBuffer::ReadOnly)) {
-        //img就是转换的数据了
-        QImage img = QImage(currentFrame_.bits(),currentFrame_.width(),currentFrame_.height(),currentFrame_.bytesPerLine(),imageFormat_).mirrored(true,false);
+        //img就是转换的数据了，映射内存在unmap后失效，需深拷贝；镜像由处理线程按设置原地完成
+        QImage img = QImage(currentFrame_.bits(),currentFrame_.width(),currentFrame_.height(),currentFrame_.bytesPerLine(),imageFormat_).copy();
         emit presentImage(img);
         currentFrame_.unmap();
     }
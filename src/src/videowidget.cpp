@@ -255,13 +255,9 @@ void videowidget::delayInit()
     connect(m_imgPrcThread, SIGNAL(sigReflushSnapshotLabel()),
             this, SIGNAL(reflushSnapshotLabel()));
 
-    connect(m_imgPrcThread, SIGNAL(sigRecordFrame(uchar*, uint)),
-            this, SLOT(onRecordFrame(uchar*, uint)));
-
     m_audPrcThread = new AudioProcessingThread;
     m_audPrcThread->setParent(this);
     m_audPrcThread->setObjectName("AudioThread");
-    connect(m_audPrcThread, SIGNAL(sendAudioProcessing(uchar*, uint)), this, SLOT(onRecordAudio(uchar*, uint)));
 
     QPalette pltFlashLabel = m_flashLabel->palette();
     pltFlashLabel.setColor(QPalette::Window, QColor(Qt::white));
@@ -773,6 +769,15 @@ void videowidget::showRecTime()
 //        m_nCount = static_cast<int>(get_video_time_capture());
         m_nCount = m_imgPrcThread->getRecCount();
 
+        //编码速度与编码队列深度，编码跟不上采集时队列会持续增长
+        double encodeFps = 0;
+        int queueDepth = 0;
+        int queueSize = 0;
+        encoder_get_video_stats(&encodeFps, &queueDepth, &queueSize);
+        m_recordingTimeWidget->setToolTip(QString("%1 fps  %2/%3").arg(encodeFps, 0, 'f', 1).arg(queueDepth).arg(queueSize));
+        if (queueSize > 0 && queueDepth * 2 > queueSize)
+            qWarning() << "encoder falling behind:" << encodeFps << "fps, queue" << queueDepth << "/" << queueSize;
+
         //过滤不正常的时间
 //        if (m_nCount <= 3) {
 //            qWarning() << "error time" << m_nCount;
@@ -899,18 +904,6 @@ void videowidget::slotVideoFormatChanged(const QString &format)
     m_videoFormat = format;
 }
 
-void videowidget::onRecordFrame(uchar *rgb, uint size)
-{
-    if (m_videoWriter)
-        m_videoWriter->writeFrame(rgb, size);
-}
-
-void videowidget::onRecordAudio(uchar *data, uint size)
-{
-    if (m_videoWriter)
-        m_videoWriter->writeAudio(data, size);
-}
-
 void videowidget::onEndBtnClicked()
 {
     if (m_countTimer->isActive())
@@ -1192,6 +1185,8 @@ void videowidget::onTakeVideo() //点一次开，再点一次关
         //向mainwindow 发送录像状态通知信号
         emit updateRecordState(photoRecordBtn::Normal);
         if (DataManager::instance()->encodeEnv() == FFmpeg_Env) {
+            //点击录像到第一帧编码完成的延迟
+            qDebug() << "record start latency(ms):" << get_record_start_latency() / 1000000.0;
             stop_encoder_thread();
         } else if (DataManager::instance()->encodeEnv() == QCamera_Env) {
             Camera::instance()->stopRecoder();
@@ -1288,10 +1283,14 @@ void videowidget::startTakeVideo()
                 start_encoder_thread();
             } else if (DataManager::instance()->encodeEnv() == GStreamer_Env) {
                 QString recordFileName = m_saveVdFolder + "/" + DataManager::instance()->getstrFileName();
-                if (!m_videoWriter)
+                if (!m_videoWriter) {
                     m_videoWriter = new GstVideoWriter(recordFileName);
-                else
+                    // 采集线程和音频线程直接向写入器的缓冲池写入数据
+                    m_imgPrcThread->setVideoWriter(m_videoWriter);
+                    m_audPrcThread->setVideoWriter(m_videoWriter);
+                } else {
                     m_videoWriter->setVideoPath(recordFileName);
+                }
 
                 m_videoWriter->start();
                 m_audPrcThread->init();
@@ -1548,13 +1547,18 @@ void videowidget::onFilterDisplayChanged(int bDisplay)
 
 videowidget::~videowidget()
 {
+    //先停止处理线程并解除其持有的写入器指针，之后才能释放写入器
     m_imgPrcThread->stop();
     m_imgPrcThread->wait();
+    m_imgPrcThread->setVideoWriter(nullptr);
     delete m_imgPrcThread;
+    m_imgPrcThread = nullptr;
 
     m_audPrcThread->stop();
     m_audPrcThread->wait();
+    m_audPrcThread->setVideoWriter(nullptr);
     delete m_audPrcThread;
+    m_audPrcThread = nullptr;
 #ifndef __mips__
     if (!get_wayland_status()) {
         if (m_openglwidget) {
@@ -361,16 +361,6 @@ private slots:
      */
     void slotVideoFormatChanged(const QString &);
 
-    /**
-    * @brief onRecordFrame　向GStreamer写入视频帧数据
-    */
-    void onRecordFrame(uchar* yuv, uint size);
-
-    /**
-    * @brief onRecordAudio　向GStreamer写入音频帧数据
-    */
-    void onRecordAudio(uchar* data, uint size);
-
 private:
     void resizeEvent(QResizeEvent *size) Q_DECL_OVERRIDE;
 
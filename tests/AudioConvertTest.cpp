@@ -0,0 +1,147 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "AudioConvertTest.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+extern "C"
+{
+#include "gviewaudio.h"
+}
+
+#define TEST_FRAMES 1155 //非SIMD块大小整数倍，覆盖尾部标量处理
+
+/**
+ *  @brief 逐样本参考实现(原audio_get_next_buffer中的转换)
+ */
+static int16_t refClip(float in)
+{
+    long lout = lroundf(in);
+    return static_cast<int16_t>(lout < INT16_MIN ? INT16_MIN : (lout > INT16_MAX ? INT16_MAX : lout));
+}
+
+AudioConvertTest::AudioConvertTest()
+{
+
+}
+
+void AudioConvertTest::SetUp()
+{
+    m_samples.resize(TEST_FRAMES * 3);
+    for (int i = 0; i < m_samples.size(); i++)
+        m_samples[i] = static_cast<float>(sin(i * 0.01) * 1.2);
+    //超出范围的样本需要饱和
+    m_samples[1] = 5.0f;
+    m_samples[2] = -7.0f;
+}
+
+void AudioConvertTest::TearDown()
+{
+    m_samples.clear();
+}
+
+/**
+ *  @brief 交错浮点转int16，与逐样本转换最多相差1(舍入方式不同)
+ */
+TEST_F(AudioConvertTest, Int16)
+{
+    for (int channels = 1; channels <= 3; channels++) {
+        QVector<int16_t> out(TEST_FRAMES * channels);
+        audio_convert_samples(out.data(), m_samples.data(), TEST_FRAMES, channels, GV_SAMPLE_TYPE_INT16);
+        for (int i = 0; i < out.size(); i++)
+            EXPECT_LE(qAbs(out[i] - refClip(m_samples[i] * INT16_MAX)), 1);
+        EXPECT_EQ(out[1], INT16_MAX);
+        EXPECT_EQ(out[2], INT16_MIN);
+    }
+}
+
+/**
+ *  @brief 交错转平面格式(float/int16)
+ */
+TEST_F(AudioConvertTest, Planar)
+{
+    for (int channels = 1; channels <= 3; channels++) {
+        QVector<float> outf(TEST_FRAMES * channels);
+        QVector<int16_t> outs(TEST_FRAMES * channels);
+        audio_convert_samples(outf.data(), m_samples.data(), TEST_FRAMES, channels, GV_SAMPLE_TYPE_FLOATP);
+        audio_convert_samples(outs.data(), m_samples.data(), TEST_FRAMES, channels, GV_SAMPLE_TYPE_INT16P);
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            for (int j = 0; j < channels; j++) {
+                float in = m_samples[i * channels + j];
+                EXPECT_EQ(outf[j * TEST_FRAMES + i], in);
+                EXPECT_LE(qAbs(outs[j * TEST_FRAMES + i] - refClip(in * INT16_MAX)), 1);
+            }
+        }
+    }
+}
+
+/**
+ *  @brief 多声道峰值与RMS电平(SIMD与尾部标量路径)
+ */
+TEST_F(AudioConvertTest, Levels)
+{
+    for (int channels = 1; channels <= AUDIO_METER_MAX_CHANNELS; channels++) {
+        int frames = m_samples.size() / channels;
+        float peak[AUDIO_METER_MAX_CHANNELS];
+        float rms[AUDIO_METER_MAX_CHANNELS];
+        audio_get_block_levels(m_samples.constData(), frames, channels, peak, rms);
+        for (int j = 0; j < channels; j++) {
+            double refPeak = 0;
+            double refSum = 0;
+            for (int i = 0; i < frames; i++) {
+                double v = fabs(m_samples[i * channels + j]);
+                refPeak = qMax(refPeak, v);
+                refSum += v * v;
+            }
+            EXPECT_FLOAT_EQ(peak[j], static_cast<float>(refPeak));
+            EXPECT_NEAR(rms[j], sqrt(refSum / frames), 1e-4);
+        }
+    }
+}
+
+/**
+ *  @brief 立体声int16平面格式转换：SIMD输出与逐样本转换一致(最多相差1)，并输出两者耗时
+ */
+TEST_F(AudioConvertTest, Benchmark)
+{
+    const int frames = 1024;
+    const int channels = 2;
+    const int loops = 2000;
+    QVector<float> in(frames * channels);
+    for (int i = 0; i < in.size(); i++)
+        in[i] = m_samples[i % m_samples.size()];
+    QVector<int16_t> refOut(frames * channels);
+    QVector<int16_t> out(frames * channels);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int n = 0; n < loops; n++) {
+        int16_t *planes[channels] = {refOut.data(), refOut.data() + frames};
+        const float *p = in.constData();
+        for (int i = 0; i < frames; i++)
+            for (int j = 0; j < channels; j++)
+                planes[j][i] = refClip((*p++) * INT16_MAX);
+    }
+    qint64 refNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int n = 0; n < loops; n++)
+        audio_convert_samples(out.data(), in.constData(), frames, channels, GV_SAMPLE_TYPE_INT16P);
+    qint64 simdNs = timer.nsecsElapsed();
+
+    qDebug() << "int16p per-sample:" << refNs / loops << "ns/block, simd:" << simdNs / loops << "ns/block";
+
+    int mismatched = 0;
+    for (int i = 0; i < out.size(); i++) {
+        if (qAbs(out[i] - refOut[i]) > 1)
+            mismatched++;
+    }
+    EXPECT_EQ(mismatched, 0);
+    //饱和的样本：第0帧右声道与第1帧左声道
+    EXPECT_EQ(out[frames], INT16_MAX);
+    EXPECT_EQ(out[1], INT16_MIN);
+}
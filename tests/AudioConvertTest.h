@@ -0,0 +1,25 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef AUDIOCONVERTTEST_H
+#define AUDIOCONVERTTEST_H
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QVector>
+
+class AudioConvertTest : public ::testing::Test
+{
+public:
+    AudioConvertTest();
+    virtual void SetUp();
+    virtual void TearDown();
+
+protected:
+    QVector<float> m_samples; //交错格式的浮点样本
+};
+
+#endif // AUDIOCONVERTTEST_H
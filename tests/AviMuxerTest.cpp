@@ -0,0 +1,202 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "AviMuxerTest.h"
+
+#include <QFileInfo>
+#include <QFile>
+#include <QStringList>
+#include <QDir>
+#include <QStorageInfo>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <linux/videodev2.h>
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include "gviewencoder.h"
+#include "encoder.h"
+#include "avi.h"
+}
+
+#define TEST_FRAME_MAX (2 * 1024 * 1024) //4K MJPEG单帧上限
+#define TEST_AUDIO_SIZE 6401             //奇数大小，覆盖对齐字节
+#define TEST_SPACE_NEEDED (48LL * 1024 * 1024) //单个用例写入的最大数据量(分段录制约40MB)
+
+AviMuxerTest::AviMuxerTest()
+{
+
+}
+
+void AviMuxerTest::SetUp()
+{
+    //优先放在tmpfs上，容器中/dev/shm默认只有64MB，空间不足时使用临时目录
+    QString dir = QDir::tempPath();
+    QStorageInfo shm("/dev/shm");
+    if (shm.isValid() && shm.bytesAvailable() > TEST_SPACE_NEEDED)
+        dir = "/dev/shm";
+    m_fileName = dir + "/deepin-camera-avi-test.avi";
+    m_frame.resize(TEST_FRAME_MAX);
+    for (int i = 0; i < m_frame.size(); i++)
+        m_frame[i] = static_cast<char>(i * 7 + 3);
+}
+
+void AviMuxerTest::TearDown()
+{
+    QFile::remove(m_fileName);
+    m_frame.clear();
+}
+
+/**
+ *  @brief 4K MJPEG录制(1秒30fps，含PCM音频)：文件大小与逻辑偏移一致，idx1包含每个数据块
+ */
+TEST_F(AviMuxerTest, IndexEntries)
+{
+    const int frames = 30;
+    avi_context_t *ctx = avi_create_context(m_fileName.toLocal8Bit().constData());
+    ASSERT_NE(ctx, nullptr);
+    ctx->fps = 30;
+    avi_add_video_stream(ctx, 3840, 2160, 30, 1, AV_CODEC_ID_MJPEG);
+    avi_add_audio_stream(ctx, 2, 48000, 16, 1536000, AV_CODEC_ID_PCM_S16LE, 1);
+    avi_add_new_riff(ctx);
+
+    uint8_t *data = reinterpret_cast<uint8_t *>(m_frame.data());
+    quint32 seed = 1;
+    qint64 payload = 0;
+    for (int i = 0; i < frames; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t size = 600 * 1024 + (seed >> 8) % (900 * 1024);
+        avi_write_packet(ctx, 0, data, size, i, 0, (i % 30) == 0 ? AV_PKT_FLAG_KEY : 0);
+        avi_write_packet(ctx, 1, data, TEST_AUDIO_SIZE, i, 0, AV_PKT_FLAG_KEY);
+        payload += size + TEST_AUDIO_SIZE;
+    }
+    avi_close(ctx);
+    int64_t offset = io_get_offset(ctx->writer);
+    avi_destroy_context(ctx);
+
+    //逻辑偏移必须与实际文件大小一致
+    EXPECT_EQ(QFileInfo(m_fileName).size(), offset);
+    EXPECT_GT(offset, payload);
+
+    QFile file(m_fileName);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    QByteArray header = file.read(12);
+    EXPECT_EQ(header.left(4), QByteArray("RIFF"));
+    EXPECT_EQ(header.mid(8, 4), QByteArray("AVI "));
+
+    //单个RIFF的文件以idx1结束，每个数据块对应16字节的索引项
+    const int idxSize = 8 + frames * 2 * 16;
+    ASSERT_TRUE(file.seek(file.size() - idxSize));
+    QByteArray idx = file.read(idxSize);
+    ASSERT_EQ(idx.left(4), QByteArray("idx1"));
+    quint32 chunkSize = static_cast<quint8>(idx[4]) | (static_cast<quint8>(idx[5]) << 8)
+                        | (static_cast<quint8>(idx[6]) << 16) | (static_cast<quint32>(static_cast<quint8>(idx[7])) << 24);
+    EXPECT_EQ(chunkSize, quint32(frames * 2 * 16));
+
+    int videoEntries = 0;
+    int audioEntries = 0;
+    for (int pos = 8; pos + 16 <= idx.size(); pos += 16) {
+        QByteArray tag = idx.mid(pos, 4);
+        if (tag == "00dc")
+            videoEntries++;
+        else if (tag == "01wb")
+            audioEntries++;
+    }
+    EXPECT_EQ(videoEntries, frames);
+    EXPECT_EQ(audioEntries, frames);
+}
+
+/**
+ *  @brief 长时间4K MJPEG录制的写入吞吐量(约10秒30fps，含PCM音频，写入约450MB)
+ *  默认不运行，使用--gtest_also_run_disabled_tests --gtest_filter=*Throughput手动测量
+ */
+TEST_F(AviMuxerTest, DISABLED_Throughput)
+{
+    const int frames = 300;
+    QStorageInfo storage(QFileInfo(m_fileName).absolutePath());
+    if (storage.bytesAvailable() < static_cast<qint64>(frames) * TEST_FRAME_MAX) {
+        qDebug() << "avi throughput skipped: not enough space in" << storage.rootPath();
+        return;
+    }
+
+    avi_context_t *ctx = avi_create_context(m_fileName.toLocal8Bit().constData());
+    ASSERT_NE(ctx, nullptr);
+    ctx->fps = 30;
+    avi_add_video_stream(ctx, 3840, 2160, 30, 1, AV_CODEC_ID_MJPEG);
+    avi_add_audio_stream(ctx, 2, 48000, 16, 1536000, AV_CODEC_ID_PCM_S16LE, 1);
+    avi_add_new_riff(ctx);
+
+    uint8_t *data = reinterpret_cast<uint8_t *>(m_frame.data());
+    quint32 seed = 1;
+    qint64 payload = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t size = 600 * 1024 + (seed >> 8) % (900 * 1024);
+        avi_write_packet(ctx, 0, data, size, i, 0, (i % 30) == 0 ? AV_PKT_FLAG_KEY : 0);
+        avi_write_packet(ctx, 1, data, TEST_AUDIO_SIZE, i, 0, AV_PKT_FLAG_KEY);
+        payload += size + TEST_AUDIO_SIZE;
+    }
+    avi_close(ctx);
+    int64_t offset = io_get_offset(ctx->writer);
+    avi_destroy_context(ctx);
+    qint64 ns = timer.nsecsElapsed();
+
+    EXPECT_EQ(QFileInfo(m_fileName).size(), offset);
+
+    qDebug() << "avi 4K mjpeg:" << frames << "frames," << payload / (1024 * 1024) << "MB in"
+             << ns / 1000000 << "ms," << (payload / 1048576.0) / (ns / 1e9) << "MB/s";
+}
+
+/**
+ *  @brief 分段录制：按时长在关键帧处切换文件，并写入索引日志
+ */
+TEST_F(AviMuxerTest, Segments)
+{
+    encoder_video_context_t video = {};
+    encoder_context_t encoder = {};
+    encoder.enc_video_ctx = &video;
+    encoder.muxer_id = ENCODER_MUX_AVI;
+    encoder.input_format = V4L2_PIX_FMT_H264; //直接写入摄像头的编码数据
+    encoder.video_width = 3840;
+    encoder.video_height = 2160;
+    encoder.fps_num = 1;
+    encoder.fps_den = 30;
+    video.outbuf = reinterpret_cast<uint8_t *>(m_frame.data());
+
+    encoder_set_segment_limits(2, 0);
+    encoder_set_index_journal(1);
+    encoder_muxer_init(&encoder, m_fileName.toLocal8Bit().constData());
+    for (int i = 0; i < 200; i++) {
+        video.pts = static_cast<int64_t>(i) * 1000000000 / 30;
+        video.flags = (i % 15) == 0 ? AV_PKT_FLAG_KEY : 0; //每0.5秒一个关键帧
+        video.outbuf_coded_size = 200 * 1024 + i;
+        encoder_write_video_data(&encoder);
+    }
+    encoder_muxer_close(&encoder);
+    encoder_set_segment_limits(0, 0);
+    encoder_set_index_journal(0);
+
+    //6.6秒的录制：0-2.5秒，2.5-5秒，5-6.6秒
+    EXPECT_EQ(encoder_get_segment_count(), 3);
+
+    QString stem = m_fileName.left(m_fileName.lastIndexOf('.'));
+    QStringList files = {m_fileName, stem + "_002.avi", stem + "_003.avi"};
+    for (const QString &name : files) {
+        QFile file(name);
+        ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+        EXPECT_EQ(file.read(4), QByteArray("RIFF"));
+        file.close();
+        if (name != m_fileName)
+            QFile::remove(name);
+    }
+
+    QFile journal(m_fileName + ".journal");
+    ASSERT_TRUE(journal.open(QIODevice::ReadOnly));
+    QList<QByteArray> lines = journal.readAll().split('\n');
+    journal.remove();
+    EXPECT_TRUE(lines.contains("end 3"));
+}
@@ -0,0 +1,27 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef AVIMUXERTEST_H
+#define AVIMUXERTEST_H
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QByteArray>
+#include <QString>
+
+class AviMuxerTest : public ::testing::Test
+{
+public:
+    AviMuxerTest();
+    virtual void SetUp();
+    virtual void TearDown();
+
+protected:
+    QString m_fileName;  //输出文件(优先放在tmpfs上)
+    QByteArray m_frame;  //模拟的4K MJPEG帧数据
+};
+
+#endif // AVIMUXERTEST_H
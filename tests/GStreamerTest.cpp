@@ -73,6 +73,7 @@ TEST_F(GStreamerTest, videorecord)
     Stub_Function::resetSub(::audio_start, ADDR(Stub_Function, audio_start));
     Stub_Function::resetSub(::audio_stop, ADDR(Stub_Function, audio_stop));
     Stub_Function::resetSub(::audio_get_next_buffer, ADDR(Stub_Function, audio_get_next_buffer));
+    Stub_Function::resetSub(::audio_wait_buffer, ADDR(Stub_Function, audio_wait_buffer));
     RollingBox *rollBox = m_mainwindow->findChild<RollingBox *>(MODE_SWITCH_BOX);
     dc::Settings::get().settings()->setOption(QString("photosetting.photosdelay.photodelays"), 0);
     emit rollBox->currentValueChanged(ActType::ActTakeVideo);
@@ -112,6 +113,7 @@ TEST_F(GStreamerTest, videorecord)
     Stub_Function::clearSub(ADDR(Stub_Function, audio_start));
     Stub_Function::clearSub(ADDR(Stub_Function, audio_stop));
     Stub_Function::clearSub(ADDR(Stub_Function, audio_get_next_buffer));
+    Stub_Function::clearSub(ADDR(Stub_Function, audio_wait_buffer));
 
     //切换回拍照模式
     emit rollBox->currentValueChanged(ActType::ActTakePic);
@@ -22,14 +22,56 @@
 #include "src/capplication.h"
 #include "stub/stub_function.h"
 #include <QtTest/qtest.h>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QFile>
 extern "C"
 {
 #include "v4l2_devices.h"
 #include "camview.h"
+#include "gviewrender.h"
+#include "colorspaces.h"
+#include "gviewencoder.h"
+#include <libimagevisualresult/visualresult.h>
 }
 #include "addr_pri.h"
 
 ACCESS_PRIVATE_FUN(MajorImageProcessingThread, void(), run);
+ACCESS_PRIVATE_FUN(MajorImageProcessingThread, void(const uint8_t*, uint8_t*, int, int), ImageHorizontalMirror);
+ACCESS_PRIVATE_FIELD(MajorImageProcessingThread, EncodeEnv, m_eEncodeEnv);
+ACCESS_PRIVATE_FIELD(MajorImageProcessingThread, render_lut_t *, m_pipeLut);
+ACCESS_PRIVATE_FIELD(MajorImageProcessingThread, QString, m_pipeFilter);
+ACCESS_PRIVATE_FIELD(MajorImageProcessingThread, uint8_t *, m_rgbPtr);
+ACCESS_PRIVATE_FUN(MajorImageProcessingThread, void(uint8_t*, int, int, int), applyFilterRgb);
+
+/**
+ *  @brief 在dir下生成暖色滤镜的cube文件(红色提升，蓝色衰减)，作为3D LUT测试数据
+ *  @return cube文件路径
+ */
+static QString writeWarmCube(const QString &dir)
+{
+    const int size = 17;
+    QString fileName = dir + "/warm.cube";
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return QString();
+
+    QTextStream out(&file);
+    out << "TITLE \"warm\"\n";
+    out << "LUT_3D_SIZE " << size << "\n";
+    for (int b = 0; b < size; b++)
+        for (int g = 0; g < size; g++)
+            for (int r = 0; r < size; r++) {
+                double rv = qMin(1.0, r / double(size - 1) * 0.9 + 0.1);
+                double gv = g / double(size - 1);
+                double bv = b / double(size - 1) * 0.8;
+                out << QString::number(rv, 'f', 6) << " " << QString::number(gv, 'f', 6) << " "
+                    << QString::number(bv, 'f', 6) << "\n";
+            }
+
+    return fileName;
+}
 
 MajorImagePThTest::MajorImagePThTest()
 {
@@ -171,3 +213,227 @@ TEST_F(MajorImagePThTest, TakePic)
     call_private_fun::MajorImageProcessingThreadrun(*m_processThread);
     m_processThread->setHorizontalMirror(true);
 }
+
+/**
+ *  @brief 拍照状态下滤镜+曝光+镜像融合处理，与原处理链(镜像->yu12转rgb->滤镜->曝光)结果一致
+ */
+TEST_F(MajorImagePThTest, FilterExposure)
+{
+    v4l2_frame_buff_t *frame = ::v4l2core_get_decoded_frame(nullptr);
+    ASSERT_NE(frame, nullptr);
+    const int width = frame->width;
+    const int height = frame->height;
+    const int yuvsize = width * height * 3 / 2;
+    uint8_t *pu = frame->yuv_frame + width * height;
+    uint8_t *pv = pu + width * height / 4;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            frame->yuv_frame[y * width + x] = static_cast<uint8_t>((x + y) & 0xff);
+    for (int y = 0; y < height / 2; y++)
+        for (int x = 0; x < width / 2; x++) {
+            pu[y * width / 2 + x] = static_cast<uint8_t>(64 + (x & 0x7f));
+            pv[y * width / 2 + x] = static_cast<uint8_t>(192 - (x & 0x7f));
+        }
+    QVector<uint8_t> src(frame->yuv_frame, frame->yuv_frame + yuvsize);
+
+    // 滤镜目录指向测试生成的cube文件，清除之前缓存的加载失败结果
+    QTemporaryDir lutDir;
+    ASSERT_TRUE(lutDir.isValid());
+    ASSERT_FALSE(writeWarmCube(lutDir.path()).isEmpty());
+    m_processThread->setFilter("");
+    render_lut_clean();
+    render_lut_set_dir(lutDir.path().toLocal8Bit().constData());
+    ASSERT_NE(render_lut_get("warm"), nullptr);
+    access_private_field::MajorImageProcessingThreadm_pipeFilter(*m_processThread).clear();
+
+    // 使用rgb显示，融合处理结果输出到m_rgbPtr
+    EncodeEnv encodeEnv = access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread);
+    access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread) = FFmpeg_Env;
+    Stub_Function::resetSub(::get_wayland_status, ADDR(Stub_Function, get_wayland_status_true));
+    Stub_Function::resetSub(::get_encoder_status, ADDR(Stub_Function, get_encoder_status_true));
+
+    m_processThread->init();
+    m_processThread->setState(true);
+    m_processThread->setFilter("warm");
+    m_processThread->setExposure(50);
+    m_processThread->setHorizontalMirror(true);
+    call_private_fun::MajorImageProcessingThreadrun(*m_processThread);
+
+    uint8_t *fusedRgb = access_private_field::MajorImageProcessingThreadm_rgbPtr(*m_processThread);
+    ASSERT_NE(fusedRgb, nullptr);
+
+    init_yuv2rgb_num_table();
+    QVector<uint8_t> mirror(yuvsize);
+    QVector<uint8_t> chainRgb(width * height * 3);
+    call_private_fun::MajorImageProcessingThreadImageHorizontalMirror(*m_processThread, src.constData(), mirror.data(), width, height);
+    yu12_to_rgb24_higheffic(chainRgb.data(), mirror.data(), width, height);
+    call_private_fun::MajorImageProcessingThreadapplyFilterRgb(*m_processThread, chainRgb.data(), width, height, width * 3);
+    exposure(chainRgb.data(), width, height, 50);
+
+    // 不加滤镜的结果，用于确认滤镜确实生效
+    QVector<uint8_t> plainRgb(width * height * 3);
+    yu12_to_rgb24_higheffic(plainRgb.data(), mirror.data(), width, height);
+    exposure(plainRgb.data(), width, height, 50);
+
+    // LUT网格插值与逐像素计算存在量化误差
+    double diff = 0;
+    double filterDiff = 0;
+    for (int i = 0; i < chainRgb.size(); i++) {
+        diff += qAbs(chainRgb[i] - fusedRgb[i]);
+        filterDiff += qAbs(plainRgb[i] - fusedRgb[i]);
+    }
+    EXPECT_LT(diff / chainRgb.size(), 3.0);
+    EXPECT_GT(filterDiff / chainRgb.size(), 5.0);
+
+    m_processThread->setFilter("");
+    m_processThread->setExposure(0);
+    render_lut_clean();
+    Stub_Function::clearSub(::get_wayland_status);
+    Stub_Function::clearSub(::get_encoder_status);
+    access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread) = encodeEnv;
+}
+
+/**
+ *  @brief 使用rgb显示时拍照滤镜融合处理，送入编码器(预录)的yu12为当前帧镜像+滤镜结果
+ */
+TEST_F(MajorImagePThTest, RgbDisplayEncoderInput)
+{
+    v4l2_frame_buff_t *frame = ::v4l2core_get_decoded_frame(nullptr);
+    ASSERT_NE(frame, nullptr);
+    const int width = frame->width;
+    const int height = frame->height;
+    const int yuvsize = width * height * 3 / 2;
+    for (int i = 0; i < yuvsize; i++)
+        frame->yuv_frame[i] = static_cast<uint8_t>((i * 7 + i / width) & 0xff);
+    QVector<uint8_t> src(frame->yuv_frame, frame->yuv_frame + yuvsize);
+
+    EncodeEnv encodeEnv = access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread);
+    access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread) = FFmpeg_Env;
+    Stub_Function::resetSub(::get_wayland_status, ADDR(Stub_Function, get_wayland_status_true));
+    Stub_Function::resetSub(::video_capture_get_encoder_input, ADDR(Stub_Function, video_capture_get_encoder_input_true));
+    Stub_Function::resetSub(::get_encoder_status, ADDR(Stub_Function, get_encoder_status_true));
+    Stub_Function::resetSub(::encoder_add_video_frame, ADDR(Stub_Function, encoder_add_video_frame_record));
+    Stub_Function::resetSub(::get_video_codec_ind, ADDR(Stub_Function, get_video_codec_ind_one));
+    Stub_Function::m_encoderFrame.clear();
+
+    m_processThread->init();
+    m_processThread->setState(true);
+    m_processThread->setFilter("warm");
+    m_processThread->setExposure(0);
+    m_processThread->setHorizontalMirror(true);
+    call_private_fun::MajorImageProcessingThreadrun(*m_processThread);
+
+    render_lut_t *pipeLut = access_private_field::MajorImageProcessingThreadm_pipeLut(*m_processThread);
+    ASSERT_NE(pipeLut, nullptr);
+    QVector<uint8_t> expected(yuvsize);
+    render_lut_process_yu12(pipeLut, src.constData(), expected.data(), nullptr, width, height, 1, 0);
+
+    ASSERT_EQ(Stub_Function::m_encoderFrame.size(), yuvsize);
+    EXPECT_EQ(memcmp(Stub_Function::m_encoderFrame.constData(), expected.constData(), static_cast<size_t>(yuvsize)), 0);
+
+    m_processThread->setFilter("");
+    Stub_Function::clearSub(::get_wayland_status);
+    Stub_Function::clearSub(::video_capture_get_encoder_input);
+    Stub_Function::clearSub(::get_encoder_status);
+    Stub_Function::clearSub(::encoder_add_video_frame);
+    Stub_Function::resetSub(::get_video_codec_ind, ADDR(Stub_Function, get_video_codec_ind));
+    access_private_field::MajorImageProcessingThreadm_eEncodeEnv(*m_processThread) = encodeEnv;
+}
+
+/**
+ *  @brief 1080p下原处理链(镜像->yu12转rgb->imageFilter24滤镜->曝光)与融合处理的耗时对比
+ */
+TEST_F(MajorImagePThTest, FusedPipelineBenchmark)
+{
+    const int width = 1920;
+    const int height = 1080;
+    const int loops = 20;
+    const int size = 33;
+
+    // 色度只随列变化，镜像前后的色度平面可直接对比
+    QVector<uint8_t> yuv(width * height * 3 / 2);
+    uint8_t *pu = yuv.data() + width * height;
+    uint8_t *pv = pu + width * height / 4;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            yuv[y * width + x] = static_cast<uint8_t>((x + y) & 0xff);
+    for (int y = 0; y < height / 2; y++)
+        for (int x = 0; x < width / 2; x++) {
+            pu[y * width / 2 + x] = static_cast<uint8_t>(64 + (x & 0x7f));
+            pv[y * width / 2 + x] = static_cast<uint8_t>(192 - (x & 0x7f));
+        }
+
+    // 原处理链使用imageFilter24逐帧解析滤镜，融合处理使用同一cube文件编译的LUT
+    QTemporaryDir lutDir;
+    ASSERT_TRUE(lutDir.isValid());
+    QString cubeFile = writeWarmCube(lutDir.path());
+    ASSERT_FALSE(cubeFile.isEmpty());
+    initFilters(lutDir.path().toLocal8Bit().constData());
+    render_lut_t *filterLut = render_lut_load(cubeFile.toLocal8Bit().constData());
+    ASSERT_NE(filterLut, nullptr);
+
+    // 融合LUT：在网格上依次执行滤镜和曝光(与MajorImageProcessingThread::pipelineLut一致)
+    QVector<uint8_t> pipeGrid(size * size * size * 3);
+    render_lut_identity_rgb24(pipeGrid.data(), size);
+    render_lut_apply_rgb24(filterLut, pipeGrid.data(), size, size * size, size * 3, 0);
+    exposure(pipeGrid.data(), size, size * size, 50);
+    render_lut_t *pipeLut = render_lut_create_rgb24(pipeGrid.data(), size);
+    ASSERT_NE(pipeLut, nullptr);
+
+    init_yuv2rgb_num_table();
+
+    QVector<uint8_t> mirror(yuv.size());
+    QVector<uint8_t> chainRgb(width * height * 3);
+    QVector<uint8_t> fusedRgb(width * height * 3);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < loops; i++) {
+        call_private_fun::MajorImageProcessingThreadImageHorizontalMirror(*m_processThread, yuv.data(), mirror.data(), width, height);
+        yu12_to_rgb24_higheffic(chainRgb.data(), mirror.data(), width, height);
+        imageFilter24(chainRgb.data(), width, height, "warm", 100);
+        exposure(chainRgb.data(), width, height, 50);
+    }
+    qint64 chainNs = timer.nsecsElapsed() / loops;
+
+    timer.restart();
+    for (int i = 0; i < loops; i++)
+        render_lut_process_yu12(pipeLut, yuv.data(), nullptr, fusedRgb.data(), width, height, 1, 0);
+    qint64 fusedNs = timer.nsecsElapsed() / loops;
+
+    qDebug() << "chain:" << chainNs / 1000 << "us, fused:" << fusedNs / 1000 << "us";
+
+    double diff = 0;
+    for (int i = 0; i < chainRgb.size(); i++)
+        diff += qAbs(chainRgb[i] - fusedRgb[i]);
+    EXPECT_LT(diff / chainRgb.size(), 3.0);
+
+    render_lut_free(filterLut);
+    render_lut_free(pipeLut);
+}
+
+/**
+ *  @brief yu12镜像：每个平面逐行反转，色度行顺序不变
+ */
+TEST_F(MajorImagePThTest, HorizontalMirrorPlanes)
+{
+    const int width = 68;
+    const int height = 6;
+    QVector<uint8_t> src(width * height * 3 / 2);
+    QVector<uint8_t> dst(src.size());
+    for (int i = 0; i < src.size(); i++)
+        src[i] = static_cast<uint8_t>(i * 7);
+
+    call_private_fun::MajorImageProcessingThreadImageHorizontalMirror(*m_processThread, src.data(), dst.data(), width, height);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            EXPECT_EQ(dst[y * width + x], src[y * width + width - 1 - x]);
+
+    const int cw = width / 2;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < cw; x++) {
+            int base = width * height;
+            EXPECT_EQ(dst[base + y * cw + x], src[base + y * cw + cw - 1 - x]);
+        }
+}
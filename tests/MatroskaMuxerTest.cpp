@@ -0,0 +1,218 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "MatroskaMuxerTest.h"
+
+#include <QFile>
+#include <QDir>
+#include <QStorageInfo>
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include "gviewencoder.h"
+#include "encoder.h"
+#include "matroska.h"
+#include "load_libs.h"
+}
+
+#define TEST_FRAME_MAX (64 * 1024)             //单帧上限
+#define TEST_SPACE_NEEDED (48LL * 1024 * 1024) //单个用例写入的最大数据量(长时间录制约30MB)
+
+MatroskaMuxerTest::MatroskaMuxerTest()
+{
+
+}
+
+void MatroskaMuxerTest::SetUp()
+{
+    //优先放在tmpfs上，容器中/dev/shm默认只有64MB，空间不足时使用临时目录
+    QString dir = QDir::tempPath();
+    QStorageInfo shm("/dev/shm");
+    if (shm.isValid() && shm.bytesAvailable() > TEST_SPACE_NEEDED)
+        dir = "/dev/shm";
+    m_fileName = dir + "/deepin-camera-mkv-test.mkv";
+    m_frame.resize(TEST_FRAME_MAX);
+    for (int i = 0; i < m_frame.size(); i++)
+        m_frame[i] = static_cast<char>(i * 7 + 3);
+}
+
+void MatroskaMuxerTest::TearDown()
+{
+    QFile::remove(m_fileName);
+    m_frame.clear();
+}
+
+/**
+ *  @brief 读取EBML变长整数(ID保留长度标记位)
+ */
+static quint64 readVint(const QByteArray &data, int &pos, bool keepMarker)
+{
+    quint8 first = static_cast<quint8>(data[pos]);
+    int len = 1;
+    quint8 mask = 0x80;
+    while (mask && !(first & mask)) {
+        mask >>= 1;
+        len++;
+    }
+    quint64 value = keepMarker ? first : (first & (mask - 1));
+    for (int i = 1; i < len; i++)
+        value = (value << 8) | static_cast<quint8>(data[pos + i]);
+    pos += len;
+    return value;
+}
+
+/**
+ *  @brief 长时间mkv录制：超过内存块的索引点写入临时文件，关闭时完整写入Cues
+ */
+TEST_F(MatroskaMuxerTest, Cues)
+{
+    const int frames = 10000; //全部为关键帧，超过两个索引块
+    mkv_context_t *ctx = mkv_create_context(m_fileName.toLocal8Bit().constData(), ENCODER_MUX_MKV);
+    ASSERT_NE(ctx, nullptr);
+    mkv_add_video_stream(ctx, 640, 480, 1, 30, AV_CODEC_ID_MJPEG);
+    mkv_write_header(ctx);
+
+    uint8_t *data = reinterpret_cast<uint8_t *>(m_frame.data());
+    for (int i = 0; i < frames; i++)
+        mkv_write_packet(ctx, 0, data, 1000 + i % 4000, 33, static_cast<uint64_t>(i) * 1000000000 / 30, AV_PKT_FLAG_KEY);
+    mkv_close(ctx);
+    int64_t offset = io_get_offset(ctx->writer);
+    mkv_destroy_context(ctx);
+
+    QFile file(m_fileName);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    QByteArray content = file.readAll();
+    ASSERT_EQ(content.size(), offset);
+
+    //跳过EBML头，遍历Segment的一级元素
+    int pos = 0;
+    readVint(content, pos, true);
+    pos += static_cast<int>(readVint(content, pos, false));
+    ASSERT_EQ(readVint(content, pos, true), quint64(0x18538067));
+    quint64 segmentSize = readVint(content, pos, false);
+    int segmentStart = pos;
+    EXPECT_EQ(segmentStart + segmentSize, quint64(content.size()));
+
+    int clusters = 0;
+    int cuePoints = 0;
+    int badPositions = 0;
+    while (pos < content.size()) {
+        quint64 id = readVint(content, pos, true);
+        int size = static_cast<int>(readVint(content, pos, false));
+        if (id == 0x1F43B675)
+            clusters++;
+        if (id == 0x1C53BB6B) {
+            //每个CuePoint: CueTime + CueTrackPositions(CueTrack, CueClusterPosition)
+            int cue = pos;
+            while (cue < pos + size) {
+                EXPECT_EQ(readVint(content, cue, true), quint64(0xBB));
+                int pointEnd = static_cast<int>(readVint(content, cue, false));
+                pointEnd += cue;
+                while (cue < pointEnd) {
+                    quint64 childId = readVint(content, cue, true);
+                    int childSize = static_cast<int>(readVint(content, cue, false));
+                    if (childId == 0xB7) {
+                        int track = cue;
+                        cue += childSize;
+                        while (track < cue) {
+                            quint64 trackId = readVint(content, track, true);
+                            int trackSize = static_cast<int>(readVint(content, track, false));
+                            if (trackId == 0xF1) {
+                                quint64 clusterPos = 0;
+                                for (int i = 0; i < trackSize; i++)
+                                    clusterPos = (clusterPos << 8) | static_cast<quint8>(content[track + i]);
+                                if (content.mid(segmentStart + static_cast<int>(clusterPos), 4) != QByteArray("\x1f\x43\xb6\x75", 4))
+                                    badPositions++;
+                            }
+                            track += trackSize;
+                        }
+                    } else {
+                        cue += childSize;
+                    }
+                }
+                cuePoints++;
+            }
+        }
+        pos += size;
+    }
+
+    EXPECT_EQ(clusters, frames);
+    EXPECT_EQ(cuePoints, frames);
+    EXPECT_EQ(badPositions, 0);
+}
+
+/**
+ *  @brief WebM+AV1录制：av1C包含序列头，数据块去掉时间分隔符OBU，libavformat可以读回
+ */
+TEST_F(MatroskaMuxerTest, WebmAv1)
+{
+    //轨道的编码ID来自编码器列表，没有AV1编码器时无法写入
+    if (get_video_codec_list_index(AV_CODEC_ID_AV1) < 0)
+        return;
+
+    //640x480，main profile，4.0级，8位4:2:0的序列头OBU
+    const uint8_t seqHeader[] = {0x0a, 0x0b, 0x00, 0x00, 0x00, 0x42, 0x62, 0x7f, 0xef, 0x98, 0x4f, 0x30, 0x08};
+    uint8_t av1c[sizeof(seqHeader) + 4];
+    ASSERT_EQ(av1_get_codec_config(seqHeader, sizeof(seqHeader), av1c), int(sizeof(av1c)));
+    EXPECT_EQ(av1c[0], 0x81);
+    EXPECT_EQ(av1c[1], 0x08);
+    EXPECT_EQ(av1c[2], 0x0c);
+    EXPECT_EQ(av1c[3], 0x00);
+    EXPECT_EQ(memcmp(av1c + 4, seqHeader, sizeof(seqHeader)), 0);
+
+    const int frames = 30;
+    mkv_context_t *ctx = mkv_create_context(m_fileName.toLocal8Bit().constData(), ENCODER_MUX_WEBM);
+    ASSERT_NE(ctx, nullptr);
+    stream_io_t *stream = mkv_add_video_stream(ctx, 640, 480, 30, 1, AV_CODEC_ID_AV1);
+    stream->extra_data = av1c;
+    stream->extra_data_size = sizeof(av1c);
+    ASSERT_EQ(mkv_write_header(ctx), 0);
+
+    //时间单元：时间分隔符 + 序列头(关键帧) + 帧OBU
+    QList<QByteArray> expected;
+    for (int i = 0; i < frames; i++) {
+        bool key = (i % 10) == 0;
+        QByteArray unit("\x12\x00", 2);
+        QByteArray payload;
+        if (key)
+            payload.append(reinterpret_cast<const char *>(seqHeader), sizeof(seqHeader));
+        payload.append(char(0x32)).append(char(100)).append(m_frame.left(100));
+        unit.append(payload);
+        expected.append(payload);
+        mkv_write_packet(ctx, 0, reinterpret_cast<uint8_t *>(unit.data()), unit.size(), 33,
+                         static_cast<uint64_t>(i) * 1000000000 / 30, key ? AV_PKT_FLAG_KEY : 0);
+    }
+    mkv_close(ctx);
+    mkv_destroy_context(ctx);
+
+    AVFormatContext *fmt = nullptr;
+    int ret = getAvformat()->m_avformat_open_input(&fmt, m_fileName.toLocal8Bit().constData(), nullptr, nullptr);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(fmt->nb_streams, 1u);
+    AVCodecParameters *par = fmt->streams[0]->codecpar;
+    EXPECT_EQ(par->codec_id, AV_CODEC_ID_AV1);
+    EXPECT_EQ(par->width, 640);
+    EXPECT_EQ(par->height, 480);
+    //解复用器导出的额外数据以序列头结束(去掉或保留av1C头)
+    ASSERT_GE(par->extradata_size, int(sizeof(seqHeader)));
+    EXPECT_EQ(memcmp(par->extradata + par->extradata_size - sizeof(seqHeader), seqHeader, sizeof(seqHeader)), 0);
+
+    AVPacket *pkt = getLoadLibsInstance()->m_av_packet_alloc();
+    int count = 0;
+    int mismatched = 0;
+    while (getAvformat()->m_av_read_frame(fmt, pkt) >= 0) {
+        if (count < expected.size() && QByteArray(reinterpret_cast<const char *>(pkt->data), pkt->size) != expected[count])
+            mismatched++;
+        if (count == 0)
+            EXPECT_TRUE(pkt->flags & AV_PKT_FLAG_KEY);
+        count++;
+        getLoadLibsInstance()->m_av_packet_unref(pkt);
+    }
+    getLoadLibsInstance()->m_av_packet_free(&pkt);
+    getAvformat()->m_avformat_close_input(&fmt);
+
+    EXPECT_EQ(count, frames);
+    EXPECT_EQ(mismatched, 0);
+}
@@ -0,0 +1,27 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef MATROSKAMUXERTEST_H
+#define MATROSKAMUXERTEST_H
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QByteArray>
+#include <QString>
+
+class MatroskaMuxerTest : public ::testing::Test
+{
+public:
+    MatroskaMuxerTest();
+    virtual void SetUp();
+    virtual void TearDown();
+
+protected:
+    QString m_fileName;  //输出文件(优先放在tmpfs上)
+    QByteArray m_frame;  //模拟的帧数据
+};
+
+#endif // MATROSKAMUXERTEST_H
@@ -0,0 +1,139 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "StreamSinkTest.h"
+
+#include <QFile>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QThread>
+#include <linux/videodev2.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include "gviewencoder.h"
+#include "encoder.h"
+}
+
+#define TEST_FRAME_MAX (64 * 1024) //单帧上限
+
+StreamSinkTest::StreamSinkTest()
+    : m_socket(-1)
+    , m_port(0)
+{
+
+}
+
+void StreamSinkTest::SetUp()
+{
+    m_fileName = QDir::tempPath() + "/deepin-camera-stream-test.avi";
+    m_frame.resize(TEST_FRAME_MAX);
+    m_frame.fill(0);
+
+    //本地回环上接收推流数据，由系统分配端口
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0)
+        return;
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addrLen = sizeof(addr);
+    if (bind(m_socket, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0
+            && getsockname(m_socket, reinterpret_cast<struct sockaddr *>(&addr), &addrLen) == 0)
+        m_port = ntohs(addr.sin_port);
+}
+
+void StreamSinkTest::TearDown()
+{
+    if (m_socket >= 0)
+        close(m_socket);
+    m_socket = -1;
+    m_port = 0;
+    QFile::remove(m_fileName);
+    m_frame.clear();
+}
+
+/**
+ *  @brief 直播推流：录制同时以MPEG-TS发送到本地UDP端口，从关键帧开始发送
+ */
+TEST_F(StreamSinkTest, Loopback)
+{
+    ASSERT_GE(m_socket, 0);
+    ASSERT_NE(m_port, 0);
+
+    encoder_video_context_t video = {};
+    encoder_context_t encoder = {};
+    encoder.enc_video_ctx = &video;
+    encoder.muxer_id = ENCODER_MUX_AVI;
+    encoder.input_format = V4L2_PIX_FMT_H264; //直接发送摄像头的编码数据
+    encoder.video_width = 640;
+    encoder.video_height = 480;
+    encoder.fps_num = 1;
+    encoder.fps_den = 30;
+    video.outbuf = reinterpret_cast<uint8_t *>(m_frame.data());
+
+    //Annex B格式：关键帧为SPS+IDR，其余为非IDR片
+    const char keyNal[] = {0, 0, 0, 1, 0x67, 0x42, 0, 0x1e, 0, 0, 0, 1, 0x65};
+    const char sliceNal[] = {0, 0, 0, 1, 0x41};
+
+    QString url = QString("udp://127.0.0.1:%1").arg(m_port);
+    encoder_set_stream_sink(url.toLocal8Bit().constData());
+    encoder_muxer_init(&encoder, m_fileName.toLocal8Bit().constData());
+    for (int i = 0; i < 60; i++) {
+        bool key = (i % 30) == 5; //前5帧不是关键帧，不应被发送
+        if (key)
+            memcpy(video.outbuf, keyNal, sizeof(keyNal));
+        else
+            memcpy(video.outbuf, sliceNal, sizeof(sliceNal));
+        video.pts = static_cast<int64_t>(i) * 1000000000 / 30;
+        video.flags = key ? AV_PKT_FLAG_KEY : 0;
+        video.outbuf_coded_size = 2000 + i;
+        encoder_write_video_data(&encoder);
+    }
+
+    //关闭时丢弃未发送的队列，先等待发送线程
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (encoder_get_stream_sink_stats(&sent, &dropped) && sent + dropped < 60 && timer.elapsed() < 2000)
+        QThread::msleep(10);
+    encoder_muxer_close(&encoder);
+    encoder_set_stream_sink(nullptr);
+
+    EXPECT_EQ(encoder_get_stream_sink_stats(&sent, &dropped), 1);
+    EXPECT_GT(sent, 0u);
+
+    //找到视频PID的第一个PES起始包，检查随机访问标志(关键帧)
+    bool found = false;
+    bool keyFrame = false;
+    char datagram[2048];
+    ssize_t len = 0;
+    while (!found && (len = recv(m_socket, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0) {
+        for (ssize_t pos = 0; pos + 188 <= len; pos += 188) {
+            const quint8 *ts = reinterpret_cast<const quint8 *>(datagram + pos);
+            ASSERT_EQ(ts[0], 0x47);
+            int pid = ((ts[1] & 0x1f) << 8) | ts[2];
+            bool unitStart = ts[1] & 0x40;
+            //跳过PAT、SDT和PMT
+            if (pid == 0x0000 || pid == 0x0011 || pid == 0x1000 || !unitStart)
+                continue;
+            bool adaptation = ts[3] & 0x20;
+            keyFrame = adaptation && ts[4] > 0 && (ts[5] & 0x40);
+            found = true;
+            break;
+        }
+    }
+
+    EXPECT_TRUE(found);
+    EXPECT_TRUE(keyFrame);
+}
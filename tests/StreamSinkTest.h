@@ -0,0 +1,29 @@
+// Copyright (C) 2020 ~ 2021 Uniontech Software Technology Co.,Ltd.
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef STREAMSINKTEST_H
+#define STREAMSINKTEST_H
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QByteArray>
+#include <QString>
+
+class StreamSinkTest : public ::testing::Test
+{
+public:
+    StreamSinkTest();
+    virtual void SetUp();
+    virtual void TearDown();
+
+protected:
+    QString m_fileName;  //同时录制的本地文件
+    QByteArray m_frame;  //编码帧缓冲
+    int m_socket;        //接收推流数据的本地UDP套接字
+    quint16 m_port;      //系统分配的端口
+};
+
+#endif // STREAMSINKTEST_H
@@ -1,5 +1,6 @@
 #include "stub_function.h"
 #include "stub.h"
+#include <QThread>
 extern "C"
 {
 #include "v4l2_devices.h"
@@ -15,6 +16,7 @@ v4l2_device_list_t *Stub_Function::m_v4l2_device_list3 =  nullptr;//三个摄像
 v4l2_frame_buff_t *Stub_Function::m_v4l2_frame_buff =  nullptr;//帧缓冲器
 v4l2_frame_buff_t *Stub_Function::m_v4l2_frame_buff2 =  nullptr;//帧缓冲器
 audio_context_t *Stub_Function::m_audio_ctx = nullptr;//音频上下文
+QByteArray Stub_Function::m_encoderFrame;//最近一次送入编码器的帧数据
 Stub    Stub_Function::m_stub;
 
 
@@ -226,6 +228,11 @@ int Stub_Function::v4l2core_update_current_format_Not_OK(v4l2_dev_t *vd)
     return -10;
 }
 
+int Stub_Function::v4l2core_switch_format(v4l2_dev_t *vd)
+{
+    return 0;
+}
+
 int Stub_Function::v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
     return 0;
@@ -256,6 +263,27 @@ int Stub_Function::v4l2core_get_requested_frame_format_yuv(v4l2_dev_t *vd)
     return V4L2_PIX_FMT_NV12;
 }
 
+int Stub_Function::get_wayland_status_true()
+{
+    return 1;
+}
+
+int Stub_Function::video_capture_get_encoder_input_true()
+{
+    return 1;
+}
+
+int Stub_Function::get_encoder_status_true()
+{
+    return 1;
+}
+
+int Stub_Function::encoder_add_video_frame_record(uint8_t *frame, int size, int64_t timestamp, int isKeyframe)
+{
+    m_encoderFrame = QByteArray(reinterpret_cast<const char *>(frame), size);
+    return 0;
+}
+
 int Stub_Function::get_capture_pause_true()
 {
     return 1;
@@ -306,6 +334,13 @@ int Stub_Function::audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_
     return 1;
 }
 
+int Stub_Function::audio_wait_buffer(audio_context_t *audio_ctx, int timeout_ms)
+{
+    Q_UNUSED(timeout_ms);
+    QThread::usleep(1000);
+    return 1;
+}
+
 QVariant Stub_Function::toString()
 {
     return "/a";
@@ -381,6 +416,11 @@ int Stub_Function::get_video_codec_ind()
     return 0;
 }
 
+int Stub_Function::get_video_codec_ind_one()
+{
+    return 1;
+}
+
 QList<QSize> Stub_Function::getSupportResolutionsSize()
 {
     QList<QSize> resolutions;
@@ -604,6 +644,7 @@ void Stub_Function::initSub()
     m_stub.set(::get_resolution_status, ADDR(Stub_Function, get_resolution_status));
     m_stub.set(::v4l2core_clean_buffers, ADDR(Stub_Function, v4l2core_clean_buffers));
     m_stub.set(::v4l2core_update_current_format, ADDR(Stub_Function, v4l2core_update_current_format_OK));
+    m_stub.set(::v4l2core_switch_format, ADDR(Stub_Function, v4l2core_switch_format));
     m_stub.set(::v4l2core_prepare_valid_format, ADDR(Stub_Function, v4l2core_prepare_valid_format));
     m_stub.set(::v4l2core_prepare_valid_resolution, ADDR(Stub_Function, v4l2core_prepare_valid_resolution));
     m_stub.set(::get_v4l2_device_handler, ADDR(Stub_Function, get_v4l2_device_handler));
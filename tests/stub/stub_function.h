@@ -86,6 +86,7 @@ public:
     //更新当前格式
     int v4l2core_update_current_format_OK(v4l2_dev_t *vd);//返回零
     int v4l2core_update_current_format_Not_OK(v4l2_dev_t *vd);//返回非零
+    int v4l2core_switch_format(v4l2_dev_t *vd);//返回零
     //释放帧数据
     int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
     //有效格式
@@ -108,12 +109,21 @@ public:
     double encoder_buff_scheduler_one(int mode, double thresh, double max_time);
     //h264帧率设置
     int v4l2core_set_h264_frame_rate_config(v4l2_dev_t *vd, uint32_t framerate);
+    //wayland环境(使用rgb显示)
+    int get_wayland_status_true();
+    //编码器输入已启用(录像或预录)
+    int video_capture_get_encoder_input_true();
+    //编码线程已启动
+    int get_encoder_status_true();
+    //记录送入编码器的帧数据
+    int encoder_add_video_frame_record(uint8_t *frame, int size, int64_t timestamp, int isKeyframe);
 
     //获取音频上下文
     audio_context_t *get_audio_context();
     int audio_start(audio_context_t *audio_ctx);
     int audio_stop(audio_context_t *audio_ctx);
     int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int type, uint32_t mask);
+    int audio_wait_buffer(audio_context_t *audio_ctx, int timeout_ms);
 
     //mainwindow
     //返回不存在的路径
@@ -136,6 +146,7 @@ public:
     int check_device_list_events(v4l2_dev_t *vd);
     void devnumMonitorStartCheck();
     int get_video_codec_ind();
+    int get_video_codec_ind_one();//非raw编码，送入yu12帧
 
     // Camera类相关桩函数--------------------begin
     QList<QSize> getSupportResolutionsSize();
@@ -167,6 +178,8 @@ public:
 
     //初始化所有的桩函数
     static void initSub();
+
+    static QByteArray m_encoderFrame;//最近一次送入编码器的帧数据
 private:
     //定义静态成员变量用于打桩时多次调用
     static v4l2_dev_t *m_v4l2_dev;//设备属性